@@ -0,0 +1,197 @@
+#include "client.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+short writes under backpressure: the server gets a tiny send buffer on every
+accepted socket and its readers take a few bytes per step, while one client
+floods them with messages. Every message carries its number and a payload
+derived from it, the readers check that all of them arrive whole and in
+order. Reports how many sends the kernel only took in part and the bytes
+delivered per second.
+
+usage: bench_backpressure [port] [readers] [messages] [buffer bytes]
+                          [bytes read per step]
+*/
+
+#define BACKPRESSURE_TEXT 700
+#define BACKPRESSURE_TIMEOUT 60000UL
+
+struct reader {
+    unsigned long next;
+    unsigned long broken;
+};
+
+static struct client *backpressure_clients;
+static size_t backpressure_count;
+static long backpressure_sender = -1;
+static int backpressure_buffer;
+static unsigned long backpressure_sends;
+static unsigned long backpressure_short;
+
+static void text_fill(char *text, unsigned long number)
+{
+    size_t idx = (size_t)sprintf(text, "%lu ", number);
+
+    for (; idx < BACKPRESSURE_TEXT; idx++)
+        text[idx] = (char)('a' + (number + idx) % 26);
+    text[BACKPRESSURE_TEXT] = '\0';
+}
+
+/*the sends of the clients are not counted*/
+static void sends_count(const sxp_t *sock, sxpResult result, size_t sent,
+                        size_t size)
+{
+    size_t idx;
+
+    for (idx = 0; idx < backpressure_count; idx++) {
+        if (backpressure_clients[idx].socket == *sock)
+            return;
+    }
+    backpressure_sends++;
+    if (result == SXP_SUCCESS && sent < size)
+        backpressure_short++;
+}
+
+static sxpResult stub_accept(sxp_t *sock, sxp_t *newsock, int nonblockingio)
+{
+    sxpResult result = sxp_platform.accept(sock, newsock, nonblockingio);
+
+    if (result == SXP_SUCCESS)
+        (void)setsockopt(*newsock, SOL_SOCKET, SO_SNDBUF,
+                         (const char *)&backpressure_buffer,
+                         sizeof(backpressure_buffer));
+    return result;
+}
+
+static sxpResult stub_send(sxp_t *sock, const char *data, size_t *num_sent,
+                           size_t size)
+{
+    sxpResult result = sxp_platform.send(sock, data, num_sent, size);
+
+    sends_count(sock, result, *num_sent, size);
+    return result;
+}
+
+static sxpResult stub_sendv(sxp_t *sock, const sxp_buffer_t buffers[],
+                            size_t count, size_t *num_sent)
+{
+    sxpResult result = sxp_platform.sendv(sock, buffers, count, num_sent);
+    size_t size = 0;
+    size_t idx;
+
+    for (idx = 0; idx < count; idx++)
+        size += buffers[idx].size;
+    sends_count(sock, result, *num_sent, size);
+    return result;
+}
+
+static void on_message(struct client *client,
+                       const struct protocol_packet_message *message)
+{
+    struct reader *reader = client->data;
+    char text[BACKPRESSURE_TEXT + 1];
+
+    if ((long)message->person_id != backpressure_sender)
+        return;
+    text_fill(text, reader->next);
+    if (strcmp(message->message, text))
+        reader->broken++;
+    reader->next++;
+}
+
+int main(int argc, char **argv)
+{
+    const char *port = argc > 1 ? argv[1] : "27003";
+    size_t count = (argc > 2 ? strtoul(argv[2], NULL, 10) : 8) + 1;
+    unsigned long messages = argc > 3 ? strtoul(argv[3], NULL, 10) : 20000;
+    size_t read_limit = argc > 5 ? strtoul(argv[5], NULL, 10) : 4096;
+    sxp_vtable_t stub = sxp_platform;
+    struct client *clients;
+    struct client *sender;
+    struct reader *readers;
+    unsigned long sent = 0, broken = 0, started, elapsed;
+    char text[BACKPRESSURE_TEXT + 1];
+    size_t idx;
+    int done = 0;
+
+    backpressure_buffer = argc > 4 ? atoi(argv[4]) : 2048;
+    clients = calloc(count, sizeof(*clients));
+    readers = calloc(count, sizeof(*readers));
+    if (!clients || !readers)
+        return 1;
+    sender = &clients[0];
+    stub.accept = stub_accept;
+    stub.send = stub_send;
+    stub.sendv = stub_sendv;
+    encrypt_init();
+    sxp_vtable_set(&stub);
+    if (net_init() != NET_SUCCESS || net_serve(port) != NET_SUCCESS) {
+        fprintf(stderr, "backpressure: could not serve on %s\n", port);
+        return 1;
+    }
+    for (idx = 0; idx < count; idx++) {
+        if (client_connect(&clients[idx], "127.0.0.1", port) != NET_SUCCESS) {
+            fprintf(stderr, "backpressure: client %lu could not connect\n",
+                    (unsigned long)idx);
+            return 1;
+        }
+        if (idx) {
+            clients[idx].read_limit = read_limit;
+            clients[idx].on_message = on_message;
+            clients[idx].data = &readers[idx];
+        }
+        while (!clients[idx].closed && clients[idx].id < 0)
+            (void)clients_step(&clients[idx], 1);
+    }
+    backpressure_clients = clients;
+    backpressure_count = count;
+    backpressure_sender = sender->id;
+    backpressure_sends = 0;
+    backpressure_short = 0;
+
+    started = sxp_clock();
+    while (!done && sxp_clock() - started < BACKPRESSURE_TIMEOUT) {
+        if (clients_step(clients, count) != NET_SUCCESS)
+            break;
+        /*as fast as the server reads, the readers set the pace*/
+        while (sent < messages && client_queued(sender) < 4 * sizeof(text)) {
+            text_fill(text, sent);
+            if (client_send(sender, text) != NET_SUCCESS)
+                break;
+            sent++;
+        }
+        done = 1;
+        for (idx = 1; idx < count; idx++) {
+            if (!clients[idx].closed && readers[idx].next < messages)
+                done = 0;
+        }
+    }
+
+    elapsed = sxp_clock() - started;
+    for (idx = 1; idx < count; idx++) {
+        broken += readers[idx].broken;
+        if (clients[idx].closed) {
+            fprintf(stderr, "backpressure: reader %lu was closed\n",
+                    (unsigned long)idx);
+            done = 0;
+        } else if (readers[idx].next < messages) {
+            fprintf(stderr, "backpressure: reader %lu received %lu of %lu\n",
+                    (unsigned long)idx, readers[idx].next, messages);
+        }
+    }
+    printf("backpressure: %lu readers, %lu messages in %lu ms, %.1f MB/s, "
+           "%lu of %lu sends short, %lu messages broken\n",
+           (unsigned long)count - 1, messages, elapsed,
+           (double)messages * BACKPRESSURE_TEXT * (count - 1) /
+               ((elapsed + 1) * 1000.0),
+           backpressure_short, backpressure_sends, broken);
+
+    for (idx = 0; idx < count; idx++)
+        client_close(&clients[idx]);
+    net_reset();
+    net_exit();
+    free(clients);
+    free(readers);
+    return done && !broken ? 0 : 1;
+}
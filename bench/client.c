@@ -0,0 +1,312 @@
+#include "client.h"
+#include "netio.h"
+#include <string.h>
+#include <time.h>
+
+#define CLIENT_READ 4096
+
+static netResult client_queue(struct client *client,
+                              const struct protocol_packet *packet);
+static netResult client_flush(struct client *client);
+static netResult client_read(struct client *client);
+static netResult client_handle(struct client *client,
+                               struct protocol_packet *packet);
+
+netResult client_connect(struct client *client, const char *host,
+                         const char *port)
+{
+    struct protocol_packet handshake;
+    struct sockaddr_storage local;
+    size_t addrlen;
+    addrinfo_t hints;
+    addrinfo_t *addresses = NULL;
+    sockaddr_t *address;
+    sxpResult result;
+
+    memset(client, 0, sizeof(*client));
+    client->id = -1;
+    /*the port is ignored for the socket file of a server*/
+    if (host && !strncmp(host, NETIO_UNIX_PREFIX, strlen(NETIO_UNIX_PREFIX))) {
+        if (sxp_unix_address(&local, &addrlen,
+                             host + strlen(NETIO_UNIX_PREFIX)) != SXP_SUCCESS)
+            return NET_ERROR;
+        address = (sockaddr_t *)&local;
+        result = sxp_create(&client->socket, local.ss_family, SOCK_STREAM, 0);
+    } else {
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (sxp_addrinfo_get(&addresses, host, port, &hints) != SXP_SUCCESS)
+            return NET_ERROR;
+        address = addresses->ai_addr;
+        addrlen = addresses->ai_addrlen;
+        result = sxp_create(&client->socket, addresses->ai_family,
+                            addresses->ai_socktype, addresses->ai_protocol);
+    }
+    if (result != SXP_SUCCESS) {
+        if (addresses)
+            sxp_addrinfo_free(addresses);
+        return NET_ERROR;
+    }
+    if ((result = sxp_nbio_set(&client->socket, SXP_NONBLOCKING)) ==
+        SXP_SUCCESS)
+        result = sxp_connect(&client->socket, address, addrlen);
+    if (addresses)
+        sxp_addrinfo_free(addresses);
+    /*the handshake stays queued until the connection is established*/
+    if (result != SXP_SUCCESS && result != SXP_ASYNC) {
+        sxp_destroy(&client->socket);
+        return NET_ERROR;
+    }
+
+    handshake.type = NET_PROTO_HANDSHAKE_C;
+    handshake.as.handshake_c.proto_ver = 0;
+    handshake.as.handshake_c.proto_flags = 0;
+    if (client_queue(client, &handshake) != NET_SUCCESS) {
+        client_close(client);
+        return NET_ERROR;
+    }
+    return NET_SUCCESS;
+}
+
+netResult client_send(struct client *client, const char *message)
+{
+    struct protocol_packet packet;
+
+    if (client->closed || client->id < 0)
+        return NET_ERROR;
+    packet.type = NET_PROTO_MESSAGE;
+    packet.as.message.person_id = client->id;
+    packet.as.message.encryption = 0;
+    packet.as.message.index = -1;
+    packet.as.message.message = (char *)message;
+    if (client_queue(client, &packet) != NET_SUCCESS)
+        return NET_ERROR;
+    return client_flush(client);
+}
+
+netResult client_history(struct client *client)
+{
+    struct protocol_packet packet;
+
+    if (client->closed || client->id < 0)
+        return NET_ERROR;
+    packet.type = NET_PROTO_INFO_C;
+    packet.as.info_c.info_type = NET_PINFO_AUDIENCE | NET_PINFO_HISTORY;
+    if (client_queue(client, &packet) != NET_SUCCESS)
+        return NET_ERROR;
+    return client_flush(client);
+}
+
+netResult client_ping(struct client *client, unsigned long token)
+{
+    return client_pings(client, token, 1);
+}
+
+netResult client_pings(struct client *client, unsigned long token,
+                       size_t count)
+{
+    struct protocol_packet packet;
+    size_t idx;
+
+    if (client->closed || client->id < 0)
+        return NET_ERROR;
+    packet.type = NET_PROTO_PING;
+    for (idx = 0; idx < count; idx++) {
+        packet.as.ping.token = token + idx;
+        if (client_queue(client, &packet) != NET_SUCCESS)
+            return NET_ERROR;
+    }
+    return client_flush(client);
+}
+
+size_t client_queued(const struct client *client)
+{
+    return client->out.size - client->out_sent;
+}
+
+netResult client_poll(struct client *client)
+{
+    if (client->closed)
+        return NET_ERROR;
+    if (client_flush(client) != NET_SUCCESS ||
+        client_read(client) != NET_SUCCESS) {
+        client->closed = 1;
+        return NET_ERROR;
+    }
+    return NET_SUCCESS;
+}
+
+void client_close(struct client *client)
+{
+    sxp_destroy(&client->socket);
+    packet_free(&client->in);
+    packet_free(&client->out);
+    client->out_sent = 0;
+    client->closed = 1;
+}
+
+netResult clients_step(struct client clients[], size_t count)
+{
+    netResult result;
+    size_t idx;
+
+    if ((result = net_tick()) != NET_SUCCESS)
+        return result;
+    for (idx = 0; idx < count; idx++) {
+        if (!clients[idx].closed)
+            (void)client_poll(&clients[idx]);
+    }
+    return NET_SUCCESS;
+}
+
+unsigned long bench_now()
+{
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (unsigned long)(now.QuadPart / frequency.QuadPart * 1000000 +
+                           now.QuadPart % frequency.QuadPart * 1000000 /
+                               frequency.QuadPart);
+#else
+    struct timespec now;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+int bench_compare(const void *first, const void *second)
+{
+    unsigned long one = *(const unsigned long *)first;
+    unsigned long other = *(const unsigned long *)second;
+    return one < other ? -1 : one > other;
+}
+
+static netResult client_queue(struct client *client,
+                              const struct protocol_packet *packet)
+{
+    net_buffer_t body = { 0 };
+    netResult result = NET_ERROR;
+
+    /*what was sent is dropped before the queue grows*/
+    if (client->out_sent) {
+        memmove(client->out.buffer, client->out.buffer + client->out_sent,
+                client->out.size - client->out_sent);
+        client->out.size -= client->out_sent;
+        client->out_sent = 0;
+    }
+    if (packet_serialize(&body, packet) == PACKET_SUCCESS &&
+        packet_send_packet(&client->out, &body) == PACKET_SUCCESS)
+        result = NET_SUCCESS;
+    packet_free(&body);
+    return result;
+}
+
+static netResult client_flush(struct client *client)
+{
+    size_t num_sent;
+    sxpResult result;
+
+    while (client->out_sent < client->out.size) {
+        result = sxp_send(&client->socket,
+                          client->out.buffer + client->out_sent, &num_sent,
+                          client->out.size - client->out_sent);
+        if (result == SXP_TRY_AGAIN)
+            return NET_SUCCESS;
+        if (result != SXP_SUCCESS)
+            return NET_ERROR;
+        client->out_sent += num_sent;
+    }
+    client->out.size = 0;
+    client->out_sent = 0;
+    return NET_SUCCESS;
+}
+
+static netResult client_read(struct client *client)
+{
+    net_buffer_t view;
+    net_buffer_t frame;
+    struct protocol_packet packet;
+    size_t limit = client->read_limit;
+    size_t num_read;
+    sxpResult result;
+    netResult handled;
+
+    for (;;) {
+        size_t room;
+        if (client->in.capacity - client->in.size < CLIENT_READ &&
+            packet_realloc(&client->in, client->in.size + CLIENT_READ) !=
+                PACKET_SUCCESS)
+            return NET_ERROR;
+        room = client->in.capacity - client->in.size;
+        if (client->read_limit && room > limit)
+            room = limit;
+        if (!room)
+            break;
+        result = sxp_recv(&client->socket,
+                          client->in.buffer + client->in.size, &num_read,
+                          room);
+        if (result == SXP_TRY_AGAIN)
+            break;
+        if (result != SXP_SUCCESS || !num_read)
+            return NET_ERROR;
+        client->in.size += num_read;
+        client->bytes_in += num_read;
+        limit -= num_read;
+    }
+
+    /*packet_peek_packet reads from size up to capacity*/
+    view.buffer = client->in.buffer;
+    view.size = 0;
+    view.capacity = client->in.size;
+    while (packet_peek_packet(&view, &frame) == PACKET_SUCCESS) {
+        while (frame.size < frame.capacity) {
+            if (packet_deserialize(&frame, &packet) != PACKET_SUCCESS)
+                return NET_ERROR;
+            handled = client_handle(client, &packet);
+            if (packet.type == NET_PROTO_PERSON)
+                free(packet.as.person.name);
+            if (packet.type == NET_PROTO_MESSAGE)
+                free(packet.as.message.message);
+            if (handled != NET_SUCCESS)
+                return NET_ERROR;
+        }
+    }
+    memmove(client->in.buffer, client->in.buffer + view.size,
+            client->in.size - view.size);
+    client->in.size -= view.size;
+    return NET_SUCCESS;
+}
+
+static netResult client_handle(struct client *client,
+                               struct protocol_packet *packet)
+{
+    switch (packet->type) {
+    case NET_PROTO_HANDSHAKE_S:
+        client->id = packet->as.handshake_s.self_id;
+        break;
+    case NET_PROTO_MESSAGE:
+        client->messages++;
+        if (client->on_message)
+            client->on_message(client, &packet->as.message);
+        break;
+    case NET_PROTO_PONG:
+        client->pongs++;
+        break;
+    case NET_PROTO_PING:
+        packet->type = NET_PROTO_PONG;
+        if (client_queue(client, packet) != NET_SUCCESS)
+            return NET_ERROR;
+        break;
+    case NET_PROTO_BUSY:
+        client->busy = 1;
+        return NET_ERROR;
+    default:
+        break;
+    }
+    return NET_SUCCESS;
+}
@@ -0,0 +1,69 @@
+#ifndef CLIENT_H_
+#define CLIENT_H_
+
+#include "net.h"
+#include "packet.h"
+#include "protocol.h"
+#include "socketxp.h"
+
+/*
+a chat client for the benchmarks, which serve and drive their clients from a
+single thread: every step calls net_tick once and client_poll on every
+client. Clients never block, what cannot be sent at once is queued and sent
+by client_poll. Pings are answered, so that idle clients are not closed.
+*/
+struct client {
+    sxp_t socket;
+    /*the id assigned by the server, -1 until the handshake is done*/
+    long id;
+    /*nonzero once the connection is gone or the server was busy*/
+    int closed;
+    int busy;
+    /*messages received, including the own ones echoed by the server*/
+    unsigned long messages;
+    unsigned long bytes_in;
+    /*pongs received*/
+    unsigned long pongs;
+    /*bytes read per call of client_poll, 0 for as many as there are*/
+    size_t read_limit;
+    /*called for every message received, may be NULL*/
+    void (*on_message)(struct client *client,
+                       const struct protocol_packet_message *message);
+    /*left to the benchmark*/
+    void *data;
+
+    net_buffer_t in;
+    net_buffer_t out;
+    size_t out_sent;
+};
+
+/*
+connects to port on host (ignored by sxp_loopback), or to the socket file of
+a server if host is unix:path, and sends the handshake
+*/
+netResult client_connect(struct client *client, const char *host,
+                         const char *port);
+/*queues a message to everyone*/
+netResult client_send(struct client *client, const char *message);
+/*asks the server for everyone present and the messages sent before*/
+netResult client_history(struct client *client);
+/*asks the server for a pong, which only this client receives*/
+netResult client_ping(struct client *client, unsigned long token);
+/*queues count pings with the tokens from token on and sends them at once*/
+netResult client_pings(struct client *client, unsigned long token,
+                       size_t count);
+/*bytes queued and not sent yet*/
+size_t client_queued(const struct client *client);
+/*sends what is queued and handles what was received*/
+netResult client_poll(struct client *client);
+void client_close(struct client *client);
+
+/*net_tick and client_poll on every open client*/
+netResult clients_step(struct client clients[], size_t count);
+
+/*microseconds of a monotonic clock, only differences are meaningful*/
+unsigned long bench_now();
+/*orders unsigned longs for qsort, such as the times the benchmarks took*/
+int bench_compare(const void *first, const void *second);
+
+#endif /*CLIENT_H_*/
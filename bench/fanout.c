@@ -0,0 +1,131 @@
+#include "client.h"
+#include "loopback.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+what fanning a message out to every client costs the server. The listeners
+stop reading once they have joined and their sxp_loopback buffers fill up,
+so a broadcast only queues the frame on every one of them and nothing is
+written. Only the processor time spent in net_tick until the sender reads
+its own message back is counted. Frames are shared by reference, so the cost
+should grow with the listeners but hardly with the size of the message. Run
+it with different sizes to compare. Afterwards the listeners read everything
+and have to receive every message.
+
+usage: bench_fanout [listeners] [messages] [message bytes]
+*/
+
+#define FANOUT_PORT "7001"
+/*loopback buffer of the listeners, filled by the first message*/
+#define FANOUT_BUFFER 1024
+#define FANOUT_HIGH (3 * 1024 * 1024)
+#define FANOUT_STEPS 1000000UL
+
+int main(int argc, char **argv)
+{
+    size_t count = (argc > 1 ? strtoul(argv[1], NULL, 10) : 1000) + 1;
+    unsigned long messages = argc > 2 ? strtoul(argv[2], NULL, 10) : 200;
+    size_t size = argc > 3 ? strtoul(argv[3], NULL, 10) : 1024;
+    /*everything stays queued on the listeners until they read again*/
+    struct net_policy policy = { NET_POLICY_PAUSE, FANOUT_HIGH,
+                                 FANOUT_HIGH / 2, 0 };
+    struct client *clients;
+    struct client *sender;
+    unsigned long sent, steps = 0;
+    clock_t spent = 0, before;
+    char *text;
+    size_t idx;
+    int done = 0;
+
+    /*the first message has to fill the buffers of the listeners*/
+    if (size < FANOUT_BUFFER)
+        size = FANOUT_BUFFER;
+    if ((messages + 1) * size >= FANOUT_HIGH) {
+        fprintf(stderr, "fanout: at most %lu bytes of messages\n",
+                (unsigned long)FANOUT_HIGH);
+        return 1;
+    }
+    clients = calloc(count, sizeof(*clients));
+    text = malloc(size + 1);
+    if (!clients || !text)
+        return 1;
+    memset(text, 'x', size);
+    text[size] = '\0';
+    sender = &clients[count - 1];
+    encrypt_init();
+    sxp_vtable_set(&sxp_loopback);
+    sxp_loopback_set(0, FANOUT_BUFFER);
+    if (net_init() != NET_SUCCESS ||
+        net_policy_set(NET_CLASS_GUEST, &policy) != NET_SUCCESS ||
+        net_outbound_max_set(count * FANOUT_HIGH) != NET_SUCCESS ||
+        net_timeouts_set(0, 0) != NET_SUCCESS ||
+        net_serve(FANOUT_PORT) != NET_SUCCESS) {
+        fprintf(stderr, "fanout: could not serve\n");
+        return 1;
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        /*the sender reads its messages back at once*/
+        if (idx == count - 1)
+            sxp_loopback_set(0, LOOPBACK_BUFFER);
+        if (client_connect(&clients[idx], NULL, FANOUT_PORT) != NET_SUCCESS) {
+            fprintf(stderr, "fanout: client %lu could not connect\n",
+                    (unsigned long)idx);
+            return 1;
+        }
+        while (!clients[idx].closed && clients[idx].id < 0)
+            (void)clients_step(clients, idx + 1);
+    }
+
+    for (sent = 0; sent <= messages && !sender->closed; sent++) {
+        if (client_send(sender, text) != NET_SUCCESS)
+            break;
+        while (sender->messages <= sent && !sender->closed) {
+            before = clock();
+            if (net_tick() != NET_SUCCESS)
+                break;
+            /*the first message only fills the buffers*/
+            if (sent)
+                spent += clock() - before;
+            (void)client_poll(sender);
+        }
+    }
+    printf("fanout: %lu listeners, %lu messages of %lu bytes, %.1f us "
+           "processor time each, %.1f ns per listener\n",
+           (unsigned long)count - 1, sent ? sent - 1 : 0,
+           (unsigned long)size,
+           sent > 1 ? (double)spent * 1000000 / CLOCKS_PER_SEC / (sent - 1) :
+                      0.0,
+           sent > 1 ? (double)spent * 1000000000 / CLOCKS_PER_SEC /
+                          (sent - 1) / (count - 1) :
+                      0.0);
+
+    while (!done && steps < FANOUT_STEPS) {
+        if (clients_step(clients, count) != NET_SUCCESS)
+            break;
+        steps++;
+        done = 1;
+        for (idx = 0; idx < count; idx++) {
+            if (clients[idx].messages < messages + 1)
+                done = 0;
+        }
+    }
+    for (idx = 0; idx < count; idx++) {
+        if (clients[idx].closed || clients[idx].messages != messages + 1) {
+            fprintf(stderr, "fanout: client %lu received %lu of %lu\n",
+                    (unsigned long)idx, clients[idx].messages,
+                    messages + 1);
+            done = 0;
+        }
+    }
+
+    for (idx = 0; idx < count; idx++)
+        client_close(&clients[idx]);
+    net_reset();
+    net_exit();
+    free(clients);
+    free(text);
+    return done ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include "client.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+round trips of a well behaved client while another one floods the server
+with pings. The flooder queues a batch of them whenever it has sent the
+previous one, the other client sends its next ping once it has the pong of
+the previous one. Reports the median and the 99th percentile of the round
+trips and the pings of the flooder answered per second.
+bench_flood_unbudgeted is built without the read and frame budgets per
+connection, so the server reads and handles all that the flooder sent
+before it gets to the other client, as it used to.
+
+usage: bench_flood [port] [round trips] [pings per batch of the flooder]
+*/
+
+#define FLOOD_TIMEOUT 60000UL
+
+int main(int argc, char **argv)
+{
+    const char *port = argc > 1 ? argv[1] : "27016";
+    unsigned long rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+    unsigned long batch = argc > 3 ? strtoul(argv[3], NULL, 10) : 10000;
+    struct client clients[2];
+    struct client *flooder = &clients[0];
+    struct client *client = &clients[1];
+    unsigned long *took;
+    unsigned long round = 0, token = 0, sent, started;
+    size_t idx;
+
+    if (!rounds || !(took = calloc(rounds, sizeof(*took))))
+        return 1;
+    encrypt_init();
+    if (net_init() != NET_SUCCESS || net_serve(port) != NET_SUCCESS) {
+        fprintf(stderr, "flood: could not serve on %s\n", port);
+        return 1;
+    }
+    for (idx = 0; idx < 2; idx++) {
+        if (client_connect(&clients[idx], "127.0.0.1", port) != NET_SUCCESS) {
+            fprintf(stderr, "flood: client %lu could not connect\n",
+                    (unsigned long)idx);
+            return 1;
+        }
+        while (!clients[idx].closed && clients[idx].id < 0)
+            (void)clients_step(&clients[idx], 1);
+    }
+
+    started = sxp_clock();
+    sent = bench_now();
+    if (client_ping(client, round) != NET_SUCCESS)
+        return 1;
+    while (round < rounds && sxp_clock() - started < FLOOD_TIMEOUT) {
+        /*the next batch once the previous one has been sent*/
+        if (!client_queued(flooder) &&
+            client_pings(flooder, token, batch) == NET_SUCCESS)
+            token += batch;
+        if (clients_step(clients, 2) != NET_SUCCESS || client->closed)
+            break;
+        if (client->pongs > round) {
+            took[round++] = bench_now() - sent;
+            sent = bench_now();
+            if (round < rounds && client_ping(client, round) != NET_SUCCESS)
+                break;
+        }
+    }
+
+    if (flooder->closed)
+        fprintf(stderr, "flood: the flooder was closed\n");
+    qsort(took, round, sizeof(*took), bench_compare);
+    printf("%s: %lu round trips, median %lu us, p99 %lu us, "
+           "%.0f pings of the flooder answered per second\n",
+           argv[0], round, round ? took[round / 2] : 0,
+           round ? took[round * 99 / 100] : 0,
+           (double)flooder->pongs * 1000 / (sxp_clock() - started + 1));
+
+    for (idx = 0; idx < 2; idx++)
+        client_close(&clients[idx]);
+    net_reset();
+    net_exit();
+    free(took);
+    return round == rounds ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include "client.h"
+#include <stdio.h>
+#include <time.h>
+
+/*
+what idle clients cost a server: one client pings the server over and over
+while all others stay connected and silent. With epoll a round trip should
+cost the same however many clients idle, bench_idle_poll is built with the
+poll() poller which looks at every one of them on every wait.
+
+usage: bench_idle [port] [idle clients] [round trips]
+*/
+
+#define IDLE_SERVICE 256
+
+int main(int argc, char **argv)
+{
+    const char *port = argc > 1 ? argv[1] : "27001";
+    size_t count = (argc > 2 ? strtoul(argv[2], NULL, 10) : 1000) + 1;
+    unsigned long rounds = argc > 3 ? strtoul(argv[3], NULL, 10) : 10000;
+    struct client *clients;
+    struct client *active;
+    unsigned long round, started, ticks = 0;
+    clock_t processor;
+    size_t idx;
+
+    if (!(clients = calloc(count, sizeof(*clients))))
+        return 1;
+    active = &clients[0];
+    encrypt_init();
+    if (net_init() != NET_SUCCESS || net_serve(port) != NET_SUCCESS) {
+        fprintf(stderr, "idle: could not serve on %s\n", port);
+        return 1;
+    }
+    for (idx = 0; idx < count; idx++) {
+        if (client_connect(&clients[idx], "127.0.0.1", port) != NET_SUCCESS) {
+            fprintf(stderr, "idle: client %lu could not connect\n",
+                    (unsigned long)idx);
+            return 1;
+        }
+        while (!clients[idx].closed && clients[idx].id < 0)
+            (void)clients_step(&clients[idx], 1);
+    }
+
+    started = sxp_clock();
+    processor = clock();
+    for (round = 0; round < rounds && !active->closed; round++) {
+        if (client_ping(active, round) != NET_SUCCESS)
+            break;
+        while (active->pongs <= round && !active->closed) {
+            if (net_tick() != NET_SUCCESS)
+                break;
+            ticks++;
+            (void)client_poll(active);
+        }
+        /*the idle clients answer the pings of the server now and then*/
+        if (round % IDLE_SERVICE == 0) {
+            for (idx = 1; idx < count; idx++)
+                (void)client_poll(&clients[idx]);
+        }
+    }
+
+    printf("%s: %lu idle clients, %lu round trips in %lu ticks, "
+           "%.1f us each, %.1f us processor time each\n",
+           argv[0], (unsigned long)count - 1, round, ticks,
+           round ? (double)(sxp_clock() - started) * 1000 / round : 0.0,
+           round ? (double)(clock() - processor) * 1000000 / CLOCKS_PER_SEC /
+                       round :
+                   0.0);
+
+    for (idx = 0; idx < count; idx++)
+        client_close(&clients[idx]);
+    net_reset();
+    net_exit();
+    free(clients);
+    return round == rounds ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include "client.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+a join storm: rounds of clients join a room with a long history and all of
+them ask for it at once, which makes the server send the largest frames it
+has. Run it with zero copy off (0) and on for frames of at least threshold
+KiB to compare the time and processor time it takes. The kernel copies
+anyway over the loopback interface, so zero copy can only win on a real
+network interface. Exits with 77, which ctest counts as skipped, if zero copy
+was asked for and the platform does not have it.
+
+usage: bench_join [port] [zero copy threshold KiB] [clients] [rounds]
+                  [history KiB, below 1024]
+*/
+
+#define JOIN_SKIPPED 77
+#define JOIN_TEXT 1000
+#define JOIN_TIMEOUT 60000UL
+
+int main(int argc, char **argv)
+{
+    const char *port = argc > 1 ? argv[1] : "27018";
+    size_t threshold = argc > 2 ? strtoul(argv[2], NULL, 10) * 1024 : 0;
+    size_t count = argc > 3 ? strtoul(argv[3], NULL, 10) : 50;
+    unsigned long rounds = argc > 4 ? strtoul(argv[4], NULL, 10) : 5;
+    unsigned long history = argc > 5 ? strtoul(argv[5], NULL, 10) : 800;
+    struct client *clients;
+    int *asked;
+    struct net_stats stats;
+    struct linger reset;
+    unsigned long round, messages, bytes = 0, started;
+    char text[JOIN_TEXT + 1];
+    clock_t processor;
+    size_t idx;
+    int done = 1;
+
+    clients = calloc(count, sizeof(*clients));
+    asked = calloc(count, sizeof(*asked));
+    if (!count || !clients || !asked)
+        return 1;
+    memset(text, 'x', JOIN_TEXT);
+    text[JOIN_TEXT] = '\0';
+    reset.l_onoff = 1;
+    reset.l_linger = 0;
+    encrypt_init();
+    if (net_init() != NET_SUCCESS ||
+        net_zerocopy_set(threshold) != NET_SUCCESS ||
+        net_serve(port) != NET_SUCCESS) {
+        fprintf(stderr, "join: could not serve on %s\n", port);
+        return 1;
+    }
+    messages = history * 1024 / JOIN_TEXT;
+    for (idx = 0; idx < messages; idx++) {
+        if (net_message_send(0, text) != NET_SUCCESS)
+            return 1;
+    }
+
+    started = sxp_clock();
+    processor = clock();
+    for (round = 0; round < rounds && done; round++) {
+        for (idx = 0; idx < count; idx++) {
+            if (client_connect(&clients[idx], "127.0.0.1", port) !=
+                NET_SUCCESS) {
+                fprintf(stderr, "join: client %lu could not connect\n",
+                        (unsigned long)idx);
+                return 1;
+            }
+            asked[idx] = 0;
+        }
+        done = 0;
+        while (!done && sxp_clock() - started < JOIN_TIMEOUT) {
+            if (clients_step(clients, count) != NET_SUCCESS)
+                break;
+            done = 1;
+            for (idx = 0; idx < count; idx++) {
+                struct client *client = &clients[idx];
+                /*asks as soon as it has joined*/
+                if (client->id >= 0 && !asked[idx] &&
+                    client_history(client) == NET_SUCCESS)
+                    asked[idx] = 1;
+                if (client->closed || client->messages < messages)
+                    done = 0;
+            }
+        }
+        for (idx = 0; idx < count; idx++) {
+            bytes += clients[idx].bytes_in;
+            if (clients[idx].closed)
+                fprintf(stderr, "join: client %lu was closed\n",
+                        (unsigned long)idx);
+            else if (clients[idx].messages < messages)
+                fprintf(stderr, "join: client %lu received %lu of %lu\n",
+                        (unsigned long)idx, clients[idx].messages, messages);
+            /*no connection is left waiting out its close*/
+            (void)setsockopt(clients[idx].socket, SOL_SOCKET, SO_LINGER,
+                             (const char *)&reset, sizeof(reset));
+            client_close(&clients[idx]);
+        }
+    }
+
+    (void)net_stats_get(&stats);
+    printf("join: zero copy from %lu KiB, %lu rounds of %lu clients, "
+           "%.1f MB in %lu ms, %.0f ms processor time, %lu zero copy sends "
+           "(%lu copied)\n",
+           (unsigned long)threshold / 1024, round, (unsigned long)count,
+           (double)bytes / 1000000, sxp_clock() - started,
+           (double)(clock() - processor) * 1000 / CLOCKS_PER_SEC,
+           stats.zerocopy_sends, stats.zerocopy_copied);
+
+    net_reset();
+    net_exit();
+    free(clients);
+    free(asked);
+    if (done && threshold && !stats.zerocopy_sends) {
+        printf("join: zero copy is not available\n");
+        return JOIN_SKIPPED;
+    }
+    return done ? 0 : 1;
+}
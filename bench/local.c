@@ -0,0 +1,93 @@
+#include "client.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+round trips of a client on the same host over tcp and over a unix domain
+socket: a server listens on both, one client connects to each and they take
+turns sending a message and waiting for it to come back. Reports the median
+and the 99th percentile of the round trips over either of them and the
+processor time spent on them.
+
+usage: bench_local [port] [socket file] [round trips]
+*/
+
+#define LOCAL_TEXT 100
+#define LOCAL_TIMEOUT 60000UL
+
+int main(int argc, char **argv)
+{
+    const char *port = argc > 1 ? argv[1] : "27022";
+    const char *path = argc > 2 ? argv[2] : "bench_local.sock";
+    unsigned long rounds = argc > 3 ? strtoul(argv[3], NULL, 10) : 10000;
+    const char *names[2] = { "tcp", "unix" };
+    struct client clients[2];
+    unsigned long *took[2];
+    unsigned long round, done[2] = { 0, 0 }, before, sent, started;
+    char endpoint[256];
+    char text[LOCAL_TEXT + 1];
+    clock_t spent[2] = { 0, 0 }, processor;
+    size_t idx;
+
+    took[0] = calloc(rounds, sizeof(*took[0]));
+    took[1] = calloc(rounds, sizeof(*took[1]));
+    if (!rounds || !took[0] || !took[1] || strlen(path) > 200)
+        return 1;
+    memset(text, 'x', LOCAL_TEXT);
+    text[LOCAL_TEXT] = '\0';
+    sprintf(endpoint, "unix:%s", path);
+    encrypt_init();
+    if (net_init() != NET_SUCCESS || net_serve(port) != NET_SUCCESS ||
+        net_listen(endpoint) != NET_SUCCESS) {
+        fprintf(stderr, "local: could not serve on %s and %s\n", port,
+                endpoint);
+        return 1;
+    }
+    for (idx = 0; idx < 2; idx++) {
+        if (client_connect(&clients[idx], idx ? endpoint : "127.0.0.1",
+                           port) != NET_SUCCESS) {
+            fprintf(stderr, "local: could not connect over %s\n", names[idx]);
+            return 1;
+        }
+        while (!clients[idx].closed && clients[idx].id < 0)
+            (void)clients_step(clients, idx + 1);
+    }
+
+    started = sxp_clock();
+    for (round = 0; round < 2 * rounds; round++) {
+        struct client *client = &clients[round % 2];
+        before = client->messages;
+        processor = clock();
+        sent = bench_now();
+        if (client_send(client, text) != NET_SUCCESS)
+            break;
+        while (client->messages == before && !client->closed &&
+               sxp_clock() - started < LOCAL_TIMEOUT)
+            (void)clients_step(clients, 2);
+        if (client->messages == before)
+            break;
+        took[round % 2][done[round % 2]++] = bench_now() - sent;
+        spent[round % 2] += clock() - processor;
+    }
+
+    for (idx = 0; idx < 2; idx++) {
+        qsort(took[idx], done[idx], sizeof(*took[idx]), bench_compare);
+        printf("local: %s, %lu round trips, median %lu us, p99 %lu us, "
+               "%.1f us processor time each\n",
+               names[idx], done[idx],
+               done[idx] ? took[idx][done[idx] / 2] : 0,
+               done[idx] ? took[idx][done[idx] * 99 / 100] : 0,
+               done[idx] ? (double)spent[idx] * 1000000 / CLOCKS_PER_SEC /
+                               done[idx] :
+                           0.0);
+    }
+
+    for (idx = 0; idx < 2; idx++)
+        client_close(&clients[idx]);
+    net_reset();
+    net_exit();
+    free(took[0]);
+    free(took[1]);
+    return done[0] == rounds && done[1] == rounds ? 0 : 1;
+}
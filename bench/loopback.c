@@ -0,0 +1,95 @@
+#include "client.h"
+#include "loopback.h"
+#include <stdio.h>
+#include <time.h>
+
+/*
+serves clients over sxp_loopback: every client connects, the first senders
+of them send messages each, and all of them have to receive every message.
+Reports the steps and virtual time this took and the processor time spent.
+
+usage: bench_loopback [clients] [messages] [latency ms] [senders]
+*/
+
+#define LOOPBACK_PORT "7000"
+#define LOOPBACK_STEPS 1000000UL
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000;
+    unsigned long messages = argc > 2 ? strtoul(argv[2], NULL, 10) : 2;
+    unsigned long latency = argc > 3 ? strtoul(argv[3], NULL, 10) : 5;
+    size_t senders = argc > 4 ? strtoul(argv[4], NULL, 10) : count;
+    struct client *clients;
+    unsigned long *sent;
+    unsigned long expected, received = 0, steps = 0;
+    clock_t started;
+    size_t idx;
+    int done = 0;
+
+    if (!count || senders > count)
+        return 1;
+    clients = calloc(count, sizeof(*clients));
+    sent = calloc(count, sizeof(*sent));
+    if (!clients || !sent)
+        return 1;
+    encrypt_init();
+    sxp_vtable_set(&sxp_loopback);
+    sxp_loopback_set(latency, LOOPBACK_BUFFER);
+    if (net_init() != NET_SUCCESS || net_serve(LOOPBACK_PORT) != NET_SUCCESS) {
+        fprintf(stderr, "loopback: could not serve\n");
+        return 1;
+    }
+
+    started = clock();
+    for (idx = 0; idx < count; idx++) {
+        if (client_connect(&clients[idx], NULL, LOOPBACK_PORT) !=
+                NET_SUCCESS ||
+            clients_step(clients, idx + 1) != NET_SUCCESS) {
+            fprintf(stderr, "loopback: client %lu could not connect\n",
+                    (unsigned long)idx);
+            return 1;
+        }
+        steps++;
+    }
+
+    expected = senders * messages;
+    while (!done && steps < LOOPBACK_STEPS) {
+        if (clients_step(clients, count) != NET_SUCCESS)
+            break;
+        steps++;
+        done = 1;
+        for (idx = 0; idx < count; idx++) {
+            struct client *client = &clients[idx];
+            if (idx < senders && client->id >= 0 && sent[idx] < messages) {
+                char text[48];
+                sprintf(text, "%lu.%lu", (unsigned long)idx, sent[idx]);
+                if (client_send(client, text) == NET_SUCCESS)
+                    sent[idx]++;
+            }
+            if (client->messages < expected)
+                done = 0;
+        }
+        sxp_loopback_advance(1);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        received += clients[idx].messages;
+        if (clients[idx].closed)
+            fprintf(stderr, "loopback: client %lu was closed\n",
+                    (unsigned long)idx);
+    }
+    printf("loopback: %lu clients, %lu of %lu messages delivered in %lu steps, "
+           "%lu virtual ms, %.0f ms processor time\n",
+           (unsigned long)count, received, expected * count, steps,
+           sxp_clock(),
+           (double)(clock() - started) * 1000 / CLOCKS_PER_SEC);
+
+    for (idx = 0; idx < count; idx++)
+        client_close(&clients[idx]);
+    net_reset();
+    net_exit();
+    free(clients);
+    free(sent);
+    return done ? 0 : 1;
+}
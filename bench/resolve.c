@@ -0,0 +1,138 @@
+#include "client.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+connects through a stub resolver which answers every name with 127.0.0.1
+after delay ms. net_tick has to keep returning while the name resolves, the
+connection has to arrive once it did, and connecting again has to be served
+from the cache without asking the resolver.
+
+usage: bench_resolve [port] [delay ms]
+*/
+
+#define RESOLVE_HOST "stub.test"
+
+static int resolve_delay;
+static unsigned long resolve_calls;
+static unsigned long resolve_answers;
+
+/*nothing is ever written to the pair, so polling it sleeps*/
+static void stub_sleep(int ms)
+{
+    pollsxp_t sleeper;
+    sxp_t pair[2];
+
+    if (sxp_pair(pair) != SXP_SUCCESS)
+        return;
+    sleeper.fd = pair[0];
+    sleeper.events = POLLIN;
+    (void)sxp_poll(NULL, &sleeper, 1, ms);
+    sxp_destroy(&pair[0]);
+    sxp_destroy(&pair[1]);
+}
+
+static sxpResult stub_addrinfo_get(addrinfo_t **results,
+                                   const char *maybe_hostname,
+                                   const char *serviceport, addrinfo_t *hints)
+{
+    sxpResult result;
+
+    (void)maybe_hostname;
+    __atomic_add_fetch(&resolve_calls, 1, __ATOMIC_SEQ_CST);
+    stub_sleep(resolve_delay);
+    result = sxp_platform.addrinfo_get(results, "127.0.0.1", serviceport,
+                                       hints);
+    __atomic_add_fetch(&resolve_answers, 1, __ATOMIC_SEQ_CST);
+    return result;
+}
+
+/*ticks until the listener accepts, returns the ms it took or -1*/
+static long await_connection(sxp_t *listener, unsigned long *longest_tick)
+{
+    unsigned long started = sxp_clock(), last = started, now;
+    sxp_t accepted;
+
+    *longest_tick = 0;
+    while ((now = sxp_clock()) - started < 10UL * resolve_delay + 1000) {
+        if (now - last > *longest_tick)
+            *longest_tick = now - last;
+        last = now;
+        if (sxp_accept(listener, &accepted, SXP_NONBLOCKING) == SXP_SUCCESS) {
+            sxp_destroy(&accepted);
+            return (long)(now - started);
+        }
+        if (net_tick() != NET_SUCCESS)
+            return -1;
+    }
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *port = argc > 1 ? argv[1] : "27013";
+    sxp_vtable_t stub = sxp_platform;
+    addrinfo_t hints;
+    addrinfo_t *address;
+    sxp_t listener;
+    unsigned long longest, started;
+    long took, cached;
+    int failed = 0;
+
+    resolve_delay = argc > 2 ? atoi(argv[2]) : 500;
+    stub.addrinfo_get = stub_addrinfo_get;
+    encrypt_init();
+    sxp_vtable_set(&stub);
+    if (net_init() != NET_SUCCESS)
+        return 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (sxp_platform.addrinfo_get(&address, "127.0.0.1", port, &hints) !=
+            SXP_SUCCESS ||
+        sxp_create(&listener, AF_INET, SOCK_STREAM, 0) != SXP_SUCCESS ||
+        sxp_nbio_set(&listener, SXP_NONBLOCKING) != SXP_SUCCESS ||
+        sxp_bind(&listener, address->ai_addr, address->ai_addrlen) !=
+            SXP_SUCCESS ||
+        sxp_listen(&listener, 4) != SXP_SUCCESS) {
+        fprintf(stderr, "resolve: could not listen on %s\n", port);
+        return 1;
+    }
+    sxp_addrinfo_free(address);
+
+    started = sxp_clock();
+    if (net_connect(RESOLVE_HOST, port) != NET_SUCCESS)
+        return 1;
+    printf("resolve: net_connect returned after %lu ms\n",
+           sxp_clock() - started);
+    took = await_connection(&listener, &longest);
+    printf("resolve: connected after %ld ms with a %d ms resolver, "
+           "net_tick returned at least every %lu ms\n",
+           took, resolve_delay, longest);
+    if (took < resolve_delay || longest > (unsigned long)resolve_delay / 2)
+        failed = 1;
+
+    net_reset();
+    if (net_connect(RESOLVE_HOST, port) != NET_SUCCESS)
+        return 1;
+    cached = await_connection(&listener, &longest);
+    printf("resolve: connected again after %ld ms, %lu resolver calls\n",
+           cached, resolve_calls);
+    if (cached < 0 || cached >= resolve_delay || resolve_calls != 1)
+        failed = 1;
+
+    /*an abandoned resolution must not touch the connection after it*/
+    net_reset();
+    if (net_connect("other." RESOLVE_HOST, port) != NET_SUCCESS)
+        return 1;
+    net_reset();
+    while (__atomic_load_n(&resolve_answers, __ATOMIC_SEQ_CST) < 2)
+        stub_sleep(10);
+    /*for the resolver thread to free what it was left with*/
+    stub_sleep(100);
+
+    sxp_destroy(&listener);
+    net_exit();
+    return failed;
+}
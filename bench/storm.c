@@ -0,0 +1,96 @@
+#include "client.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+a connect storm, as when a room restarts and all of its clients reconnect at
+once: every client starts to connect before the server accepts any of them.
+Reports the time until all of them have completed the handshake and how
+long the median and the slowest client took. Connections which do not fit
+into the listen backlog are retried by the kernel a second later and then
+after ever longer pauses, so compare a backlog above the number of clients
+with the default one.
+
+usage: bench_storm [port] [clients] [backlog]
+*/
+
+#define STORM_TIMEOUT 60000UL
+
+int main(int argc, char **argv)
+{
+    const char *port = argc > 1 ? argv[1] : "27011";
+    size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000;
+    int backlog = argc > 3 ? atoi(argv[3]) : 0;
+    struct client *clients;
+    unsigned long *took;
+    unsigned long started, now;
+    size_t idx, joined = 0, closed = 0;
+    struct linger reset;
+
+    clients = calloc(count, sizeof(*clients));
+    took = calloc(count, sizeof(*took));
+    if (!count || !clients || !took)
+        return 1;
+    encrypt_init();
+    if (net_init() != NET_SUCCESS ||
+        (backlog && net_backlog_set(backlog) != NET_SUCCESS) ||
+        net_serve(port) != NET_SUCCESS) {
+        fprintf(stderr, "storm: could not serve on %s\n", port);
+        return 1;
+    }
+
+    reset.l_onoff = 1;
+    reset.l_linger = 0;
+    started = sxp_clock();
+    for (idx = 0; idx < count; idx++) {
+        if (client_connect(&clients[idx], "127.0.0.1", port) != NET_SUCCESS) {
+            fprintf(stderr, "storm: client %lu could not connect\n",
+                    (unsigned long)idx);
+            return 1;
+        }
+    }
+    while (joined + closed < count &&
+           (now = sxp_clock()) - started < STORM_TIMEOUT) {
+        if (clients_step(clients, count) != NET_SUCCESS)
+            break;
+        for (idx = 0; idx < count; idx++) {
+            if (took[idx])
+                continue;
+            if (clients[idx].id >= 0) {
+                /*0 marks the clients still connecting*/
+                took[idx] = now - started + 1;
+                joined++;
+            } else if (clients[idx].closed) {
+                took[idx] = (unsigned long)-1;
+                closed++;
+            }
+        }
+    }
+
+    /*the clients which did not join sort last*/
+    for (idx = 0; idx < count; idx++) {
+        if (!took[idx])
+            took[idx] = (unsigned long)-1;
+    }
+    qsort(took, count, sizeof(*took), bench_compare);
+    printf("storm: %lu of %lu clients joined in %lu ms, median %lu ms, "
+           "slowest %lu ms, %lu closed\n",
+           (unsigned long)joined, (unsigned long)count,
+           sxp_clock() - started, joined ? took[joined / 2] - 1 : 0,
+           joined ? took[joined - 1] - 1 : 0, (unsigned long)closed);
+
+    /*
+    the clients reset their connections, so that none of them waits out its
+    close on a port which other benchmarks listen on
+    */
+    for (idx = 0; idx < count; idx++) {
+        (void)setsockopt(clients[idx].socket, SOL_SOCKET, SO_LINGER,
+                         (const char *)&reset, sizeof(reset));
+        client_close(&clients[idx]);
+    }
+    net_reset();
+    net_exit();
+    free(clients);
+    free(took);
+    return joined == count ? 0 : 1;
+}
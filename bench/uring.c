@@ -0,0 +1,103 @@
+#include "client.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+throughput of the poller backends: every client sends messages to everyone
+over TCP and all of them have to receive every message. Run it once with
+poll (epoll on linux) and once with uring to compare the time and processor
+time they take. The backends only differ in how the server waits for its
+sockets and receives from them. Both make a send system call for every
+client a message is fanned out to, so that cost is the same for both. Exits
+with 77, which ctest counts as skipped, if the kernel has no io_uring.
+
+usage: bench_uring [port] [poll|uring] [clients] [messages]
+*/
+
+#define URING_SKIPPED 77
+#define URING_TEXT 200
+#define URING_TIMEOUT 60000UL
+
+int main(int argc, char **argv)
+{
+    const char *port = argc > 1 ? argv[1] : "27020";
+    const char *backend = argc > 2 ? argv[2] : "uring";
+    size_t count = argc > 3 ? strtoul(argv[3], NULL, 10) : 50;
+    unsigned long messages = argc > 4 ? strtoul(argv[4], NULL, 10) : 200;
+    struct client *clients;
+    unsigned long *sent;
+    unsigned long expected, received = 0, started;
+    char text[URING_TEXT + 32];
+    clock_t processor;
+    size_t idx;
+    int done = 0;
+
+    clients = calloc(count, sizeof(*clients));
+    sent = calloc(count, sizeof(*sent));
+    if (!count || !clients || !sent)
+        return 1;
+    memset(text, 'x', URING_TEXT);
+    text[URING_TEXT] = '\0';
+    encrypt_init();
+    if (net_init() != NET_SUCCESS)
+        return 1;
+    if (net_backend_set(strcmp(backend, "uring") ? NET_BACKEND_POLL :
+                                                   NET_BACKEND_URING) !=
+        NET_SUCCESS) {
+        printf("uring: backend %s is not available\n", backend);
+        net_exit();
+        return URING_SKIPPED;
+    }
+    if (net_serve(port) != NET_SUCCESS) {
+        fprintf(stderr, "uring: could not serve on %s\n", port);
+        return 1;
+    }
+    for (idx = 0; idx < count; idx++) {
+        if (client_connect(&clients[idx], "127.0.0.1", port) != NET_SUCCESS) {
+            fprintf(stderr, "uring: client %lu could not connect\n",
+                    (unsigned long)idx);
+            return 1;
+        }
+        while (!clients[idx].closed && clients[idx].id < 0)
+            (void)clients_step(&clients[idx], 1);
+    }
+
+    expected = count * messages;
+    started = sxp_clock();
+    processor = clock();
+    while (!done && sxp_clock() - started < URING_TIMEOUT) {
+        if (clients_step(clients, count) != NET_SUCCESS)
+            break;
+        done = 1;
+        for (idx = 0; idx < count; idx++) {
+            struct client *client = &clients[idx];
+            /*a message at a time, so that the server sets the pace*/
+            if (sent[idx] < messages && !client_queued(client) &&
+                client_send(client, text) == NET_SUCCESS)
+                sent[idx]++;
+            if (client->messages < expected)
+                done = 0;
+        }
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        received += clients[idx].messages;
+        if (clients[idx].closed)
+            fprintf(stderr, "uring: client %lu was closed\n",
+                    (unsigned long)idx);
+    }
+    printf("uring: %s, %lu clients, %lu of %lu messages delivered in %lu ms, "
+           "%.0f ms processor time\n",
+           backend, (unsigned long)count, received, expected * count,
+           sxp_clock() - started,
+           (double)(clock() - processor) * 1000 / CLOCKS_PER_SEC);
+
+    for (idx = 0; idx < count; idx++)
+        client_close(&clients[idx]);
+    net_reset();
+    net_exit();
+    free(clients);
+    free(sent);
+    return done ? 0 : 1;
+}
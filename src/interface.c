@@ -3,7 +3,6 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 #define INPUT_LENGTH 128
 #define COMMAND_BUF_LENGTH 8192
@@ -14,7 +13,7 @@
 
 static int terminal_height = 24;
 static int terminal_width = 80;
-static time_t last_since_checked_size = 0;
+static int bounds_requested = 0;
 
 static char *messages[MAX_LINES] = { 0 };
 static int messages_count = 0;
@@ -229,23 +228,33 @@ uiResult interface_tick()
 {
     if (input_tick() != UI_SUCCESS)
         return UI_ERROR;
+    return interface_render();
+}
+
+uiResult interface_render()
+{
     if (STATUS_DIRTY && (render_status() != UI_SUCCESS))
         return UI_ERROR;
     if (MESSAGES_DIRTY && (render_messages() != UI_SUCCESS))
         return UI_ERROR;
     if (INPUTS_DIRTY && (render_input() != UI_SUCCESS))
         return UI_ERROR;
-    if (bounds_tick() != UI_SUCCESS)
+    return UI_SUCCESS;
+}
+
+uiResult interface_wait_get(int fds[UI_WAIT_MAX], size_t *count)
+{
+    if (txp_wait_get(fds, count) != TXP_SUCCESS)
         return UI_ERROR;
     return UI_SUCCESS;
 }
 
 static uiResult bounds_tick()
 {
-    time_t current_time = time(NULL);
-    if (current_time - last_since_checked_size < 1)
+    /*later changes of the size are reported by txp_recv*/
+    if (bounds_requested)
         return UI_SUCCESS;
-    last_since_checked_size = current_time;
+    bounds_requested = 1;
 
     sprintf(command_buffer, "\033[s\033[999;999H\033[6n\033[u");
     if (txp_send(command_buffer) != TXP_SUCCESS)
@@ -1,6 +1,8 @@
 #ifndef INTERFACE_H_
 #define INTERFACE_H_
 
+#include <stddef.h>
+
 enum uiresults { UI_SUCCESS = 0, UI_TRY_AGAIN = 1, UI_ERROR = -1 };
 
 typedef int uiResult;
@@ -8,7 +10,17 @@ typedef int uiResult;
 uiResult interface_init();
 uiResult interface_exit();
 
+/*reads pending terminal input and renders*/
 uiResult interface_tick();
+/*renders everything which changed since the last call*/
+uiResult interface_render();
+
+/*
+file descriptors which become readable when there is terminal input, so the
+caller can sleep until then. Fails if terminal input has to be polled.
+*/
+#define UI_WAIT_MAX 2
+uiResult interface_wait_get(int fds[UI_WAIT_MAX], size_t *count);
 
 uiResult interface_message_recv(const char **message);
 uiResult interface_message_send(const char *message);
@@ -0,0 +1,845 @@
+#include "loopback.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LOOPBACK_NONE ((size_t)-1)
+/*handles start at 1, so that a zeroed sxp_t is never a socket*/
+#define LOOPBACK_HANDLE(idx) ((sxp_t)((idx) + 1))
+
+struct loopback_chunk {
+    struct loopback_chunk *next;
+    /*virtual time at which the chunk becomes readable*/
+    unsigned long due;
+    size_t size;
+    /*bytes of the chunk which have been read already*/
+    size_t offset;
+    /*followed by the data*/
+};
+
+struct loopback_socket {
+    int used;
+    int listening;
+    /*port the socket is bound to, 0 if it is not bound*/
+    unsigned int port;
+    /*nonzero once connected, peer is LOOPBACK_NONE once the peer is gone*/
+    int connected;
+    size_t peer;
+    unsigned long latency;
+    size_t buffer;
+    /*nonzero once this socket stopped sending*/
+    int shut;
+    /*nonzero once the peer stopped sending, readable as the end at end_due*/
+    int ended;
+    unsigned long end_due;
+    /*received chunks which have not been read and bytes left in them*/
+    struct loopback_chunk *head;
+    struct loopback_chunk *tail;
+    size_t queued;
+    /*ring of the connections a listener has not accepted yet*/
+    size_t *backlog;
+    size_t backlog_max;
+    size_t backlog_first;
+    size_t backlog_count;
+};
+
+struct loopback_watch {
+    size_t socket;
+    int events;
+    size_t key;
+};
+
+struct loopback_poller {
+    struct loopback_watch *list;
+    size_t count;
+    size_t capacity;
+    /*index into list for every key*/
+    size_t *slots;
+    size_t slot_count;
+    /*entry of list to look at first, so that no socket is left behind*/
+    size_t next;
+};
+
+/*an addrinfo_t and its address in a single allocation*/
+struct loopback_address {
+    addrinfo_t info;
+    struct sockaddr_storage address;
+};
+
+static struct loopback_socket *loopback_sockets = NULL;
+static size_t loopback_count = 0;
+/*no socket below this index is unused*/
+static size_t loopback_unused = 0;
+static unsigned long loopback_now = 0;
+static unsigned long loopback_latency = LOOPBACK_LATENCY;
+static size_t loopback_buffer = LOOPBACK_BUFFER;
+
+static struct loopback_socket *loopback_get(const sxp_t *sock);
+static sxpResult loopback_open(size_t *idx);
+static void loopback_close(size_t idx);
+static void loopback_link(size_t one, size_t other);
+static unsigned long loopback_due(struct loopback_socket *receiver,
+                                  unsigned long latency);
+static int loopback_eof(struct loopback_socket *socket);
+static int loopback_ready(size_t idx);
+static size_t loopback_scan(struct loopback_poller *self, sxp_event_t events[],
+                            size_t *count, size_t limit);
+static int loopback_wait(int timeout);
+static sxpResult loopback_port_get(const sockaddr_t *address, size_t addrlen,
+                                   unsigned int *port);
+
+sxpResult sxp_loopback_set(unsigned long latency, size_t buffer)
+{
+    if (!buffer)
+        return SXP_ERROR_INVAL;
+    loopback_latency = latency;
+    loopback_buffer = buffer;
+    return SXP_SUCCESS;
+}
+
+void sxp_loopback_advance(unsigned long ms)
+{
+    loopback_now += ms;
+}
+
+sxpResult sxp_loopback_next(unsigned long *due)
+{
+    int found = 0;
+    size_t idx;
+    if (!due)
+        return SXP_ERROR_INVAL;
+    for (idx = 0; idx < loopback_count; idx++) {
+        struct loopback_socket *socket = &loopback_sockets[idx];
+        struct loopback_chunk *chunk = socket->head;
+        unsigned long next;
+        if (!socket->used)
+            continue;
+        /*chunks are queued in the order they become readable*/
+        while (chunk && (long)(chunk->due - loopback_now) <= 0)
+            chunk = chunk->next;
+        if (chunk)
+            next = chunk->due;
+        else if (socket->ended && (long)(socket->end_due - loopback_now) > 0)
+            next = socket->end_due;
+        else
+            continue;
+        if (!found || (long)(next - *due) < 0)
+            *due = next;
+        found = 1;
+    }
+    return found ? SXP_SUCCESS : SXP_TRY_AGAIN;
+}
+
+static sxpResult loopback_init()
+{
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_cleanup()
+{
+    size_t idx;
+    for (idx = 0; idx < loopback_count; idx++) {
+        if (loopback_sockets[idx].used)
+            loopback_close(idx);
+    }
+    free(loopback_sockets);
+    loopback_sockets = NULL;
+    loopback_count = 0;
+    loopback_unused = 0;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_create(sxp_t *dst, int family, int type,
+                                 int protocol)
+{
+    sxpResult result;
+    size_t idx;
+    (void)family;
+    (void)protocol;
+    if (!dst)
+        return SXP_ERROR_INVAL;
+    if (type != SOCK_STREAM)
+        return SXP_ERROR_PLATFORM;
+    if ((result = loopback_open(&idx)) != SXP_SUCCESS)
+        return result;
+    *dst = LOOPBACK_HANDLE(idx);
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_destroy(sxp_t *sock)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    if (!socket)
+        return SXP_ERROR_INVAL;
+    loopback_close(socket - loopback_sockets);
+    return SXP_SUCCESS;
+}
+
+/*no call blocks, so there is nothing to switch*/
+static sxpResult loopback_nbio_set(sxp_t *sock, int nonblockingio)
+{
+    (void)nonblockingio;
+    return loopback_get(sock) ? SXP_SUCCESS : SXP_ERROR_INVAL;
+}
+
+static sxpResult loopback_addrinfo_get(addrinfo_t **results,
+                                       const char *maybe_hostname,
+                                       const char *serviceport,
+                                       addrinfo_t *hints)
+{
+    struct loopback_address *result;
+    sockaddr_t *address;
+    unsigned long port;
+    char *end;
+    (void)maybe_hostname;
+    if (!results || !serviceport)
+        return SXP_ERROR_INVAL;
+    port = strtoul(serviceport, &end, 10);
+    if (end == serviceport || *end || !port || port > 65535)
+        return SXP_ERROR_INVAL;
+    if (hints && hints->ai_socktype && hints->ai_socktype != SOCK_STREAM)
+        return SXP_ERROR_INVAL;
+    if (!(result = malloc(sizeof(*result))))
+        return SXP_ERROR_MEMORY;
+    memset(result, 0, sizeof(*result));
+    address = (sockaddr_t *)&result->address;
+    address->sa_family = AF_INET;
+    /*in network byte order like the port of a sockaddr_in*/
+    address->sa_data[0] = (char)((port >> 8) & 0xff);
+    address->sa_data[1] = (char)(port & 0xff);
+    result->info.ai_family = AF_INET;
+    result->info.ai_socktype = SOCK_STREAM;
+    result->info.ai_addr = address;
+    result->info.ai_addrlen = sizeof(*address);
+    *results = &result->info;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_addrinfo_free(addrinfo_t *info)
+{
+    free(info);
+    return SXP_SUCCESS;
+}
+
+/*server-side API*/
+static sxpResult loopback_bind(sxp_t *sock, const sockaddr_t *address,
+                               size_t addrlen)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    unsigned int port;
+    size_t idx;
+    if (!socket || socket->port || socket->connected ||
+        loopback_port_get(address, addrlen, &port) != SXP_SUCCESS)
+        return SXP_ERROR_INVAL;
+    for (idx = 0; idx < loopback_count; idx++) {
+        if (loopback_sockets[idx].used && loopback_sockets[idx].port == port)
+            return SXP_ERROR_INVAL;
+    }
+    socket->port = port;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_listen(sxp_t *sock, size_t backlog)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    if (!socket || !socket->port || socket->listening)
+        return SXP_ERROR_INVAL;
+    socket->backlog_max = backlog ? backlog : 1;
+    if (!(socket->backlog =
+              malloc(socket->backlog_max * sizeof(*socket->backlog))))
+        return SXP_ERROR_MEMORY;
+    socket->listening = 1;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_accept(sxp_t *sock, sxp_t *newsock,
+                                 int nonblockingio)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    (void)nonblockingio;
+    if (!socket || !newsock || !socket->listening)
+        return SXP_ERROR_INVAL;
+    if (!socket->backlog_count)
+        return SXP_TRY_AGAIN;
+    *newsock = LOOPBACK_HANDLE(socket->backlog[socket->backlog_first]);
+    socket->backlog_first = (socket->backlog_first + 1) % socket->backlog_max;
+    socket->backlog_count--;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_unix_address(struct sockaddr_storage *address,
+                                       size_t *addrlen, const char *path)
+{
+    (void)address;
+    (void)addrlen;
+    (void)path;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult loopback_unix_unlink(const char *path)
+{
+    (void)path;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult loopback_send_fd(sxp_t *sock, int fd)
+{
+    (void)sock;
+    (void)fd;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult loopback_recv_fd(sxp_t *sock, int *fd)
+{
+    (void)sock;
+    (void)fd;
+    return SXP_ERROR_PLATFORM;
+}
+
+/*client-side API*/
+static sxpResult loopback_connect(sxp_t *sock, sockaddr_t *address,
+                                  size_t addrlen)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    struct loopback_socket *listener;
+    size_t client;
+    size_t server;
+    size_t idx;
+    unsigned int port;
+    sxpResult result;
+    if (!socket || socket->connected || socket->listening ||
+        loopback_port_get(address, addrlen, &port) != SXP_SUCCESS)
+        return SXP_ERROR_INVAL;
+    client = socket - loopback_sockets;
+    for (idx = 0; idx < loopback_count; idx++) {
+        if (loopback_sockets[idx].used && loopback_sockets[idx].listening &&
+            loopback_sockets[idx].port == port)
+            break;
+    }
+    /*refused like a port nobody listens on*/
+    if (idx == loopback_count ||
+        loopback_sockets[idx].backlog_count ==
+            loopback_sockets[idx].backlog_max)
+        return SXP_ERROR_IO;
+    /*may move the sockets*/
+    if ((result = loopback_open(&server)) != SXP_SUCCESS)
+        return result;
+    loopback_link(client, server);
+    listener = &loopback_sockets[idx];
+    listener->backlog[(listener->backlog_first + listener->backlog_count) %
+                      listener->backlog_max] = server;
+    listener->backlog_count++;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_connect_finish(sxp_t *sock)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    if (!socket)
+        return SXP_ERROR_INVAL;
+    return socket->connected ? SXP_SUCCESS : SXP_ERROR_IO;
+}
+
+/*any-side API*/
+static sxpResult loopback_shutdown(sxp_t *sock)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    if (!socket || !socket->connected)
+        return SXP_ERROR_INVAL;
+    if (socket->shut)
+        return SXP_SUCCESS;
+    socket->shut = 1;
+    if (socket->peer != LOOPBACK_NONE) {
+        struct loopback_socket *peer = &loopback_sockets[socket->peer];
+        peer->ended = 1;
+        peer->end_due = loopback_due(peer, socket->latency);
+    }
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_sendv(sxp_t *sock, const sxp_buffer_t buffers[],
+                                size_t count, size_t *num_sent)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    struct loopback_socket *peer;
+    struct loopback_chunk *chunk;
+    size_t total = 0;
+    size_t offset;
+    size_t idx;
+    if (!socket || !buffers || !num_sent)
+        return SXP_ERROR_INVAL;
+    if (count > SXP_IOV_MAX)
+        return SXP_TOO_BIG;
+    if (!socket->connected)
+        return SXP_ERROR_INVAL;
+    if (socket->shut || socket->peer == LOOPBACK_NONE)
+        return SXP_ERROR_CLOSED;
+    peer = &loopback_sockets[socket->peer];
+    *num_sent = 0;
+    for (idx = 0; idx < count; idx++)
+        total += buffers[idx].size;
+    if (!total)
+        return SXP_SUCCESS;
+    if (peer->queued >= peer->buffer)
+        return SXP_TRY_AGAIN;
+    if (total > peer->buffer - peer->queued)
+        total = peer->buffer - peer->queued;
+
+    if (!(chunk = malloc(sizeof(*chunk) + total)))
+        return SXP_ERROR_MEMORY;
+    chunk->next = NULL;
+    chunk->due = loopback_due(peer, socket->latency);
+    chunk->size = total;
+    chunk->offset = 0;
+    for (idx = 0, offset = 0; offset < total; idx++) {
+        size_t size = buffers[idx].size;
+        if (size > total - offset)
+            size = total - offset;
+        memcpy((char *)(chunk + 1) + offset, buffers[idx].data, size);
+        offset += size;
+    }
+    if (peer->tail)
+        peer->tail->next = chunk;
+    else
+        peer->head = chunk;
+    peer->tail = chunk;
+    peer->queued += total;
+    *num_sent = total;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_send(sxp_t *sock, const char *data,
+                               size_t *num_sent, size_t size)
+{
+    sxp_buffer_t buffer;
+    buffer.data = data;
+    buffer.size = size;
+    return loopback_sendv(sock, &buffer, 1, num_sent);
+}
+
+static sxpResult loopback_recv(sxp_t *sock, char *data, size_t *num_read,
+                               size_t size)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    if (!socket || !data || !num_read || !socket->connected)
+        return SXP_ERROR_INVAL;
+    *num_read = 0;
+    while (socket->head && *num_read < size &&
+           (long)(loopback_now - socket->head->due) >= 0) {
+        struct loopback_chunk *chunk = socket->head;
+        size_t length = chunk->size - chunk->offset;
+        if (length > size - *num_read)
+            length = size - *num_read;
+        memcpy(data + *num_read, (char *)(chunk + 1) + chunk->offset, length);
+        chunk->offset += length;
+        socket->queued -= length;
+        *num_read += length;
+        if (chunk->offset == chunk->size) {
+            if (!(socket->head = chunk->next))
+                socket->tail = NULL;
+            free(chunk);
+        }
+    }
+    if (*num_read || loopback_eof(socket))
+        return SXP_SUCCESS;
+    return SXP_TRY_AGAIN;
+}
+
+static sxpResult loopback_zerocopy_set(sxp_t *sock, int enabled)
+{
+    (void)sock;
+    (void)enabled;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult loopback_send_zerocopy(sxp_t *sock, const char *data,
+                                        size_t *num_sent, size_t size,
+                                        int *pinned)
+{
+    (void)sock;
+    (void)data;
+    (void)num_sent;
+    (void)size;
+    (void)pinned;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult loopback_zerocopy_completed(sxp_t *sock, unsigned long *first,
+                                             unsigned long *last, int *copied)
+{
+    (void)sock;
+    (void)first;
+    (void)last;
+    (void)copied;
+    return SXP_ERROR_PLATFORM;
+}
+
+/*the peer acknowledges bytes by reading them*/
+static sxpResult loopback_transport_get(sxp_t *sock,
+                                        sxp_transport_t *transport)
+{
+    struct loopback_socket *socket = loopback_get(sock);
+    if (!socket || !transport || !socket->connected)
+        return SXP_ERROR_INVAL;
+    memset(transport, 0, sizeof(*transport));
+    if (socket->peer != LOOPBACK_NONE)
+        transport->queued = loopback_sockets[socket->peer].queued;
+    transport->rtt = socket->latency * 2 * 1000;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_pair(sxp_t pair[2])
+{
+    size_t first;
+    size_t second;
+    sxpResult result;
+    if (!pair)
+        return SXP_ERROR_INVAL;
+    if ((result = loopback_open(&first)) != SXP_SUCCESS)
+        return result;
+    if ((result = loopback_open(&second)) != SXP_SUCCESS) {
+        loopback_close(first);
+        return result;
+    }
+    loopback_link(first, second);
+    /*wakeups within the process are not delayed*/
+    loopback_sockets[first].latency = 0;
+    loopback_sockets[second].latency = 0;
+    pair[0] = LOOPBACK_HANDLE(first);
+    pair[1] = LOOPBACK_HANDLE(second);
+    return SXP_SUCCESS;
+}
+
+static unsigned long loopback_clock()
+{
+    return loopback_now;
+}
+
+static sxpResult loopback_poll(size_t /*maybe NULL*/ *results,
+                               pollsxp_t sxps[], size_t sxpcount, int timeout)
+{
+    size_t ready;
+    size_t idx;
+    if (!sxpcount)
+        return SXP_TRY_AGAIN;
+    if (!sxps)
+        return SXP_ERROR_INVAL;
+    for (;;) {
+        ready = 0;
+        for (idx = 0; idx < sxpcount; idx++) {
+            struct loopback_socket *socket = loopback_get(&sxps[idx].fd);
+            int events = socket ? loopback_ready(socket - loopback_sockets) :
+                                  SXP_POLLHUP;
+            sxps[idx].revents =
+                events & (sxps[idx].events | SXP_POLLHUP | SXP_POLLERR);
+            if (sxps[idx].revents)
+                ready++;
+        }
+        if (ready || !loopback_wait(timeout))
+            break;
+        timeout = 0;
+    }
+    if (results)
+        *results = ready;
+    return ready > 0 ? SXP_SUCCESS : SXP_TRY_AGAIN;
+}
+
+static sxpResult loopback_poller_create(sxp_poller_t **poller, int kind)
+{
+    struct loopback_poller *self;
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    if (kind != SXP_POLLER_DEFAULT)
+        return SXP_ERROR_PLATFORM;
+    if (!(self = malloc(sizeof(*self))))
+        return SXP_ERROR_MEMORY;
+    memset(self, 0, sizeof(*self));
+    *poller = (sxp_poller_t *)self;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_poller_destroy(sxp_poller_t *poller)
+{
+    struct loopback_poller *self = (struct loopback_poller *)poller;
+    if (!self)
+        return SXP_ERROR_INVAL;
+    free(self->list);
+    free(self->slots);
+    free(self);
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_poller_add(sxp_poller_t *poller, sxp_t *sock,
+                                     int events, size_t key)
+{
+    struct loopback_poller *self = (struct loopback_poller *)poller;
+    struct loopback_socket *socket = loopback_get(sock);
+    if (!self || !socket)
+        return SXP_ERROR_INVAL;
+    if (self->count == self->capacity) {
+        size_t capacity = self->capacity ? self->capacity * 2 : 16;
+        struct loopback_watch *list =
+            realloc(self->list, capacity * sizeof(*list));
+        if (!list)
+            return SXP_ERROR_MEMORY;
+        self->list = list;
+        self->capacity = capacity;
+    }
+    if (key >= self->slot_count) {
+        size_t slot_count = self->slot_count ? self->slot_count : 16;
+        size_t *slots;
+        while (slot_count <= key)
+            slot_count *= 2;
+        if (!(slots = realloc(self->slots, slot_count * sizeof(*slots))))
+            return SXP_ERROR_MEMORY;
+        self->slots = slots;
+        self->slot_count = slot_count;
+    }
+    self->list[self->count].socket = socket - loopback_sockets;
+    self->list[self->count].events = events;
+    self->list[self->count].key = key;
+    self->slots[key] = self->count;
+    self->count++;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_poller_modify(sxp_poller_t *poller, sxp_t *sock,
+                                        int events, size_t key)
+{
+    struct loopback_poller *self = (struct loopback_poller *)poller;
+    struct loopback_socket *socket = loopback_get(sock);
+    size_t slot;
+    if (!self || !socket || key >= self->slot_count)
+        return SXP_ERROR_INVAL;
+    slot = self->slots[key];
+    if (slot >= self->count ||
+        self->list[slot].socket != (size_t)(socket - loopback_sockets))
+        return SXP_ERROR_INVAL;
+    self->list[slot].events = events;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_poller_remove(sxp_poller_t *poller, sxp_t *sock,
+                                        size_t key)
+{
+    struct loopback_poller *self = (struct loopback_poller *)poller;
+    struct loopback_socket *socket = loopback_get(sock);
+    size_t slot;
+    if (!self || !socket || key >= self->slot_count)
+        return SXP_ERROR_INVAL;
+    slot = self->slots[key];
+    if (slot >= self->count ||
+        self->list[slot].socket != (size_t)(socket - loopback_sockets))
+        return SXP_ERROR_INVAL;
+    self->count--;
+    self->list[slot] = self->list[self->count];
+    self->slots[self->list[slot].key] = slot;
+    return SXP_SUCCESS;
+}
+
+static sxpResult loopback_poller_wait(sxp_poller_t *poller,
+                                      sxp_event_t events[], size_t *count,
+                                      size_t limit, int timeout)
+{
+    struct loopback_poller *self = (struct loopback_poller *)poller;
+    if (!self || !events || !count || !limit)
+        return SXP_ERROR_INVAL;
+    if (!loopback_scan(self, events, count, limit) && loopback_wait(timeout))
+        loopback_scan(self, events, count, limit);
+    return *count > 0 ? SXP_SUCCESS : SXP_TRY_AGAIN;
+}
+
+/*loopback pollers never receive ahead*/
+static sxpResult loopback_poller_recv(sxp_poller_t *poller, sxp_t *sock,
+                                      size_t key, char *data,
+                                      size_t *num_read, size_t size)
+{
+    (void)key;
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    return loopback_recv(sock, data, num_read, size);
+}
+
+static struct loopback_socket *loopback_get(const sxp_t *sock)
+{
+    size_t idx;
+    if (!sock)
+        return NULL;
+    /*wraps around for 0 and negative handles*/
+    idx = (size_t)*sock - 1;
+    if (idx >= loopback_count || !loopback_sockets[idx].used)
+        return NULL;
+    return &loopback_sockets[idx];
+}
+
+static sxpResult loopback_open(size_t *idx)
+{
+    struct loopback_socket *socket;
+    while (loopback_unused < loopback_count &&
+           loopback_sockets[loopback_unused].used)
+        loopback_unused++;
+    if (loopback_unused == loopback_count) {
+        size_t count = loopback_count ? loopback_count * 2 : 16;
+        struct loopback_socket *sockets =
+            realloc(loopback_sockets, count * sizeof(*sockets));
+        if (!sockets)
+            return SXP_ERROR_MEMORY;
+        memset(sockets + loopback_count, 0,
+               (count - loopback_count) * sizeof(*sockets));
+        loopback_sockets = sockets;
+        loopback_count = count;
+    }
+    *idx = loopback_unused++;
+    socket = &loopback_sockets[*idx];
+    memset(socket, 0, sizeof(*socket));
+    socket->used = 1;
+    socket->peer = LOOPBACK_NONE;
+    socket->latency = loopback_latency;
+    socket->buffer = loopback_buffer;
+    return SXP_SUCCESS;
+}
+
+/*the peer reads the end of the stream, connections not accepted are reset*/
+static void loopback_close(size_t idx)
+{
+    struct loopback_socket *socket = &loopback_sockets[idx];
+    struct loopback_chunk *chunk;
+    while (socket->backlog_count) {
+        size_t pending = socket->backlog[socket->backlog_first];
+        socket->backlog_first = (socket->backlog_first + 1) %
+                                socket->backlog_max;
+        socket->backlog_count--;
+        loopback_close(pending);
+    }
+    if (socket->peer != LOOPBACK_NONE) {
+        struct loopback_socket *peer = &loopback_sockets[socket->peer];
+        peer->peer = LOOPBACK_NONE;
+        if (!socket->shut) {
+            peer->ended = 1;
+            peer->end_due = loopback_due(peer, socket->latency);
+        }
+    }
+    while ((chunk = socket->head)) {
+        socket->head = chunk->next;
+        free(chunk);
+    }
+    free(socket->backlog);
+    memset(socket, 0, sizeof(*socket));
+    if (idx < loopback_unused)
+        loopback_unused = idx;
+}
+
+static void loopback_link(size_t one, size_t other)
+{
+    loopback_sockets[one].connected = 1;
+    loopback_sockets[one].peer = other;
+    loopback_sockets[one].latency = loopback_latency;
+    loopback_sockets[one].buffer = loopback_buffer;
+    loopback_sockets[other].connected = 1;
+    loopback_sockets[other].peer = one;
+    loopback_sockets[other].latency = loopback_latency;
+    loopback_sockets[other].buffer = loopback_buffer;
+}
+
+/*never before what is already queued on the receiver*/
+static unsigned long loopback_due(struct loopback_socket *receiver,
+                                  unsigned long latency)
+{
+    unsigned long due = loopback_now + latency;
+    if (receiver->tail && (long)(receiver->tail->due - due) > 0)
+        due = receiver->tail->due;
+    return due;
+}
+
+static int loopback_eof(struct loopback_socket *socket)
+{
+    return socket->ended && !socket->head &&
+           (long)(loopback_now - socket->end_due) >= 0;
+}
+
+/*like tcp, the socket hangs up once both directions have ended*/
+static int loopback_ready(size_t idx)
+{
+    struct loopback_socket *socket = &loopback_sockets[idx];
+    int ready = 0;
+    if (!socket->used)
+        return SXP_POLLHUP;
+    if (socket->listening)
+        return socket->backlog_count ? SXP_POLLIN : 0;
+    if (!socket->connected)
+        return 0;
+    if ((socket->head && (long)(loopback_now - socket->head->due) >= 0) ||
+        loopback_eof(socket))
+        ready |= SXP_POLLIN;
+    /*sending fails right away once it can not go on*/
+    if (socket->shut || socket->peer == LOOPBACK_NONE ||
+        loopback_sockets[socket->peer].queued <
+            loopback_sockets[socket->peer].buffer)
+        ready |= SXP_POLLOUT;
+    if (socket->shut && socket->ended &&
+        (long)(loopback_now - socket->end_due) >= 0)
+        ready |= SXP_POLLHUP;
+    return ready;
+}
+
+/*reports the ready sockets of self, starting after the last one reported*/
+static size_t loopback_scan(struct loopback_poller *self, sxp_event_t events[],
+                            size_t *count, size_t limit)
+{
+    size_t seen;
+    *count = 0;
+    for (seen = 0; seen < self->count && *count < limit; seen++) {
+        struct loopback_watch *watch =
+            &self->list[(self->next + seen) % self->count];
+        int ready = loopback_ready(watch->socket) &
+                    (watch->events | SXP_POLLHUP | SXP_POLLERR);
+        if (!ready)
+            continue;
+        events[*count].key = watch->key;
+        events[*count].events = ready;
+        *count += 1;
+    }
+    self->next = self->count ? (self->next + seen) % self->count : 0;
+    return *count;
+}
+
+/*
+instead of sleeping, the clock moves on to the end of the timeout or to the
+arrival of the next bytes on the way, whichever comes first. Returns nonzero
+if it has moved.
+*/
+static int loopback_wait(int timeout)
+{
+    unsigned long due;
+    if (timeout <= 0)
+        return 0;
+    if (sxp_loopback_next(&due) == SXP_SUCCESS &&
+        (long)(due - loopback_now) < timeout)
+        loopback_now = due;
+    else
+        loopback_now += timeout;
+    return 1;
+}
+
+static sxpResult loopback_port_get(const sockaddr_t *address, size_t addrlen,
+                                   unsigned int *port)
+{
+    if (!address || addrlen < sizeof(*address) ||
+        address->sa_family != AF_INET)
+        return SXP_ERROR_INVAL;
+    *port = ((unsigned int)(unsigned char)address->sa_data[0] << 8) |
+            (unsigned int)(unsigned char)address->sa_data[1];
+    return *port ? SXP_SUCCESS : SXP_ERROR_INVAL;
+}
+
+const sxp_vtable_t sxp_loopback = {
+    0, loopback_init, loopback_cleanup, loopback_create, loopback_destroy,
+    loopback_nbio_set, loopback_addrinfo_get, loopback_addrinfo_free,
+    loopback_bind, loopback_listen, loopback_accept, loopback_unix_address,
+    loopback_unix_unlink, loopback_send_fd, loopback_recv_fd, loopback_connect,
+    loopback_connect_finish, loopback_shutdown, loopback_send, loopback_recv,
+    loopback_sendv, loopback_zerocopy_set, loopback_send_zerocopy,
+    loopback_zerocopy_completed, loopback_transport_get, loopback_pair,
+    loopback_clock, loopback_poll, loopback_poller_create,
+    loopback_poller_destroy, loopback_poller_add, loopback_poller_modify,
+    loopback_poller_remove, loopback_poller_wait, loopback_poller_recv
+};
@@ -0,0 +1,42 @@
+#ifndef LOOPBACK_H_
+#define LOOPBACK_H_
+
+#include "socketxp.h"
+
+/*
+an in-memory transport, set with sxp_vtable_set(&sxp_loopback), which lets a
+single process host a server and any number of clients for benchmarks. None
+of its calls ever blocks and sxp_clock returns a virtual clock, so a run
+driven by the same steps always behaves the same. The clock moves on with
+sxp_loopback_advance and whenever a wait finds no socket ready: instead of
+sleeping, it skips to the end of the timeout or to the arrival of the next
+bytes on the way, whichever comes first.
+
+Addresses are ports: sxp_addrinfo_get ignores the hostname and only takes a
+numeric port. Connecting succeeds at once if a socket listens on the port and
+has room in its backlog, otherwise it fails with SXP_ERROR_IO. Bytes become
+readable by the peer latency ms after they were sent and no more than buffer
+bytes are on the way to a socket at once, sends beyond that fail with
+SXP_TRY_AGAIN. Unix domain sockets, passing file descriptors, zero copy and
+SXP_POLLER_URING are not available (SXP_ERROR_PLATFORM).
+
+The transport is not thread safe, so netio refuses io threads and resolves
+addresses in the thread calling net_tick while it is set.
+*/
+extern const sxp_vtable_t sxp_loopback;
+
+/*default one way latency in ms and bytes on the way to a socket*/
+#define LOOPBACK_LATENCY 0
+#define LOOPBACK_BUFFER (256 * 1024)
+
+/*applies to connections made afterwards*/
+sxpResult sxp_loopback_set(unsigned long latency, size_t buffer);
+/*moves the clock returned by sxp_clock forward by ms*/
+void sxp_loopback_advance(unsigned long ms);
+/*
+the time at which the next bytes on the way become readable, SXP_TRY_AGAIN
+if nothing is on the way. A driver can advance the clock right to it.
+*/
+sxpResult sxp_loopback_next(unsigned long *due);
+
+#endif /*LOOPBACK_H_*/
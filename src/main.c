@@ -5,13 +5,20 @@
 #include "util.h"
 #include <string.h>
 
+/*number of port= options accepted by !serve*/
+#define SERVE_ENDPOINTS_MAX 4
+
 static void display_help(char **argv);
 static void command_connect(char **argv);
 static void command_serve(char **argv);
+static int parse_policy(const char *name);
 static void command_key(char **argv, int *self_encryption);
 static void command_encrypt(char **argv, int *encryption);
 static void command_name(char **argv);
 static void command_decode(char **argv);
+static void command_netstat(char **argv);
+static void command_connstat(char **argv);
+static int connstat_compare(const void *a, const void *b);
 static void handle_command(char **argv, int *loop, int *encryption);
 static int handle_net_message(struct net_message *buffer);
 
@@ -19,6 +26,9 @@ int main(int argc, char **argv)
 {
     int loop = 1;
     int encryption = ENCRYPT_NONE;
+    int fds[UI_WAIT_MAX];
+    size_t fd_count = 0;
+    size_t idx;
 
     encrypt_init();
 
@@ -28,6 +38,12 @@ int main(int argc, char **argv)
     if (interface_init() != UI_SUCCESS)
         return -1;
 
+    /*net_tick sleeps until there is input, otherwise it is polled*/
+    if (interface_wait_get(fds, &fd_count) == UI_SUCCESS) {
+        for (idx = 0; idx < fd_count; idx++)
+            net_watch(fds[idx]);
+    }
+
     if (argc < 1)
         return 1;
 
@@ -46,12 +62,24 @@ int main(int argc, char **argv)
         struct net_message buffer[1];
         size_t netCount = 0;
 
-        if (interface_tick() != UI_SUCCESS)
+        /*everything changed by the last iteration is shown before waiting*/
+        if (interface_render() != UI_SUCCESS)
             return -1;
-        if (net_tick() != NET_SUCCESS) {
+        if ((netStatus = net_tick()) == NET_HANDED_OFF)
+            break;
+        if (netStatus == NET_BUSY) {
+            char tmp_buf[64];
+            unsigned long retry = 0;
+            net_retry_get(&retry);
+            net_reset();
+            sprintf(tmp_buf, "Server busy, try again in %lu ms", retry);
+            interface_message_send(tmp_buf);
+        } else if (netStatus != NET_SUCCESS) {
             net_reset();
             interface_message_send("error in net!");
         }
+        if (interface_tick() != UI_SUCCESS)
+            return -1;
 
         while ((status = interface_message_recv(&input)) == UI_SUCCESS) {
             if (strlen(input) >= 1 && *input == '!') {
@@ -128,6 +156,10 @@ static void handle_command(char **argv, int *loop, int *encryption)
         command_encrypt(argv, encryption);
     } else if (!strcmp(argv[0], "decode") || !strcmp(argv[0], "dc")) {
         command_decode(argv);
+    } else if (!strcmp(argv[0], "netstat") || !strcmp(argv[0], "ns")) {
+        command_netstat(argv);
+    } else if (!strcmp(argv[0], "connstat") || !strcmp(argv[0], "cs")) {
+        command_connstat(argv);
     }
 }
 
@@ -136,16 +168,84 @@ static void display_help(char **argv)
     int idx;
     for (idx = 1; argv[idx]; idx++) {
         if (!strcmp(argv[idx], "connect")) {
-            interface_message_send("!connect [ip=###] [port=###]\n"
+            interface_message_send("!connect [ip=###] [port=###] [idle=###]\n"
                                    "Connect to ip[ip] on port[port]\n"
+                                   "or to a server on this host with\n"
+                                   "ip=unix:path (port is ignored),\n"
+                                   "or ip=shm:path to exchange messages\n"
+                                   "through shared memory\n"
+                                   "and disconnect once the server has\n"
+                                   "been silent for idle[idle] ms\n"
                                    "Defaults:\n"
                                    "  ip=127.0.0.1\n"
-                                   "  port=10001");
+                                   "  port=10001\n"
+                                   "  idle=60000");
         } else if (!strcmp(argv[idx], "serve")) {
-            interface_message_send("!serve [port=###]\n"
-                                   "Serve clients on port[port]\n"
-                                   "Defaults:\n"
-                                   "  port=10001");
+            interface_message_send(
+                "!serve [port=###] [backend=###] [threads=###] [backlog=###]\n"
+                "       [policy=###] [guests=###] [high=###] [low=###]\n"
+                "       [grace=###] [outbound=###] [zerocopy=###]\n"
+                "       [handshake=###] [idle=###] [handoff=###]\n"
+                "       [clients=###] [rate=###] [queue=###]\n"
+                "Serve clients on port[port]\n"
+                "using backend[backend] (poll or uring)\n"
+                "and threads[threads] io threads (number or auto)\n"
+                "queueing up to backlog[backlog] connecting clients\n"
+                "Defaults:\n"
+                "  port=10001\n"
+                "  backend=poll\n"
+                "  threads=0\n"
+                "  backlog=128");
+            interface_message_send(
+                "port[port] may also be unix:path to serve clients on\n"
+                "this host, or shm:path to serve them through shared\n"
+                "memory, give it up to 4 times to serve on all of\n"
+                "them at once");
+            interface_message_send(
+                "Once more than high[high] KiB (less than 4096) are\n"
+                "queued on a named client (guests[guests] for unnamed\n"
+                "ones) it is handled by policy[policy] until it is back\n"
+                "below low[low] KiB:\n"
+                "  pause: skip messages and catch up on them later\n"
+                "  backfill: drop history first, then pause\n"
+                "  disconnect: disconnect after grace[grace] ms\n"
+                "At most outbound[outbound] MiB are queued on all clients\n"
+                "Defaults:\n"
+                "  policy=pause\n"
+                "  guests=backfill\n"
+                "  high=1024\n"
+                "  low=256\n"
+                "  grace=10000\n"
+                "  outbound=64");
+            interface_message_send(
+                "Frames of at least zerocopy[zerocopy] KiB (such as\n"
+                "history for joining clients) are sent without copying\n"
+                "them into the kernel, 0 disables it\n"
+                "Defaults:\n"
+                "  zerocopy=0");
+            interface_message_send(
+                "Clients which have not completed the handshake within\n"
+                "handshake[handshake] ms or have been silent for idle[idle]\n"
+                "ms are disconnected, 0 disables the timeout. Silent\n"
+                "clients are pinged after half of idle[idle] ms.\n"
+                "Defaults:\n"
+                "  handshake=10000\n"
+                "  idle=60000");
+            interface_message_send(
+                "At most clients[clients] clients are served at once and\n"
+                "at most rate[rate] of them admitted per second, up to\n"
+                "queue[queue] more wait for their turn. Others are told\n"
+                "to try again later, 0 disables either limit.\n"
+                "Defaults:\n"
+                "  clients=0\n"
+                "  rate=0\n"
+                "  queue=64");
+            interface_message_send(
+                "With handoff[handoff] (a path), a server already serving\n"
+                "with the same handoff[handoff] is taken over along with\n"
+                "its clients and history, the other options but the\n"
+                "ports still apply. Otherwise the server is served and\n"
+                "handed over to the next one started that way.");
         } else if (!strcmp(argv[idx], "key")) {
             interface_message_send(
                 "!key [key=###] [encrypt=###] [name=###]\n"
@@ -169,9 +269,21 @@ static void display_help(char **argv)
             interface_message_send(
                 "!decode [enable=###]\n"
                 "Enable (on) or disable (off) decoding of messages.");
+        } else if (!strcmp(argv[idx], "netstat")) {
+            interface_message_send("!netstat\n"
+                                   "Display statistics of the network.");
+        } else if (!strcmp(argv[idx], "connstat")) {
+            interface_message_send(
+                "!connstat [limit=###]\n"
+                "Display statistics of the limit[limit] connections\n"
+                "with the most bytes waiting to be sent: bytes queued\n"
+                "(and of them in the socket), received and sent, round\n"
+                "trip time, retransmitted segments and congestion window\n"
+                "Defaults:\n"
+                "  limit=16");
         }
     }
-    if (!(idx - 1))
+    if (!(idx - 1)) {
         interface_message_send(
             "!quit    - !q:  Quit the application\n"
             "!help    - !h:  Display this help message\n"
@@ -186,6 +298,10 @@ static void display_help(char **argv)
             "!name    - !n:  Set own name\n"
             "!encrypt - !e:  Set own encryption method\n"
             "!decode  - !dc: Enable or disable decoding of messages.");
+        interface_message_send(
+            "!netstat - !ns: Display network statistics.\n"
+            "!connstat - !cs: Display statistics of connections.");
+    }
 }
 
 static void command_connect(char **argv)
@@ -193,6 +309,7 @@ static void command_connect(char **argv)
     int idx;
     const char *ip = "127.0.0.1";
     const char *port = "10001";
+    unsigned long idle = 60000;
     for (idx = 1; argv[idx]; idx++) {
         if (util_startswith(argv[idx], "ip=")) {
             ip = argv[idx] + strlen("ip=");
@@ -200,9 +317,13 @@ static void command_connect(char **argv)
         if (util_startswith(argv[idx], "port=")) {
             port = argv[idx] + strlen("port=");
         }
+        if (util_startswith(argv[idx], "idle=")) {
+            idle = strtoul(argv[idx] + strlen("idle="), NULL, 10);
+        }
     }
     net_reset();
     interface_message_clear();
+    net_timeouts_set(10000, idle);
     interface_message_send("Connecting on ip:");
     interface_message_send(ip);
     interface_message_send("And on port:");
@@ -213,17 +334,156 @@ static void command_connect(char **argv)
 static void command_serve(char **argv)
 {
     int idx;
-    const char *port = "10001";
+    const char *ports[SERVE_ENDPOINTS_MAX] = { "10001" };
+    int port_count = 0;
+    int backend = NET_BACKEND_POLL;
+    int threads = 0;
+    int backlog = 128;
+    const struct net_policy defaults = { NET_POLICY_PAUSE, 1024 * 1024,
+                                         256 * 1024, 10000 };
+    struct net_policy member = defaults;
+    struct net_policy guest = defaults;
+    size_t outbound = 64;
+    size_t zerocopy = 0;
+    unsigned long handshake = 10000;
+    unsigned long idle = 60000;
+    struct net_admission admission = { 0, 0, 64 };
+    const char *handoff = NULL;
+    netResult taken;
+    guest.policy = NET_POLICY_BACKFILL;
     for (idx = 1; argv[idx]; idx++) {
-        if (util_startswith(argv[idx], "port=")) {
-            port = argv[idx] + strlen("port=");
+        if (util_startswith(argv[idx], "port=") &&
+            port_count < SERVE_ENDPOINTS_MAX) {
+            ports[port_count++] = argv[idx] + strlen("port=");
+        }
+        if (util_startswith(argv[idx], "backend=")) {
+            const char *backend_name = argv[idx] + strlen("backend=");
+            if (!strcmp(backend_name, "uring"))
+                backend = NET_BACKEND_URING;
+        }
+        if (util_startswith(argv[idx], "threads=")) {
+            const char *threads_count = argv[idx] + strlen("threads=");
+            threads = strcmp(threads_count, "auto") ? atoi(threads_count) :
+                                                      NET_THREADS_AUTO;
+        }
+        if (util_startswith(argv[idx], "backlog=")) {
+            backlog = atoi(argv[idx] + strlen("backlog="));
+        }
+        if (util_startswith(argv[idx], "policy=")) {
+            member.policy = parse_policy(argv[idx] + strlen("policy="));
+        }
+        if (util_startswith(argv[idx], "guests=")) {
+            guest.policy = parse_policy(argv[idx] + strlen("guests="));
+        }
+        if (util_startswith(argv[idx], "high=")) {
+            member.high = atol(argv[idx] + strlen("high=")) * 1024;
+            guest.high = member.high;
+        }
+        if (util_startswith(argv[idx], "low=")) {
+            member.low = atol(argv[idx] + strlen("low=")) * 1024;
+            guest.low = member.low;
+        }
+        if (util_startswith(argv[idx], "grace=")) {
+            member.grace = atol(argv[idx] + strlen("grace="));
+            guest.grace = member.grace;
+        }
+        if (util_startswith(argv[idx], "outbound=")) {
+            outbound = atol(argv[idx] + strlen("outbound="));
+        }
+        if (util_startswith(argv[idx], "zerocopy=")) {
+            zerocopy = atol(argv[idx] + strlen("zerocopy="));
+        }
+        if (util_startswith(argv[idx], "handshake=")) {
+            handshake = strtoul(argv[idx] + strlen("handshake="), NULL, 10);
+        }
+        if (util_startswith(argv[idx], "idle=")) {
+            idle = strtoul(argv[idx] + strlen("idle="), NULL, 10);
+        }
+        if (util_startswith(argv[idx], "handoff=")) {
+            handoff = argv[idx] + strlen("handoff=");
+        }
+        if (util_startswith(argv[idx], "clients=")) {
+            admission.clients = atol(argv[idx] + strlen("clients="));
+        }
+        if (util_startswith(argv[idx], "rate=")) {
+            admission.rate = strtoul(argv[idx] + strlen("rate="), NULL, 10);
+        }
+        if (util_startswith(argv[idx], "queue=")) {
+            admission.queue = atol(argv[idx] + strlen("queue="));
         }
     }
     net_reset();
     interface_message_clear();
+    if (net_backend_set(backend) != NET_SUCCESS) {
+        interface_message_send("Backend not available, using poll");
+        net_backend_set(NET_BACKEND_POLL);
+    }
+    if (net_threads_set(threads) != NET_SUCCESS) {
+        interface_message_send("Invalid number of threads, using 0");
+        net_threads_set(0);
+    }
+    if (net_backlog_set(backlog) != NET_SUCCESS) {
+        interface_message_send("Invalid backlog, using 128");
+        net_backlog_set(128);
+    }
+    if (net_policy_set(NET_CLASS_MEMBER, &member) != NET_SUCCESS ||
+        net_policy_set(NET_CLASS_GUEST, &guest) != NET_SUCCESS) {
+        interface_message_send("Invalid policy, using the defaults");
+        guest = defaults;
+        guest.policy = NET_POLICY_BACKFILL;
+        net_policy_set(NET_CLASS_MEMBER, &defaults);
+        net_policy_set(NET_CLASS_GUEST, &guest);
+    }
+    if (net_outbound_max_set(outbound * 1024 * 1024) != NET_SUCCESS) {
+        interface_message_send("Invalid outbound limit, using 64");
+        net_outbound_max_set(64 * 1024 * 1024);
+    }
+    if (net_zerocopy_set(zerocopy * 1024) != NET_SUCCESS) {
+        interface_message_send("Invalid zerocopy threshold, using 0");
+        net_zerocopy_set(0);
+    }
+    net_timeouts_set(handshake, idle);
+    if (net_admission_set(&admission) != NET_SUCCESS) {
+        interface_message_send("Invalid admission limits, admitting all");
+        admission.clients = 0;
+        admission.rate = 0;
+        net_admission_set(&admission);
+    }
+    /*the endpoints of the server taken over are kept*/
+    if (handoff && (taken = net_takeover(handoff)) != NET_TRY_AGAIN) {
+        interface_message_send(taken == NET_SUCCESS ?
+                                   "Took over the server at:" :
+                                   "Could not take over the server at:");
+        interface_message_send(handoff);
+        return;
+    }
     interface_message_send("Listening on port:");
-    interface_message_send(port);
-    net_serve(port);
+    interface_message_send(ports[0]);
+    net_serve(ports[0]);
+    for (idx = 1; idx < port_count; idx++) {
+        interface_message_send(net_listen(ports[idx]) == NET_SUCCESS ?
+                                   "And on port:" :
+                                   "Could not listen on port:");
+        interface_message_send(ports[idx]);
+    }
+    if (handoff) {
+        interface_message_send(net_handoff_listen(handoff) == NET_SUCCESS ?
+                                   "Handing over to successors at:" :
+                                   "Could not hand over at:");
+        interface_message_send(handoff);
+    }
+}
+
+/*unknown names are left to net_policy_set to reject*/
+static int parse_policy(const char *name)
+{
+    if (!strcmp(name, "pause"))
+        return NET_POLICY_PAUSE;
+    if (!strcmp(name, "backfill"))
+        return NET_POLICY_BACKFILL;
+    if (!strcmp(name, "disconnect"))
+        return NET_POLICY_DISCONNECT;
+    return -1;
 }
 
 static void command_encrypt(char **argv, int *encryption)
@@ -363,6 +623,128 @@ static void command_decode(char **argv)
     }
 }
 
+static void command_netstat(char **argv)
+{
+    char tmp_buf[255];
+    struct net_stats stats;
+
+    (void)argv;
+
+    if (net_stats_get(&stats) != NET_SUCCESS) {
+        interface_message_send("Not connected!");
+        return;
+    }
+    sprintf(tmp_buf, "backend: %s",
+            stats.backend == NET_BACKEND_URING ? "uring" : "poll");
+    interface_message_send(tmp_buf);
+    sprintf(tmp_buf, "io threads: %u", stats.threads);
+    interface_message_send(tmp_buf);
+    sprintf(tmp_buf, "wakeups/s: %lu", stats.wakeups_per_second);
+    interface_message_send(tmp_buf);
+    sprintf(tmp_buf, "queued outbound: %lu bytes",
+            (unsigned long)stats.outbound);
+    interface_message_send(tmp_buf);
+    sprintf(tmp_buf, "zerocopy sends: %lu (%lu copied)", stats.zerocopy_sends,
+            stats.zerocopy_copied);
+    interface_message_send(tmp_buf);
+    sprintf(tmp_buf, "timed out: %lu", stats.timeouts);
+    interface_message_send(tmp_buf);
+    sprintf(tmp_buf, "waiting to be admitted: %lu (%lu refused)",
+            (unsigned long)stats.waiting, stats.refused);
+    interface_message_send(tmp_buf);
+}
+
+struct connstat_entry {
+    int person;
+    struct net_connection_stats stats;
+};
+
+static void command_connstat(char **argv)
+{
+    char tmp_buf[255];
+    struct connstat_entry *entries;
+    size_t entry_count = 0;
+    size_t person_count;
+    size_t limit = 16;
+    int *people;
+    size_t idx;
+
+    for (idx = 1; argv[idx]; idx++) {
+        if (util_startswith(argv[idx], "limit=")) {
+            limit = atol(argv[idx] + strlen("limit="));
+        }
+    }
+
+    if (net_person_count(&person_count) != NET_SUCCESS) {
+        interface_message_send("Not connected!");
+        return;
+    }
+    /*a client only has its connection to the server*/
+    people = malloc((person_count + 1) * sizeof(*people));
+    entries = malloc((person_count + 1) * sizeof(*entries));
+    if (!people || !entries ||
+        net_person_list(people, person_count) != NET_SUCCESS) {
+        free(people);
+        free(entries);
+        return;
+    }
+    people[person_count++] = NET_MYSELF;
+    for (idx = 0; idx < person_count; idx++) {
+        if (net_connection_stats_get(people[idx],
+                                     &entries[entry_count].stats) !=
+            NET_SUCCESS)
+            continue;
+        entries[entry_count++].person = people[idx];
+    }
+    free(people);
+    qsort(entries, entry_count, sizeof(*entries), connstat_compare);
+
+    sprintf(tmp_buf, "%lu connections", (unsigned long)entry_count);
+    interface_message_send(tmp_buf);
+    for (idx = 0; idx < entry_count && idx < limit; idx++) {
+        struct net_connection_stats *stats = &entries[idx].stats;
+        char *name = NULL;
+        if (entries[idx].person != NET_MYSELF &&
+            net_name_get(entries[idx].person, &name) != NET_SUCCESS)
+            name = NULL;
+        sprintf(tmp_buf,
+                "%.40s: queued %lu (%lu in socket), in %lu B/%lu, "
+                "out %lu B/%lu",
+                entries[idx].person == NET_MYSELF ? "server" :
+                name                              ? name :
+                                                    "Unknown User",
+                (unsigned long)stats->queued + stats->socket_queued,
+                stats->socket_queued, stats->bytes_in, stats->frames_in,
+                stats->bytes_out, stats->frames_out);
+        interface_message_send(tmp_buf);
+        free(name);
+        if (!stats->sampled || !stats->rtt)
+            continue;
+        sprintf(tmp_buf,
+                "  rtt %lu.%03lu ms (+-%lu.%03lu), %lu retransmits, "
+                "cwnd %lu",
+                stats->rtt / 1000, stats->rtt % 1000, stats->rtt_var / 1000,
+                stats->rtt_var % 1000, stats->retransmits, stats->cwnd);
+        interface_message_send(tmp_buf);
+    }
+    free(entries);
+}
+
+/*most bytes waiting first*/
+static int connstat_compare(const void *a, const void *b)
+{
+    const struct net_connection_stats *first =
+        &((const struct connstat_entry *)a)->stats;
+    const struct net_connection_stats *second =
+        &((const struct connstat_entry *)b)->stats;
+    unsigned long waiting_first = first->queued + first->socket_queued;
+    unsigned long waiting_second = second->queued + second->socket_queued;
+
+    if (waiting_first != waiting_second)
+        return waiting_first < waiting_second ? 1 : -1;
+    return 0;
+}
+
 static int handle_net_message(struct net_message *buffer)
 {
     char tmp_buf[255];
@@ -11,6 +11,12 @@ static size_t messages_count = 0;
 static size_t message_last_seen = -1;
 static int messages_should_decode = 1;
 
+/*ms a busy server asked this client to wait, once it has*/
+static unsigned long busy_retry = 0;
+static int busy = 0;
+
+/*per person arrays are indexed by NET_ID_SLOT of the person id*/
+static long int *person_ids = NULL;
 static char **person_name = NULL;
 static size_t person_count = 0;
 
@@ -26,7 +32,19 @@ static netResult connection_close(connection_t who);
 static netResult messages_set(long int index, long int person_id,
                               long int encryption, const char *message);
 
-static netResult broadcast(const net_buffer_t *broadcast);
+static netResult broadcast(const net_buffer_t *broadcast, long int tag);
+static netResult history_create(netio_frame_t **frame, int info_type,
+                                long int from, size_t limit, int flags,
+                                long int *next);
+static void clients_resume();
+static void connections_probe();
+static void connections_closed();
+static void connections_refused();
+static netResult control_send(connection_t who, int type, unsigned long value);
+
+static netResult handoff();
+static netResult state_save(net_buffer_t *state);
+static netResult state_load(net_buffer_t *state);
 
 static netResult handle_packet_handshake_c(connection_t sender,
                                            struct protocol_packet *packet);
@@ -38,6 +56,10 @@ static netResult handle_packet_person(connection_t sender,
                                       struct protocol_packet *packet);
 static netResult handle_packet_message(connection_t sender,
                                        struct protocol_packet *packet);
+static netResult handle_packet_ping(connection_t sender,
+                                    struct protocol_packet *packet);
+static netResult handle_packet_busy(connection_t sender,
+                                    struct protocol_packet *packet);
 
 netResult net_init()
 {
@@ -77,7 +99,7 @@ netResult net_connect(const char *hostname, const char *port)
     return result;
 }
 
-netResult net_serve(const char *port)
+netResult net_serve(const char *endpoint)
 {
     netResult result;
 
@@ -86,13 +108,47 @@ netResult net_serve(const char *port)
     is_server = 1;
     self_person_id = 0;
 
-    result = netio_serve(port);
+    result = netio_serve(endpoint);
     if (result == NET_SUCCESS)
         result = person_make(self_person_id);
 
     return result;
 }
 
+netResult net_listen(const char *endpoint)
+{
+    if (is_server != 1)
+        return NET_ERROR;
+    return netio_listen(endpoint);
+}
+
+netResult net_handoff_listen(const char *path)
+{
+    if (is_server != 1)
+        return NET_ERROR;
+    return netio_handoff_listen(path);
+}
+
+netResult net_takeover(const char *path)
+{
+    netResult result;
+    net_buffer_t state = { 0 };
+
+    if (is_server >= 0)
+        return NET_ERROR;
+
+    if ((result = netio_takeover(path, &state)) != NET_SUCCESS)
+        return result;
+    is_server = 1;
+    self_person_id = 0;
+
+    result = state_load(&state);
+    packet_free(&state);
+    if (result != NET_SUCCESS)
+        net_reset();
+    return result;
+}
+
 netResult net_reset()
 {
     size_t i, j;
@@ -126,10 +182,14 @@ netResult net_reset()
         free(person_name[i]);
     free(person_name);
     person_name = NULL;
+    free(person_ids);
+    person_ids = NULL;
     person_count = 0;
 
     is_server = -1;
     self_person_id = -1;
+    busy = 0;
+    busy_retry = 0;
 
     return netio_reset();
 }
@@ -142,13 +202,19 @@ netResult net_tick()
     net_buffer_t incoming = { 0 };
     struct protocol_packet request = { 0 };
 
+    /*also waits for the watched file descriptors*/
     if (is_server < 0)
-        return NET_SUCCESS;
+        return netio_tick();
 
     if ((result = netio_tick()) != NET_SUCCESS)
         return result;
+    clients_resume();
+    connections_probe();
+    connections_closed();
+    connections_refused();
     while ((result = netio_recv(&sender, &incoming)) == NET_SUCCESS) {
         while (incoming.size < incoming.capacity &&
+               netio_connection_active(sender) &&
                packet_deserialize(&incoming, &request) == PACKET_SUCCESS) {
             switch (request.type) {
             case NET_PROTO_HANDSHAKE_C:
@@ -168,22 +234,41 @@ netResult net_tick()
                 result = handle_packet_message(sender, &request);
                 free(request.as.message.message);
                 break;
+            case NET_PROTO_PING:
+                result = handle_packet_ping(sender, &request);
+                break;
+            case NET_PROTO_PONG:
+                /*arriving was all it had to do*/
+                result = NET_SUCCESS;
+                break;
+            case NET_PROTO_BUSY:
+                result = handle_packet_busy(sender, &request);
+                break;
             default:
                 result = NET_ERROR;
                 break;
             }
+            /*the server closes the connection by itself*/
+            if (result == NET_BUSY)
+                return result;
             if (result != NET_SUCCESS) {
                 connection_close(sender);
                 break;
             }
         }
-        packet_free(&incoming);
     }
     if (result == NET_TRY_AGAIN)
-        return NET_SUCCESS;
+        result = NET_SUCCESS;
+    if (result == NET_SUCCESS && netio_successor() == NET_SUCCESS)
+        return handoff();
     return result;
 }
 
+netResult net_watch(int fd)
+{
+    return netio_watch(fd);
+}
+
 netResult net_name_set(int person, const char *name)
 {
     netResult result;
@@ -215,7 +300,7 @@ netResult net_name_set(int person, const char *name)
 
     if (result == NET_SUCCESS) {
         if (is_server) {
-            result = broadcast(&outgoing);
+            result = broadcast(&outgoing, NETIO_TAG_NONE);
             if (result == NET_SUCCESS)
                 result = handle_packet_person(person, &update);
         } else {
@@ -243,7 +328,7 @@ netResult net_name_get(int person, char **name)
     if (!person_exists(person)) {
         if (is_server)
             return NET_ERROR;
-        if (person >= 0 && (size_t)person < person_count)
+        if (person >= 0 && NET_ID_SLOT(person) < person_count)
             return NET_ERROR;
 
         query.type = NET_PROTO_INFO_C;
@@ -258,13 +343,15 @@ netResult net_name_get(int person, char **name)
         return result != NET_ERROR ? NET_TRY_AGAIN : NET_ERROR;
     }
 
-    result = util_strcpy(name, person_name[person], NET_SUCCESS, NET_ERROR);
+    result = util_strcpy(name, person_name[NET_ID_SLOT(person)], NET_SUCCESS,
+                         NET_ERROR);
     return result;
 }
 
 netResult net_key_set(int person, int method, const char *key)
 {
     netResult result;
+    size_t slot;
 
     if (is_server < 0)
         return NET_ERROR;
@@ -275,19 +362,20 @@ netResult net_key_set(int person, int method, const char *key)
 
     if (!person_exists(person))
         return NET_ERROR;
+    slot = NET_ID_SLOT(person);
 
-    if (person_encrypt_plain[method][person]) {
-        free(person_encrypt_plain[method][person]);
-        encryptors[method].key_free(person_encrypt_key[method][person]);
+    if (person_encrypt_plain[method][slot]) {
+        free(person_encrypt_plain[method][slot]);
+        encryptors[method].key_free(person_encrypt_key[method][slot]);
     }
 
-    result = util_strcpy(&person_encrypt_plain[method][person], key,
-                         NET_SUCCESS, NET_ERROR);
+    result = util_strcpy(&person_encrypt_plain[method][slot], key, NET_SUCCESS,
+                         NET_ERROR);
     if (result == NET_SUCCESS) {
-        person_encrypt_key[method][person] = encryptors[method].key_parse(key);
-        if (!person_encrypt_key[method][person]) {
-            free(person_encrypt_plain[method][person]);
-            person_encrypt_plain[method][person] = NULL;
+        person_encrypt_key[method][slot] = encryptors[method].key_parse(key);
+        if (!person_encrypt_key[method][slot]) {
+            free(person_encrypt_plain[method][slot]);
+            person_encrypt_plain[method][slot] = NULL;
         }
     }
     return result;
@@ -307,13 +395,13 @@ netResult net_key_get(int person, int method, char **dst)
     if (!person_exists(person))
         return NET_ERROR;
 
-    if (!person_encrypt_plain[method][person]) {
+    if (!person_encrypt_plain[method][NET_ID_SLOT(person)]) {
         *dst = NULL;
         return NET_SUCCESS;
     }
 
-    result = util_strcpy(dst, person_encrypt_plain[method][person], NET_SUCCESS,
-                         NET_ERROR);
+    result = util_strcpy(dst, person_encrypt_plain[method][NET_ID_SLOT(person)],
+                         NET_SUCCESS, NET_ERROR);
 
     return result;
 }
@@ -323,26 +411,26 @@ netResult net_message_send(int encryption, const char *message)
     netResult result;
     net_buffer_t outgoing = { 0 };
     struct protocol_packet packet = { 0 };
+    size_t slot;
 
     if (is_server < 0)
         return NET_ERROR;
     if (!person_exists(self_person_id))
         return NET_TRY_AGAIN;
+    slot = NET_ID_SLOT(self_person_id);
 
     packet.type = NET_PROTO_MESSAGE;
     packet.as.message.person_id = self_person_id;
     packet.as.message.index = -1;
     packet.as.message.encryption =
-        person_encrypt_plain[encryption][self_person_id] ? encryption :
-                                                           ENCRYPT_NONE;
+        person_encrypt_plain[encryption][slot] ? encryption : ENCRYPT_NONE;
     packet.as.message.message = NULL;
     result = util_strcpy(&packet.as.message.message, message, NET_SUCCESS,
                          NET_ERROR);
 
-    if (person_encrypt_plain[encryption][self_person_id]) {
-        encryptors[encryption].encode(
-            &packet.as.message.message,
-            person_encrypt_key[encryption][self_person_id]);
+    if (person_encrypt_plain[encryption][slot]) {
+        encryptors[encryption].encode(&packet.as.message.message,
+                                      person_encrypt_key[encryption][slot]);
     }
 
     if (result == NET_SUCCESS)
@@ -351,7 +439,7 @@ netResult net_message_send(int encryption, const char *message)
                      NET_ERROR;
     if (result == NET_SUCCESS) {
         if (is_server) {
-            result = broadcast(&outgoing);
+            result = broadcast(&outgoing, NETIO_TAG_NONE);
             if (result == NET_SUCCESS)
                 result = handle_packet_message(self_person_id, &packet);
         } else {
@@ -369,47 +457,110 @@ netResult net_message_recv(struct net_message *buffer, size_t *count,
 {
     netResult result = NET_SUCCESS;
     long int read_start;
-    size_t max_count;
+    size_t read_end;
+    size_t read;
     size_t idx;
 
     if (is_server < 0)
         return NET_TRY_AGAIN;
 
     if (flags & NET_FHISTORY) {
-        read_start = message_last_seen - limit;
+        read_start = message_last_seen - limit + 1;
         read_start = read_start > 0 ? read_start : 0;
-        max_count = message_last_seen - read_start + 1;
+        read_end = message_last_seen + 1;
     } else {
         read_start = message_last_seen + 1;
-        max_count = messages_count - read_start;
-        max_count = max_count > limit ? limit : max_count;
-        message_last_seen += max_count;
+        read_end = messages_count;
     }
 
-    if (max_count == 0)
-        return NET_TRY_AGAIN;
-
-    for (idx = 0; idx < max_count && result == NET_SUCCESS; idx++) {
-        buffer[idx].person_id = messages[read_start + idx].person_id;
-        buffer[idx].index = messages[read_start + idx].index;
-        buffer[idx].encryption = messages[read_start + idx].encryption;
+    idx = 0;
+    for (read = read_start; read < read_end && idx < limit &&
+                            result == NET_SUCCESS;
+         read++) {
+        /*left out of a capped history or catch up, they never arrive*/
+        if (!messages[read].message)
+            continue;
+        if (!(flags & NET_FHISTORY))
+            message_last_seen = read;
+        buffer[idx].person_id = messages[read].person_id;
+        buffer[idx].index = messages[read].index;
+        buffer[idx].encryption = messages[read].encryption;
         buffer[idx].message = NULL;
-        result = util_strcpy(&buffer[idx].message,
-                             messages[read_start + idx].message, NET_SUCCESS,
-                             NET_ERROR);
+        result = util_strcpy(&buffer[idx].message, messages[read].message,
+                             NET_SUCCESS, NET_ERROR);
 
         if (messages_should_decode && person_exists(buffer[idx].person_id) &&
-            person_encrypt_plain[buffer[idx].encryption][buffer[idx].person_id]) {
+            person_encrypt_plain[buffer[idx].encryption]
+                                [NET_ID_SLOT(buffer[idx].person_id)]) {
             encryptors[buffer[idx].encryption].decode(
                 &buffer[idx].message,
                 person_encrypt_key[buffer[idx].encryption]
-                                  [buffer[idx].person_id]);
+                                  [NET_ID_SLOT(buffer[idx].person_id)]);
         }
+        idx++;
     }
     *count = idx;
+    if (!idx && result == NET_SUCCESS)
+        return NET_TRY_AGAIN;
     return result;
 }
 
+netResult net_backend_set(int backend)
+{
+    if (is_server >= 0)
+        return NET_ERROR;
+    return netio_backend_set(backend);
+}
+
+netResult net_threads_set(int threads)
+{
+    if (is_server >= 0)
+        return NET_ERROR;
+    return netio_threads_set(threads);
+}
+
+netResult net_backlog_set(int backlog)
+{
+    if (is_server >= 0)
+        return NET_ERROR;
+    return netio_backlog_set(backlog);
+}
+
+netResult net_policy_set(int client_class, const struct net_policy *policy)
+{
+    if (is_server >= 0)
+        return NET_ERROR;
+    return netio_policy_set(client_class, policy);
+}
+
+netResult net_outbound_max_set(size_t limit)
+{
+    if (is_server >= 0)
+        return NET_ERROR;
+    return netio_outbound_max_set(limit);
+}
+
+netResult net_zerocopy_set(size_t threshold)
+{
+    if (is_server >= 0)
+        return NET_ERROR;
+    return netio_zerocopy_set(threshold);
+}
+
+netResult net_timeouts_set(unsigned long handshake, unsigned long idle)
+{
+    if (is_server >= 0)
+        return NET_ERROR;
+    return netio_timeouts_set(handshake, idle);
+}
+
+netResult net_admission_set(const struct net_admission *admission)
+{
+    if (is_server >= 0)
+        return NET_ERROR;
+    return netio_admission_set(admission);
+}
+
 netResult net_messages_decoding_set(int enabled)
 {
     if (is_server < 0)
@@ -427,7 +578,7 @@ netResult net_person_count(size_t *list)
 
     *list = 0;
     for (person = 0; person < person_count; person++) {
-        if (person_exists(person))
+        if (person_name[person])
             *list += 1;
     }
 
@@ -442,8 +593,8 @@ netResult net_person_list(int list[], size_t limit)
         return NET_ERROR;
 
     for (person = 0; person < person_count && limit > 0; person++) {
-        if (person_exists(person)) {
-            *(list++) = person;
+        if (person_name[person]) {
+            *(list++) = person_ids[person];
             limit--;
         }
     }
@@ -451,15 +602,50 @@ netResult net_person_list(int list[], size_t limit)
     return NET_SUCCESS;
 }
 
+netResult net_retry_get(unsigned long *retry)
+{
+    if (is_server != 0 || !busy)
+        return NET_ERROR;
+    *retry = busy_retry;
+    return NET_SUCCESS;
+}
+
+netResult net_stats_get(struct net_stats *stats)
+{
+    if (is_server < 0)
+        return NET_ERROR;
+    memset(stats, 0, sizeof(*stats));
+    return netio_stats_get(stats);
+}
+
+netResult net_connection_stats_get(int person,
+                                   struct net_connection_stats *stats)
+{
+    if (is_server < 0)
+        return NET_ERROR;
+    if (!is_server) {
+        if (person != NET_MYSELF)
+            return NET_ERROR;
+        person = 0;
+    } else if (person == self_person_id || !person_exists(person)) {
+        return NET_ERROR;
+    }
+    memset(stats, 0, sizeof(*stats));
+    return netio_connection_stats_get(person, stats);
+}
+
 static int person_exists(int who)
 {
-    return who >= 0 && (size_t)who < person_count && person_name[who];
+    size_t slot = NET_ID_SLOT(who);
+    return who >= 0 && slot < person_count && person_name[slot] &&
+           person_ids[slot] == who;
 }
 
 static netResult person_make(int who)
 {
     int i;
     netResult result;
+    size_t slot = NET_ID_SLOT(who);
 
     if (is_server < 0)
         return NET_ERROR;
@@ -468,32 +654,45 @@ static netResult person_make(int who)
     if (person_exists(who))
         return NET_ERROR;
 
-    if ((size_t)who >= person_count) {
+    if (slot >= person_count) {
         size_t i;
         for (i = 0; i < ENCRYPT_MAX_VAL; i++) {
             person_encrypt_plain[i] =
                 realloc(person_encrypt_plain[i],
-                        (who + 1) * sizeof(*person_encrypt_plain[i]));
+                        (slot + 1) * sizeof(*person_encrypt_plain[i]));
             if (!person_encrypt_plain[i])
                 return NET_ERROR;
             memset(person_encrypt_plain[i] + person_count, 0,
-                   (who + 1 - person_count) * sizeof(*person_encrypt_plain[i]));
+                   (slot + 1 - person_count) *
+                       sizeof(*person_encrypt_plain[i]));
 
             person_encrypt_key[i] =
                 realloc(person_encrypt_key[i],
-                        (who + 1) * sizeof(*person_encrypt_key[i]));
+                        (slot + 1) * sizeof(*person_encrypt_key[i]));
             if (!person_encrypt_key[i])
                 return NET_ERROR;
             memset(person_encrypt_key[i] + person_count, 0,
-                   (who + 1 - person_count) * sizeof(*person_encrypt_key[i]));
+                   (slot + 1 - person_count) * sizeof(*person_encrypt_key[i]));
         }
-        person_name = realloc(person_name, (who + 1) * sizeof(*person_name));
+        person_name = realloc(person_name, (slot + 1) * sizeof(*person_name));
+        if (!person_name)
+            return NET_ERROR;
         memset(person_name + person_count, 0,
-               (who + 1 - person_count) * sizeof(*person_name));
-        person_count = who + 1;
+               (slot + 1 - person_count) * sizeof(*person_name));
+        person_ids = realloc(person_ids, (slot + 1) * sizeof(*person_ids));
+        if (!person_ids)
+            return NET_ERROR;
+        memset(person_ids + person_count, 0,
+               (slot + 1 - person_count) * sizeof(*person_ids));
+        person_count = slot + 1;
     }
 
-    result = util_strcpy(&person_name[who], "(anon)", NET_SUCCESS, NET_ERROR);
+    /*the slot is still held by a previous occupant who has left*/
+    if (person_name[slot])
+        person_free(person_ids[slot]);
+
+    person_ids[slot] = who;
+    result = util_strcpy(&person_name[slot], "(anon)", NET_SUCCESS, NET_ERROR);
 
     if (result == NET_SUCCESS)
         for (i = 0; i < ENCRYPT_MAX_VAL; i++) {
@@ -506,20 +705,21 @@ static netResult person_make(int who)
 static netResult person_free(int who)
 {
     size_t i;
+    size_t slot = NET_ID_SLOT(who);
 
     if (is_server < 0)
         return NET_ERROR;
     if (!person_exists(who))
         return NET_ERROR;
 
-    free(person_name[who]);
-    person_name[who] = NULL;
+    free(person_name[slot]);
+    person_name[slot] = NULL;
 
     for (i = 0; i < ENCRYPT_MAX_VAL; i++) {
-        free(person_encrypt_plain[i][who]);
-        person_encrypt_plain[i][who] = NULL;
-        encryptors[i].key_free(person_encrypt_key[i][who]);
-        person_encrypt_key[i][who] = NULL;
+        free(person_encrypt_plain[i][slot]);
+        person_encrypt_plain[i][slot] = NULL;
+        encryptors[i].key_free(person_encrypt_key[i][slot]);
+        person_encrypt_key[i][slot] = NULL;
     }
 
     return NET_SUCCESS;
@@ -568,22 +768,340 @@ static netResult messages_set(long int index, long int person_id,
     return result;
 }
 
-static netResult broadcast(const net_buffer_t *broadcast)
+/*tag is the index of the broadcast message, if it is one*/
+static netResult broadcast(const net_buffer_t *broadcast, long int tag)
 {
-    connection_t client;
+    netio_frame_t *frame;
+    size_t slot;
 
     if (is_server != 1)
         return NET_ERROR;
 
-    for (client = 1; client < person_count; client++)
-        if (netio_connection_active(client) && person_exists(client)) {
-            if (netio_send(client, broadcast) != NET_SUCCESS)
+    /*serialize once, every client queues a reference to the same frame*/
+    if (netio_frame_create(&frame, broadcast, 0, tag) != NET_SUCCESS)
+        return NET_ERROR;
+    for (slot = 1; slot < person_count; slot++) {
+        connection_t client = person_ids[slot];
+        if (person_name[slot] && netio_connection_active(client)) {
+            if (netio_send_frame(client, frame) != NET_SUCCESS)
                 connection_close(client);
         }
+    }
+    netio_frame_release(frame);
 
     return NET_SUCCESS;
 }
 
+/*
+serializes the audience and messages with an index of at least from into a
+single frame. The audience is capped so that the frame stays small, messages
+are added until the frame is larger than limit. Without next the newest
+messages down to from are taken. With next they are taken oldest first from
+from, at least one of them, and next is set to the first one left out or
+NETIO_TAG_NONE.
+*/
+static netResult history_create(netio_frame_t **frame, int info_type,
+                                long int from, size_t limit, int flags,
+                                long int *next)
+{
+    netResult result = NET_SUCCESS;
+    net_buffer_t outgoing = { 0 };
+    struct protocol_packet response = { 0 };
+    long int idx;
+
+    if (info_type & NET_PINFO_AUDIENCE) {
+        for (idx = person_count - 1; idx >= 0 && result == NET_SUCCESS; idx--) {
+            if (outgoing.size > (NETIO_BUFFER_MAX_SIZE >> 3))
+                break;
+            if (!person_name[idx])
+                continue;
+
+            response.type = NET_PROTO_PERSON;
+            response.as.person.person_id = person_ids[idx];
+            response.as.person.name = person_name[idx];
+            result = packet_serialize(&outgoing, &response) == PACKET_SUCCESS ?
+                         NET_SUCCESS :
+                         NET_ERROR;
+        }
+    }
+
+    if (next)
+        *next = NETIO_TAG_NONE;
+    if (info_type & NET_PINFO_HISTORY) {
+        for (idx = next ? from : (long int)messages_count - 1;
+             idx >= from && idx < (long int)messages_count &&
+             result == NET_SUCCESS;
+             idx += next ? 1 : -1) {
+            if (outgoing.size > limit && !(next && idx == from)) {
+                if (next)
+                    *next = idx;
+                break;
+            }
+
+            response.type = NET_PROTO_MESSAGE;
+            response.as.message.person_id = messages[idx].person_id;
+            response.as.message.encryption = messages[idx].encryption;
+            response.as.message.index = messages[idx].index;
+            response.as.message.message = messages[idx].message;
+            result = packet_serialize(&outgoing, &response) == PACKET_SUCCESS ?
+                         NET_SUCCESS :
+                         NET_ERROR;
+        }
+    }
+
+    if (result == NET_SUCCESS)
+        result = netio_frame_create(frame, &outgoing, flags, NETIO_TAG_NONE);
+
+    packet_free(&outgoing);
+
+    return result;
+}
+
+/*sends paused clients which have drained what they missed in the meantime*/
+static void clients_resume()
+{
+    netio_frame_t *frame;
+    connection_t client;
+    long int missed;
+    long int next;
+    size_t budget;
+
+    while (netio_resumed(&client, &missed, &budget) == NET_SUCCESS) {
+        /*names may have changed as well, they are untagged*/
+        int info_type = NET_PINFO_AUDIENCE;
+        if (missed != NETIO_TAG_NONE)
+            info_type |= NET_PINFO_HISTORY;
+
+        /*
+        not a backfill, it must not be dropped again. Messages which do not
+        fit into the budget follow once the client has drained these.
+        */
+        if (history_create(&frame, info_type, missed, budget, 0, &next) !=
+            NET_SUCCESS) {
+            connection_close(client);
+            continue;
+        }
+        if (netio_resume(client, frame, next) != NET_SUCCESS)
+            connection_close(client);
+        netio_frame_release(frame);
+    }
+}
+
+/*pings connections which have been silent for a while*/
+static void connections_probe()
+{
+    static unsigned long token = 0;
+    connection_t who;
+
+    while (netio_idle(&who) == NET_SUCCESS) {
+        if (control_send(who, NET_PROTO_PING, ++token) != NET_SUCCESS)
+            connection_close(who);
+    }
+}
+
+/*frees the persons of clients netio has closed by itself*/
+static void connections_closed()
+{
+    connection_t who;
+
+    while (netio_closed(&who) == NET_SUCCESS) {
+        /*those closed by connection_close are already freed*/
+        if (person_exists(who))
+            person_free(who);
+    }
+}
+
+/*tells clients refused by netio to come back later*/
+static void connections_refused()
+{
+    connection_t who;
+    unsigned long retry;
+
+    while (netio_refused(&who, &retry) == NET_SUCCESS) {
+        /*netio closes it once the frame is sent*/
+        if (control_send(who, NET_PROTO_BUSY, retry) != NET_SUCCESS)
+            netio_connection_close(who);
+    }
+}
+
+/*
+control frames also reach paused clients and are never dropped. value is the
+token of a ping or pong, or the retry of a busy packet.
+*/
+static netResult control_send(connection_t who, int type, unsigned long value)
+{
+    netResult result;
+    netio_frame_t *frame;
+    net_buffer_t outgoing = { 0 };
+    struct protocol_packet packet = { 0 };
+
+    packet.type = type;
+    if (type == NET_PROTO_BUSY)
+        packet.as.busy.retry = value;
+    else
+        packet.as.ping.token = value;
+    result = packet_serialize(&outgoing, &packet) == PACKET_SUCCESS ?
+                 NET_SUCCESS :
+                 NET_ERROR;
+    if (result == NET_SUCCESS)
+        result = netio_frame_create(&frame, &outgoing, NETIO_FRAME_CONTROL,
+                                    NETIO_TAG_NONE);
+    packet_free(&outgoing);
+    if (result != NET_SUCCESS)
+        return result;
+
+    result = netio_send_frame(who, frame);
+    netio_frame_release(frame);
+    return result;
+}
+
+/*passes everything to a waiting successor, see net_handoff_listen*/
+static netResult handoff()
+{
+    netResult result;
+    net_buffer_t state = { 0 };
+
+    /*the successor gives up and the next one is tried later*/
+    if (state_save(&state) != NET_SUCCESS) {
+        packet_free(&state);
+        return NET_SUCCESS;
+    }
+    result = netio_handoff(&state);
+    packet_free(&state);
+    /*it was not compatible or went away, serving goes on*/
+    if (result == NET_TRY_AGAIN)
+        return NET_SUCCESS;
+
+    /*netio has been reset either way*/
+    net_reset();
+    return result == NET_SUCCESS ? NET_HANDED_OFF : NET_ERROR;
+}
+
+/*
+the persons with their names and keys, followed by the messages. Keys are
+passed as given, the successor parses them again.
+*/
+static netResult state_save(net_buffer_t *state)
+{
+    parseResult parsed;
+    size_t slot;
+    size_t idx;
+    int method;
+
+    parsed = packet_send_u32(state, ENCRYPT_MAX_VAL);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(state, person_count);
+    for (slot = 0; slot < person_count && parsed == PACKET_SUCCESS; slot++) {
+        parsed = packet_send_u32(state, person_name[slot] != NULL);
+        if (!person_name[slot])
+            continue;
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_i32(state, person_ids[slot]);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_str(state, person_name[slot]);
+        for (method = 0; method < ENCRYPT_MAX_VAL; method++) {
+            const char *key = person_encrypt_plain[method][slot];
+            if (parsed == PACKET_SUCCESS)
+                parsed = packet_send_u32(state, key != NULL);
+            if (parsed == PACKET_SUCCESS && key)
+                parsed = packet_send_str(state, key);
+        }
+    }
+
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(state, messages_count);
+    for (idx = 0; idx < messages_count && parsed == PACKET_SUCCESS; idx++) {
+        parsed = packet_send_u32(state, messages[idx].message != NULL);
+        if (!messages[idx].message)
+            continue;
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_i32(state, messages[idx].person_id);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_i32(state, messages[idx].encryption);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_str(state, messages[idx].message);
+    }
+    return parsed == PACKET_SUCCESS ? NET_SUCCESS : NET_ERROR;
+}
+
+static netResult state_load(net_buffer_t *state)
+{
+    netResult result = NET_SUCCESS;
+    unsigned long count;
+    unsigned long present;
+    long int id;
+    long int encryption;
+    char *text = NULL;
+    size_t slot;
+    size_t idx;
+    int method;
+
+    if (packet_recv_u32(state, &count) != PACKET_SUCCESS ||
+        count != ENCRYPT_MAX_VAL ||
+        packet_recv_u32(state, &count) != PACKET_SUCCESS)
+        return NET_ERROR;
+    for (slot = 0; slot < count && result == NET_SUCCESS; slot++) {
+        if (packet_recv_u32(state, &present) != PACKET_SUCCESS)
+            return NET_ERROR;
+        if (!present)
+            continue;
+        if (packet_recv_i32(state, &id) != PACKET_SUCCESS ||
+            NET_ID_SLOT(id) != slot ||
+            packet_recv_str(state, &text) != PACKET_SUCCESS)
+            return NET_ERROR;
+        result = person_make(id);
+        if (result == NET_SUCCESS) {
+            free(person_name[slot]);
+            person_name[slot] = text;
+            text = NULL;
+        }
+        free(text);
+        text = NULL;
+        for (method = 0; method < ENCRYPT_MAX_VAL && result == NET_SUCCESS;
+             method++) {
+            if (packet_recv_u32(state, &present) != PACKET_SUCCESS)
+                return NET_ERROR;
+            if (!present)
+                continue;
+            if (packet_recv_str(state, &text) != PACKET_SUCCESS)
+                return NET_ERROR;
+            result = net_key_set(id, method, text);
+            free(text);
+            text = NULL;
+        }
+    }
+
+    if (result == NET_SUCCESS &&
+        packet_recv_u32(state, &count) != PACKET_SUCCESS)
+        return NET_ERROR;
+    if (result == NET_SUCCESS && count) {
+        if (!(messages = calloc(count, sizeof(*messages))))
+            return NET_ERROR;
+        messages_count = count;
+    }
+    for (idx = 0; idx < count && result == NET_SUCCESS; idx++) {
+        if (packet_recv_u32(state, &present) != PACKET_SUCCESS)
+            return NET_ERROR;
+        if (!present)
+            continue;
+        if (packet_recv_i32(state, &id) != PACKET_SUCCESS ||
+            packet_recv_i32(state, &encryption) != PACKET_SUCCESS ||
+            encryption < 0 || encryption >= ENCRYPT_MAX_VAL ||
+            packet_recv_str(state, &text) != PACKET_SUCCESS)
+            return NET_ERROR;
+        result = messages_set(idx, id, encryption, text);
+        free(text);
+        text = NULL;
+    }
+
+    /*clients which could not be taken over are gone*/
+    for (slot = 1; slot < person_count && result == NET_SUCCESS; slot++) {
+        if (person_name[slot] && !netio_connection_active(person_ids[slot]))
+            person_free(person_ids[slot]);
+    }
+    return result;
+}
+
 static netResult handle_packet_handshake_c(connection_t sender,
                                            struct protocol_packet *packet)
 {
@@ -609,6 +1127,8 @@ static netResult handle_packet_handshake_c(connection_t sender,
                      NET_ERROR;
     if (result == NET_SUCCESS)
         result = netio_send(sender, &outgoing);
+    if (result == NET_SUCCESS)
+        result = netio_established(sender);
 
     packet_free(&outgoing);
 
@@ -651,10 +1171,8 @@ static netResult handle_packet_handshake_s(connection_t sender,
 static netResult handle_packet_info_c(connection_t sender,
                                       struct protocol_packet *packet)
 {
-    netResult result = NET_SUCCESS;
-    net_buffer_t outgoing = { 0 };
-    struct protocol_packet response = { 0 };
-    long int idx;
+    netResult result;
+    netio_frame_t *frame;
 
     if (packet->type != NET_PROTO_INFO_C)
         return NET_ERROR;
@@ -665,43 +1183,12 @@ static netResult handle_packet_info_c(connection_t sender,
           (NET_PINFO_AUDIENCE | NET_PINFO_HISTORY)))
         return NET_SUCCESS;
 
-    if (packet->as.info_c.info_type & NET_PINFO_AUDIENCE) {
-        for (idx = person_count - 1; idx >= 0 && result == NET_SUCCESS; idx--) {
-            if (outgoing.size > (NETIO_BUFFER_MAX_SIZE >> 3))
-                break;
-            if (!person_exists(idx))
-                continue;
-
-            response.type = NET_PROTO_PERSON;
-            response.as.person.person_id = idx;
-            response.as.person.name = person_name[idx];
-            result = packet_serialize(&outgoing, &response) == PACKET_SUCCESS ?
-                         NET_SUCCESS :
-                         NET_ERROR;
-        }
-    }
-
-    if (packet->as.info_c.info_type & NET_PINFO_HISTORY) {
-        for (idx = messages_count - 1; idx >= 0 && result == NET_SUCCESS;
-             idx--) {
-            if (outgoing.size > (NETIO_BUFFER_MAX_SIZE >> 2))
-                break;
-
-            response.type = NET_PROTO_MESSAGE;
-            response.as.message.person_id = messages[idx].person_id;
-            response.as.message.encryption = messages[idx].encryption;
-            response.as.message.index = messages[idx].index;
-            response.as.message.message = messages[idx].message;
-            result = packet_serialize(&outgoing, &response) == PACKET_SUCCESS ?
-                         NET_SUCCESS :
-                         NET_ERROR;
-        }
-    }
-
-    if (result == NET_SUCCESS)
-        result = netio_send(sender, &outgoing);
-
-    packet_free(&outgoing);
+    if (history_create(&frame, packet->as.info_c.info_type, 0,
+                       NETIO_BUFFER_MAX_SIZE >> 2, NETIO_FRAME_BACKFILL,
+                       NULL) != NET_SUCCESS)
+        return NET_ERROR;
+    result = netio_send_frame(sender, frame);
+    netio_frame_release(frame);
 
     return result;
 }
@@ -722,18 +1209,23 @@ static netResult handle_packet_person(connection_t sender,
     }
 
     if (result == NET_SUCCESS) {
-        if (person_name[packet->as.person.person_id])
-            free(person_name[packet->as.person.person_id]);
-        result = util_strcpy(&person_name[packet->as.person.person_id],
-                             packet->as.person.name, NET_SUCCESS, NET_ERROR);
+        size_t slot = NET_ID_SLOT(packet->as.person.person_id);
+        if (person_name[slot])
+            free(person_name[slot]);
+        result = util_strcpy(&person_name[slot], packet->as.person.name,
+                             NET_SUCCESS, NET_ERROR);
     }
 
+    /*a client which has named itself is no longer treated as a guest*/
+    if (result == NET_SUCCESS && is_server && sender != self_person_id)
+        netio_class_set(sender, NET_CLASS_MEMBER);
+
     if (result == NET_SUCCESS && is_server) {
         result = packet_serialize(&outgoing, packet) == PACKET_SUCCESS ?
                      NET_SUCCESS :
                      NET_ERROR;
         if (result == NET_SUCCESS)
-            result = broadcast(&outgoing);
+            result = broadcast(&outgoing, NETIO_TAG_NONE);
         packet_free(&outgoing);
     }
 
@@ -773,9 +1265,30 @@ static netResult handle_packet_message(connection_t sender,
                      NET_SUCCESS :
                      NET_ERROR;
         if (result == NET_SUCCESS)
-            result = broadcast(&outgoing);
+            result = broadcast(&outgoing, packet->as.message.index);
         packet_free(&outgoing);
     }
 
     return result;
 }
+
+static netResult handle_packet_ping(connection_t sender,
+                                    struct protocol_packet *packet)
+{
+    if (packet->type != NET_PROTO_PING)
+        return NET_ERROR;
+    return control_send(sender, NET_PROTO_PONG, packet->as.ping.token);
+}
+
+static netResult handle_packet_busy(connection_t sender,
+                                    struct protocol_packet *packet)
+{
+    (void)sender;
+    if (packet->type != NET_PROTO_BUSY)
+        return NET_ERROR;
+    if (is_server)
+        return NET_ERROR;
+    busy = 1;
+    busy_retry = packet->as.busy.retry;
+    return NET_BUSY;
+}
@@ -7,8 +7,55 @@ typedef int netResult;
 
 #define NET_MYSELF -1
 
-enum netresults { NET_SUCCESS = 0, NET_TRY_AGAIN = 1, NET_ERROR = -1 };
+/*
+person ids (and the connection ids of netio) consist of a slot index in the
+lower NET_ID_SLOT_BITS bits and a generation counter in the bits above.
+Slots are reused once their occupant is gone, the generation is bumped on
+every reuse so that ids still stored in the history or in packets in flight
+are not confused with the new occupant of the slot.
+*/
+#define NET_ID_SLOT_BITS 20
+#define NET_ID_GENERATION_BITS (31 - NET_ID_SLOT_BITS)
+#define NET_ID_SLOT(id) ((unsigned long)(id) & ((1UL << NET_ID_SLOT_BITS) - 1))
+#define NET_ID_GENERATION(id)                                                  \
+    (((unsigned long)(id) >> NET_ID_SLOT_BITS) &                               \
+     ((1UL << NET_ID_GENERATION_BITS) - 1))
+#define NET_ID_MAKE(slot, generation)                                          \
+    ((((unsigned long)(generation) & ((1UL << NET_ID_GENERATION_BITS) - 1))    \
+      << NET_ID_SLOT_BITS) |                                                   \
+     (unsigned long)(slot))
+
+/*
+NET_HANDED_OFF is returned by net_tick once a successor took over,
+NET_BUSY once the server refused to admit this client, see net_retry_get
+*/
+enum netresults {
+    NET_SUCCESS = 0,
+    NET_TRY_AGAIN = 1,
+    NET_HANDED_OFF = 2,
+    NET_BUSY = 3,
+    NET_ERROR = -1
+};
 enum netflags { NET_FHISTORY = 1 };
+/*NET_BACKEND_URING is only available on linux*/
+enum netbackends { NET_BACKEND_POLL = 0, NET_BACKEND_URING = 1 };
+/*
+what a server does once more than the high watermark is queued on a client:
+NET_POLICY_PAUSE drops further messages until the client has drained to the
+low watermark and then sends the missed ones in batches, NET_POLICY_BACKFILL
+drops queued history first and pauses if that is not enough,
+NET_POLICY_DISCONNECT keeps queueing and disconnects the client if it is
+still above the low watermark after the grace period.
+*/
+enum netpolicies {
+    NET_POLICY_PAUSE = 0,
+    NET_POLICY_BACKFILL = 1,
+    NET_POLICY_DISCONNECT = 2
+};
+/*clients are guests until they set their name*/
+enum netclasses { NET_CLASS_GUEST = 0, NET_CLASS_MEMBER = 1, NET_CLASS_COUNT };
+/*one io thread per processor besides the one calling net_tick*/
+#define NET_THREADS_AUTO -1
 
 struct net_message {
     long int index;
@@ -17,14 +64,157 @@ struct net_message {
     char *message;
 };
 
+struct net_policy {
+    int policy;
+    /*bytes queued on a client*/
+    size_t high;
+    size_t low;
+    /*ms, only used by NET_POLICY_DISCONNECT*/
+    unsigned long grace;
+};
+
+/*
+limits on admitting new clients, 0 disables either of them. A client beyond
+them is told to try again later and disconnected, before anything is kept
+about it.
+*/
+struct net_admission {
+    /*clients served at once, including those waiting to be admitted*/
+    size_t clients;
+    /*handshakes started per second, up to a second worth of them at once*/
+    unsigned long rate;
+    /*clients waiting for their handshake while rate is exceeded*/
+    size_t queue;
+};
+
+struct net_stats {
+    /*poller wakeups with ready sockets during the last full second*/
+    unsigned long wakeups_per_second;
+    /*NET_BACKEND_POLL or NET_BACKEND_URING*/
+    int backend;
+    /*io threads serving clients besides the thread calling net_tick*/
+    unsigned int threads;
+    /*bytes queued for sending on all connections*/
+    size_t outbound;
+    /*zero copy sends and how many of them the kernel had to copy anyway*/
+    unsigned long zerocopy_sends;
+    unsigned long zerocopy_copied;
+    /*clients closed for not completing the handshake or for silence*/
+    unsigned long timeouts;
+    /*clients waiting to be admitted and clients refused as too many*/
+    size_t waiting;
+    unsigned long refused;
+};
+
+/*
+statistics of a single connection. The counters are kept as data passes,
+the state of the transport below is sampled about once a second. Clients of
+io threads are reported as of their last sample.
+*/
+struct net_connection_stats {
+    /*bytes and frames received from and sent to the peer*/
+    unsigned long bytes_in;
+    unsigned long bytes_out;
+    unsigned long frames_in;
+    unsigned long frames_out;
+    /*bytes waiting in the send queue*/
+    size_t queued;
+    /*nonzero once the transport has been sampled*/
+    int sampled;
+    /*bytes in the socket buffer which the peer has not acknowledged yet*/
+    unsigned long socket_queued;
+    /*
+    round trip time and its mean deviation in microseconds, retransmitted
+    segments and the congestion window in segments, 0 for connections
+    which are not tcp
+    */
+    unsigned long rtt;
+    unsigned long rtt_var;
+    unsigned long retransmits;
+    unsigned long cwnd;
+};
+
 netResult net_init();
 netResult net_exit();
 
+/*
+hostname may be unix:path to connect to a server on the same host through a
+unix domain socket, or shm:path to exchange packets with it through shared
+memory, port is ignored then
+*/
 netResult net_connect(const char *hostname, const char *port);
-netResult net_serve(const char *port);
+/*endpoint is a port, unix:path or shm:path*/
+netResult net_serve(const char *endpoint);
+/*lets a server accept clients on another endpoint as well*/
+netResult net_listen(const char *endpoint);
+/*
+lets another process serving with net_takeover(path) take over a server
+without interrupting its clients. Once it has, net_tick returns
+NET_HANDED_OFF and this one is reset. Only available on unix.
+*/
+netResult net_handoff_listen(const char *path);
+/*
+serves the clients, the history and the endpoints (including the one at
+path) of the server which called net_handoff_listen(path), instead of
+net_serve. NET_TRY_AGAIN if there is no such server.
+*/
+netResult net_takeover(const char *path);
 netResult net_reset();
 
+/*
+can only be changed while neither connected nor serving. NET_BACKEND_URING
+waits for sockets and receives through io_uring, it accepts and sends with
+the same system calls as NET_BACKEND_POLL.
+*/
+netResult net_backend_set(int backend);
+/*
+number of io threads a server spreads its clients across, 0 (the default)
+serves all clients from the thread calling net_tick. Chat state is always
+handled by the thread calling net_tick. Refused while the transport is not
+thread safe (see sxp_vtable_t).
+*/
+netResult net_threads_set(int threads);
+/*length of the queue of clients waiting to be accepted by a server*/
+netResult net_backlog_set(int backlog);
+/*
+policy of a NET_CLASS_* of clients, low has to be below high and high below
+the hard limit of NETIO_BUFFER_MAX_SIZE bytes queued on a client
+*/
+netResult net_policy_set(int client_class, const struct net_policy *policy);
+/*
+bytes which may be queued on all clients together. Once it is reached, a
+client holding more than an equal share of it is treated as above its high
+watermark, or disconnected with NET_POLICY_DISCONNECT.
+*/
+netResult net_outbound_max_set(size_t limit);
+/*
+frames of at least threshold bytes, such as history sent to joining clients,
+are sent to clients with zero copy where the platform supports it, so they
+are not copied into the socket buffers. 0 (the default) disables it.
+*/
+netResult net_zerocopy_set(size_t threshold);
+/*
+milliseconds a client of a server may take to complete the handshake, and
+milliseconds a connection may stay silent. A connection silent for half of
+idle is pinged, one which is still silent after idle is closed. 0 disables
+either timeout. Can only be changed while neither connected nor serving.
+*/
+netResult net_timeouts_set(unsigned long handshake, unsigned long idle);
+/*
+limits on the clients a server admits, so that a flood of joining clients
+does not hold up those already served. Can only be changed while neither
+connected nor serving.
+*/
+netResult net_admission_set(const struct net_admission *admission);
+
+/*
+waits until the network, a watched file descriptor or a timer needs
+attention, then handles the network. Without watched file descriptors the
+wait is short, so that input which can not be watched is polled regularly.
+*/
 netResult net_tick();
+/*makes net_tick return once fd (e.g. the terminal) is readable*/
+netResult net_watch(int fd);
 
 netResult net_name_set(int person, const char *name);
 netResult net_name_get(int person, char **name);
@@ -41,4 +231,15 @@ netResult net_messages_decoding_set(int enabled);
 netResult net_person_count(size_t *list);
 netResult net_person_list(int list[], size_t limit);
 
+/*ms the server asked a client to wait after net_tick returned NET_BUSY*/
+netResult net_retry_get(unsigned long *retry);
+
+netResult net_stats_get(struct net_stats *stats);
+/*
+statistics of the connection to a client of a server, or of the connection
+to the server with NET_MYSELF on a client
+*/
+netResult net_connection_stats_get(int person,
+                                   struct net_connection_stats *stats);
+
 #endif /*NET_H_*/
@@ -2,130 +2,861 @@
 #include "net.h"
 #include "netio.h"
 #include "packet.h"
+#include "shmxp.h"
+#include "threadxp.h"
+#include <stdio.h>
+#include <time.h>
+
+/*
+receive buffer of a connection. recv() writes directly behind tail and frames
+are parsed in place starting at head, so received bytes are not copied before
+they reach the protocol parser. Unread bytes are only moved to the front once
+the space behind tail runs out, which moves at most a partial frame.
+*/
+struct netio_recv_buffer {
+    char *buffer;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+};
+
+struct netio_frame {
+    /*number of send queues and callers holding this frame, the queues may
+    belong to different io threads so it is only changed atomically*/
+    unsigned long references;
+    /*NETIO_FRAME_* and the tag reported by netio_resumed*/
+    int flags;
+    long tag;
+    size_t size;
+    /*points directly behind the struct in the same allocation*/
+    char *data;
+};
+
+/*
+send queue of a connection. Frames are queued by reference and flushed in
+batches with sxp_sendv, a partially sent first frame is tracked by offset,
+so queued bytes are never moved once they have been serialized.
+*/
+struct netio_send_queue {
+    struct netio_frame **frames;
+    /*frames are stored circularly starting at head*/
+    size_t head;
+    size_t count;
+    size_t capacity;
+    /*bytes of the first frame which have already been sent*/
+    size_t offset;
+    /*bytes which have not yet been sent*/
+    size_t size;
+    /*bytes held back in netio_outbound for frames of netio_resume*/
+    size_t reserved;
+    /*frames sent with zero copy which the kernel may still read from*/
+    struct netio_pinned *pinned;
+    size_t pinned_count;
+    size_t pinned_capacity;
+    /*number the kernel gives to the next zero copy send of the socket*/
+    unsigned long pinned_next;
+};
+
+struct netio_pinned {
+    unsigned long sequence;
+    struct netio_frame *frame;
+};
+
+/*
+flow of the send queue of a paused client. It drops its frames until it has
+drained to the low watermark, then it is reported by netio_resumed and keeps
+dropping until the missed frames are passed to netio_resume, so that nothing
+newer overtakes them.
+*/
+enum netio_flows { NETIO_FLOWING, NETIO_PAUSED, NETIO_RESUMING };
+
+/*
+rings a local client shares with its server instead of sending frames over
+its unix domain socket. The client creates the region and passes it over the
+socket, which from then on only carries single bytes waking up the other
+side. Frames are copied into a ring as they are and parsed in place by the
+receiver, which releases them at the start of the next netio_tick.
+*/
+#define NETIO_RING_MAGIC 0x53454352UL
+#define NETIO_RING_UP 0
+#define NETIO_RING_DOWN 1
+#define NETIO_CACHE_LINE 64
+
+struct netio_ring {
+    /*written by the producer, waiting is cleared by it before a wakeup*/
+    unsigned long tail;
+    unsigned long waiting;
+    char producer_pad[NETIO_CACHE_LINE - 2 * sizeof(unsigned long)];
+    /*written by the consumer, blocked is cleared by it before a wakeup*/
+    unsigned long head;
+    unsigned long blocked;
+    char consumer_pad[NETIO_CACHE_LINE - 2 * sizeof(unsigned long)];
+};
+
+/*start of the region, followed by the ring from and the ring to the server*/
+struct netio_ring_header {
+    unsigned long magic;
+    unsigned long size;
+    char pad[NETIO_CACHE_LINE - 2 * sizeof(unsigned long)];
+    struct netio_ring rings[SHMXP_RINGS];
+};
+
+struct netio_shm {
+    shmxp_region_t region;
+    struct netio_ring *in;
+    struct netio_ring *out;
+    char *in_data;
+    char *out_data;
+    /*end of the frames returned by netio_recv, published as head next tick*/
+    unsigned long read;
+    /*end of the bytes copied into the outgoing ring, published as its tail*/
+    unsigned long written;
+};
 
 static struct netio_connection_info {
+    /*id of the occupant of this slot or NETIO_NONE if the slot is free*/
     connection_t connection;
+    /*generation the next occupant of this slot will get*/
+    unsigned long generation;
+    /*next slot in the list of free slots*/
+    connection_t free_next;
+    /*1 + index of the io thread owning the socket, 0 if owned by this one*/
+    unsigned int worker;
+    /*no socket yet, the client is still racing netio_attempts*/
+    int connecting;
+    /*socket of a server accepting clients, and its file if it is local*/
+    int listening;
+    char *path;
+    /*the listener accepts successors instead of clients, see netio_handoff*/
+    int handoff;
+    /*
+    a listener whose clients share rings or a client sharing them once it is
+    connected, and an accepted client whose rings have not arrived yet
+    */
+    int rings;
+    int attaching;
+    /*frames are exchanged through these rings instead of the socket*/
+    struct netio_shm *shm;
     sxp_t socket;
-    net_buffer_t recv_buffer;
-    net_buffer_t send_buffer;
+    /*frames of at least netio_zerocopy_min bytes are sent with zero copy*/
+    int zerocopy;
+    /*poller the socket is registered in and the events it is registered for*/
+    sxp_poller_t *poller;
+    int events;
+    /*links in the list of connections with unparsed received data*/
+    int pending;
+    connection_t pending_prev;
+    connection_t pending_next;
+    /*frames returned by netio_recv during the tick numbered frames_tick*/
+    unsigned int frames;
+    unsigned long frames_tick;
+    /*counters and the last sample of the transport, see samples_take*/
+    struct net_connection_stats stats;
+    /*drained and shut down for writing, closed once the peer closes*/
+    int shut;
+    /*
+    an accepted client counted against the admission limits, or one refused
+    by them which is told to wait retry ms and closed once that is sent
+    */
+    int admitted;
+    int refused;
+    unsigned long retry;
+    struct netio_recv_buffer recv_buffer;
+    struct netio_send_queue send_queue;
+    /*NET_CLASS_*, selects the policy applied to the send queue*/
+    int client_class;
+    int flow;
+    /*lowest tag of the frames dropped since the client was paused*/
+    long missed;
+    /*the grace period of NET_POLICY_DISCONNECT is running until deadline*/
+    int lingering;
+    unsigned long deadline;
+    /*
+    an accepted client is closed unless it completes its handshake before
+    its timer expires, then it is probed once it has been silent for half
+    the idle timeout and closed once it has been silent for all of it
+    */
+    int handshaking;
+    int probed;
+    unsigned long last_seen;
+    /*1 + index of the bucket of the timer wheel holding it, 0 if none*/
+    unsigned int timer_bucket;
+    unsigned long timer_due;
+    connection_t timer_prev;
+    connection_t timer_next;
 } *netio_connections = NULL;
 static connection_t netio_connection_count = 0;
 
-static pollsxp_t *netio_poll_list = NULL;
-static size_t netio_active_count = 0;
+/*free slots are reused first in first out to spread generation increments*/
+static connection_t netio_free_head = NETIO_NONE;
+static connection_t netio_free_tail = NETIO_NONE;
+
+/*served round robin, the head is the least recently served connection*/
+static connection_t netio_pending_head = NETIO_NONE;
+static connection_t netio_pending_tail = NETIO_NONE;
+/*number of the current tick, counts against NETIO_FRAME_BUDGET*/
+static unsigned long netio_ticks = 0;
+/*sxp_clock() once the poller has returned in the current tick*/
+static unsigned long netio_now = 0;
+
+/*
+hierarchical timer wheel of the connections, timers are kept in slots of
+NETIO_WHEEL_RESOLUTION ms. Level l holds the timers due within 2 ** (b * (l +
+1)) slots, where b is NETIO_WHEEL_BITS, in buckets of 2 ** (b * l) slots.
+Whenever the level below wraps around, the next bucket of a level is moved
+down and only level 0 expires timers, so a tick costs the expired and moved
+timers instead of a scan of all of them.
+*/
+#define NETIO_WHEEL_SLOTS (1UL << NETIO_WHEEL_BITS)
+static connection_t netio_wheel[NETIO_WHEEL_LEVELS * NETIO_WHEEL_SLOTS];
+/*last slot which has expired*/
+static unsigned long netio_wheel_now = 0;
+static size_t netio_wheel_count = 0;
+
+/*only changed while idle*/
+static unsigned long netio_handshake_timeout = NETIO_HANDSHAKE_TIMEOUT;
+static unsigned long netio_idle_timeout = NETIO_IDLE_TIMEOUT;
+/*connections closed because they timed out*/
+static unsigned long netio_timeouts = 0;
+
+/*the next connection to sample from slot sample_next on at sample_due*/
+static unsigned long netio_sample_due = 0;
+static connection_t netio_sample_next = 0;
+
+/*netio_reset is draining the connections until drain_deadline*/
+static int netio_draining = 0;
+static unsigned long netio_drain_deadline = 0;
+/*io threads which have not yet reported NETIO_MESSAGE_DRAINED*/
+static unsigned int netio_workers_draining = 0;
+
+/*successor accepted by a handoff listener, waiting for netio_handoff*/
+static sxp_t netio_successor_socket;
+static int netio_successor_waiting = 0;
+
+/*kinds of the slots in the state passed by netio_handoff*/
+enum netio_handoff_slots {
+    NETIO_HANDOFF_FREE,
+    NETIO_HANDOFF_LISTENER,
+    NETIO_HANDOFF_CLIENT
+};
+
+/*connections with rings, which are serviced at the start of every tick*/
+static connection_t *netio_rings = NULL;
+static size_t netio_ring_count = 0;
+static size_t netio_ring_capacity = 0;
+
+/*
+keys of the pollers: the wake sockets and the file descriptors watched for
+the caller of netio_tick come first, followed by the slots of the
+connections. A connecting client uses the slots behind its own for its
+connection attempts.
+*/
+#define NETIO_KEY_WAKE 0
+#define NETIO_KEY_RESOLVE 1
+#define NETIO_KEY_WATCH 2
+#define NETIO_KEY(slot) ((slot) + NETIO_KEY_WATCH + NETIO_WATCH_MAX)
+
+static sxp_poller_t *netio_poller = NULL;
+static int netio_backend = NET_BACKEND_POLL;
+static sxp_event_t netio_events[NETIO_EVENTS_MAX];
+
+/*number of wakeups with ready sockets, rolled over once per second*/
+static unsigned long netio_wakeups = 0;
+static unsigned long netio_wakeups_rate = 0;
+static time_t netio_wakeups_second = 0;
 
 static int netio_accepts_sockets = 0;
+static int netio_backlog = NETIO_ACCEPT_BACKLOG;
+
+/*
+admission limits, only changed while idle. A client accepted while the rate
+is exceeded waits unregistered in netio_waiting until enough credit, counted
+in thousandths of a handshake, has built up since credit_time.
+*/
+static size_t netio_clients_max = 0;
+static unsigned long netio_admit_rate = 0;
+static size_t netio_waiting_max = 0;
+static size_t netio_clients = 0;
+static unsigned long netio_credit = 0;
+static unsigned long netio_credit_time = 0;
+static unsigned long netio_refusals = 0;
+
+struct netio_waiting {
+    sxp_t socket;
+    int rings;
+};
+
+static struct netio_waiting *netio_waiting = NULL;
+static size_t netio_waiting_count = 0;
+static connection_t *netio_refused_list = NULL;
+static size_t netio_refused_count = 0;
+static size_t netio_refused_capacity = 0;
+
+/*only changed while idle, so the io threads read them without locking*/
+static struct net_policy netio_policies[NET_CLASS_COUNT] = {
+    { NET_POLICY_BACKFILL, NETIO_HIGH_WATERMARK, NETIO_LOW_WATERMARK,
+      NETIO_GRACE },
+    { NET_POLICY_PAUSE, NETIO_HIGH_WATERMARK, NETIO_LOW_WATERMARK,
+      NETIO_GRACE }
+};
+static size_t netio_outbound_max = NETIO_OUTBOUND_MAX;
+/*
+bytes held by the send queues of all threads and the number of queues holding
+any, only changed atomically
+*/
+static size_t netio_outbound = 0;
+static size_t netio_outbound_queues = 0;
+
+/*smallest frame sent with zero copy, 0 disables it. Only changed while idle*/
+static size_t netio_zerocopy_min = 0;
+/*zero copy sends and those the kernel copied anyway, only changed atomically*/
+static unsigned long netio_zerocopy_sends = 0;
+static unsigned long netio_zerocopy_copied = 0;
+
+/*
+nonblocking connects to the resolved addresses of a server (RFC 8305). The
+addresses alternate between families and every attempt gets a head start of
+NETIO_CONNECT_DELAY before the next one is started, or none if it fails. The
+first connected socket becomes the client connection, all others are closed.
+Running attempts are registered in netio_poller under NETIO_KEY(1 + index).
+*/
+enum netio_attempt_states {
+    NETIO_ATTEMPT_WAITING,
+    NETIO_ATTEMPT_RUNNING,
+    NETIO_ATTEMPT_FAILED
+};
+
+struct netio_attempt {
+    struct sockaddr_storage address;
+    size_t addrlen;
+    int family;
+    int socktype;
+    int protocol;
+    int state;
+    sxp_t socket;
+};
+
+static struct netio_attempt *netio_attempts = NULL;
+static size_t netio_attempt_count = 0;
+/*index of the next attempt to start and when it is due (sxp_clock)*/
+static size_t netio_attempt_next = 0;
+static unsigned long netio_attempt_due = 0;
+static size_t netio_attempts_running = 0;
+
+/*
+hostnames are resolved by a detached thread so that a slow resolver does not
+stall netio_tick. The request is handed over through state, it is freed by
+the resolver thread if the client gave up on it before it was done. The
+thread wakes netio_tick through wake, which belongs to the request, as
+netio_wake may be gone by the time it is done.
+*/
+enum netio_resolve_states {
+    NETIO_RESOLVE_RUNNING,
+    NETIO_RESOLVE_DONE,
+    NETIO_RESOLVE_ABANDONED
+};
+
+struct netio_resolve {
+    int state;
+    sxpResult result;
+    addrinfo_t *addresses;
+    /*wake[0] is watched under NETIO_KEY_RESOLVE until the request is done*/
+    sxp_t wake[2];
+    /*point directly behind the struct in the same allocation*/
+    char *hostname;
+    char *port;
+};
+
+static struct netio_resolve *netio_resolve = NULL;
+
+/*
+attempts made from a resolved hostname, reused by reconnects until they
+expire. getaddrinfo does not report record TTLs, so NETIO_RESOLVE_TTL is used.
+*/
+struct netio_resolved {
+    /*hostname and port, separated by their terminating zero*/
+    char *name;
+    struct netio_attempt *attempts;
+    size_t count;
+    unsigned long expires;
+};
+
+static struct netio_resolved netio_resolved[NETIO_RESOLVE_CACHE];
+
+/*
+messages exchanged between the core thread calling netio_tick and the io
+threads. The core thread hands accepted sockets and outgoing frames to an io
+thread, which returns the packets it received and reports connections it
+closed. Every adopted connection is reported closed exactly once, its slot
+is only reused afterwards.
+*/
+enum netio_message_types {
+    NETIO_MESSAGE_ADOPT,
+    NETIO_MESSAGE_SEND,
+    NETIO_MESSAGE_RESUME,
+    NETIO_MESSAGE_CLASS,
+    NETIO_MESSAGE_CLOSE,
+    NETIO_MESSAGE_PACKET,
+    NETIO_MESSAGE_RESUMED,
+    NETIO_MESSAGE_CLOSED,
+    NETIO_MESSAGE_STATS,
+    NETIO_MESSAGE_DRAIN,
+    NETIO_MESSAGE_DRAINED
+};
+
+struct netio_message {
+    int type;
+    connection_t connection;
+    /*NETIO_MESSAGE_ADOPT*/
+    sxp_t socket;
+    int zerocopy;
+    /*NETIO_MESSAGE_SEND and NETIO_MESSAGE_RESUME, holds one reference*/
+    netio_frame_t *frame;
+    /*NETIO_MESSAGE_CLASS*/
+    int client_class;
+    /*NETIO_MESSAGE_PACKET, the buffer is owned by the message*/
+    net_buffer_t packet;
+    /*
+    NETIO_MESSAGE_ADOPT of a client taken over from another server, which
+    also carries its class, the missed tag, the bytes received from it in
+    packet and those still queued for it in frame, see connection_restore
+    */
+    int flow;
+    unsigned long sequence;
+    /*NETIO_MESSAGE_RESUME and NETIO_MESSAGE_RESUMED*/
+    long tag;
+    size_t budget;
+    /*NETIO_MESSAGE_STATS, owned by the message*/
+    struct net_connection_stats *stats;
+};
+
+/*
+lock-free queue with a single producer and a single consumer thread.
+Messages which do not fit into the ring are kept by the producer in
+overflow and moved to the ring once the consumer has caught up, so pushing
+never blocks. The producer sets blocked while it holds overflow and the
+consumer wakes it up once it has made room, see channel_popped.
+*/
+struct netio_channel {
+    struct netio_message ring[NETIO_CHANNEL_SIZE];
+    /*only written by the consumer*/
+    unsigned long head;
+    /*only written by the producer*/
+    unsigned long tail;
+    int blocked;
+    /*only accessed by the producer*/
+    struct netio_message *overflow;
+    size_t overflow_head;
+    size_t overflow_count;
+    size_t overflow_capacity;
+};
+
+struct netio_worker {
+    /*1 + index into netio_workers*/
+    unsigned int index;
+    thxp_thread_t thread;
+    int running;
+    sxp_poller_t *poller;
+    /*the core thread writes to wake[1], wake[0] is watched under key 0*/
+    sxp_t wake[2];
+    int wake_pending;
+    /*core thread to io thread*/
+    struct netio_channel commands;
+    /*io thread to core thread*/
+    struct netio_channel results;
+    /*connections owned by this thread indexed by their slot*/
+    struct netio_connection_info **connections;
+    size_t connection_count;
+    sxp_event_t events[NETIO_EVENTS_MAX];
+    /*like netio_sample_due and netio_sample_next*/
+    unsigned long sample_due;
+    size_t sample_next;
+    /*the earliest deadline of the lingering connections, if any*/
+    int lingering;
+    unsigned long linger_due;
+    /*1 after NETIO_MESSAGE_DRAIN, 2 once NETIO_MESSAGE_DRAINED is sent*/
+    int draining;
+    /*set once the poller failed and the thread has stopped*/
+    int failed;
+};
+
+/*number of io threads started by netio_serve*/
+static int netio_threads = 0;
+static struct netio_worker **netio_workers = NULL;
+static unsigned int netio_worker_count = 0;
+static unsigned int netio_worker_next = 0;
+
+/*the io threads write to netio_wake[1] to interrupt the wait in netio_tick*/
+static sxp_t netio_wake[2];
+static int netio_wake_pending = 0;
+
+static sxp_t netio_watched[NETIO_WATCH_MAX];
+static size_t netio_watch_count = 0;
+
+/*packets received by the io threads, returned by netio_recv*/
+static struct netio_message *netio_inbox = NULL;
+static size_t netio_inbox_count = 0;
+static size_t netio_inbox_next = 0;
+static size_t netio_inbox_capacity = 0;
+
+/*paused clients which have drained, returned by netio_resumed*/
+static struct netio_message *netio_resumed_list = NULL;
+static size_t netio_resumed_count = 0;
+static size_t netio_resumed_capacity = 0;
+
+/*connections returned by netio_idle and netio_closed*/
+static connection_t *netio_idle_list = NULL;
+static size_t netio_idle_count = 0;
+static size_t netio_idle_capacity = 0;
+static connection_t *netio_closed_list = NULL;
+static size_t netio_closed_count = 0;
+static size_t netio_closed_capacity = 0;
 
 static netResult pull_data(struct netio_connection_info *connection);
+static netResult recv_reserve(struct netio_recv_buffer *recv);
+static parseResult recv_next(struct netio_recv_buffer *recv,
+                             net_buffer_t *packet);
 static netResult push_data(struct netio_connection_info *connection);
+static netResult send_queue_push(struct netio_send_queue *queue,
+                                 struct netio_frame *frame);
+static void send_queue_consume(struct netio_send_queue *queue, size_t size);
+static void send_queue_drop(struct netio_send_queue *queue, int flags);
+static void send_queue_free(struct netio_send_queue *queue);
+static void send_queue_account(struct netio_send_queue *queue, size_t before);
+static netResult send_queue_pin_reserve(struct netio_send_queue *queue);
+static void send_queue_pin(struct netio_send_queue *queue,
+                           struct netio_frame *frame);
+static int zerocopy_enable(sxp_t *socket);
+static netResult zerocopy_complete(struct netio_connection_info *connection);
+
+static netResult flow_send(struct netio_connection_info *connection,
+                           struct netio_frame *frame);
+static netResult flow_resume(struct netio_connection_info *connection,
+                             struct netio_frame *frame, long missed);
+static int flow_drained(struct netio_connection_info *connection,
+                        size_t *budget);
+static int flow_exceeded(struct netio_connection_info *connection,
+                         const struct net_policy *policy, size_t size);
+static int flow_overdrawn(struct netio_connection_info *connection,
+                          size_t size);
+static void flow_miss(struct netio_connection_info *connection,
+                      struct netio_frame *frame);
+static netResult resumed_push(connection_t who, long tag, size_t budget);
+
+static void drain();
+static void drain_discard();
+static int drain_step(struct netio_connection_info *connection);
+
+static void samples_take();
+static void stats_sample(struct netio_connection_info *connection);
+
+static netResult handoff_export(net_buffer_t *body, int *fds,
+                                size_t *fd_count);
+static netResult handoff_slot(net_buffer_t *body, connection_t slot,
+                              net_buffer_t *received, int *fds,
+                              size_t *fd_count);
+static netResult handoff_adopt(net_buffer_t *body, connection_t slot,
+                               const int *fds, size_t fd_count,
+                               size_t *fd_next);
+static netResult handoff_write(sxp_t *socket, const char *data, size_t size);
+static netResult handoff_read(sxp_t *socket, char *data, size_t size);
+static netResult handoff_wait(sxp_t *socket, int events);
+static netResult bytes_append(net_buffer_t *buffer, const char *data,
+                              size_t size);
+static netResult frame_wrap(netio_frame_t **frame, const net_buffer_t *bytes);
+
+static netResult ring_create(struct netio_connection_info *connection);
+static netResult ring_attach(struct netio_connection_info *connection);
+static netResult ring_map(struct netio_connection_info *connection, int fd);
+static netResult ring_setup(struct netio_connection_info *connection,
+                            struct netio_shm *shm, int in);
+static void ring_remove(connection_t who);
+static netResult ring_service(struct netio_connection_info *connection);
+static parseResult ring_next(struct netio_connection_info *connection,
+                             net_buffer_t *packet);
+static netResult ring_push(struct netio_connection_info *connection);
+static netResult ring_doorbell(struct netio_connection_info *connection);
+static netResult ring_wake(struct netio_connection_info *connection);
+
+static void timer_start(connection_t who, int handshaking);
+static void timer_set(connection_t who, unsigned long due);
+static void timer_arm(connection_t who);
+static void timer_insert(connection_t who, unsigned long due);
+static void timer_remove(connection_t who);
+static void timers_expire();
+static void timer_expire(connection_t who);
+static long timer_next();
+static void list_push(connection_t **list, size_t *count, size_t *capacity,
+                      connection_t who);
+
+static void admission_accept(sxp_t socket, int rings);
+static void admission_tick();
+static int credit_take();
+static void admit(sxp_t socket, int rings);
+static void refuse(sxp_t socket, int rings, unsigned long retry);
 
-static netResult setup_connection(sxp_t socket);
+static netResult poller_setup(sxp_poller_t *poller);
+static int tick_timeout();
+static netResult listener_create(const char *endpoint, int handoff);
+static netResult setup_connection(sxp_t socket, unsigned int worker,
+                                  int zerocopy, connection_t *who);
+static netResult slot_occupy(connection_t slot, unsigned int worker,
+                             struct netio_message *adopt);
+static netResult connection_restore(struct netio_connection_info *connection,
+                                    struct netio_message *adopt);
+static void slot_release(connection_t who);
+static netResult interest_set(struct netio_connection_info *connection,
+                              int events);
+static netResult receive_start(struct netio_connection_info *connection);
+static netResult receive_stop(struct netio_connection_info *connection);
+
+static netResult resolve_start(const char *hostname, const char *port);
+static void resolve_run(void *argument);
+static netResult resolve_finish();
+static void resolve_cancel();
+static void resolve_free(struct netio_resolve *resolve);
+static struct netio_resolved *resolved_find(const char *hostname,
+                                            const char *port);
+static void resolved_store(const char *hostname, const char *port);
+static void resolved_free(struct netio_resolved *resolved);
+
+static netResult attempts_create(addrinfo_t *addresses);
+static netResult attempts_unix(const char *path);
+static addrinfo_t *attempt_find(addrinfo_t *address, int family, int same);
+static void attempt_add(const addrinfo_t *address);
+static netResult attempts_tick();
+static netResult attempt_finish(size_t idx);
+static void attempt_fail(size_t idx);
+static void attempts_free();
+
+static void pending_push(connection_t who);
+static void pending_remove(connection_t who);
+
+static netResult workers_start();
+static netResult workers_resume();
+static void workers_join();
+static netResult workers_settle();
+static void workers_stop();
+static netResult workers_exchange();
+static netResult worker_command(unsigned int worker,
+                                struct netio_message *message);
+static void worker_run(void *argument);
+static int worker_timeout(struct netio_worker *worker);
+static void worker_sample(struct netio_worker *worker);
+static void worker_linger(struct netio_worker *worker);
+static void worker_drain(struct netio_worker *worker);
+static void worker_fail(struct netio_worker *worker);
+static void worker_handle(struct netio_worker *worker,
+                          struct netio_message *message);
+static netResult worker_receive(struct netio_worker *worker,
+                                struct netio_connection_info *connection);
+static void worker_close(struct netio_worker *worker,
+                         struct netio_connection_info *connection);
+
+static netResult channel_push(struct netio_channel *channel,
+                              const struct netio_message *message);
+static void channel_flush(struct netio_channel *channel);
+static int channel_pop(struct netio_channel *channel,
+                       struct netio_message *message);
+static int channel_popped(struct netio_channel *channel);
+static void channel_free(struct netio_channel *channel);
+static void message_free(struct netio_message *message);
+
+static void wake(sxp_t *socket, int *pending);
+static void wake_clear(sxp_t *socket, int *pending);
 
 netResult netio_init()
 {
+    size_t idx;
     sxp_init();
-    return NET_SUCCESS;
+    for (idx = 0; idx < NETIO_WHEEL_LEVELS * NETIO_WHEEL_SLOTS; idx++)
+        netio_wheel[idx] = NETIO_NONE;
+    if (sxp_poller_create(&netio_poller, SXP_POLLER_DEFAULT) != SXP_SUCCESS)
+        return NET_ERROR;
+    netio_backend = NET_BACKEND_POLL;
+    if (sxp_pair(netio_wake) != SXP_SUCCESS)
+        return NET_ERROR;
+    if (sxp_nbio_set(&netio_wake[0], SXP_NONBLOCKING) != SXP_SUCCESS ||
+        sxp_nbio_set(&netio_wake[1], SXP_NONBLOCKING) != SXP_SUCCESS)
+        return NET_ERROR;
+    return poller_setup(netio_poller);
 }
 
 netResult netio_exit()
 {
+    size_t idx;
+    for (idx = 0; idx < NETIO_RESOLVE_CACHE; idx++)
+        resolved_free(&netio_resolved[idx]);
+    if (netio_poller) {
+        sxp_poller_destroy(netio_poller);
+        netio_poller = NULL;
+    }
+    sxp_destroy(&netio_wake[0]);
+    sxp_destroy(&netio_wake[1]);
+    netio_watch_count = 0;
+    free(netio_waiting);
+    netio_waiting = NULL;
+    netio_waiting_max = 0;
     sxp_cleanup();
     return NET_SUCCESS;
 }
 
 netResult netio_connect(const char *hostname, const char *port)
 {
-    addrinfo_t *addresses;
-    addrinfo_t hints;
-    sxp_t client;
-    sxpResult res;
-    netResult result = NET_SUCCESS;
+    struct netio_resolved *resolved;
+    const char *path = NULL;
 
-    if (netio_connection_count) {
-        result = NET_ERROR;
-        goto end;
-    }
+    if (netio_connection_count || !hostname || !port)
+        return NET_ERROR;
+    if (!(netio_connections = calloc(1, sizeof(*netio_connections))))
+        return NET_ERROR;
 
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
+    netio_accepts_sockets = 0;
 
-    if ((res = sxp_addrinfo_get(&addresses, hostname, port, &hints)) !=
-        SXP_SUCCESS) {
-        result = res == SXP_TRY_AGAIN ? NET_TRY_AGAIN : NET_ERROR;
-        goto end;
-    }
+    /*packets are queued on the connection until an attempt succeeds*/
+    netio_connection_count = 1;
+    netio_connections[0].connection = NET_ID_MAKE(0, 0);
+    netio_connections[0].connecting = 1;
+    netio_connections[0].poller = netio_poller;
+    netio_connections[0].events = SXP_POLLIN;
+    netio_now = sxp_clock();
+    timer_start(netio_connections[0].connection, 0);
 
-    if ((res = sxp_create(&client, addresses->ai_family, addresses->ai_socktype,
-                          addresses->ai_protocol)) != SXP_SUCCESS) {
-        result = NET_ERROR;
-        goto end_addrinfo;
+    if (!strncmp(hostname, NETIO_SHM_PREFIX, strlen(NETIO_SHM_PREFIX))) {
+        path = hostname + strlen(NETIO_SHM_PREFIX);
+        netio_connections[0].rings = 1;
+    } else if (!strncmp(hostname, NETIO_UNIX_PREFIX,
+                        strlen(NETIO_UNIX_PREFIX))) {
+        path = hostname + strlen(NETIO_UNIX_PREFIX);
     }
-
-    if ((res = sxp_connect(&client, addresses->ai_addr,
-                           addresses->ai_addrlen)) != SXP_SUCCESS) {
-        result = NET_ERROR;
-        goto end_socket;
+    /*a local server has no other address than its socket file*/
+    if (path) {
+        if (attempts_unix(path) != NET_SUCCESS ||
+            attempts_tick() != NET_SUCCESS)
+            goto fail;
+        return NET_SUCCESS;
     }
 
-    if ((res = sxp_nbio_set(&client, SXP_NONBLOCKING)) != SXP_SUCCESS) {
-        result = NET_ERROR;
-        goto end_socket;
+    if (!(resolved = resolved_find(hostname, port))) {
+        if (resolve_start(hostname, port) != NET_SUCCESS)
+            goto fail;
+        return NET_SUCCESS;
     }
 
+    if (!(netio_attempts = malloc(sizeof(*netio_attempts) * resolved->count)))
+        goto fail;
+    memcpy(netio_attempts, resolved->attempts,
+           sizeof(*netio_attempts) * resolved->count);
+    netio_attempt_count = resolved->count;
+    if (attempts_tick() != NET_SUCCESS)
+        goto fail;
+    return NET_SUCCESS;
+fail:
+    attempts_free();
+    timer_remove(netio_connections[0].connection);
+    free(netio_connections);
+    netio_connections = NULL;
     netio_connection_count = 0;
+    return NET_ERROR;
+}
 
-    netio_accepts_sockets = 0;
+netResult netio_serve(const char *endpoint)
+{
+    netResult result;
 
-    if ((result = setup_connection(client)) != NET_SUCCESS)
-        goto end_socket;
+    if (netio_connection_count)
+        return NET_ERROR;
 
-    goto end_addrinfo;
-end_socket:
-    (void)sxp_destroy(&client);
-end_addrinfo:
-    (void)sxp_addrinfo_free(addresses);
-end:
-    return result;
+    netio_accepts_sockets = 1;
+
+    if ((result = netio_listen(endpoint)) != NET_SUCCESS) {
+        netio_accepts_sockets = 0;
+        return result;
+    }
+
+    /*without io threads all clients are served by netio_tick itself*/
+    if (netio_threads && workers_start() != NET_SUCCESS)
+        workers_stop();
+    return NET_SUCCESS;
 }
 
-netResult netio_serve(const char *port)
+netResult netio_listen(const char *endpoint)
 {
-    addrinfo_t *addresses;
+    return listener_create(endpoint, 0);
+}
+
+netResult netio_handoff_listen(const char *path)
+{
+    return listener_create(path, 1);
+}
+
+/*endpoint is the path of the socket file of a handoff listener*/
+static netResult listener_create(const char *endpoint, int handoff)
+{
+    addrinfo_t *addresses = NULL;
     addrinfo_t hints;
+    struct sockaddr_storage local;
+    const sockaddr_t *address;
+    size_t addrlen;
+    int protocol = 0;
+    int socket_file = 0;
+    int rings = 0;
+    char *path = NULL;
+    connection_t listener;
     sxp_t server;
     sxpResult res;
     netResult result = NET_SUCCESS;
 
-    if (netio_connection_count) {
-        result = NET_ERROR;
-        goto end;
+    if (!netio_accepts_sockets || !endpoint)
+        return NET_ERROR;
+
+    if (handoff) {
+        socket_file = 1;
+    } else if (!strncmp(endpoint, NETIO_SHM_PREFIX,
+                        strlen(NETIO_SHM_PREFIX))) {
+        endpoint += strlen(NETIO_SHM_PREFIX);
+        socket_file = 1;
+        rings = 1;
+    } else if (!strncmp(endpoint, NETIO_UNIX_PREFIX,
+                        strlen(NETIO_UNIX_PREFIX))) {
+        endpoint += strlen(NETIO_UNIX_PREFIX);
+        socket_file = 1;
     }
 
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_PASSIVE;
+    if (socket_file) {
+        if (sxp_unix_address(&local, &addrlen, endpoint) != SXP_SUCCESS ||
+            !(path = malloc(strlen(endpoint) + 1)))
+            return NET_ERROR;
+        strcpy(path, endpoint);
+        /*a socket file left behind by a server which is gone is replaced*/
+        (void)sxp_unix_unlink(path);
+        address = (const sockaddr_t *)&local;
+    } else {
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
 
-    if ((res = sxp_addrinfo_get(&addresses, NULL, port, &hints)) !=
-        SXP_SUCCESS) {
-        result = res == SXP_TRY_AGAIN ? NET_TRY_AGAIN : NET_ERROR;
-        goto end;
+        if ((res = sxp_addrinfo_get(&addresses, NULL, endpoint, &hints)) !=
+            SXP_SUCCESS)
+            return res == SXP_TRY_AGAIN ? NET_TRY_AGAIN : NET_ERROR;
+        address = addresses->ai_addr;
+        addrlen = addresses->ai_addrlen;
+        protocol = addresses->ai_protocol;
     }
 
-    if ((res = sxp_create(&server, addresses->ai_family, addresses->ai_socktype,
-                          addresses->ai_protocol)) != SXP_SUCCESS) {
+    if ((res = sxp_create(&server, address->sa_family, SOCK_STREAM,
+                          protocol)) != SXP_SUCCESS) {
         result = NET_ERROR;
-        goto end_addrinfo;
+        goto end_address;
     }
 
-    if ((res = sxp_bind(&server, addresses->ai_addr, addresses->ai_addrlen)) !=
-        SXP_SUCCESS) {
+    if ((res = sxp_bind(&server, address, addrlen)) != SXP_SUCCESS) {
         result = NET_ERROR;
         goto end_socket;
     }
 
-    if ((res = sxp_listen(&server, NETIO_ACCEPT_BACKLOG)) != SXP_SUCCESS) {
+    if ((res = sxp_listen(&server, netio_backlog)) != SXP_SUCCESS) {
         result = NET_ERROR;
         goto end_socket;
     }
@@ -135,285 +866,3874 @@ netResult netio_serve(const char *port)
         goto end_socket;
     }
 
-    netio_connection_count = 0;
-
-    netio_accepts_sockets = 1;
-
-    if ((result = setup_connection(server)) != NET_SUCCESS)
+    if ((result = setup_connection(server, 0, 0, &listener)) != NET_SUCCESS)
         goto end_socket;
+    netio_connections[NET_ID_SLOT(listener)].listening = 1;
+    netio_connections[NET_ID_SLOT(listener)].rings = rings;
+    netio_connections[NET_ID_SLOT(listener)].handoff = handoff;
+    /*the socket file is removed again once the listener is closed*/
+    netio_connections[NET_ID_SLOT(listener)].path = path;
+    path = NULL;
 
-    goto end_addrinfo;
+    goto end_address;
 end_socket:
     (void)sxp_destroy(&server);
-end_addrinfo:
-    (void)sxp_addrinfo_free(addresses);
-end:
+end_address:
+    if (addresses)
+        (void)sxp_addrinfo_free(addresses);
+    free(path);
     return result;
 }
 
 netResult netio_reset()
 {
+    size_t idx;
+    /*waiting clients have not been told anything yet*/
+    for (idx = 0; idx < netio_waiting_count; idx++)
+        sxp_destroy(&netio_waiting[idx].socket);
+    netio_waiting_count = 0;
+    drain();
+    workers_stop();
+    if (netio_successor_waiting) {
+        sxp_destroy(&netio_successor_socket);
+        netio_successor_waiting = 0;
+    }
     if (netio_connections) {
         connection_t i;
         for (i = 0; i < netio_connection_count; i++) {
-            if (netio_connection_active(i))
-                netio_connection_close(i);
+            /*sockets of io threads have been closed by workers_stop*/
+            if (netio_connections[i].connection != NETIO_NONE &&
+                !netio_connections[i].worker)
+                netio_connection_close(netio_connections[i].connection);
         }
         free(netio_connections);
         netio_connections = NULL;
     }
-    if (netio_poll_list) {
-        free(netio_poll_list);
-        netio_poll_list = NULL;
-    }
     netio_connection_count = 0;
-    netio_active_count = 0;
+    netio_free_head = NETIO_NONE;
+    netio_free_tail = NETIO_NONE;
+    netio_pending_head = NETIO_NONE;
+    netio_pending_tail = NETIO_NONE;
     netio_accepts_sockets = 0;
+    free(netio_resumed_list);
+    netio_resumed_list = NULL;
+    netio_resumed_count = 0;
+    netio_resumed_capacity = 0;
+    free(netio_rings);
+    netio_rings = NULL;
+    netio_ring_count = 0;
+    netio_ring_capacity = 0;
+    /*timers of clients of io threads are left behind*/
+    for (idx = 0; idx < NETIO_WHEEL_LEVELS * NETIO_WHEEL_SLOTS; idx++)
+        netio_wheel[idx] = NETIO_NONE;
+    netio_wheel_count = 0;
+    free(netio_idle_list);
+    netio_idle_list = NULL;
+    netio_idle_count = 0;
+    netio_idle_capacity = 0;
+    free(netio_closed_list);
+    netio_closed_list = NULL;
+    netio_closed_count = 0;
+    netio_closed_capacity = 0;
+    free(netio_refused_list);
+    netio_refused_list = NULL;
+    netio_refused_count = 0;
+    netio_refused_capacity = 0;
+    netio_clients = 0;
+    netio_credit = 0;
+    netio_credit_time = 0;
+    netio_sample_next = 0;
+    resolve_cancel();
+    attempts_free();
     return NET_SUCCESS;
 }
 
-netResult netio_tick()
+netResult netio_successor()
 {
-    size_t event_count;
-    sxpResult result;
+    return netio_successor_waiting ? NET_SUCCESS : NET_TRY_AGAIN;
+}
+
+/*
+the successor sends NETIO_HANDOFF_VERSION, then it is sent the body made by
+handoff_export, starting with its length, and the file descriptors the body
+refers to, each with a byte of its own
+*/
+netResult netio_handoff(const net_buffer_t *state)
+{
+    net_buffer_t body = { 0 };
+    net_buffer_t view;
+    char hello[4];
+    unsigned long version;
+    int *fds = NULL;
+    size_t fd_count = 0;
     size_t idx;
+    connection_t slot;
+    sxpResult sent;
+    netResult result = NET_ERROR;
 
-    if ((result = sxp_poll(&event_count, netio_poll_list, netio_active_count,
-                           NETIO_TIMEOUT)) != SXP_SUCCESS) {
-        switch (result) {
-        case SXP_TRY_AGAIN:
-            return NET_SUCCESS;
-        default:
-            return NET_ERROR;
+    if (!netio_successor_waiting)
+        return NET_ERROR;
+    view.buffer = hello;
+    view.size = 0;
+    view.capacity = sizeof(hello);
+    if (handoff_read(&netio_successor_socket, hello, sizeof(hello)) !=
+            NET_SUCCESS ||
+        packet_recv_u32(&view, &version) != PACKET_SUCCESS ||
+        version != NETIO_HANDOFF_VERSION) {
+        sxp_destroy(&netio_successor_socket);
+        netio_successor_waiting = 0;
+        return NET_TRY_AGAIN;
+    }
+
+    /*the successor applies its own limits to the waiting clients*/
+    for (idx = 0; idx < netio_waiting_count; idx++)
+        admit(netio_waiting[idx].socket, netio_waiting[idx].rings);
+    netio_waiting_count = 0;
+    /*the io threads are stopped until the successor has everything*/
+    if (workers_settle() != NET_SUCCESS)
+        goto end;
+    for (slot = 0; slot < netio_connection_count; slot++) {
+        struct netio_connection_info *connection = &netio_connections[slot];
+        /*refused clients are not worth passing on*/
+        if (connection->connection != NETIO_NONE && connection->refused)
+            netio_connection_close(connection->connection);
+        if (connection->shm && ring_service(connection) != NET_SUCCESS)
+            netio_connection_close(connection->connection);
+    }
+    /*a socket and the rings of every slot at most*/
+    if (!(fds = malloc(2 * netio_connection_count * sizeof(*fds))))
+        goto resume;
+    if (handoff_export(&body, fds, &fd_count) != NET_SUCCESS ||
+        packet_send_packet(&body, state) != PACKET_SUCCESS)
+        goto resume;
+    view.buffer = body.buffer;
+    view.size = 0;
+    view.capacity = body.capacity;
+    if (packet_send_u32(&view, body.size - 4) != PACKET_SUCCESS ||
+        packet_send_u32(&view, fd_count) != PACKET_SUCCESS ||
+        handoff_write(&netio_successor_socket, body.buffer, body.size) !=
+            NET_SUCCESS)
+        goto resume;
+    for (idx = 0; idx < fd_count; idx++) {
+        while ((sent = sxp_send_fd(&netio_successor_socket, fds[idx])) ==
+               SXP_TRY_AGAIN) {
+            if (handoff_wait(&netio_successor_socket, SXP_POLLOUT) !=
+                NET_SUCCESS)
+                goto resume;
         }
+        if (sent != SXP_SUCCESS)
+            goto resume;
     }
+    result = NET_SUCCESS;
 
-    idx = 0;
+    /*
+    the successor holds its own duplicates of the sockets, so closing them
+    here neither tells the clients nor removes the socket files
+    */
+    for (slot = 0; slot < netio_connection_count; slot++) {
+        struct netio_connection_info *connection = &netio_connections[slot];
+        free(connection->path);
+        connection->path = NULL;
+        if (connection->connection != NETIO_NONE && !connection->worker)
+            netio_connection_close(connection->connection);
+    }
+    goto end;
+resume:
+    /*
+    the successor drops what it got of an incomplete handoff, so only its
+    socket is closed and this server carries on with the io threads
+    */
+    sxp_destroy(&netio_successor_socket);
+    netio_successor_waiting = 0;
+    if (workers_resume() == NET_SUCCESS) {
+        packet_free(&body);
+        free(fds);
+        return NET_TRY_AGAIN;
+    }
+end:
+    workers_stop();
+    netio_reset();
+    packet_free(&body);
+    free(fds);
+    return result;
+}
 
-    if (netio_accepts_sockets && netio_active_count) {
-        /*server socket is no longer index 0. an error must have occured*/
-        if (netio_poll_list[idx].events & SXP_POLLOUT)
-            return NET_ERROR;
-        /*an error occured on the server socket*/
-        if (netio_poll_list[idx].revents & (POLLHUP | POLLERR | POLLNVAL))
-            return NET_ERROR;
-        /*a new client can be accepted*/
-        if (netio_poll_list[idx].revents & POLLIN) {
-            sxp_t new_sock;
-            if (sxp_accept(&netio_poll_list[idx].fd, &new_sock) ==
-                SXP_SUCCESS) {
-                if (sxp_nbio_set(&new_sock, SXP_NONBLOCKING) != SXP_SUCCESS) {
-                    sxp_destroy(&new_sock);
-                } else {
-                    setup_connection(new_sock);
-                }
-            }
-        }
-        idx++;
+netResult netio_takeover(const char *path, net_buffer_t *state)
+{
+    struct sockaddr_storage address;
+    size_t addrlen;
+    net_buffer_t body = { 0 };
+    net_buffer_t view;
+    char hello[4];
+    unsigned long length;
+    unsigned long fd_total;
+    unsigned long slots;
+    connection_t slot;
+    sxp_t predecessor;
+    int *fds = NULL;
+    size_t fd_count = 0;
+    size_t fd_next = 0;
+    sxpResult received;
+    netResult result = NET_ERROR;
+
+    if (netio_connection_count || !path)
+        return NET_ERROR;
+    if (sxp_unix_address(&address, &addrlen, path) != SXP_SUCCESS ||
+        sxp_create(&predecessor, address.ss_family, SOCK_STREAM, 0) !=
+            SXP_SUCCESS)
+        return NET_ERROR;
+    if (sxp_connect(&predecessor, (sockaddr_t *)&address, addrlen) !=
+        SXP_SUCCESS) {
+        sxp_destroy(&predecessor);
+        return NET_TRY_AGAIN;
     }
 
-    for (; event_count > 0 && idx < netio_active_count;) {
-        connection_t conn;
-        pollsxp_t *client = &netio_poll_list[idx];
-        if (!(client->revents &
-              (POLLHUP | POLLERR | POLLNVAL | SXP_POLLIN | SXP_POLLOUT))) {
-            idx++;
-            continue;
-        }
-        event_count--;
-        for (conn = 0; conn < netio_connection_count; conn++)
-            if (netio_connections[conn].socket == client->fd)
-                break;
+    view.buffer = hello;
+    view.size = 0;
+    view.capacity = sizeof(hello);
+    if (sxp_nbio_set(&predecessor, SXP_NONBLOCKING) != SXP_SUCCESS ||
+        packet_send_u32(&view, NETIO_HANDOFF_VERSION) != PACKET_SUCCESS ||
+        handoff_write(&predecessor, hello, sizeof(hello)) != NET_SUCCESS ||
+        handoff_read(&predecessor, hello, sizeof(hello)) != NET_SUCCESS)
+        goto end;
+    view.size = 0;
+    if (packet_recv_u32(&view, &length) != PACKET_SUCCESS || length < 8 ||
+        packet_realloc(&body, length) != PACKET_SUCCESS ||
+        handoff_read(&predecessor, body.buffer, length) != NET_SUCCESS ||
+        packet_recv_u32(&body, &fd_total) != PACKET_SUCCESS ||
+        packet_recv_u32(&body, &slots) != PACKET_SUCCESS ||
+        slots > NET_ID_SLOT(-1) || fd_total > 2 * slots)
+        goto end;
 
-        if (client->revents & (POLLHUP | POLLERR | POLLNVAL)) {
-            netio_connection_close(conn);
-            continue;
-        }
-        if ((client->revents & SXP_POLLIN) &&
-            (pull_data(&(netio_connections[conn])) == NET_ERROR)) {
-            netio_connection_close(conn);
-            continue;
-        }
-        if ((client->revents & SXP_POLLOUT) &&
-            (push_data(&(netio_connections[conn])) == NET_ERROR)) {
-            netio_connection_close(conn);
+    if (!(fds = malloc((fd_total + 1) * sizeof(*fds))))
+        goto end;
+    while (fd_count < fd_total) {
+        received = sxp_recv_fd(&predecessor, &fds[fd_count]);
+        if (received == SXP_TRY_AGAIN &&
+            handoff_wait(&predecessor, SXP_POLLIN) == NET_SUCCESS)
             continue;
-        }
+        if (received != SXP_SUCCESS)
+            goto end;
+        if (fds[fd_count] < 0)
+            goto end;
+        fd_count++;
+    }
 
-        idx++;
+    netio_accepts_sockets = 1;
+    if (netio_threads && workers_start() != NET_SUCCESS)
+        workers_stop();
+    if (slots &&
+        !(netio_connections = calloc(slots, sizeof(*netio_connections))))
+        goto end;
+    netio_connection_count = slots;
+    for (slot = 0; slot < slots; slot++) {
+        netio_connections[slot].connection = NETIO_NONE;
+        netio_connections[slot].free_next = NETIO_NONE;
     }
-    return NET_SUCCESS;
+    netio_now = sxp_clock();
+    for (slot = 0; slot < slots; slot++) {
+        if (handoff_adopt(&body, slot, fds, fd_count, &fd_next) !=
+            NET_SUCCESS)
+            goto end;
+    }
+    if (packet_recv_packet(&body, state) != PACKET_SUCCESS)
+        goto end;
+    result = NET_SUCCESS;
+end:
+    for (; fd_next < fd_count; fd_next++) {
+        sxp_t unused = (sxp_t)fds[fd_next];
+        sxp_destroy(&unused);
+    }
+    if (result != NET_SUCCESS)
+        netio_reset();
+    sxp_destroy(&predecessor);
+    packet_free(&body);
+    free(fds);
+    return result;
 }
 
-netResult netio_recv(connection_t *who, net_buffer_t *packet)
+netResult netio_backend_set(int backend)
 {
-    connection_t con = netio_accepts_sockets ? 1 : 0;
-    for (; con < netio_connection_count; con++) {
-        if (netio_connection_active(con)) {
-            switch (packet_recv_packet(&(netio_connections[con].recv_buffer),
-                                       packet)) {
-            case PACKET_NOT_READY:
-                continue;
-            case PACKET_SUCCESS:
-                *who = con;
-                return NET_SUCCESS;
-            case PACKET_ERROR:
-            default:
-                return NET_ERROR;
-            }
-        }
+    sxp_poller_t *poller;
+    int kind;
+
+    if (netio_connection_count)
+        return NET_ERROR;
+    if (backend == netio_backend)
+        return NET_SUCCESS;
+    switch (backend) {
+    case NET_BACKEND_POLL:
+        kind = SXP_POLLER_DEFAULT;
+        break;
+    case NET_BACKEND_URING:
+        kind = SXP_POLLER_URING;
+        break;
+    default:
+        return NET_ERROR;
     }
-    return NET_TRY_AGAIN;
+    /*the current poller is kept if the new one is not supported*/
+    if (sxp_poller_create(&poller, kind) != SXP_SUCCESS)
+        return NET_ERROR;
+    if (poller_setup(poller) != NET_SUCCESS) {
+        sxp_poller_destroy(poller);
+        return NET_ERROR;
+    }
+    sxp_poller_destroy(netio_poller);
+    netio_poller = poller;
+    netio_backend = backend;
+    return NET_SUCCESS;
 }
 
-netResult netio_send(connection_t who, const net_buffer_t *packet)
+netResult netio_threads_set(int threads)
 {
-    if (!netio_connection_active(who))
-        return NET_ERROR;
-
-    if (netio_connections[who].send_buffer.size + packet->size +
-            sizeof(unsigned long) >
-        NETIO_BUFFER_MAX_SIZE) {
+    if (netio_connection_count)
         return NET_ERROR;
+    if (threads == NET_THREADS_AUTO) {
+        /*one processor is left to the core thread*/
+        threads = thxp_cpu_count() - 1;
     }
-    if (packet_send_packet(&(netio_connections[who].send_buffer), packet) !=
-        PACKET_SUCCESS)
+    if (threads < 0 || threads > NETIO_THREADS_MAX)
         return NET_ERROR;
+    if (threads && !sxp_vtable_get()->threads)
+        return NET_ERROR;
+    netio_threads = threads;
     return NET_SUCCESS;
 }
 
-int netio_connection_active(connection_t who)
+netResult netio_backlog_set(int backlog)
 {
-    if (who >= netio_connection_count)
-        return 0;
-    return netio_connections[who].connection == who;
+    if (netio_connection_count || backlog <= 0)
+        return NET_ERROR;
+    netio_backlog = backlog;
+    return NET_SUCCESS;
 }
 
-netResult netio_connection_close(connection_t who)
+netResult netio_policy_set(int client_class, const struct net_policy *policy)
 {
-    size_t pollidx;
-
-    if (!netio_connection_active(who))
+    if (netio_connection_count || client_class < 0 ||
+        client_class >= NET_CLASS_COUNT)
         return NET_ERROR;
-
-    for (pollidx = 0; pollidx < netio_active_count; pollidx++)
-        if (netio_poll_list[pollidx].fd == netio_connections[who].socket)
-            break;
-    if (pollidx == netio_active_count)
+    if (policy->policy < NET_POLICY_PAUSE ||
+        policy->policy > NET_POLICY_DISCONNECT)
         return NET_ERROR;
-
-    if (sxp_destroy(&netio_connections[who].socket) != SXP_SUCCESS)
+    /*the policy has to act before a queue reaches its hard limit*/
+    if (policy->low >= policy->high || policy->high >= NETIO_BUFFER_MAX_SIZE)
         return NET_ERROR;
-    packet_free(&(netio_connections[who].recv_buffer));
-    packet_free(&(netio_connections[who].send_buffer));
-    memset(&netio_connections[who], 0, sizeof(netio_connections[0]));
-    netio_connections[who].connection = -1;
-
-    memmove(&netio_poll_list[pollidx], &netio_poll_list[netio_active_count - 1],
-            sizeof(netio_poll_list[0]));
-
-    if ((netio_active_count - 1)) {
-        netio_poll_list =
-            realloc(netio_poll_list,
-                    sizeof(netio_poll_list[0]) * (netio_active_count - 1));
-        if (!netio_poll_list)
-            return NET_ERROR;
-        netio_active_count -= 1;
-    } else {
-        free(netio_poll_list);
-        netio_poll_list = NULL;
-        netio_active_count = 0;
-    }
-
+    netio_policies[client_class] = *policy;
     return NET_SUCCESS;
 }
 
-static netResult setup_connection(sxp_t socket)
+netResult netio_outbound_max_set(size_t limit)
 {
-    netio_connections =
-        realloc(netio_connections,
-                sizeof(netio_connections[0]) * (netio_connection_count + 1));
-    if (!netio_connections)
+    if (netio_connection_count || !limit)
         return NET_ERROR;
+    netio_outbound_max = limit;
+    return NET_SUCCESS;
+}
 
-    memset(&netio_connections[netio_connection_count], 0,
-           sizeof(netio_connections[0]));
-    netio_connections[netio_connection_count].connection =
-        netio_connection_count;
-    netio_connections[netio_connection_count].socket = socket;
-
-    netio_poll_list = realloc(netio_poll_list, sizeof(netio_poll_list[0]) *
-                                                   (netio_active_count + 1));
-    if (!netio_poll_list)
+netResult netio_timeouts_set(unsigned long handshake, unsigned long idle)
+{
+    if (netio_connection_count)
         return NET_ERROR;
+    netio_handshake_timeout = handshake;
+    netio_idle_timeout = idle;
+    return NET_SUCCESS;
+}
 
-    netio_poll_list[netio_active_count].fd = socket;
-    netio_poll_list[netio_active_count].events = SXP_POLLIN;
-    netio_poll_list[netio_active_count].revents = 0;
-
-    /*socket is not the server socket*/
-    if (!netio_accepts_sockets || netio_active_count) {
-        netio_poll_list[netio_active_count].events |= SXP_POLLOUT;
-    } else {
-        netio_poll_list[netio_active_count].events |= POLLIN;
-    }
-    netio_active_count += 1;
-    netio_connection_count += 1;
+netResult netio_zerocopy_set(size_t threshold)
+{
+    if (netio_connection_count)
+        return NET_ERROR;
+    netio_zerocopy_min = threshold;
     return NET_SUCCESS;
 }
 
-static netResult pull_data(struct netio_connection_info *connection)
+netResult netio_admission_set(const struct net_admission *admission)
 {
-    size_t new_capacity;
-    size_t old_capacity;
-    size_t num_read;
-    sxpResult result;
-    char buf[NETIO_READ_MAX];
+    struct netio_waiting *waiting;
 
-    while ((result = sxp_recv(&(connection->socket), buf, &num_read,
-                              NETIO_READ_MAX)) == SXP_SUCCESS) {
-        if (num_read == 0)
-            return NET_ERROR;
-        old_capacity = connection->recv_buffer.capacity;
-        new_capacity = connection->recv_buffer.capacity + num_read;
-        if (new_capacity > NETIO_BUFFER_MAX_SIZE) {
-            old_capacity -= connection->recv_buffer.size;
-            new_capacity -= connection->recv_buffer.size;
-            memmove(connection->recv_buffer.buffer,
-                    connection->recv_buffer.buffer +
-                        connection->recv_buffer.size,
-                    old_capacity);
-            connection->recv_buffer.size = 0;
-            if (new_capacity > NETIO_BUFFER_MAX_SIZE)
-                return NET_ERROR;
-        }
-        if (packet_realloc(&(connection->recv_buffer), new_capacity) !=
-            PACKET_SUCCESS)
+    if (netio_connection_count || admission->rate > NETIO_RATE_MAX)
+        return NET_ERROR;
+    /*the queue is only used while the rate is exceeded*/
+    if (admission->rate && admission->queue) {
+        waiting = realloc(netio_waiting,
+                          admission->queue * sizeof(*netio_waiting));
+        if (!waiting)
             return NET_ERROR;
-        memcpy(connection->recv_buffer.buffer + old_capacity, buf, num_read);
+        netio_waiting = waiting;
     }
-    if (result == SXP_TRY_AGAIN)
-        return NET_SUCCESS;
-    return NET_ERROR;
+    netio_clients_max = admission->clients;
+    netio_admit_rate = admission->rate;
+    netio_waiting_max = admission->rate ? admission->queue : 0;
+    return NET_SUCCESS;
 }
 
-static netResult push_data(struct netio_connection_info *connection)
+netResult netio_tick()
 {
-    size_t msg_size = connection->send_buffer.size;
+    size_t event_count;
     sxpResult result;
+    size_t budget;
+    size_t idx;
+    time_t now;
 
-    while ((result = sxp_send(&(connection->socket),
-                              connection->send_buffer.buffer, msg_size)) ==
-           SXP_TOO_BIG) {
-        msg_size /= 2;
+    netio_ticks++;
+    /*packets returned by netio_recv are only valid until now*/
+    for (idx = 0; idx < netio_inbox_next; idx++)
+        message_free(&netio_inbox[idx]);
+    if (netio_inbox_next) {
+        memmove(netio_inbox, netio_inbox + netio_inbox_next,
+                (netio_inbox_count - netio_inbox_next) * sizeof(*netio_inbox));
+        netio_inbox_count -= netio_inbox_next;
+        netio_inbox_next = 0;
     }
-    if (result == SXP_TRY_AGAIN)
-        return NET_TRY_AGAIN;
-    if (result != SXP_SUCCESS)
+    /*releases what netio_recv returned and passes on what has been sent*/
+    for (idx = netio_ring_count; idx-- > 0;) {
+        connection_t conn = netio_rings[idx];
+        struct netio_connection_info *connection =
+            &netio_connections[NET_ID_SLOT(conn)];
+        if (ring_service(connection) != NET_SUCCESS ||
+            (flow_drained(connection, &budget) &&
+             resumed_push(conn, connection->missed, budget) != NET_SUCCESS))
+            netio_connection_close(conn);
+    }
+
+    result = sxp_poller_wait(netio_poller, netio_events, &event_count,
+                             NETIO_EVENTS_MAX, tick_timeout());
+    netio_now = sxp_clock();
+
+    now = time(NULL);
+    if (now != netio_wakeups_second) {
+        netio_wakeups_rate =
+            now - netio_wakeups_second == 1 ? netio_wakeups : 0;
+        netio_wakeups_second = now;
+        netio_wakeups = 0;
+    }
+
+    if (result == SXP_TRY_AGAIN)
+        event_count = 0;
+    else if (result != SXP_SUCCESS)
+        return NET_ERROR;
+    else
+        netio_wakeups++;
+
+    for (idx = 0; idx < event_count; idx++) {
+        sxp_event_t *event = &netio_events[idx];
+        connection_t slot;
+        connection_t conn;
+
+        if (event->key == NETIO_KEY_WAKE) {
+            wake_clear(&netio_wake[0], &netio_wake_pending);
+            continue;
+        }
+        /*watched file descriptors are read by the caller*/
+        if (event->key < NETIO_KEY(0))
+            continue;
+        slot = event->key - NETIO_KEY(0);
+
+        if (slot && netio_attempts) {
+            if (attempt_finish(slot - 1) != NET_SUCCESS)
+                return NET_ERROR;
+            continue;
+        }
+
+        /*connection has already been closed during this tick*/
+        if (slot >= netio_connection_count ||
+            netio_connections[slot].connection == NETIO_NONE)
+            continue;
+        conn = netio_connections[slot].connection;
+
+        if (netio_connections[slot].listening) {
+            /*an error occured on a listening socket*/
+            if (event->events & (SXP_POLLHUP | SXP_POLLERR))
+                return NET_ERROR;
+            /*a single successor is kept, see netio_handoff*/
+            if (netio_connections[slot].handoff) {
+                sxp_t successor;
+                while (sxp_accept(&netio_connections[slot].socket, &successor,
+                                  SXP_NONBLOCKING) == SXP_SUCCESS) {
+                    if (netio_successor_waiting) {
+                        sxp_destroy(&successor);
+                        continue;
+                    }
+                    netio_successor_socket = successor;
+                    netio_successor_waiting = 1;
+                }
+                continue;
+            }
+            /*
+            accept all waiting clients, the budget keeps a connect storm
+            from starving the connected clients, the rest is accepted on
+            the next tick
+            */
+            if (event->events & SXP_POLLIN) {
+                size_t accepted;
+                for (accepted = 0; accepted < NETIO_ACCEPT_BUDGET; accepted++) {
+                    sxp_t new_sock;
+                    if (sxp_accept(&netio_connections[slot].socket,
+                                   &new_sock, SXP_NONBLOCKING) != SXP_SUCCESS)
+                        break;
+                    admission_accept(new_sock, netio_connections[slot].rings);
+                }
+            }
+            continue;
+        }
+
+        if (netio_connections[slot].attaching ||
+            netio_connections[slot].shm) {
+            if ((event->events & (SXP_POLLHUP | SXP_POLLERR)) ||
+                ((event->events & SXP_POLLIN) &&
+                 (netio_connections[slot].attaching
+                      ? ring_attach(&(netio_connections[slot]))
+                      : ring_doorbell(&(netio_connections[slot]))) !=
+                     NET_SUCCESS))
+                netio_connection_close(conn);
+            continue;
+        }
+
+        if ((event->events & SXP_POLLHUP) ||
+            ((event->events & SXP_POLLERR) &&
+             zerocopy_complete(&(netio_connections[slot])) != NET_SUCCESS)) {
+            netio_connection_close(conn);
+            continue;
+        }
+        /*frames left over by NETIO_FRAME_BUDGET are handled before reading*/
+        if ((event->events & SXP_POLLIN) && !netio_connections[slot].pending) {
+            if (pull_data(&(netio_connections[slot])) == NET_ERROR) {
+                netio_connection_close(conn);
+                continue;
+            }
+            /*read only to notice the hangup*/
+            if (netio_connections[slot].refused) {
+                netio_connections[slot].recv_buffer.head = 0;
+                netio_connections[slot].recv_buffer.tail = 0;
+            } else {
+                pending_push(conn);
+            }
+        }
+        if ((event->events & SXP_POLLOUT) &&
+            (push_data(&(netio_connections[slot])) == NET_ERROR ||
+             (netio_connections[slot].refused &&
+              drain_step(&(netio_connections[slot]))))) {
+            netio_connection_close(conn);
+            continue;
+        }
+        if (flow_drained(&(netio_connections[slot]), &budget) &&
+            resumed_push(conn, netio_connections[slot].missed, budget) !=
+                NET_SUCCESS)
+            netio_connection_close(conn);
+    }
+    admission_tick();
+    timers_expire();
+    samples_take();
+
+    if (netio_resolve &&
+        __atomic_load_n(&netio_resolve->state, __ATOMIC_ACQUIRE) ==
+            NETIO_RESOLVE_DONE &&
+        resolve_finish() != NET_SUCCESS)
+        return NET_ERROR;
+    if (netio_attempts && attempts_tick() != NET_SUCCESS)
+        return NET_ERROR;
+    return workers_exchange();
+}
+
+netResult netio_watch(int fd)
+{
+    sxp_t socket = (sxp_t)fd;
+    if (netio_watch_count >= NETIO_WATCH_MAX)
+        return NET_ERROR;
+    if (sxp_poller_add(netio_poller, &socket, SXP_POLLIN,
+                       NETIO_KEY_WATCH + netio_watch_count) != SXP_SUCCESS)
+        return NET_ERROR;
+    netio_watched[netio_watch_count++] = socket;
+    return NET_SUCCESS;
+}
+
+netResult netio_recv(connection_t *who, net_buffer_t *packet)
+{
+    while (netio_pending_head != NETIO_NONE) {
+        connection_t con = netio_pending_head;
+        struct netio_connection_info *connection =
+            &netio_connections[NET_ID_SLOT(con)];
+
+        if (connection->frames_tick != netio_ticks) {
+            connection->frames_tick = netio_ticks;
+            connection->frames = 0;
+        }
+        /*
+        every connection is served once before the head is served again, so
+        all of them have used up their budget. The rest waits for the next
+        tick.
+        */
+        if (connection->frames >= NETIO_FRAME_BUDGET)
+            break;
+
+        switch (connection->shm
+                    ? ring_next(connection, packet)
+                    : recv_next(&(connection->recv_buffer), packet)) {
+        case PACKET_NOT_READY:
+            pending_remove(con);
+            continue;
+        case PACKET_SUCCESS:
+            connection->frames++;
+            connection->stats.frames_in++;
+            connection->last_seen = netio_now;
+            connection->probed = 0;
+            pending_remove(con);
+            pending_push(con);
+            *who = con;
+            return NET_SUCCESS;
+        case PACKET_ERROR:
+        default:
+            return NET_ERROR;
+        }
+    }
+    if (netio_inbox_next < netio_inbox_count) {
+        *who = netio_inbox[netio_inbox_next].connection;
+        *packet = netio_inbox[netio_inbox_next].packet;
+        netio_inbox_next++;
+        if (netio_connection_active(*who)) {
+            netio_connections[NET_ID_SLOT(*who)].last_seen = netio_now;
+            netio_connections[NET_ID_SLOT(*who)].probed = 0;
+        }
+        return NET_SUCCESS;
+    }
+    return NET_TRY_AGAIN;
+}
+
+netResult netio_send(connection_t who, const net_buffer_t *packet)
+{
+    netio_frame_t *frame;
+    netResult result;
+
+    if (!netio_connection_active(who))
+        return NET_ERROR;
+    if (netio_frame_create(&frame, packet, 0, NETIO_TAG_NONE) != NET_SUCCESS)
+        return NET_ERROR;
+    result = netio_send_frame(who, frame);
+    netio_frame_release(frame);
+    return result;
+}
+
+netResult netio_frame_create(netio_frame_t **frame, const net_buffer_t *packet,
+                             int flags, long tag)
+{
+    net_buffer_t view;
+
+    if (packet->size > NETIO_BUFFER_MAX_SIZE)
+        return NET_ERROR;
+    if (!(*frame = malloc(sizeof(**frame) + packet->size + 4)))
+        return NET_ERROR;
+    (*frame)->references = 1;
+    (*frame)->flags = flags;
+    (*frame)->tag = tag;
+    (*frame)->data = (char *)(*frame + 1);
+
+    view.buffer = (*frame)->data;
+    view.size = 0;
+    view.capacity = packet->size + 4;
+    if (packet_send_packet(&view, packet) != PACKET_SUCCESS) {
+        free(*frame);
+        return NET_ERROR;
+    }
+    (*frame)->size = view.size;
+    return NET_SUCCESS;
+}
+
+void netio_frame_release(netio_frame_t *frame)
+{
+    if (frame && !__atomic_sub_fetch(&frame->references, 1, __ATOMIC_ACQ_REL))
+        free(frame);
+}
+
+netResult netio_send_frame(connection_t who, netio_frame_t *frame)
+{
+    struct netio_connection_info *connection;
+
+    if (!netio_connection_active(who))
+        return NET_ERROR;
+    connection = &netio_connections[NET_ID_SLOT(who)];
+
+    if (connection->worker) {
+        struct netio_message message;
+        memset(&message, 0, sizeof(message));
+        message.type = NETIO_MESSAGE_SEND;
+        message.connection = who;
+        message.frame = frame;
+        __atomic_add_fetch(&frame->references, 1, __ATOMIC_RELAXED);
+        if (worker_command(connection->worker, &message) != NET_SUCCESS) {
+            netio_frame_release(frame);
+            return NET_ERROR;
+        }
+        return NET_SUCCESS;
+    }
+
+    /*the connection of a client is never paused*/
+    if (!netio_accepts_sockets) {
+        if (connection->send_queue.size + frame->size > NETIO_BUFFER_MAX_SIZE)
+            return NET_ERROR;
+        if (send_queue_push(&(connection->send_queue), frame) != NET_SUCCESS)
+            return NET_ERROR;
+        __atomic_add_fetch(&frame->references, 1, __ATOMIC_RELAXED);
+        return interest_set(connection, SXP_POLLIN | SXP_POLLOUT);
+    }
+    return flow_send(connection, frame);
+}
+
+netResult netio_resumed(connection_t *who, long *tag, size_t *budget)
+{
+    while (netio_resumed_count) {
+        struct netio_message *resumed =
+            &netio_resumed_list[--netio_resumed_count];
+        if (!netio_connection_active(resumed->connection))
+            continue;
+        *who = resumed->connection;
+        *tag = resumed->tag;
+        *budget = resumed->budget;
+        return NET_SUCCESS;
+    }
+    return NET_TRY_AGAIN;
+}
+
+netResult netio_resume(connection_t who, netio_frame_t *frame, long missed)
+{
+    struct netio_connection_info *connection;
+
+    if (!netio_connection_active(who))
+        return NET_ERROR;
+    connection = &netio_connections[NET_ID_SLOT(who)];
+
+    if (connection->worker) {
+        struct netio_message message;
+        memset(&message, 0, sizeof(message));
+        message.type = NETIO_MESSAGE_RESUME;
+        message.connection = who;
+        message.frame = frame;
+        message.tag = missed;
+        __atomic_add_fetch(&frame->references, 1, __ATOMIC_RELAXED);
+        if (worker_command(connection->worker, &message) != NET_SUCCESS) {
+            netio_frame_release(frame);
+            return NET_ERROR;
+        }
+        return NET_SUCCESS;
+    }
+    return flow_resume(connection, frame, missed);
+}
+
+netResult netio_class_set(connection_t who, int client_class)
+{
+    struct netio_connection_info *connection;
+
+    if (!netio_connection_active(who) || client_class < 0 ||
+        client_class >= NET_CLASS_COUNT)
+        return NET_ERROR;
+    connection = &netio_connections[NET_ID_SLOT(who)];
+    connection->client_class = client_class;
+
+    if (connection->worker) {
+        struct netio_message message;
+        memset(&message, 0, sizeof(message));
+        message.type = NETIO_MESSAGE_CLASS;
+        message.connection = who;
+        message.client_class = client_class;
+        return worker_command(connection->worker, &message);
+    }
+    return NET_SUCCESS;
+}
+
+netResult netio_established(connection_t who)
+{
+    if (!netio_connection_active(who))
+        return NET_ERROR;
+    timer_start(who, 0);
+    return NET_SUCCESS;
+}
+
+netResult netio_idle(connection_t *who)
+{
+    if (!netio_idle_count)
+        return NET_TRY_AGAIN;
+    *who = netio_idle_list[--netio_idle_count];
+    return NET_SUCCESS;
+}
+
+netResult netio_closed(connection_t *who)
+{
+    if (!netio_closed_count)
+        return NET_TRY_AGAIN;
+    *who = netio_closed_list[--netio_closed_count];
+    return NET_SUCCESS;
+}
+
+netResult netio_refused(connection_t *who, unsigned long *retry)
+{
+    while (netio_refused_count) {
+        connection_t refused = netio_refused_list[--netio_refused_count];
+        /*it may have hung up already*/
+        if (!netio_connection_active(refused))
+            continue;
+        *who = refused;
+        *retry = netio_connections[NET_ID_SLOT(refused)].retry;
+        return NET_SUCCESS;
+    }
+    return NET_TRY_AGAIN;
+}
+
+netResult netio_stats_get(struct net_stats *stats)
+{
+    stats->wakeups_per_second = netio_wakeups_rate;
+    stats->backend = netio_backend;
+    stats->threads = netio_worker_count;
+    stats->outbound = __atomic_load_n(&netio_outbound, __ATOMIC_RELAXED);
+    stats->zerocopy_sends =
+        __atomic_load_n(&netio_zerocopy_sends, __ATOMIC_RELAXED);
+    stats->zerocopy_copied =
+        __atomic_load_n(&netio_zerocopy_copied, __ATOMIC_RELAXED);
+    stats->timeouts = netio_timeouts;
+    stats->waiting = netio_waiting_count;
+    stats->refused = netio_refusals;
+    return NET_SUCCESS;
+}
+
+netResult netio_connection_stats_get(connection_t who,
+                                     struct net_connection_stats *stats)
+{
+    struct netio_connection_info *connection;
+
+    if (!netio_connection_active(who))
+        return NET_ERROR;
+    connection = &netio_connections[NET_ID_SLOT(who)];
+    if (connection->listening || connection->connecting)
+        return NET_ERROR;
+    *stats = connection->stats;
+    /*the send queue of a client of an io thread is not visible here*/
+    if (!connection->worker)
+        stats->queued = connection->send_queue.size;
+    return NET_SUCCESS;
+}
+
+int netio_connection_active(connection_t who)
+{
+    if (NET_ID_SLOT(who) >= netio_connection_count)
+        return 0;
+    return netio_connections[NET_ID_SLOT(who)].connection == who;
+}
+
+netResult netio_connection_close(connection_t who)
+{
+    connection_t slot = NET_ID_SLOT(who);
+    struct netio_connection_info *connection;
+
+    if (!netio_connection_active(who))
+        return NET_ERROR;
+    connection = &netio_connections[slot];
+    timer_remove(who);
+
+    if (connection->worker) {
+        struct netio_message message;
+        memset(&message, 0, sizeof(message));
+        message.type = NETIO_MESSAGE_CLOSE;
+        message.connection = who;
+        /*the slot is released once the io thread reports it closed*/
+        connection->connection = NETIO_NONE;
+        return worker_command(connection->worker, &message);
+    }
+
+    if (connection->connecting) {
+        resolve_cancel();
+        attempts_free();
+    } else {
+        (void)sxp_poller_remove(connection->poller, &connection->socket,
+                                NETIO_KEY(slot));
+        if (sxp_destroy(&connection->socket) != SXP_SUCCESS)
+            return NET_ERROR;
+    }
+    if (connection->shm) {
+        ring_remove(who);
+        (void)shmxp_destroy(&connection->shm->region);
+        free(connection->shm);
+    }
+    /*the poller may still hold the socket, so its file is not probed*/
+    if (connection->path) {
+        (void)remove(connection->path);
+        free(connection->path);
+    }
+    pending_remove(who);
+
+    free(connection->recv_buffer.buffer);
+    send_queue_free(&(connection->send_queue));
+    slot_release(who);
+
+    return NET_SUCCESS;
+}
+
+/*(re)starts the timer of who, counting its silence from now*/
+static void timer_start(connection_t who, int handshaking)
+{
+    struct netio_connection_info *connection =
+        &netio_connections[NET_ID_SLOT(who)];
+
+    connection->handshaking = handshaking && netio_handshake_timeout;
+    connection->probed = 0;
+    connection->last_seen = netio_now;
+    if (connection->handshaking)
+        timer_set(who, netio_now + netio_handshake_timeout);
+    else
+        timer_arm(who);
+}
+
+/*due is in ms, a timer never expires early but up to one slot late*/
+static void timer_set(connection_t who, unsigned long due)
+{
+    unsigned long slot =
+        (due + NETIO_WHEEL_RESOLUTION - 1) / NETIO_WHEEL_RESOLUTION;
+
+    /*an empty wheel is not advanced by netio_tick*/
+    if (!netio_wheel_count)
+        netio_wheel_now = netio_now / NETIO_WHEEL_RESOLUTION;
+    /*at the earliest in the next slot, the current one has expired already*/
+    if ((long)(slot - netio_wheel_now) <= 0)
+        slot = netio_wheel_now + 1;
+    timer_remove(who);
+    timer_insert(who, slot);
+}
+
+/*
+sets the timer of who, which is done with its handshake, to its next idle
+check or to the end of its grace period, whichever comes first
+*/
+static void timer_arm(connection_t who)
+{
+    struct netio_connection_info *connection =
+        &netio_connections[NET_ID_SLOT(who)];
+    unsigned long due =
+        connection->last_seen +
+        (connection->probed ? netio_idle_timeout : netio_idle_timeout / 2);
+
+    if (connection->lingering &&
+        (!netio_idle_timeout || (long)(connection->deadline - due) < 0))
+        timer_set(who, connection->deadline);
+    else if (netio_idle_timeout)
+        timer_set(who, due);
+    else
+        timer_remove(who);
+}
+
+static void timer_insert(connection_t who, unsigned long due)
+{
+    struct netio_connection_info *connection =
+        &netio_connections[NET_ID_SLOT(who)];
+    unsigned long delta = due - netio_wheel_now;
+    size_t bucket;
+    int level;
+
+    if (delta >= 1UL << (NETIO_WHEEL_BITS * NETIO_WHEEL_LEVELS)) {
+        delta = (1UL << (NETIO_WHEEL_BITS * NETIO_WHEEL_LEVELS)) - 1;
+        due = netio_wheel_now + delta;
+    }
+    for (level = 0; level < NETIO_WHEEL_LEVELS - 1; level++) {
+        if (delta < 1UL << (NETIO_WHEEL_BITS * (level + 1)))
+            break;
+    }
+    bucket = level * NETIO_WHEEL_SLOTS +
+             ((due >> (NETIO_WHEEL_BITS * level)) & (NETIO_WHEEL_SLOTS - 1));
+
+    connection->timer_due = due;
+    connection->timer_bucket = bucket + 1;
+    connection->timer_prev = NETIO_NONE;
+    connection->timer_next = netio_wheel[bucket];
+    if (netio_wheel[bucket] != NETIO_NONE)
+        netio_connections[NET_ID_SLOT(netio_wheel[bucket])].timer_prev = who;
+    netio_wheel[bucket] = who;
+    netio_wheel_count++;
+}
+
+static void timer_remove(connection_t who)
+{
+    struct netio_connection_info *connection =
+        &netio_connections[NET_ID_SLOT(who)];
+
+    if (!connection->timer_bucket)
+        return;
+    if (connection->timer_prev != NETIO_NONE)
+        netio_connections[NET_ID_SLOT(connection->timer_prev)].timer_next =
+            connection->timer_next;
+    else
+        netio_wheel[connection->timer_bucket - 1] = connection->timer_next;
+    if (connection->timer_next != NETIO_NONE)
+        netio_connections[NET_ID_SLOT(connection->timer_next)].timer_prev =
+            connection->timer_prev;
+    connection->timer_bucket = 0;
+    netio_wheel_count--;
+}
+
+/*advances the wheel to netio_now, expiring the timers on the way*/
+static void timers_expire()
+{
+    unsigned long target = netio_now / NETIO_WHEEL_RESOLUTION;
+
+    while ((long)(target - netio_wheel_now) > 0) {
+        connection_t who;
+        int level;
+
+        /*nothing to expire or move down on the way*/
+        if (!netio_wheel_count) {
+            netio_wheel_now = target;
+            break;
+        }
+        netio_wheel_now++;
+        for (level = 1; level < NETIO_WHEEL_LEVELS; level++) {
+            size_t bucket;
+            if (netio_wheel_now &
+                ((1UL << (NETIO_WHEEL_BITS * level)) - 1))
+                break;
+            bucket = level * NETIO_WHEEL_SLOTS +
+                     ((netio_wheel_now >> (NETIO_WHEEL_BITS * level)) &
+                      (NETIO_WHEEL_SLOTS - 1));
+            while ((who = netio_wheel[bucket]) != NETIO_NONE) {
+                timer_remove(who);
+                timer_insert(who,
+                             netio_connections[NET_ID_SLOT(who)].timer_due);
+            }
+        }
+        while ((who = netio_wheel[netio_wheel_now &
+                                  (NETIO_WHEEL_SLOTS - 1)]) != NETIO_NONE) {
+            timer_remove(who);
+            timer_expire(who);
+        }
+    }
+}
+
+static void timer_expire(connection_t who)
+{
+    struct netio_connection_info *connection =
+        &netio_connections[NET_ID_SLOT(who)];
+    unsigned long silent = netio_now - connection->last_seen;
+
+    if (connection->refused) {
+        netio_connection_close(who);
+        return;
+    }
+    /*push_data ends the grace period once the queue is down to low*/
+    if (connection->lingering &&
+        (long)(netio_now - connection->deadline) >= 0) {
+        netio_connection_close(who);
+        return;
+    }
+    if (connection->handshaking ||
+        (netio_idle_timeout && silent >= netio_idle_timeout)) {
+        netio_timeouts++;
+        netio_connection_close(who);
+        return;
+    }
+    if (netio_idle_timeout && !connection->probed &&
+        silent >= netio_idle_timeout / 2) {
+        connection->probed = 1;
+        list_push(&netio_idle_list, &netio_idle_count, &netio_idle_capacity,
+                  who);
+    }
+    timer_arm(who);
+}
+
+/*ms until the next bucket holding timers is expired or moved down*/
+static long timer_next()
+{
+    unsigned long next = 1UL << (NETIO_WHEEL_BITS * NETIO_WHEEL_LEVELS);
+    long remaining;
+    int level;
+
+    for (level = 0; level < NETIO_WHEEL_LEVELS; level++) {
+        unsigned long base = netio_wheel_now >> (NETIO_WHEEL_BITS * level);
+        unsigned long step;
+        for (step = 1; step <= NETIO_WHEEL_SLOTS; step++) {
+            unsigned long slot;
+            if (netio_wheel[level * NETIO_WHEEL_SLOTS +
+                            ((base + step) & (NETIO_WHEEL_SLOTS - 1))] ==
+                NETIO_NONE)
+                continue;
+            slot = ((base + step) << (NETIO_WHEEL_BITS * level)) -
+                   netio_wheel_now;
+            if (slot < next)
+                next = slot;
+            break;
+        }
+    }
+    remaining = (long)((netio_wheel_now + next) * NETIO_WHEEL_RESOLUTION -
+                       sxp_clock());
+    return remaining > 0 ? remaining : 0;
+}
+
+static void list_push(connection_t **list, size_t *count, size_t *capacity,
+                      connection_t who)
+{
+    if (*count == *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 64;
+        connection_t *resized = realloc(*list, grown * sizeof(**list));
+        /*the connection is left out if memory is short*/
+        if (!resized)
+            return;
+        *list = resized;
+        *capacity = grown;
+    }
+    (*list)[(*count)++] = who;
+}
+
+/*
+admits a client accepted by a server, queues it while the rate is exceeded
+or refuses it. The cap counts the clients waiting in the queue as well.
+*/
+static void admission_accept(sxp_t socket, int rings)
+{
+    if (netio_clients_max &&
+        netio_clients + netio_waiting_count >= netio_clients_max) {
+        refuse(socket, rings, NETIO_RETRY_FULL);
+        return;
+    }
+    if (!netio_waiting_count && credit_take()) {
+        admit(socket, rings);
+        return;
+    }
+    if (netio_waiting_count < netio_waiting_max) {
+        netio_waiting[netio_waiting_count].socket = socket;
+        netio_waiting[netio_waiting_count].rings = rings;
+        netio_waiting_count++;
+        return;
+    }
+    /*until the queue would have room again*/
+    refuse(socket, rings,
+           (netio_waiting_count + 1) * 1000 / netio_admit_rate + 1);
+}
+
+/*admits the waiting clients the credit built up since the last tick allows*/
+static void admission_tick()
+{
+    size_t admitted = 0;
+
+    while (admitted < netio_waiting_count && credit_take()) {
+        admit(netio_waiting[admitted].socket, netio_waiting[admitted].rings);
+        admitted++;
+    }
+    if (admitted) {
+        memmove(netio_waiting, netio_waiting + admitted,
+                (netio_waiting_count - admitted) * sizeof(*netio_waiting));
+        netio_waiting_count -= admitted;
+    }
+}
+
+/*returns nonzero and spends the credit if another handshake may start now*/
+static int credit_take()
+{
+    unsigned long elapsed = netio_now - netio_credit_time;
+
+    if (!netio_admit_rate)
+        return 1;
+    /*a second worth of credit at most, which also keeps it from overflowing*/
+    if (elapsed > 1000)
+        elapsed = 1000;
+    netio_credit_time = netio_now;
+    netio_credit += elapsed * netio_admit_rate;
+    if (netio_credit > netio_admit_rate * 1000)
+        netio_credit = netio_admit_rate * 1000;
+    if (netio_credit < 1000)
+        return 0;
+    netio_credit -= 1000;
+    return 1;
+}
+
+static void admit(sxp_t socket, int rings)
+{
+    connection_t client;
+    unsigned int worker = 0;
+
+    /*rings are serviced by this thread*/
+    if (netio_worker_count && !rings) {
+        /*spread the clients across the io threads*/
+        netio_worker_next = netio_worker_next % netio_worker_count + 1;
+        worker = netio_worker_next;
+    }
+    if (setup_connection(socket, worker, zerocopy_enable(&socket), &client) !=
+        NET_SUCCESS) {
+        sxp_destroy(&socket);
+        return;
+    }
+    netio_connections[NET_ID_SLOT(client)].admitted = 1;
+    netio_clients++;
+    if (rings)
+        netio_connections[NET_ID_SLOT(client)].attaching = 1;
+    else if (!worker &&
+             receive_start(&netio_connections[NET_ID_SLOT(client)]) !=
+                 NET_SUCCESS) {
+        netio_connection_close(client);
+        return;
+    }
+    timer_start(client, 1);
+}
+
+/*
+the client is served by this thread until it has been told so. Clients of
+rings are closed right away, they only read wakeups from their socket.
+*/
+static void refuse(sxp_t socket, int rings, unsigned long retry)
+{
+    struct netio_connection_info *connection;
+    connection_t client;
+
+    netio_refusals++;
+    if (rings || setup_connection(socket, 0, 0, &client) != NET_SUCCESS) {
+        sxp_destroy(&socket);
+        return;
+    }
+    connection = &netio_connections[NET_ID_SLOT(client)];
+    connection->refused = 1;
+    connection->retry = retry;
+    /*a peer which does not hang up is not waited for any longer*/
+    timer_set(client, netio_now + NETIO_DRAIN_TIMEOUT);
+    list_push(&netio_refused_list, &netio_refused_count,
+              &netio_refused_capacity, client);
+}
+
+static netResult poller_setup(sxp_poller_t *poller)
+{
+    size_t idx;
+    if (sxp_poller_add(poller, &netio_wake[0], SXP_POLLIN, NETIO_KEY_WAKE) !=
+        SXP_SUCCESS)
+        return NET_ERROR;
+    for (idx = 0; idx < netio_watch_count; idx++) {
+        if (sxp_poller_add(poller, &netio_watched[idx], SXP_POLLIN,
+                           NETIO_KEY_WATCH + idx) != SXP_SUCCESS)
+            return NET_ERROR;
+    }
+    return NET_SUCCESS;
+}
+
+/*sleeps until the next timer is due, or for good if input is watched*/
+static int tick_timeout()
+{
+    int timeout = netio_watch_count && !netio_draining ? -1 : NETIO_TIMEOUT;
+    if (netio_inbox_count || netio_pending_head != NETIO_NONE ||
+        netio_resumed_count)
+        return 0;
+    if (netio_wheel_count) {
+        long remaining = timer_next();
+        if (timeout < 0 || remaining < timeout)
+            timeout = (int)remaining;
+    }
+    /*until the credit for the next waiting client has built up*/
+    if (netio_waiting_count) {
+        long remaining =
+            (long)((1000 - netio_credit + netio_admit_rate - 1) /
+                   netio_admit_rate) -
+            (long)(sxp_clock() - netio_credit_time);
+        if (remaining < 0)
+            remaining = 0;
+        if (timeout < 0 || remaining < timeout)
+            timeout = (int)remaining;
+    }
+    if (netio_attempts && netio_attempt_next < netio_attempt_count) {
+        long remaining = (long)(netio_attempt_due - sxp_clock());
+        if (remaining < 0)
+            remaining = 0;
+        if (timeout < 0 || remaining < timeout)
+            timeout = (int)remaining;
+    }
+    return timeout;
+}
+
+static netResult setup_connection(sxp_t socket, unsigned int worker,
+                                  int zerocopy, connection_t *who)
+{
+    struct netio_message message;
+    connection_t slot;
+
+    if (netio_free_head != NETIO_NONE) {
+        slot = netio_free_head;
+    } else {
+        struct netio_connection_info *connections;
+        slot = netio_connection_count;
+        if (NET_ID_SLOT(slot + 1) != slot + 1)
+            return NET_ERROR;
+        connections = realloc(netio_connections,
+                              sizeof(netio_connections[0]) * (slot + 1));
+        if (!connections)
+            return NET_ERROR;
+        netio_connections = connections;
+        memset(&netio_connections[slot], 0, sizeof(netio_connections[0]));
+        netio_connections[slot].connection = NETIO_NONE;
+        netio_connection_count += 1;
+    }
+
+    memset(&message, 0, sizeof(message));
+    message.type = NETIO_MESSAGE_ADOPT;
+    message.socket = socket;
+    message.zerocopy = zerocopy;
+    if (slot_occupy(slot, worker, &message) != NET_SUCCESS)
+        return NET_ERROR;
+    if (who)
+        *who = netio_connections[slot].connection;
+    return NET_SUCCESS;
+}
+
+/*
+makes the socket of adopt the next occupant of slot. Unless worker is 0 it is
+handed to that io thread with adopt, which then owns what adopt holds.
+*/
+static netResult slot_occupy(connection_t slot, unsigned int worker,
+                             struct netio_message *adopt)
+{
+    struct netio_connection_info *connection = &netio_connections[slot];
+
+    /*write interest is only registered while output is queued*/
+    if (!worker && sxp_poller_add(netio_poller, &adopt->socket, SXP_POLLIN,
+                                  NETIO_KEY(slot)) != SXP_SUCCESS)
+        return NET_ERROR;
+
+    if (slot == netio_free_head) {
+        netio_free_head = connection->free_next;
+        if (netio_free_head == NETIO_NONE)
+            netio_free_tail = NETIO_NONE;
+    }
+
+    connection->connection = NET_ID_MAKE(slot, connection->generation);
+    connection->socket = adopt->socket;
+    connection->zerocopy = adopt->zerocopy;
+    connection->poller = netio_poller;
+    connection->events = SXP_POLLIN;
+
+    if (worker) {
+        adopt->connection = connection->connection;
+        connection->worker = worker;
+        connection->poller = NULL;
+        if (worker_command(worker, adopt) != NET_SUCCESS) {
+            slot_release(connection->connection);
+            return NET_ERROR;
+        }
+    }
+    return NET_SUCCESS;
+}
+
+/*
+restores the state a client taken over by netio_takeover had on its previous
+server. The bytes received from it in the packet of adopt and the frame of
+the bytes still queued for it are taken over.
+*/
+static netResult connection_restore(struct netio_connection_info *connection,
+                                    struct netio_message *adopt)
+{
+    struct netio_recv_buffer *recv = &(connection->recv_buffer);
+
+    connection->client_class = adopt->client_class;
+    /*what was reserved for the missed frames is reserved again once drained*/
+    connection->flow =
+        adopt->flow == NETIO_FLOWING ? NETIO_FLOWING : NETIO_PAUSED;
+    connection->missed = adopt->tag;
+    connection->send_queue.pinned_next = adopt->sequence;
+    if (adopt->packet.capacity) {
+        recv->buffer = adopt->packet.buffer;
+        recv->head = 0;
+        recv->tail = adopt->packet.capacity;
+        recv->capacity = adopt->packet.capacity;
+        adopt->packet.buffer = NULL;
+    }
+    if (!adopt->frame)
+        return NET_SUCCESS;
+    if (send_queue_push(&(connection->send_queue), adopt->frame) !=
+        NET_SUCCESS)
+        return NET_ERROR;
+    adopt->frame = NULL;
+    return interest_set(connection, SXP_POLLIN | SXP_POLLOUT);
+}
+
+static void slot_release(connection_t who)
+{
+    connection_t slot = NET_ID_SLOT(who);
+    struct netio_connection_info *connection = &netio_connections[slot];
+
+    timer_remove(who);
+    if (netio_accepts_sockets && !connection->listening)
+        list_push(&netio_closed_list, &netio_closed_count,
+                  &netio_closed_capacity, who);
+    if (connection->admitted)
+        netio_clients--;
+    memset(connection, 0, sizeof(*connection));
+    connection->connection = NETIO_NONE;
+    connection->generation = NET_ID_GENERATION(who) + 1;
+    connection->free_next = NETIO_NONE;
+
+    if (netio_free_tail != NETIO_NONE)
+        netio_connections[netio_free_tail].free_next = slot;
+    else
+        netio_free_head = slot;
+    netio_free_tail = slot;
+}
+
+/*
+reads at most NETIO_READ_BUDGET bytes, the pollers are level triggered and
+report the rest again
+*/
+static netResult pull_data(struct netio_connection_info *connection)
+{
+    struct netio_recv_buffer *recv = &(connection->recv_buffer);
+    size_t budget = NETIO_READ_BUDGET;
+    size_t num_read;
+    size_t length;
+    sxpResult result;
+
+    do {
+        if (recv->tail == recv->capacity && recv_reserve(recv) != NET_SUCCESS)
+            return NET_ERROR;
+        length = recv->capacity - recv->tail;
+        result = sxp_poller_recv(
+            connection->poller, &(connection->socket),
+            NETIO_KEY(NET_ID_SLOT(connection->connection)),
+            recv->buffer + recv->tail, &num_read,
+            length < budget ? length : budget);
+        if (result == SXP_SUCCESS) {
+            /*
+            what arrived before the hangup (such as a busy packet) is
+            returned first, the hangup is read again on the next wakeup
+            */
+            if (num_read == 0)
+                return budget < NETIO_READ_BUDGET ? NET_SUCCESS : NET_ERROR;
+            recv->tail += num_read;
+            budget -= num_read;
+            connection->stats.bytes_in += num_read;
+        }
+    } while (result == SXP_SUCCESS && budget);
+    if (result == SXP_SUCCESS || result == SXP_TRY_AGAIN)
+        return NET_SUCCESS;
+    return NET_ERROR;
+}
+
+/*parses the next complete frame, the buffer is released once drained*/
+static parseResult recv_next(struct netio_recv_buffer *recv,
+                             net_buffer_t *packet)
+{
+    net_buffer_t view;
+    parseResult parsed;
+
+    view.buffer = recv->buffer;
+    view.size = recv->head;
+    view.capacity = recv->tail;
+
+    parsed = packet_peek_packet(&view, packet);
+    if (parsed == PACKET_SUCCESS) {
+        recv->head = view.size;
+    } else if (parsed == PACKET_NOT_READY && recv->head == recv->tail) {
+        recv->head = 0;
+        recv->tail = 0;
+        if (recv->capacity > NETIO_READ_MAX) {
+            free(recv->buffer);
+            memset(recv, 0, sizeof(*recv));
+        }
+    }
+    return parsed;
+}
+
+static netResult recv_reserve(struct netio_recv_buffer *recv)
+{
+    size_t unread = recv->tail - recv->head;
+    char *buffer;
+    size_t capacity;
+
+    /*grow instead while more than half is unread, so that bytes are moved
+     * at most a constant number of times on average*/
+    if (recv->head && unread <= recv->capacity / 2) {
+        memmove(recv->buffer, recv->buffer + recv->head, unread);
+        recv->head = 0;
+        recv->tail = unread;
+        return NET_SUCCESS;
+    }
+    if (recv->capacity < NETIO_BUFFER_MAX_SIZE) {
+        capacity = recv->capacity ? recv->capacity * 2 : NETIO_READ_MAX;
+        if (capacity > NETIO_BUFFER_MAX_SIZE)
+            capacity = NETIO_BUFFER_MAX_SIZE;
+        if (!(buffer = realloc(recv->buffer, capacity)))
+            return NET_ERROR;
+        recv->buffer = buffer;
+        recv->capacity = capacity;
+        return NET_SUCCESS;
+    }
+    if (recv->head) {
+        memmove(recv->buffer, recv->buffer + recv->head, unread);
+        recv->head = 0;
+        recv->tail = unread;
+        return NET_SUCCESS;
+    }
+    /*a single frame is larger than NETIO_BUFFER_MAX_SIZE*/
+    return NET_ERROR;
+}
+
+static netResult push_data(struct netio_connection_info *connection)
+{
+    struct netio_send_queue *queue = &(connection->send_queue);
+    sxp_buffer_t buffers[SXP_IOV_MAX];
+    size_t count;
+    size_t batch_size;
+    size_t num_sent;
+    sxpResult result;
+
+    while (queue->count) {
+        struct netio_frame *first = queue->frames[queue->head];
+        size_t frames = queue->count;
+        int zerocopy =
+            connection->zerocopy && first->size >= netio_zerocopy_min;
+        int pinned = 0;
+
+        batch_size = 0;
+        for (count = 0; count < queue->count && count < SXP_IOV_MAX; count++) {
+            struct netio_frame *frame =
+                queue->frames[(queue->head + count) % queue->capacity];
+            /*large frames are sent on their own, so only they are pinned*/
+            if (count && (zerocopy || (connection->zerocopy &&
+                                       frame->size >= netio_zerocopy_min)))
+                break;
+            buffers[count].data = frame->data;
+            buffers[count].size = frame->size;
+            batch_size += frame->size;
+        }
+        buffers[0].data += queue->offset;
+        buffers[0].size -= queue->offset;
+        batch_size -= queue->offset;
+
+        if (zerocopy) {
+            if (send_queue_pin_reserve(queue) != NET_SUCCESS)
+                return NET_ERROR;
+            result = sxp_send_zerocopy(&(connection->socket), buffers[0].data,
+                                       &num_sent, buffers[0].size, &pinned);
+        } else if (count == 1) {
+            result = sxp_send(&(connection->socket), buffers[0].data,
+                              &num_sent, buffers[0].size);
+        } else {
+            result = sxp_sendv(&(connection->socket), buffers, count,
+                               &num_sent);
+        }
+        if (result == SXP_TRY_AGAIN)
+            return NET_TRY_AGAIN;
+        if (result != SXP_SUCCESS)
+            return NET_ERROR;
+        /*pinned before it is consumed, which may release it*/
+        if (pinned)
+            send_queue_pin(queue, first);
+        send_queue_consume(queue, num_sent);
+        connection->stats.bytes_out += num_sent;
+        connection->stats.frames_out += frames - queue->count;
+        if (queue->size <= netio_policies[connection->client_class].low)
+            connection->lingering = 0;
+        /*the socket buffer is full, wait for the next SXP_POLLOUT*/
+        if (num_sent < batch_size)
+            return NET_SUCCESS;
+    }
+    return interest_set(connection, SXP_POLLIN);
+}
+
+static netResult send_queue_push(struct netio_send_queue *queue,
+                                 struct netio_frame *frame)
+{
+    size_t before = queue->size + queue->reserved;
+
+    if (queue->count == queue->capacity) {
+        size_t capacity = queue->capacity ? queue->capacity * 2 : 8;
+        struct netio_frame **frames = malloc(capacity * sizeof(*frames));
+        size_t idx;
+        if (!frames)
+            return NET_ERROR;
+        for (idx = 0; idx < queue->count; idx++)
+            frames[idx] = queue->frames[(queue->head + idx) % queue->capacity];
+        free(queue->frames);
+        queue->frames = frames;
+        queue->capacity = capacity;
+        queue->head = 0;
+    }
+    queue->frames[(queue->head + queue->count) % queue->capacity] = frame;
+    queue->count++;
+    queue->size += frame->size;
+    send_queue_account(queue, before);
+    return NET_SUCCESS;
+}
+
+static void send_queue_consume(struct netio_send_queue *queue, size_t size)
+{
+    size_t before = queue->size + queue->reserved;
+
+    queue->size -= size;
+    send_queue_account(queue, before);
+    while (size) {
+        struct netio_frame *frame = queue->frames[queue->head];
+        size_t remaining = frame->size - queue->offset;
+        if (size < remaining) {
+            queue->offset += size;
+            return;
+        }
+        size -= remaining;
+        netio_frame_release(frame);
+        queue->offset = 0;
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+}
+
+/*drops the queued frames with any of flags which have not been started*/
+static void send_queue_drop(struct netio_send_queue *queue, int flags)
+{
+    size_t before = queue->size + queue->reserved;
+    size_t kept = 0;
+    size_t idx;
+
+    for (idx = 0; idx < queue->count; idx++) {
+        struct netio_frame *frame =
+            queue->frames[(queue->head + idx) % queue->capacity];
+        if (!(frame->flags & flags) || (!idx && queue->offset)) {
+            queue->frames[(queue->head + kept++) % queue->capacity] = frame;
+            continue;
+        }
+        queue->size -= frame->size;
+        netio_frame_release(frame);
+    }
+    queue->count = kept;
+    send_queue_account(queue, before);
+}
+
+static void send_queue_free(struct netio_send_queue *queue)
+{
+    size_t before = queue->size + queue->reserved;
+    size_t idx;
+
+    while (queue->count) {
+        netio_frame_release(queue->frames[queue->head]);
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+    /*the socket is closed, the kernel holds its own references to the pages*/
+    for (idx = 0; idx < queue->pinned_count; idx++)
+        netio_frame_release(queue->pinned[idx].frame);
+    free(queue->pinned);
+    free(queue->frames);
+    memset(queue, 0, sizeof(*queue));
+    send_queue_account(queue, before);
+}
+
+/*updates the totals of all queues once queue held before bytes*/
+static void send_queue_account(struct netio_send_queue *queue, size_t before)
+{
+    size_t after = queue->size + queue->reserved;
+
+    if (after > before)
+        __atomic_add_fetch(&netio_outbound, after - before, __ATOMIC_RELAXED);
+    else if (after < before)
+        __atomic_sub_fetch(&netio_outbound, before - after, __ATOMIC_RELAXED);
+    if (!before && after)
+        __atomic_add_fetch(&netio_outbound_queues, 1, __ATOMIC_RELAXED);
+    else if (before && !after)
+        __atomic_sub_fetch(&netio_outbound_queues, 1, __ATOMIC_RELAXED);
+}
+
+/*makes room for the next frame pinned by send_queue_pin*/
+static netResult send_queue_pin_reserve(struct netio_send_queue *queue)
+{
+    struct netio_pinned *pinned;
+    size_t capacity;
+
+    if (queue->pinned_count < queue->pinned_capacity)
+        return NET_SUCCESS;
+    capacity = queue->pinned_capacity ? queue->pinned_capacity * 2 : 8;
+    if (!(pinned = realloc(queue->pinned, capacity * sizeof(*pinned))))
+        return NET_ERROR;
+    queue->pinned = pinned;
+    queue->pinned_capacity = capacity;
+    return NET_SUCCESS;
+}
+
+/*keeps frame alive until the kernel reports the zero copy send just made*/
+static void send_queue_pin(struct netio_send_queue *queue,
+                           struct netio_frame *frame)
+{
+    __atomic_add_fetch(&frame->references, 1, __ATOMIC_RELAXED);
+    queue->pinned[queue->pinned_count].sequence = queue->pinned_next;
+    queue->pinned[queue->pinned_count].frame = frame;
+    queue->pinned_count++;
+    queue->pinned_next = (queue->pinned_next + 1) & 0xffffffffUL;
+    __atomic_add_fetch(&netio_zerocopy_sends, 1, __ATOMIC_RELAXED);
+}
+
+/*returns whether zero copy is in use for the accepted socket*/
+static int zerocopy_enable(sxp_t *socket)
+{
+    return netio_zerocopy_min && sxp_zerocopy_set(socket, 1) == SXP_SUCCESS;
+}
+
+/*
+releases the pinned frames of the completed zero copy sends. Without any
+completion SXP_POLLERR was a socket error, so NET_ERROR is returned and the
+connection has to be closed. Completions of sends the previous server of a
+taken over client has made release nothing.
+*/
+static netResult zerocopy_complete(struct netio_connection_info *connection)
+{
+    struct netio_send_queue *queue = &(connection->send_queue);
+    unsigned long first;
+    unsigned long last;
+    int copied;
+    int completed = 0;
+    size_t kept;
+    size_t idx;
+    sxpResult result;
+
+    while ((result = sxp_zerocopy_completed(&(connection->socket), &first,
+                                            &last, &copied)) == SXP_SUCCESS) {
+        unsigned long range = (last - first) & 0xffffffffUL;
+        completed = 1;
+        /*the kernel could not avoid the copy (e.g. loopback), stop pinning*/
+        if (copied) {
+            connection->zerocopy = 0;
+            __atomic_add_fetch(&netio_zerocopy_copied, range + 1,
+                               __ATOMIC_RELAXED);
+        }
+        kept = 0;
+        for (idx = 0; idx < queue->pinned_count; idx++) {
+            struct netio_pinned *pinned = &(queue->pinned[idx]);
+            if (((pinned->sequence - first) & 0xffffffffUL) <= range)
+                netio_frame_release(pinned->frame);
+            else
+                queue->pinned[kept++] = *pinned;
+        }
+        queue->pinned_count = kept;
+    }
+    if (result != SXP_TRY_AGAIN || !completed)
+        return NET_ERROR;
+    return NET_SUCCESS;
+}
+
+/*
+queues frame on a client of a server according to the policy of its class,
+frames dropped instead are not an error. NET_ERROR means that the client has
+to be closed. Once the grace period has started, the client is closed when
+its timer expires after the deadline, or by worker_linger on an io thread.
+*/
+static netResult flow_send(struct netio_connection_info *connection,
+                           struct netio_frame *frame)
+{
+    struct netio_send_queue *queue = &(connection->send_queue);
+    const struct net_policy *policy = &netio_policies[connection->client_class];
+    int control = frame->flags & NETIO_FRAME_CONTROL;
+
+    if (connection->flow != NETIO_FLOWING && !control) {
+        flow_miss(connection, frame);
+        return NET_SUCCESS;
+    }
+
+    if (!control && flow_exceeded(connection, policy, frame->size)) {
+        switch (policy->policy) {
+        case NET_POLICY_DISCONNECT:
+            if (flow_overdrawn(connection, frame->size))
+                return NET_ERROR;
+            if (!connection->lingering) {
+                connection->lingering = 1;
+                connection->deadline = sxp_clock() + policy->grace;
+                /*a handshake ends with timer_start, which arms it then*/
+                if (!connection->worker && !connection->handshaking)
+                    timer_arm(connection->connection);
+            } else if ((long)(sxp_clock() - connection->deadline) >= 0) {
+                return NET_ERROR;
+            }
+            break;
+        case NET_POLICY_BACKFILL:
+            send_queue_drop(queue, NETIO_FRAME_BACKFILL);
+            if (!flow_exceeded(connection, policy, frame->size))
+                break;
+            /*history is not worth pausing for*/
+            if (frame->flags & NETIO_FRAME_BACKFILL)
+                return NET_SUCCESS;
+            /*fall through*/
+        case NET_POLICY_PAUSE:
+        default:
+            connection->flow = NETIO_PAUSED;
+            connection->missed = NETIO_TAG_NONE;
+            flow_miss(connection, frame);
+            return NET_SUCCESS;
+        }
+    }
+
+    /*only reached by frames the policy lets through*/
+    if (queue->size + frame->size > NETIO_BUFFER_MAX_SIZE)
+        return NET_ERROR;
+    if (send_queue_push(queue, frame) != NET_SUCCESS)
+        return NET_ERROR;
+    __atomic_add_fetch(&frame->references, 1, __ATOMIC_RELAXED);
+    return interest_set(connection, SXP_POLLIN | SXP_POLLOUT);
+}
+
+/*
+queues the frame with the missed frames and lets the client flow again, or
+keeps it paused until it has drained them if it missed more than that
+*/
+static netResult flow_resume(struct netio_connection_info *connection,
+                             struct netio_frame *frame, long missed)
+{
+    struct netio_send_queue *queue = &(connection->send_queue);
+    size_t before = queue->size + queue->reserved;
+
+    if (connection->flow != NETIO_RESUMING)
+        return NET_SUCCESS;
+    queue->reserved = 0;
+    send_queue_account(queue, before);
+    /*an empty frame would never be consumed and block the queue*/
+    if (!frame->size) {
+        connection->flow = NETIO_FLOWING;
+        return NET_SUCCESS;
+    }
+    connection->flow = missed == NETIO_TAG_NONE ? NETIO_FLOWING : NETIO_PAUSED;
+    connection->missed = missed;
+    if (queue->size + frame->size > NETIO_BUFFER_MAX_SIZE)
+        return NET_ERROR;
+    if (send_queue_push(queue, frame) != NET_SUCCESS)
+        return NET_ERROR;
+    __atomic_add_fetch(&frame->references, 1, __ATOMIC_RELAXED);
+    return interest_set(connection, SXP_POLLIN | SXP_POLLOUT);
+}
+
+/*
+returns 1 once if a paused client has drained to its low watermark. The
+missed frames have to fit into budget to keep below the high watermark and
+the limit of all queues, or an equal share of it once that is reached. The
+budget is reserved until netio_resume.
+*/
+static int flow_drained(struct netio_connection_info *connection,
+                        size_t *budget)
+{
+    struct netio_send_queue *queue = &(connection->send_queue);
+    size_t before = queue->size + queue->reserved;
+    size_t outbound = __atomic_load_n(&netio_outbound, __ATOMIC_RELAXED);
+    size_t queues = __atomic_load_n(&netio_outbound_queues, __ATOMIC_RELAXED);
+    size_t room;
+    size_t share;
+
+    if (connection->flow != NETIO_PAUSED ||
+        queue->size > netio_policies[connection->client_class].low)
+        return 0;
+    connection->flow = NETIO_RESUMING;
+    /*counting this client*/
+    share = netio_outbound_max / (queue->size ? queues : queues + 1);
+    room = outbound < netio_outbound_max ? netio_outbound_max - outbound : 0;
+    if (share > queue->size && share - queue->size > room)
+        room = share - queue->size;
+    *budget = netio_policies[connection->client_class].high - queue->size;
+    if (room < *budget)
+        *budget = room;
+    queue->reserved = *budget;
+    send_queue_account(queue, before);
+    return 1;
+}
+
+/*
+a single frame is always accepted by an empty queue, so that clients which
+keep up are served even while the limit of all queues is reached
+*/
+static int flow_exceeded(struct netio_connection_info *connection,
+                         const struct net_policy *policy, size_t size)
+{
+    size_t queued = connection->send_queue.size;
+    if (!queued)
+        return 0;
+    return queued + size > policy->high || flow_overdrawn(connection, size);
+}
+
+/*
+once the limit of all queues is reached, only the queues holding more than
+an equal share of it are held back, so that a few stalled clients can not
+take the limit away from all others
+*/
+static int flow_overdrawn(struct netio_connection_info *connection,
+                          size_t size)
+{
+    size_t held = connection->send_queue.size + connection->send_queue.reserved;
+    size_t queues;
+
+    if (__atomic_load_n(&netio_outbound, __ATOMIC_RELAXED) + size <=
+        netio_outbound_max)
+        return 0;
+    queues = __atomic_load_n(&netio_outbound_queues, __ATOMIC_RELAXED);
+    return held + size > netio_outbound_max / (queues ? queues : 1);
+}
+
+static void flow_miss(struct netio_connection_info *connection,
+                      struct netio_frame *frame)
+{
+    if (!(frame->flags & NETIO_FRAME_BACKFILL) &&
+        frame->tag < connection->missed)
+        connection->missed = frame->tag;
+}
+
+static netResult resumed_push(connection_t who, long tag, size_t budget)
+{
+    if (netio_resumed_count == netio_resumed_capacity) {
+        size_t capacity =
+            netio_resumed_capacity ? netio_resumed_capacity * 2 : 16;
+        struct netio_message *resumed =
+            realloc(netio_resumed_list, capacity * sizeof(*resumed));
+        if (!resumed)
+            return NET_ERROR;
+        netio_resumed_list = resumed;
+        netio_resumed_capacity = capacity;
+    }
+    memset(&netio_resumed_list[netio_resumed_count], 0,
+           sizeof(*netio_resumed_list));
+    netio_resumed_list[netio_resumed_count].type = NETIO_MESSAGE_RESUMED;
+    netio_resumed_list[netio_resumed_count].connection = who;
+    netio_resumed_list[netio_resumed_count].tag = tag;
+    netio_resumed_list[netio_resumed_count].budget = budget;
+    netio_resumed_count++;
+    return NET_SUCCESS;
+}
+
+/*
+stops accepting clients and ticks until every connection is drained or the
+deadline has passed. A connection whose send queue is empty is shut down for
+writing and closed once the peer has closed its end as well, so that it is
+not reset while the peer may still be reading. A connection sharing rings is
+closed once the peer has released every frame in them. What arrives in the
+meantime is discarded.
+*/
+static void drain()
+{
+    struct netio_message message;
+    connection_t slot;
+    unsigned int idx;
+
+    if (!netio_connection_count)
+        return;
+    netio_draining = 1;
+    netio_drain_deadline = sxp_clock() + NETIO_DRAIN_TIMEOUT;
+    for (slot = 0; slot < netio_connection_count; slot++) {
+        if (netio_connections[slot].connection != NETIO_NONE &&
+            netio_connections[slot].listening)
+            netio_connection_close(netio_connections[slot].connection);
+    }
+    for (idx = 0; idx < netio_worker_count; idx++) {
+        memset(&message, 0, sizeof(message));
+        message.type = NETIO_MESSAGE_DRAIN;
+        if (worker_command(idx + 1, &message) == NET_SUCCESS)
+            netio_workers_draining++;
+    }
+
+    for (;;) {
+        size_t open = 0;
+        drain_discard();
+        for (slot = 0; slot < netio_connection_count; slot++) {
+            struct netio_connection_info *connection =
+                &netio_connections[slot];
+            if (connection->connection == NETIO_NONE || connection->worker)
+                continue;
+            if (drain_step(connection))
+                netio_connection_close(connection->connection);
+            else
+                open++;
+        }
+        if ((!open && !netio_workers_draining) ||
+            (long)(sxp_clock() - netio_drain_deadline) >= 0)
+            break;
+        if (netio_tick() != NET_SUCCESS)
+            break;
+    }
+    netio_draining = 0;
+    netio_workers_draining = 0;
+}
+
+/*drops the received packets nobody is going to ask for anymore*/
+static void drain_discard()
+{
+    netio_inbox_next = netio_inbox_count;
+    while (netio_pending_head != NETIO_NONE) {
+        struct netio_connection_info *connection =
+            &netio_connections[NET_ID_SLOT(netio_pending_head)];
+        if (connection->shm)
+            connection->shm->read =
+                __atomic_load_n(&connection->shm->in->tail, __ATOMIC_ACQUIRE);
+        else
+            connection->recv_buffer.head = connection->recv_buffer.tail;
+        pending_remove(netio_pending_head);
+    }
+}
+
+/*returns nonzero once connection can be closed without losing anything*/
+static int drain_step(struct netio_connection_info *connection)
+{
+    struct netio_shm *shm = connection->shm;
+
+    if (connection->connecting || connection->attaching)
+        return 1;
+    if (connection->send_queue.count)
+        return 0;
+    if (shm)
+        return __atomic_load_n(&shm->out->head, __ATOMIC_ACQUIRE) ==
+               shm->written;
+    if (!connection->shut) {
+        connection->shut = 1;
+        if (sxp_shutdown(&(connection->socket)) != SXP_SUCCESS)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+samples the transport of up to NETIO_SAMPLE_BUDGET connections of this
+thread every NETIO_SAMPLE_INTERVAL, continuing where the last round stopped.
+Only these samples make system calls, data passing a connection is merely
+counted.
+*/
+static void samples_take()
+{
+    size_t sampled = 0;
+    connection_t visited;
+
+    if ((long)(netio_now - netio_sample_due) < 0)
+        return;
+    netio_sample_due = netio_now + NETIO_SAMPLE_INTERVAL;
+    for (visited = 0;
+         visited < netio_connection_count && sampled < NETIO_SAMPLE_BUDGET;
+         visited++) {
+        struct netio_connection_info *connection;
+        if (netio_sample_next >= netio_connection_count)
+            netio_sample_next = 0;
+        connection = &netio_connections[netio_sample_next++];
+        if (connection->connection == NETIO_NONE || connection->worker ||
+            connection->listening || connection->connecting)
+            continue;
+        stats_sample(connection);
+        sampled++;
+    }
+}
+
+static void stats_sample(struct netio_connection_info *connection)
+{
+    struct net_connection_stats *stats = &(connection->stats);
+    sxp_transport_t transport;
+
+    stats->queued = connection->send_queue.size;
+    if (sxp_transport_get(&(connection->socket), &transport) != SXP_SUCCESS)
+        return;
+    stats->sampled = 1;
+    stats->socket_queued = transport.queued;
+    stats->rtt = transport.rtt;
+    stats->rtt_var = transport.rtt_var;
+    stats->retransmits = transport.retransmits;
+    stats->cwnd = transport.cwnd;
+}
+
+/*
+serializes the slots for handoff_adopt after two words netio_handoff fills
+in and collects the file descriptors they refer to
+*/
+static netResult handoff_export(net_buffer_t *body, int *fds,
+                                size_t *fd_count)
+{
+    net_buffer_t *received;
+    connection_t slot;
+    size_t idx;
+    netResult result = NET_SUCCESS;
+
+    if (!(received = calloc(netio_connection_count + 1, sizeof(*received))))
+        return NET_ERROR;
+    /*what the io threads have passed on was received before their rest*/
+    for (idx = netio_inbox_next; idx < netio_inbox_count; idx++) {
+        struct netio_message *message = &netio_inbox[idx];
+        net_buffer_t packet = message->packet;
+        if (!netio_connection_active(message->connection))
+            continue;
+        packet.size = packet.capacity;
+        if (packet_send_packet(&received[NET_ID_SLOT(message->connection)],
+                               &packet) != PACKET_SUCCESS) {
+            result = NET_ERROR;
+            break;
+        }
+    }
+    if (result == NET_SUCCESS &&
+        (packet_send_u32(body, 0) != PACKET_SUCCESS ||
+         packet_send_u32(body, 0) != PACKET_SUCCESS ||
+         packet_send_u32(body, netio_connection_count) != PACKET_SUCCESS))
+        result = NET_ERROR;
+    for (slot = 0; slot < netio_connection_count && result == NET_SUCCESS;
+         slot++)
+        result = handoff_slot(body, slot, &received[slot], fds, fd_count);
+
+    for (slot = 0; slot < netio_connection_count; slot++)
+        packet_free(&received[slot]);
+    free(received);
+    return result;
+}
+
+/*
+a free slot is passed with the generation of its next occupant, a listener
+with its socket and a client with its socket, its rings, what has been
+received from it but not parsed and what is still queued for it
+*/
+static netResult handoff_slot(net_buffer_t *body, connection_t slot,
+                              net_buffer_t *received, int *fds,
+                              size_t *fd_count)
+{
+    struct netio_connection_info *connection = &netio_connections[slot];
+    struct netio_connection_info *owner = connection;
+    struct netio_recv_buffer *recv;
+    struct netio_send_queue *queue;
+    net_buffer_t unsent = { 0 };
+    unsigned long generation = connection->generation;
+    parseResult parsed;
+    size_t idx;
+
+    if (connection->connection != NETIO_NONE && connection->worker) {
+        struct netio_worker *worker = netio_workers[connection->worker - 1];
+        owner = slot < worker->connection_count ? worker->connections[slot] :
+                                                  NULL;
+        /*its io thread could not adopt it, it is closed already*/
+        if (!owner)
+            generation = NET_ID_GENERATION(connection->connection) + 1;
+    }
+    if (connection->connection == NETIO_NONE || !owner) {
+        parsed = packet_send_u32(body, NETIO_HANDOFF_FREE);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_u32(body, generation);
+        return parsed == PACKET_SUCCESS ? NET_SUCCESS : NET_ERROR;
+    }
+
+    if (connection->listening) {
+        fds[(*fd_count)++] = (int)connection->socket;
+        parsed = packet_send_u32(body, NETIO_HANDOFF_LISTENER);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_u32(body, connection->connection);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_u32(body, connection->rings);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_u32(body, connection->handoff);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_send_str(body,
+                                     connection->path ? connection->path : "");
+        return parsed == PACKET_SUCCESS ? NET_SUCCESS : NET_ERROR;
+    }
+
+    recv = &(owner->recv_buffer);
+    if (receive_stop(owner) != NET_SUCCESS)
+        return NET_ERROR;
+    if (bytes_append(received, recv->buffer + recv->head,
+                     recv->tail - recv->head) != NET_SUCCESS)
+        return NET_ERROR;
+    queue = &(owner->send_queue);
+    for (idx = 0; idx < queue->count; idx++) {
+        struct netio_frame *frame =
+            queue->frames[(queue->head + idx) % queue->capacity];
+        size_t offset = idx ? 0 : queue->offset;
+        if (bytes_append(&unsent, frame->data + offset,
+                         frame->size - offset) != NET_SUCCESS) {
+            packet_free(&unsent);
+            return NET_ERROR;
+        }
+    }
+    fds[(*fd_count)++] = (int)owner->socket;
+    if (connection->shm)
+        fds[(*fd_count)++] = connection->shm->region.fd;
+
+    parsed = packet_send_u32(body, NETIO_HANDOFF_CLIENT);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(body, connection->connection);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(body, connection->client_class);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(body, owner->flow);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_i32(
+            body, owner->missed == NETIO_TAG_NONE ? -1 : owner->missed);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(body, connection->handshaking);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(body, connection->attaching);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(body, connection->shm != NULL);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_u32(body, owner->send_queue.pinned_next);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_packet(body, received);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_send_packet(body, &unsent);
+    packet_free(&unsent);
+    return parsed == PACKET_SUCCESS ? NET_SUCCESS : NET_ERROR;
+}
+
+/*
+restores a slot serialized by handoff_slot, consuming the file descriptors
+it refers to from fds. A client which can not be restored is closed.
+*/
+static netResult handoff_adopt(net_buffer_t *body, connection_t slot,
+                               const int *fds, size_t fd_count,
+                               size_t *fd_next)
+{
+    struct netio_connection_info *connection = &netio_connections[slot];
+    struct netio_message adopt;
+    net_buffer_t unsent = { 0 };
+    unsigned long kind;
+    unsigned long id;
+    unsigned long values[7];
+    char *path = NULL;
+    unsigned int worker = 0;
+    int taken = 0;
+    int rings = -1;
+    size_t budget;
+    size_t idx;
+    parseResult parsed;
+
+    memset(&adopt, 0, sizeof(adopt));
+    adopt.type = NETIO_MESSAGE_ADOPT;
+    if ((parsed = packet_recv_u32(body, &kind)) == PACKET_SUCCESS)
+        parsed = packet_recv_u32(body, &id);
+    if (parsed != PACKET_SUCCESS)
+        return NET_ERROR;
+
+    if (kind == NETIO_HANDOFF_FREE) {
+        /*id is the generation of the next occupant*/
+        connection->generation = id;
+        if (netio_free_tail != NETIO_NONE)
+            netio_connections[netio_free_tail].free_next = slot;
+        else
+            netio_free_head = slot;
+        netio_free_tail = slot;
+        return NET_SUCCESS;
+    }
+
+    if (kind == NETIO_HANDOFF_LISTENER) {
+        for (idx = 0; idx < 2 && parsed == PACKET_SUCCESS; idx++)
+            parsed = packet_recv_u32(body, &values[idx]);
+        if (parsed == PACKET_SUCCESS)
+            parsed = packet_recv_str(body, &path);
+        if (parsed != PACKET_SUCCESS || NET_ID_SLOT(id) != slot ||
+            *fd_next >= fd_count) {
+            free(path);
+            return NET_ERROR;
+        }
+        adopt.socket = (sxp_t)fds[(*fd_next)++];
+        connection->generation = NET_ID_GENERATION(id);
+        if (slot_occupy(slot, 0, &adopt) != NET_SUCCESS) {
+            sxp_destroy(&adopt.socket);
+            free(path);
+            return NET_ERROR;
+        }
+        connection->listening = 1;
+        connection->rings = values[0] != 0;
+        connection->handoff = values[1] != 0;
+        /*the socket file is removed again once the listener is closed*/
+        connection->path = path;
+        if (!*path) {
+            free(path);
+            connection->path = NULL;
+        }
+        return NET_SUCCESS;
+    }
+
+    if (kind != NETIO_HANDOFF_CLIENT)
+        return NET_ERROR;
+    /*class, flow, missed, handshaking, attaching, rings, sequence*/
+    for (idx = 0; idx < 7 && parsed == PACKET_SUCCESS; idx++)
+        parsed = packet_recv_u32(body, &values[idx]);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_recv_packet(body, &adopt.packet);
+    if (parsed == PACKET_SUCCESS)
+        parsed = packet_recv_packet(body, &unsent);
+    if (parsed != PACKET_SUCCESS || NET_ID_SLOT(id) != slot ||
+        values[0] >= NET_CLASS_COUNT ||
+        *fd_next + 1 + (values[5] != 0) > fd_count)
+        goto fail;
+
+    adopt.socket = (sxp_t)fds[(*fd_next)++];
+    taken = 1;
+    if (values[5])
+        rings = fds[(*fd_next)++];
+    adopt.zerocopy = zerocopy_enable(&adopt.socket);
+    adopt.client_class = values[0];
+    adopt.flow = values[1];
+    /*NETIO_TAG_NONE was passed as -1*/
+    adopt.tag = values[2] == 0xffffffffUL ? NETIO_TAG_NONE : (long)values[2];
+    adopt.sequence = values[6];
+    if (frame_wrap(&adopt.frame, &unsent) != NET_SUCCESS)
+        goto fail;
+    packet_free(&unsent);
+
+    /*rings are serviced by this thread*/
+    if (netio_worker_count && !values[4] && !values[5]) {
+        netio_worker_next = netio_worker_next % netio_worker_count + 1;
+        worker = netio_worker_next;
+    }
+    connection->generation = NET_ID_GENERATION(id);
+    if (slot_occupy(slot, worker, &adopt) != NET_SUCCESS)
+        goto fail;
+    /*the connection has been handed to the io thread with what adopt holds*/
+    connection->admitted = 1;
+    netio_clients++;
+    connection->client_class = values[0];
+    timer_start(connection->connection, values[3] != 0);
+    if (worker)
+        return NET_SUCCESS;
+
+    connection->attaching = values[4] != 0;
+    if (rings >= 0) {
+        int fd = rings;
+        rings = -1;
+        if (ring_map(connection, fd) != NET_SUCCESS)
+            goto close;
+    } else if (!connection->attaching &&
+               receive_start(connection) != NET_SUCCESS) {
+        goto close;
+    }
+    if (connection_restore(connection, &adopt) != NET_SUCCESS)
+        goto close;
+    if (connection->recv_buffer.tail)
+        pending_push(connection->connection);
+    if (flow_drained(connection, &budget) &&
+        resumed_push(connection->connection, connection->missed, budget) !=
+            NET_SUCCESS)
+        goto close;
+    free(adopt.packet.buffer);
+    return NET_SUCCESS;
+close:
+    free(adopt.packet.buffer);
+    netio_frame_release(adopt.frame);
+    netio_connection_close(connection->connection);
+    return NET_SUCCESS;
+fail:
+    if (taken)
+        sxp_destroy(&adopt.socket);
+    if (rings >= 0) {
+        sxp_t unused = (sxp_t)rings;
+        sxp_destroy(&unused);
+    }
+    free(adopt.packet.buffer);
+    netio_frame_release(adopt.frame);
+    packet_free(&unsent);
+    return NET_ERROR;
+}
+
+/*reads exactly size bytes from the nonblocking socket*/
+static netResult handoff_read(sxp_t *socket, char *data, size_t size)
+{
+    size_t num_read;
+    sxpResult result;
+
+    while (size) {
+        result = sxp_recv(socket, data, &num_read, size);
+        if (result == SXP_TRY_AGAIN &&
+            handoff_wait(socket, SXP_POLLIN) == NET_SUCCESS)
+            continue;
+        if (result != SXP_SUCCESS || !num_read)
+            return NET_ERROR;
+        data += num_read;
+        size -= num_read;
+    }
+    return NET_SUCCESS;
+}
+
+static netResult handoff_write(sxp_t *socket, const char *data, size_t size)
+{
+    size_t num_sent;
+    sxpResult result;
+
+    while (size) {
+        result = sxp_send(socket, data, &num_sent, size);
+        if (result == SXP_TRY_AGAIN &&
+            handoff_wait(socket, SXP_POLLOUT) == NET_SUCCESS)
+            continue;
+        if (result != SXP_SUCCESS)
+            return NET_ERROR;
+        data += num_sent;
+        size -= num_sent;
+    }
+    return NET_SUCCESS;
+}
+
+/*the other side is given up on after NETIO_HANDOFF_TIMEOUT*/
+static netResult handoff_wait(sxp_t *socket, int events)
+{
+    pollsxp_t polled;
+
+    memset(&polled, 0, sizeof(polled));
+    polled.fd = *socket;
+    polled.events = events;
+    if (sxp_poll(NULL, &polled, 1, NETIO_HANDOFF_TIMEOUT) != SXP_SUCCESS)
+        return NET_ERROR;
+    return NET_SUCCESS;
+}
+
+/*appends the bytes as they are, unlike packet_send_packet*/
+static netResult bytes_append(net_buffer_t *buffer, const char *data,
+                              size_t size)
+{
+    size_t capacity = buffer->capacity;
+
+    if (!size)
+        return NET_SUCCESS;
+    if (buffer->size + size > capacity) {
+        capacity = capacity * 2 > buffer->size + size ? capacity * 2 :
+                                                        buffer->size + size;
+        if (packet_realloc(buffer, capacity) != PACKET_SUCCESS)
+            return NET_ERROR;
+    }
+    memcpy(buffer->buffer + buffer->size, data, size);
+    buffer->size += size;
+    return NET_SUCCESS;
+}
+
+/*
+makes a frame of bytes which are framed already, it is a control frame so
+that it is never dropped. Without bytes frame is set to NULL.
+*/
+static netResult frame_wrap(netio_frame_t **frame, const net_buffer_t *bytes)
+{
+    *frame = NULL;
+    if (!bytes->capacity)
+        return NET_SUCCESS;
+    if (!(*frame = malloc(sizeof(**frame) + bytes->capacity)))
+        return NET_ERROR;
+    (*frame)->references = 1;
+    (*frame)->flags = NETIO_FRAME_CONTROL;
+    (*frame)->tag = NETIO_TAG_NONE;
+    (*frame)->data = (char *)(*frame + 1);
+    (*frame)->size = bytes->capacity;
+    memcpy((*frame)->data, bytes->buffer, bytes->capacity);
+    return NET_SUCCESS;
+}
+
+/*creates the rings of a client once it is connected and passes them on*/
+static netResult ring_create(struct netio_connection_info *connection)
+{
+    struct netio_shm *shm;
+    struct netio_ring_header *header;
+
+    if (!(shm = calloc(1, sizeof(*shm))))
+        return NET_ERROR;
+    if (shmxp_create(&shm->region, NETIO_RING_SIZE) != SHMXP_SUCCESS) {
+        free(shm);
+        return NET_ERROR;
+    }
+    header = shm->region.header;
+    header->magic = NETIO_RING_MAGIC;
+    header->size = NETIO_RING_SIZE;
+    /*the socket has just been connected, so the byte always fits*/
+    if (sxp_send_fd(&(connection->socket), shm->region.fd) != SXP_SUCCESS ||
+        ring_setup(connection, shm, NETIO_RING_DOWN) != NET_SUCCESS) {
+        (void)shmxp_destroy(&shm->region);
+        free(shm);
+        return NET_ERROR;
+    }
+    return NET_SUCCESS;
+}
+
+/*maps the rings sent by an accepted client*/
+static netResult ring_attach(struct netio_connection_info *connection)
+{
+    sxpResult result;
+    int fd;
+
+    result = sxp_recv_fd(&(connection->socket), &fd);
+    if (result == SXP_TRY_AGAIN)
+        return NET_SUCCESS;
+    if (result != SXP_SUCCESS || fd < 0 ||
+        ring_map(connection, fd) != NET_SUCCESS)
+        return NET_ERROR;
+    connection->attaching = 0;
+    return NET_SUCCESS;
+}
+
+/*maps the rings of a client created in fd, which is taken over*/
+static netResult ring_map(struct netio_connection_info *connection, int fd)
+{
+    struct netio_shm *shm;
+    struct netio_ring_header *header;
+
+    if (!(shm = calloc(1, sizeof(*shm)))) {
+        sxp_t unused = (sxp_t)fd;
+        sxp_destroy(&unused);
+        return NET_ERROR;
+    }
+    if (shmxp_attach(&shm->region, fd) != SHMXP_SUCCESS) {
+        free(shm);
+        return NET_ERROR;
+    }
+    header = shm->region.header;
+    if (header->magic != NETIO_RING_MAGIC ||
+        header->size != NETIO_RING_SIZE ||
+        shm->region.size != NETIO_RING_SIZE ||
+        ring_setup(connection, shm, NETIO_RING_UP) != NET_SUCCESS) {
+        (void)shmxp_destroy(&shm->region);
+        free(shm);
+        return NET_ERROR;
+    }
+    return NET_SUCCESS;
+}
+
+static netResult ring_setup(struct netio_connection_info *connection,
+                            struct netio_shm *shm, int in)
+{
+    struct netio_ring_header *header = shm->region.header;
+
+    if (netio_ring_count == netio_ring_capacity) {
+        size_t capacity = netio_ring_capacity ? netio_ring_capacity * 2 : 8;
+        connection_t *rings =
+            realloc(netio_rings, capacity * sizeof(*netio_rings));
+        if (!rings)
+            return NET_ERROR;
+        netio_rings = rings;
+        netio_ring_capacity = capacity;
+    }
+    netio_rings[netio_ring_count++] = connection->connection;
+
+    shm->in = &header->rings[in];
+    shm->out = &header->rings[!in];
+    shm->in_data = shm->region.rings[in];
+    shm->out_data = shm->region.rings[!in];
+    shm->read = __atomic_load_n(&shm->in->head, __ATOMIC_ACQUIRE);
+    shm->written = __atomic_load_n(&shm->out->tail, __ATOMIC_ACQUIRE);
+    connection->shm = shm;
+    return NET_SUCCESS;
+}
+
+static void ring_remove(connection_t who)
+{
+    size_t idx;
+    for (idx = 0; idx < netio_ring_count; idx++) {
+        if (netio_rings[idx] == who) {
+            netio_rings[idx] = netio_rings[--netio_ring_count];
+            return;
+        }
+    }
+}
+
+/*
+releases the frames returned by netio_recv, copies queued frames into the
+outgoing ring and marks the connection pending if frames have arrived. The
+other side is woken up if it waits for either, and this one is before the
+poller sleeps.
+*/
+static netResult ring_service(struct netio_connection_info *connection)
+{
+    struct netio_shm *shm = connection->shm;
+    struct netio_recv_buffer *copies = &(connection->recv_buffer);
+
+    copies->head = 0;
+    copies->tail = 0;
+    if (copies->capacity > NETIO_READ_MAX) {
+        free(copies->buffer);
+        memset(copies, 0, sizeof(*copies));
+    }
+    if (__atomic_load_n(&shm->in->head, __ATOMIC_RELAXED) != shm->read) {
+        __atomic_store_n(&shm->in->head, shm->read, __ATOMIC_SEQ_CST);
+        if (__atomic_exchange_n(&shm->in->blocked, 0, __ATOMIC_SEQ_CST) &&
+            ring_wake(connection) != NET_SUCCESS)
+            return NET_ERROR;
+    }
+    if ((connection->events & SXP_POLLOUT) &&
+        ring_push(connection) == NET_ERROR)
+        return NET_ERROR;
+
+    if (__atomic_load_n(&shm->in->tail, __ATOMIC_SEQ_CST) == shm->read) {
+        __atomic_store_n(&shm->in->waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&shm->in->tail, __ATOMIC_SEQ_CST) == shm->read)
+            return NET_SUCCESS;
+    }
+    pending_push(connection->connection);
+    return NET_SUCCESS;
+}
+
+/*
+copies the next frame out of the ring, the client can still write to it while
+the frame is parsed. The copies are kept behind each other in the receive
+buffer, which the connection has no other use for, until ring_service
+releases them. Once it is full the rest waits for the next tick.
+*/
+static parseResult ring_next(struct netio_connection_info *connection,
+                             net_buffer_t *packet)
+{
+    struct netio_shm *shm = connection->shm;
+    struct netio_recv_buffer *copies = &(connection->recv_buffer);
+    unsigned long size = shm->region.size;
+    unsigned long tail = __atomic_load_n(&shm->in->tail, __ATOMIC_ACQUIRE);
+    unsigned long length;
+    net_buffer_t view;
+    parseResult parsed;
+
+    if (tail - shm->read > size)
+        return PACKET_ERROR;
+    view.buffer = shm->in_data + shm->read % size;
+    view.size = 0;
+    view.capacity = tail - shm->read;
+
+    if ((parsed = packet_recv_u32(&view, &length)) != PACKET_SUCCESS)
+        return parsed;
+    /*a frame filling the whole ring can never be completed*/
+    if (length > size - 4)
+        return PACKET_ERROR;
+    if (length > view.capacity - 4)
+        return PACKET_NOT_READY;
+    if (length > copies->capacity - copies->tail) {
+        char *buffer;
+        size_t capacity = copies->capacity ? copies->capacity : NETIO_READ_MAX;
+
+        /*the frames copied before are still in use*/
+        if (copies->tail)
+            return PACKET_NOT_READY;
+        while (capacity < length)
+            capacity *= 2;
+        if (capacity != copies->capacity) {
+            if (!(buffer = realloc(copies->buffer, capacity)))
+                return PACKET_ERROR;
+            copies->buffer = buffer;
+            copies->capacity = capacity;
+        }
+    }
+    memcpy(copies->buffer + copies->tail, view.buffer + 4, length);
+    packet->buffer = copies->buffer + copies->tail;
+    packet->size = 0;
+    packet->capacity = length;
+    copies->tail += length;
+    copies->head = copies->tail;
+
+    shm->read += 4 + length;
+    connection->stats.bytes_in += 4 + length;
+    return PACKET_SUCCESS;
+}
+
+static netResult ring_push(struct netio_connection_info *connection)
+{
+    struct netio_send_queue *queue = &(connection->send_queue);
+    struct netio_shm *shm = connection->shm;
+    unsigned long size = shm->region.size;
+    unsigned long tail = shm->written;
+    unsigned long head = __atomic_load_n(&shm->out->head, __ATOMIC_ACQUIRE);
+    int full = 0;
+
+    /*the client moved head past the bytes written to the ring*/
+    if (tail - head > size)
+        return NET_ERROR;
+    while (queue->count) {
+        struct netio_frame *frame = queue->frames[queue->head];
+        size_t length = frame->size - queue->offset;
+        size_t frames = queue->count;
+
+        if (tail - head == size) {
+            /*woken up again once the client has released some frames*/
+            __atomic_store_n(&shm->out->blocked, 1, __ATOMIC_SEQ_CST);
+            head = __atomic_load_n(&shm->out->head, __ATOMIC_SEQ_CST);
+            if (tail - head > size)
+                return NET_ERROR;
+            if (tail - head == size) {
+                full = 1;
+                break;
+            }
+        }
+        if (length > size - (tail - head))
+            length = size - (tail - head);
+        /*the ring is mapped twice, so the copy may run over its end*/
+        memcpy(shm->out_data + tail % size, frame->data + queue->offset,
+               length);
+        tail += length;
+        send_queue_consume(queue, length);
+        connection->stats.bytes_out += length;
+        connection->stats.frames_out += frames - queue->count;
+    }
+    if (queue->size <= netio_policies[connection->client_class].low)
+        connection->lingering = 0;
+
+    if (shm->written != tail) {
+        shm->written = tail;
+        __atomic_store_n(&shm->out->tail, tail, __ATOMIC_SEQ_CST);
+        if (__atomic_exchange_n(&shm->out->waiting, 0, __ATOMIC_SEQ_CST) &&
+            ring_wake(connection) != NET_SUCCESS)
+            return NET_ERROR;
+    }
+    if (full)
+        return NET_SUCCESS;
+    return interest_set(connection, SXP_POLLIN);
+}
+
+/*drains the wakeups sent over the socket, which is closed if it is empty*/
+static netResult ring_doorbell(struct netio_connection_info *connection)
+{
+    char bytes[64];
+    size_t num_read;
+    sxpResult result;
+
+    while ((result = sxp_recv(&(connection->socket), bytes, &num_read,
+                              sizeof(bytes))) == SXP_SUCCESS) {
+        if (num_read == 0)
+            return NET_ERROR;
+        if (num_read < sizeof(bytes))
+            break;
+    }
+    if (result != SXP_SUCCESS && result != SXP_TRY_AGAIN)
+        return NET_ERROR;
+    return ring_service(connection);
+}
+
+/*a full socket already holds a wakeup the other side has not read yet*/
+static netResult ring_wake(struct netio_connection_info *connection)
+{
+    size_t num_sent;
+    sxpResult result = sxp_send(&(connection->socket), "", &num_sent, 1);
+    if (result == SXP_SUCCESS || result == SXP_TRY_AGAIN)
+        return NET_SUCCESS;
+    return NET_ERROR;
+}
+
+static void pending_push(connection_t who)
+{
+    struct netio_connection_info *connection =
+        &netio_connections[NET_ID_SLOT(who)];
+    if (connection->pending)
+        return;
+    connection->pending = 1;
+    connection->pending_prev = netio_pending_tail;
+    connection->pending_next = NETIO_NONE;
+    if (netio_pending_tail != NETIO_NONE)
+        netio_connections[NET_ID_SLOT(netio_pending_tail)].pending_next = who;
+    else
+        netio_pending_head = who;
+    netio_pending_tail = who;
+}
+
+static void pending_remove(connection_t who)
+{
+    struct netio_connection_info *connection =
+        &netio_connections[NET_ID_SLOT(who)];
+    if (!connection->pending)
+        return;
+    if (connection->pending_prev != NETIO_NONE)
+        netio_connections[NET_ID_SLOT(connection->pending_prev)]
+            .pending_next = connection->pending_next;
+    else
+        netio_pending_head = connection->pending_next;
+    if (connection->pending_next != NETIO_NONE)
+        netio_connections[NET_ID_SLOT(connection->pending_next)]
+            .pending_prev = connection->pending_prev;
+    else
+        netio_pending_tail = connection->pending_prev;
+    connection->pending = 0;
+}
+
+static netResult interest_set(struct netio_connection_info *connection,
+                              int events)
+{
+    events |= connection->events & SXP_POLLRECV;
+    if (connection->events == events)
+        return NET_SUCCESS;
+    /*registered once connected, rings are flushed by netio_tick instead*/
+    if (connection->connecting || connection->shm) {
+        connection->events = events;
+        return NET_SUCCESS;
+    }
+    if (sxp_poller_modify(connection->poller, &(connection->socket), events,
+                          NETIO_KEY(NET_ID_SLOT(connection->connection))) !=
+        SXP_SUCCESS)
+        return NET_ERROR;
+    connection->events = events;
+    return NET_SUCCESS;
+}
+
+/*
+lets the poller receive ahead for a client which is only read by pull_data,
+unlike listeners and the sockets of rings
+*/
+static netResult receive_start(struct netio_connection_info *connection)
+{
+    int events = connection->events | SXP_POLLRECV;
+
+    if (sxp_poller_modify(connection->poller, &(connection->socket), events,
+                          NETIO_KEY(NET_ID_SLOT(connection->connection))) !=
+        SXP_SUCCESS)
+        return NET_ERROR;
+    connection->events = events;
+    return NET_SUCCESS;
+}
+
+/*
+reads the socket only directly from now on and moves what the poller has
+received ahead into the receive buffer, so that it is handed off with it
+*/
+static netResult receive_stop(struct netio_connection_info *connection)
+{
+    struct netio_recv_buffer *recv = &(connection->recv_buffer);
+    int events = connection->events & ~SXP_POLLRECV;
+    size_t num_read;
+    sxpResult result;
+
+    if (events == connection->events)
+        return NET_SUCCESS;
+    if (sxp_poller_modify(connection->poller, &(connection->socket), events,
+                          NETIO_KEY(NET_ID_SLOT(connection->connection))) !=
+        SXP_SUCCESS)
+        return NET_ERROR;
+    connection->events = events;
+    /*the socket is read along, what the successor would have read anyway*/
+    do {
+        if (recv->tail == recv->capacity && recv_reserve(recv) != NET_SUCCESS)
+            return NET_ERROR;
+        result = sxp_poller_recv(
+            connection->poller, &(connection->socket),
+            NETIO_KEY(NET_ID_SLOT(connection->connection)),
+            recv->buffer + recv->tail, &num_read,
+            recv->capacity - recv->tail);
+        if (result == SXP_SUCCESS)
+            recv->tail += num_read;
+    } while (result == SXP_SUCCESS && num_read);
+    return NET_SUCCESS;
+}
+
+static netResult resolve_start(const char *hostname, const char *port)
+{
+    struct netio_resolve *resolve;
+    thxp_thread_t thread;
+    size_t hostname_size = strlen(hostname) + 1;
+    size_t port_size = strlen(port) + 1;
+
+    if (!(resolve = malloc(sizeof(*resolve) + hostname_size + port_size)))
+        return NET_ERROR;
+    resolve->state = NETIO_RESOLVE_RUNNING;
+    resolve->result = SXP_ERROR_UNKNOWN;
+    resolve->addresses = NULL;
+    resolve->hostname = (char *)(resolve + 1);
+    resolve->port = resolve->hostname + hostname_size;
+    memcpy(resolve->hostname, hostname, hostname_size);
+    memcpy(resolve->port, port, port_size);
+
+    if (sxp_pair(resolve->wake) != SXP_SUCCESS) {
+        free(resolve);
+        return NET_ERROR;
+    }
+    if (sxp_poller_add(netio_poller, &resolve->wake[0], SXP_POLLIN,
+                       NETIO_KEY_RESOLVE) != SXP_SUCCESS)
+        goto fail;
+    netio_resolve = resolve;
+    /*the result is picked up by netio_tick all the same*/
+    if (!sxp_vtable_get()->threads) {
+        resolve_run(resolve);
+        return NET_SUCCESS;
+    }
+    if (thxp_create(&thread, resolve_run, resolve) != THXP_SUCCESS) {
+        (void)sxp_poller_remove(netio_poller, &resolve->wake[0],
+                                NETIO_KEY_RESOLVE);
+        goto fail;
+    }
+    (void)thxp_detach(&thread);
+    return NET_SUCCESS;
+fail:
+    netio_resolve = NULL;
+    sxp_destroy(&resolve->wake[0]);
+    sxp_destroy(&resolve->wake[1]);
+    free(resolve);
+    return NET_ERROR;
+}
+
+static void resolve_run(void *argument)
+{
+    struct netio_resolve *resolve = argument;
+    addrinfo_t hints;
+    size_t num_sent;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    resolve->result = sxp_addrinfo_get(&resolve->addresses, resolve->hostname,
+                                       resolve->port, &hints);
+
+    /*
+    the socket stays readable, netio_tick picks the result up once state is
+    set. Once it is, the request may be freed at any time.
+    */
+    (void)sxp_send(&resolve->wake[1], "", &num_sent, 1);
+    if (__atomic_exchange_n(&resolve->state, NETIO_RESOLVE_DONE,
+                            __ATOMIC_ACQ_REL) == NETIO_RESOLVE_ABANDONED)
+        resolve_free(resolve);
+}
+
+static netResult resolve_finish()
+{
+    struct netio_resolve *resolve = netio_resolve;
+    netResult result = NET_ERROR;
+
+    netio_resolve = NULL;
+    (void)sxp_poller_remove(netio_poller, &resolve->wake[0],
+                            NETIO_KEY_RESOLVE);
+    if (resolve->result == SXP_SUCCESS &&
+        attempts_create(resolve->addresses) == NET_SUCCESS) {
+        resolved_store(resolve->hostname, resolve->port);
+        result = NET_SUCCESS;
+    }
+    resolve_free(resolve);
+    return result;
+}
+
+static void resolve_cancel()
+{
+    if (!netio_resolve)
+        return;
+    (void)sxp_poller_remove(netio_poller, &netio_resolve->wake[0],
+                            NETIO_KEY_RESOLVE);
+    if (__atomic_exchange_n(&netio_resolve->state, NETIO_RESOLVE_ABANDONED,
+                            __ATOMIC_ACQ_REL) == NETIO_RESOLVE_DONE)
+        resolve_free(netio_resolve);
+    netio_resolve = NULL;
+}
+
+static void resolve_free(struct netio_resolve *resolve)
+{
+    if (resolve->result == SXP_SUCCESS)
+        (void)sxp_addrinfo_free(resolve->addresses);
+    sxp_destroy(&resolve->wake[0]);
+    sxp_destroy(&resolve->wake[1]);
+    free(resolve);
+}
+
+static struct netio_resolved *resolved_find(const char *hostname,
+                                            const char *port)
+{
+    unsigned long now = sxp_clock();
+    size_t idx;
+
+    for (idx = 0; idx < NETIO_RESOLVE_CACHE; idx++) {
+        struct netio_resolved *resolved = &netio_resolved[idx];
+        if (!resolved->name)
+            continue;
+        if ((long)(now - resolved->expires) >= 0) {
+            resolved_free(resolved);
+            continue;
+        }
+        if (!strcmp(resolved->name, hostname) &&
+            !strcmp(resolved->name + strlen(resolved->name) + 1, port))
+            return resolved;
+    }
+    return NULL;
+}
+
+static void resolved_store(const char *hostname, const char *port)
+{
+    struct netio_resolved *resolved = &netio_resolved[0];
+    size_t hostname_size = strlen(hostname) + 1;
+    size_t port_size = strlen(port) + 1;
+    size_t idx;
+
+    /*replace the entry which expires first*/
+    for (idx = 1; idx < NETIO_RESOLVE_CACHE && resolved->name; idx++) {
+        if (!netio_resolved[idx].name ||
+            (long)(netio_resolved[idx].expires - resolved->expires) < 0)
+            resolved = &netio_resolved[idx];
+    }
+    resolved_free(resolved);
+
+    if (!(resolved->name = malloc(hostname_size + port_size)) ||
+        !(resolved->attempts =
+              malloc(sizeof(*netio_attempts) * netio_attempt_count))) {
+        resolved_free(resolved);
+        return;
+    }
+    memcpy(resolved->name, hostname, hostname_size);
+    memcpy(resolved->name + hostname_size, port, port_size);
+    memcpy(resolved->attempts, netio_attempts,
+           sizeof(*netio_attempts) * netio_attempt_count);
+    resolved->count = netio_attempt_count;
+    resolved->expires = sxp_clock() + NETIO_RESOLVE_TTL * 1000UL;
+}
+
+static void resolved_free(struct netio_resolved *resolved)
+{
+    free(resolved->name);
+    free(resolved->attempts);
+    memset(resolved, 0, sizeof(*resolved));
+}
+
+static netResult attempts_create(addrinfo_t *addresses)
+{
+    addrinfo_t *address;
+    addrinfo_t *primary;
+    addrinfo_t *secondary;
+    size_t count = 0;
+
+    for (address = addresses; address; address = address->ai_next)
+        count++;
+    if (!count || !(netio_attempts = calloc(count, sizeof(*netio_attempts))))
+        return NET_ERROR;
+
+    /*alternate families starting with the preferred one*/
+    primary = addresses;
+    secondary = attempt_find(addresses, addresses->ai_family, 0);
+    while (primary || secondary) {
+        if (primary) {
+            attempt_add(primary);
+            primary = attempt_find(primary->ai_next, addresses->ai_family, 1);
+        }
+        if (secondary) {
+            attempt_add(secondary);
+            secondary =
+                attempt_find(secondary->ai_next, addresses->ai_family, 0);
+        }
+    }
+    return NET_SUCCESS;
+}
+
+static netResult attempts_unix(const char *path)
+{
+    struct netio_attempt *attempt;
+
+    if (!(netio_attempts = calloc(1, sizeof(*netio_attempts))))
+        return NET_ERROR;
+    attempt = &netio_attempts[0];
+    if (sxp_unix_address(&attempt->address, &attempt->addrlen, path) !=
+        SXP_SUCCESS)
+        return NET_ERROR;
+    attempt->family = attempt->address.ss_family;
+    attempt->socktype = SOCK_STREAM;
+    attempt->protocol = 0;
+    attempt->state = NETIO_ATTEMPT_WAITING;
+    netio_attempt_count = 1;
+    return NET_SUCCESS;
+}
+
+static addrinfo_t *attempt_find(addrinfo_t *address, int family, int same)
+{
+    while (address && (address->ai_family == family) != same)
+        address = address->ai_next;
+    return address;
+}
+
+static void attempt_add(const addrinfo_t *address)
+{
+    struct netio_attempt *attempt = &netio_attempts[netio_attempt_count];
+    if (address->ai_addrlen > sizeof(attempt->address))
+        return;
+    memcpy(&attempt->address, address->ai_addr, address->ai_addrlen);
+    attempt->addrlen = address->ai_addrlen;
+    attempt->family = address->ai_family;
+    attempt->socktype = address->ai_socktype;
+    attempt->protocol = address->ai_protocol;
+    attempt->state = NETIO_ATTEMPT_WAITING;
+    netio_attempt_count++;
+}
+
+static netResult attempts_tick()
+{
+    unsigned long now = sxp_clock();
+
+    /*a failed attempt passes its head start on to the next one*/
+    while (netio_attempt_next < netio_attempt_count &&
+           (!netio_attempts_running ||
+            (long)(now - netio_attempt_due) >= 0)) {
+        struct netio_attempt *attempt = &netio_attempts[netio_attempt_next];
+        sxpResult result;
+
+        netio_attempt_next++;
+        netio_attempt_due = now + NETIO_CONNECT_DELAY;
+        attempt->state = NETIO_ATTEMPT_FAILED;
+
+        if (sxp_create(&attempt->socket, attempt->family, attempt->socktype,
+                       attempt->protocol) != SXP_SUCCESS)
+            continue;
+        result = sxp_nbio_set(&attempt->socket, SXP_NONBLOCKING);
+        if (result == SXP_SUCCESS)
+            result = sxp_connect(&attempt->socket,
+                                 (sockaddr_t *)&attempt->address,
+                                 attempt->addrlen);
+        /*a connected socket is reported writable right away*/
+        if ((result == SXP_SUCCESS || result == SXP_ASYNC) &&
+            sxp_poller_add(netio_poller, &attempt->socket, SXP_POLLOUT,
+                           NETIO_KEY(netio_attempt_next)) == SXP_SUCCESS) {
+            attempt->state = NETIO_ATTEMPT_RUNNING;
+            netio_attempts_running++;
+        } else {
+            (void)sxp_destroy(&attempt->socket);
+        }
+    }
+
+    if (!netio_attempts_running && netio_attempt_next == netio_attempt_count)
+        return NET_ERROR;
+    return NET_SUCCESS;
+}
+
+static netResult attempt_finish(size_t idx)
+{
+    struct netio_connection_info *connection = &netio_connections[0];
+    struct netio_attempt *attempt;
+
+    if (idx >= netio_attempt_count ||
+        netio_attempts[idx].state != NETIO_ATTEMPT_RUNNING)
+        return NET_SUCCESS;
+    attempt = &netio_attempts[idx];
+    if (sxp_connect_finish(&attempt->socket) != SXP_SUCCESS) {
+        attempt_fail(idx);
+        /*start the next attempt now*/
+        netio_attempt_due = sxp_clock();
+        return NET_SUCCESS;
+    }
+
+    (void)sxp_poller_remove(netio_poller, &attempt->socket, NETIO_KEY(idx + 1));
+    connection->socket = attempt->socket;
+    attempt->state = NETIO_ATTEMPT_FAILED;
+    netio_attempts_running--;
+    attempts_free();
+
+    connection->connecting = 0;
+    connection->last_seen = netio_now;
+    if (connection->rings && ring_create(connection) != NET_SUCCESS) {
+        netio_connection_close(connection->connection);
+        return NET_ERROR;
+    }
+    if (!connection->shm)
+        connection->events |= SXP_POLLRECV;
+    if (sxp_poller_add(netio_poller, &connection->socket,
+                       connection->shm ? SXP_POLLIN : connection->events,
+                       NETIO_KEY(0)) != SXP_SUCCESS) {
+        netio_connection_close(connection->connection);
+        return NET_ERROR;
+    }
+    return NET_SUCCESS;
+}
+
+static void attempt_fail(size_t idx)
+{
+    struct netio_attempt *attempt = &netio_attempts[idx];
+    (void)sxp_poller_remove(netio_poller, &attempt->socket, NETIO_KEY(idx + 1));
+    (void)sxp_destroy(&attempt->socket);
+    attempt->state = NETIO_ATTEMPT_FAILED;
+    netio_attempts_running--;
+}
+
+static void attempts_free()
+{
+    size_t idx;
+    for (idx = 0; idx < netio_attempt_count; idx++) {
+        if (netio_attempts[idx].state == NETIO_ATTEMPT_RUNNING)
+            attempt_fail(idx);
+    }
+    free(netio_attempts);
+    netio_attempts = NULL;
+    netio_attempt_count = 0;
+    netio_attempt_next = 0;
+    netio_attempts_running = 0;
+}
+
+static netResult workers_start()
+{
+    int kind = netio_backend == NET_BACKEND_URING ? SXP_POLLER_URING :
+                                                    SXP_POLLER_DEFAULT;
+
+    /*the transport may have been changed since netio_threads_set*/
+    if (!sxp_vtable_get()->threads)
+        return NET_ERROR;
+    if (!(netio_workers = calloc(netio_threads, sizeof(*netio_workers))))
+        return NET_ERROR;
+    while (netio_worker_count < (unsigned int)netio_threads) {
+        struct netio_worker *worker = calloc(1, sizeof(*worker));
+        if (!worker)
+            return NET_ERROR;
+        worker->index = netio_worker_count + 1;
+        if (sxp_poller_create(&worker->poller, kind) != SXP_SUCCESS) {
+            free(worker);
+            return NET_ERROR;
+        }
+        if (sxp_pair(worker->wake) != SXP_SUCCESS) {
+            sxp_poller_destroy(worker->poller);
+            free(worker);
+            return NET_ERROR;
+        }
+        if (sxp_nbio_set(&worker->wake[0], SXP_NONBLOCKING) != SXP_SUCCESS ||
+            sxp_nbio_set(&worker->wake[1], SXP_NONBLOCKING) != SXP_SUCCESS ||
+            sxp_poller_add(worker->poller, &worker->wake[0], SXP_POLLIN,
+                           NETIO_KEY_WAKE) != SXP_SUCCESS) {
+            sxp_destroy(&worker->wake[0]);
+            sxp_destroy(&worker->wake[1]);
+            sxp_poller_destroy(worker->poller);
+            free(worker);
+            return NET_ERROR;
+        }
+        worker->running = 1;
+        netio_workers[netio_worker_count++] = worker;
+        if (thxp_create(&worker->thread, worker_run, worker) != THXP_SUCCESS) {
+            /*workers_stop must not join a thread which does not exist*/
+            worker->running = 0;
+            return NET_ERROR;
+        }
+    }
+    return NET_SUCCESS;
+}
+
+/*starts the io threads stopped by workers_join again*/
+static netResult workers_resume()
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < netio_worker_count; idx++) {
+        struct netio_worker *worker = netio_workers[idx];
+        worker->running = 1;
+        if (thxp_create(&worker->thread, worker_run, worker) != THXP_SUCCESS) {
+            worker->running = 0;
+            return NET_ERROR;
+        }
+    }
+    return NET_SUCCESS;
+}
+
+/*stops the io threads, their connections are left behind*/
+static void workers_join()
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < netio_worker_count; idx++) {
+        struct netio_worker *worker = netio_workers[idx];
+        if (!__atomic_load_n(&worker->running, __ATOMIC_SEQ_CST))
+            continue;
+        __atomic_store_n(&worker->running, 0, __ATOMIC_SEQ_CST);
+        worker->wake_pending = 0;
+        wake(&worker->wake[1], &worker->wake_pending);
+        thxp_join(&worker->thread);
+    }
+}
+
+/*
+stops the io threads and carries out the commands they have not handled yet
+on this thread instead, so that their connections are up to date and all
+they have received is in netio_inbox
+*/
+static netResult workers_settle()
+{
+    struct netio_message message;
+    unsigned int idx;
+
+    workers_join();
+    for (idx = 0; idx < netio_worker_count; idx++) {
+        struct netio_worker *worker = netio_workers[idx];
+        do {
+            channel_flush(&worker->commands);
+            while (channel_pop(&worker->commands, &message))
+                worker_handle(worker, &message);
+        } while (worker->commands.overflow_count);
+        do {
+            channel_flush(&worker->results);
+            if (workers_exchange() != NET_SUCCESS)
+                return NET_ERROR;
+        } while (worker->results.overflow_count);
+    }
+    return NET_SUCCESS;
+}
+
+static void workers_stop()
+{
+    struct netio_message message;
+    unsigned int idx;
+    size_t slot;
+
+    workers_join();
+    /*
+    the threads are gone, messages still in flight are dropped and the
+    connections are closed without reporting, the core thread resets
+    */
+    for (idx = 0; idx < netio_worker_count; idx++) {
+        struct netio_worker *worker = netio_workers[idx];
+        for (slot = 0; slot < worker->connection_count; slot++) {
+            struct netio_connection_info *connection =
+                worker->connections[slot];
+            if (!connection)
+                continue;
+            sxp_destroy(&connection->socket);
+            free(connection->recv_buffer.buffer);
+            send_queue_free(&(connection->send_queue));
+            free(connection);
+        }
+        free(worker->connections);
+        channel_flush(&worker->commands);
+        while (channel_pop(&worker->commands, &message))
+            message_free(&message);
+        channel_flush(&worker->results);
+        while (channel_pop(&worker->results, &message))
+            message_free(&message);
+        channel_free(&worker->commands);
+        channel_free(&worker->results);
+        sxp_poller_destroy(worker->poller);
+        sxp_destroy(&worker->wake[0]);
+        sxp_destroy(&worker->wake[1]);
+        free(worker);
+    }
+    free(netio_workers);
+    netio_workers = NULL;
+    netio_worker_count = 0;
+    netio_worker_next = 0;
+
+    for (idx = 0; idx < netio_inbox_count; idx++)
+        message_free(&netio_inbox[idx]);
+    free(netio_inbox);
+    netio_inbox = NULL;
+    netio_inbox_count = 0;
+    netio_inbox_next = 0;
+    netio_inbox_capacity = 0;
+}
+
+/*collects the results of the io threads and hands them queued commands*/
+static netResult workers_exchange()
+{
+    struct netio_message message;
+    unsigned int idx;
+    netResult result = NET_SUCCESS;
+
+    for (idx = 0; idx < netio_worker_count; idx++) {
+        struct netio_worker *worker = netio_workers[idx];
+
+        /*a failed io thread left what did not fit into its results here*/
+        if (__atomic_load_n(&worker->failed, __ATOMIC_SEQ_CST)) {
+            channel_flush(&worker->results);
+            result = NET_ERROR;
+        }
+        if (worker->commands.overflow_count) {
+            channel_flush(&worker->commands);
+            wake(&worker->wake[1], &worker->wake_pending);
+        }
+        while (channel_pop(&worker->results, &message)) {
+            if (message.type == NETIO_MESSAGE_CLOSED) {
+                slot_release(message.connection);
+                continue;
+            }
+            if (message.type == NETIO_MESSAGE_DRAINED) {
+                netio_workers_draining--;
+                continue;
+            }
+            if (message.type == NETIO_MESSAGE_STATS) {
+                if (netio_connection_active(message.connection))
+                    netio_connections[NET_ID_SLOT(message.connection)].stats =
+                        *message.stats;
+                message_free(&message);
+                continue;
+            }
+            if (message.type == NETIO_MESSAGE_RESUMED) {
+                if (resumed_push(message.connection, message.tag,
+                                 message.budget) != NET_SUCCESS)
+                    return NET_ERROR;
+                continue;
+            }
+            if (netio_inbox_count == netio_inbox_capacity) {
+                size_t capacity =
+                    netio_inbox_capacity ? netio_inbox_capacity * 2 : 64;
+                struct netio_message *inbox =
+                    realloc(netio_inbox, capacity * sizeof(*inbox));
+                if (!inbox) {
+                    message_free(&message);
+                    return NET_ERROR;
+                }
+                netio_inbox = inbox;
+                netio_inbox_capacity = capacity;
+            }
+            netio_inbox[netio_inbox_count++] = message;
+        }
+        if (channel_popped(&worker->results))
+            wake(&worker->wake[1], &worker->wake_pending);
+    }
+    return result;
+}
+
+static netResult worker_command(unsigned int worker,
+                                struct netio_message *message)
+{
+    struct netio_worker *target = netio_workers[worker - 1];
+    if (channel_push(&target->commands, message) != NET_SUCCESS)
         return NET_ERROR;
-    connection->send_buffer.size -= msg_size;
-    memmove(connection->send_buffer.buffer,
-            connection->send_buffer.buffer + msg_size,
-            connection->send_buffer.size);
+    wake(&target->wake[1], &target->wake_pending);
+    return NET_SUCCESS;
+}
+
+static void worker_run(void *argument)
+{
+    struct netio_worker *worker = argument;
+    struct netio_message message;
+    unsigned long published = 0;
+    sxpResult result;
+    size_t event_count;
+    size_t budget;
+    size_t idx;
+
+    while (__atomic_load_n(&worker->running, __ATOMIC_SEQ_CST)) {
+        while (channel_pop(&worker->commands, &message))
+            worker_handle(worker, &message);
+        if (channel_popped(&worker->commands))
+            wake(&netio_wake[1], &netio_wake_pending);
+        worker_sample(worker);
+        worker_linger(worker);
+        if (worker->draining == 1)
+            worker_drain(worker);
+
+        channel_flush(&worker->results);
+        if (worker->results.tail != published) {
+            published = worker->results.tail;
+            wake(&netio_wake[1], &netio_wake_pending);
+        }
+
+        result = sxp_poller_wait(worker->poller, worker->events,
+                                 &event_count, NETIO_EVENTS_MAX,
+                                 worker_timeout(worker));
+        if (result == SXP_TRY_AGAIN)
+            continue;
+        if (result != SXP_SUCCESS) {
+            worker_fail(worker);
+            return;
+        }
+
+        for (idx = 0; idx < event_count; idx++) {
+            sxp_event_t *event = &worker->events[idx];
+            struct netio_connection_info *connection;
+
+            if (event->key == NETIO_KEY_WAKE) {
+                wake_clear(&worker->wake[0], &worker->wake_pending);
+                continue;
+            }
+            /*connection has already been closed during this wakeup*/
+            if (event->key < NETIO_KEY(0) ||
+                event->key - NETIO_KEY(0) >= worker->connection_count ||
+                !(connection = worker->connections[event->key - NETIO_KEY(0)]))
+                continue;
+
+            if ((event->events & SXP_POLLHUP) ||
+                ((event->events & SXP_POLLERR) &&
+                 zerocopy_complete(connection) != NET_SUCCESS)) {
+                worker_close(worker, connection);
+                continue;
+            }
+            if ((event->events & SXP_POLLIN) &&
+                (pull_data(connection) == NET_ERROR ||
+                 worker_receive(worker, connection) != NET_SUCCESS)) {
+                worker_close(worker, connection);
+                continue;
+            }
+            if ((event->events & SXP_POLLOUT) &&
+                push_data(connection) == NET_ERROR) {
+                worker_close(worker, connection);
+                continue;
+            }
+            if (flow_drained(connection, &budget)) {
+                memset(&message, 0, sizeof(message));
+                message.type = NETIO_MESSAGE_RESUMED;
+                message.connection = connection->connection;
+                message.tag = connection->missed;
+                message.budget = budget;
+                if (channel_push(&worker->results, &message) != NET_SUCCESS)
+                    worker_close(worker, connection);
+            }
+        }
+    }
+}
+
+/*
+sleeps until the next round of samples, the core thread wakes the io thread
+up for anything else. Only draining polls.
+*/
+static int worker_timeout(struct netio_worker *worker)
+{
+    unsigned long now = sxp_clock();
+    long remaining = (long)(worker->sample_due - now);
+
+    if (worker->draining == 1)
+        return NETIO_TIMEOUT;
+    if (worker->lingering && (long)(worker->linger_due - now) < remaining)
+        remaining = (long)(worker->linger_due - now);
+    return remaining < 0 ? 0 : (int)remaining;
+}
+
+/*samples like samples_take and reports the samples to the core thread*/
+static void worker_sample(struct netio_worker *worker)
+{
+    struct netio_message message;
+    unsigned long now = sxp_clock();
+    size_t sampled = 0;
+    size_t visited;
+
+    if ((long)(now - worker->sample_due) < 0)
+        return;
+    worker->sample_due = now + NETIO_SAMPLE_INTERVAL;
+    for (visited = 0; visited < worker->connection_count &&
+                      sampled < NETIO_SAMPLE_BUDGET;
+         visited++) {
+        struct netio_connection_info *connection;
+        if (worker->sample_next >= worker->connection_count)
+            worker->sample_next = 0;
+        if (!(connection = worker->connections[worker->sample_next++]))
+            continue;
+        stats_sample(connection);
+        sampled++;
+
+        memset(&message, 0, sizeof(message));
+        message.type = NETIO_MESSAGE_STATS;
+        message.connection = connection->connection;
+        if (!(message.stats = malloc(sizeof(*message.stats))))
+            continue;
+        *message.stats = connection->stats;
+        if (channel_push(&worker->results, &message) != NET_SUCCESS)
+            message_free(&message);
+    }
+}
+
+/*
+closes the connections whose grace period is over, like timer_expire, once
+the earliest deadline is due and finds the next one
+*/
+static void worker_linger(struct netio_worker *worker)
+{
+    unsigned long now = sxp_clock();
+    size_t idx;
+
+    if (!worker->lingering || (long)(now - worker->linger_due) < 0)
+        return;
+    worker->lingering = 0;
+    for (idx = 0; idx < worker->connection_count; idx++) {
+        struct netio_connection_info *connection = worker->connections[idx];
+        if (!connection || !connection->lingering)
+            continue;
+        if ((long)(now - connection->deadline) >= 0) {
+            worker_close(worker, connection);
+        } else if (!worker->lingering ||
+                   (long)(connection->deadline - worker->linger_due) < 0) {
+            worker->lingering = 1;
+            worker->linger_due = connection->deadline;
+        }
+    }
+}
+
+/*drains like drain and reports NETIO_MESSAGE_DRAINED once it is done*/
+static void worker_drain(struct netio_worker *worker)
+{
+    struct netio_message message;
+    size_t open = 0;
+    size_t idx;
+
+    for (idx = 0; idx < worker->connection_count; idx++) {
+        struct netio_connection_info *connection = worker->connections[idx];
+        if (!connection)
+            continue;
+        if (drain_step(connection))
+            worker_close(worker, connection);
+        else
+            open++;
+    }
+    if (open && (long)(sxp_clock() - netio_drain_deadline) < 0)
+        return;
+
+    memset(&message, 0, sizeof(message));
+    message.type = NETIO_MESSAGE_DRAINED;
+    worker->draining = 2;
+    /*without memory netio_reset waits until the deadline*/
+    (void)channel_push(&worker->results, &message);
+}
+
+static void worker_handle(struct netio_worker *worker,
+                          struct netio_message *message)
+{
+    connection_t slot = NET_ID_SLOT(message->connection);
+    struct netio_connection_info *connection = NULL;
+    struct netio_message resumed;
+    netResult restored;
+    size_t budget;
+
+    if (slot < worker->connection_count && worker->connections[slot] &&
+        worker->connections[slot]->connection == message->connection)
+        connection = worker->connections[slot];
+
+    switch (message->type) {
+    case NETIO_MESSAGE_ADOPT:
+        if (slot >= worker->connection_count) {
+            size_t count = worker->connection_count ?
+                               worker->connection_count :
+                               NETIO_EVENTS_MAX;
+            struct netio_connection_info **connections;
+            while (count <= slot)
+                count *= 2;
+            connections = realloc(worker->connections,
+                                  count * sizeof(*connections));
+            if (!connections)
+                goto adopt_fail;
+            memset(connections + worker->connection_count, 0,
+                   (count - worker->connection_count) * sizeof(*connections));
+            worker->connections = connections;
+            worker->connection_count = count;
+        }
+        if (!(connection = calloc(1, sizeof(*connection))))
+            goto adopt_fail;
+        connection->connection = message->connection;
+        connection->worker = worker->index;
+        connection->socket = message->socket;
+        connection->zerocopy = message->zerocopy;
+        connection->poller = worker->poller;
+        /*the io threads serve no rings, pull_data reads all their clients*/
+        connection->events = SXP_POLLIN | SXP_POLLRECV;
+        if (sxp_poller_add(worker->poller, &connection->socket,
+                           connection->events,
+                           NETIO_KEY(slot)) != SXP_SUCCESS) {
+            free(connection);
+            goto adopt_fail;
+        }
+        worker->connections[slot] = connection;
+        /*a client taken over from another server picks up where it was*/
+        restored = connection_restore(connection, message);
+        free(message->packet.buffer);
+        netio_frame_release(message->frame);
+        if (restored != NET_SUCCESS ||
+            worker_receive(worker, connection) != NET_SUCCESS) {
+            worker_close(worker, connection);
+            return;
+        }
+        if (flow_drained(connection, &budget)) {
+            memset(&resumed, 0, sizeof(resumed));
+            resumed.type = NETIO_MESSAGE_RESUMED;
+            resumed.connection = connection->connection;
+            resumed.tag = connection->missed;
+            resumed.budget = budget;
+            if (channel_push(&worker->results, &resumed) != NET_SUCCESS)
+                worker_close(worker, connection);
+        }
+        return;
+    adopt_fail:
+        message_free(message);
+        message->type = NETIO_MESSAGE_CLOSED;
+        channel_push(&worker->results, message);
+        return;
+    case NETIO_MESSAGE_SEND:
+        /*the queue takes its own reference*/
+        if (connection && flow_send(connection, message->frame) != NET_SUCCESS)
+            worker_close(worker, connection);
+        else if (connection && connection->lingering &&
+                 (!worker->lingering ||
+                  (long)(connection->deadline - worker->linger_due) < 0)) {
+            worker->lingering = 1;
+            worker->linger_due = connection->deadline;
+        }
+        netio_frame_release(message->frame);
+        return;
+    case NETIO_MESSAGE_RESUME:
+        if (connection &&
+            flow_resume(connection, message->frame, message->tag) !=
+                NET_SUCCESS)
+            worker_close(worker, connection);
+        netio_frame_release(message->frame);
+        return;
+    case NETIO_MESSAGE_CLASS:
+        if (connection)
+            connection->client_class = message->client_class;
+        return;
+    case NETIO_MESSAGE_CLOSE:
+        if (connection)
+            worker_close(worker, connection);
+        return;
+    case NETIO_MESSAGE_DRAIN:
+        worker->draining = 1;
+        return;
+    default:
+        message_free(message);
+        return;
+    }
+}
+
+/*copies every complete frame into a packet for the core thread*/
+static netResult worker_receive(struct netio_worker *worker,
+                                struct netio_connection_info *connection)
+{
+    struct netio_message message;
+    net_buffer_t packet;
+    parseResult parsed;
+
+    /*nobody is left to handle what arrives while draining*/
+    if (worker->draining) {
+        connection->recv_buffer.head = connection->recv_buffer.tail;
+        return NET_SUCCESS;
+    }
+    while ((parsed = recv_next(&(connection->recv_buffer), &packet)) ==
+           PACKET_SUCCESS) {
+        connection->stats.frames_in++;
+        memset(&message, 0, sizeof(message));
+        message.type = NETIO_MESSAGE_PACKET;
+        message.connection = connection->connection;
+        if (!(message.packet.buffer = malloc(packet.capacity + 1)))
+            return NET_ERROR;
+        memcpy(message.packet.buffer, packet.buffer, packet.capacity);
+        message.packet.capacity = packet.capacity;
+        if (channel_push(&worker->results, &message) != NET_SUCCESS) {
+            message_free(&message);
+            return NET_ERROR;
+        }
+    }
+    return parsed == PACKET_NOT_READY ? NET_SUCCESS : NET_ERROR;
+}
+
+/*
+closes the connections of an io thread whose poller failed and reports them
+to the core thread, which then fails in netio_tick as it does when its own
+poller fails
+*/
+static void worker_fail(struct netio_worker *worker)
+{
+    size_t idx;
+
+    for (idx = 0; idx < worker->connection_count; idx++) {
+        if (worker->connections[idx])
+            worker_close(worker, worker->connections[idx]);
+    }
+    channel_flush(&worker->results);
+    __atomic_store_n(&worker->failed, 1, __ATOMIC_SEQ_CST);
+    wake(&netio_wake[1], &netio_wake_pending);
+}
+
+static void worker_close(struct netio_worker *worker,
+                         struct netio_connection_info *connection)
+{
+    connection_t slot = NET_ID_SLOT(connection->connection);
+    struct netio_message message;
+
+    (void)sxp_poller_remove(worker->poller, &connection->socket,
+                            NETIO_KEY(slot));
+    sxp_destroy(&connection->socket);
+    free(connection->recv_buffer.buffer);
+    send_queue_free(&(connection->send_queue));
+    worker->connections[slot] = NULL;
+
+    memset(&message, 0, sizeof(message));
+    message.type = NETIO_MESSAGE_CLOSED;
+    message.connection = connection->connection;
+    free(connection);
+    /*without memory the slot leaks, but it is never handed out twice*/
+    (void)channel_push(&worker->results, &message);
+}
+
+static netResult channel_push(struct netio_channel *channel,
+                              const struct netio_message *message)
+{
+    unsigned long head = __atomic_load_n(&channel->head, __ATOMIC_ACQUIRE);
+
+    if (!channel->overflow_count && channel->tail - head < NETIO_CHANNEL_SIZE) {
+        channel->ring[channel->tail % NETIO_CHANNEL_SIZE] = *message;
+        __atomic_store_n(&channel->tail, channel->tail + 1, __ATOMIC_SEQ_CST);
+        return NET_SUCCESS;
+    }
+    if (channel->overflow_head + channel->overflow_count ==
+        channel->overflow_capacity) {
+        if (channel->overflow_head) {
+            /*reuse the space of messages which have been flushed*/
+            memmove(channel->overflow,
+                    channel->overflow + channel->overflow_head,
+                    channel->overflow_count * sizeof(*channel->overflow));
+            channel->overflow_head = 0;
+        } else {
+            size_t capacity = channel->overflow_capacity ?
+                                  channel->overflow_capacity * 2 :
+                                  NETIO_CHANNEL_SIZE;
+            struct netio_message *overflow =
+                realloc(channel->overflow, capacity * sizeof(*overflow));
+            if (!overflow)
+                return NET_ERROR;
+            channel->overflow = overflow;
+            channel->overflow_capacity = capacity;
+        }
+    }
+    channel->overflow[channel->overflow_head + channel->overflow_count] =
+        *message;
+    channel->overflow_count++;
+    /*the consumer may have made room since head was read*/
+    channel_flush(channel);
     return NET_SUCCESS;
 }
+
+/*
+moves messages from overflow to the ring as far as there is room. If some
+are left the channel is marked blocked, head is read again after that so
+that the consumer either sees the mark or has its room used.
+*/
+static void channel_flush(struct netio_channel *channel)
+{
+    unsigned long head = __atomic_load_n(&channel->head, __ATOMIC_ACQUIRE);
+    unsigned long tail = channel->tail;
+
+    for (;;) {
+        while (channel->overflow_count && tail - head < NETIO_CHANNEL_SIZE) {
+            channel->ring[tail % NETIO_CHANNEL_SIZE] =
+                channel->overflow[channel->overflow_head];
+            channel->overflow_head++;
+            channel->overflow_count--;
+            tail++;
+        }
+        __atomic_store_n(&channel->tail, tail, __ATOMIC_SEQ_CST);
+        if (!channel->overflow_count) {
+            channel->overflow_head = 0;
+            return;
+        }
+        __atomic_store_n(&channel->blocked, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&channel->head, __ATOMIC_SEQ_CST) == head)
+            return;
+        head = __atomic_load_n(&channel->head, __ATOMIC_ACQUIRE);
+    }
+}
+
+static int channel_pop(struct netio_channel *channel,
+                       struct netio_message *message)
+{
+    unsigned long head = channel->head;
+
+    if (head == __atomic_load_n(&channel->tail, __ATOMIC_SEQ_CST))
+        return 0;
+    *message = channel->ring[head % NETIO_CHANNEL_SIZE];
+    __atomic_store_n(&channel->head, head + 1, __ATOMIC_SEQ_CST);
+    return 1;
+}
+
+/*
+returns nonzero if the producer is blocked on overflow, after messages have
+been popped it has to be woken up to move them to the ring
+*/
+static int channel_popped(struct netio_channel *channel)
+{
+    return __atomic_load_n(&channel->blocked, __ATOMIC_SEQ_CST) &&
+           __atomic_exchange_n(&channel->blocked, 0, __ATOMIC_SEQ_CST);
+}
+
+static void channel_free(struct netio_channel *channel)
+{
+    while (channel->overflow_count) {
+        message_free(&channel->overflow[channel->overflow_head++]);
+        channel->overflow_count--;
+    }
+    free(channel->overflow);
+    channel->overflow = NULL;
+    channel->overflow_head = 0;
+    channel->overflow_capacity = 0;
+}
+
+static void message_free(struct netio_message *message)
+{
+    switch (message->type) {
+    case NETIO_MESSAGE_ADOPT:
+        sxp_destroy(&message->socket);
+        free(message->packet.buffer);
+        netio_frame_release(message->frame);
+        break;
+    case NETIO_MESSAGE_SEND:
+    case NETIO_MESSAGE_RESUME:
+        netio_frame_release(message->frame);
+        break;
+    case NETIO_MESSAGE_PACKET:
+        free(message->packet.buffer);
+        break;
+    case NETIO_MESSAGE_STATS:
+        free(message->stats);
+        break;
+    default:
+        break;
+    }
+}
+
+/*writes to socket unless the reader has not yet been woken up since*/
+static void wake(sxp_t *socket, int *pending)
+{
+    size_t num_sent;
+    if (!__atomic_exchange_n(pending, 1, __ATOMIC_SEQ_CST))
+        (void)sxp_send(socket, "", &num_sent, 1);
+}
+
+static void wake_clear(sxp_t *socket, int *pending)
+{
+    char buffer[64];
+    size_t num_read;
+    while (sxp_recv(socket, buffer, &num_read, sizeof(buffer)) ==
+               SXP_SUCCESS &&
+           num_read)
+        ;
+    __atomic_store_n(pending, 0, __ATOMIC_SEQ_CST);
+}
@@ -3,27 +3,244 @@
 
 #include "net.h"
 #include "packet.h"
+#include <limits.h>
 
 #define NETIO_READ_MAX (16 * 1024)
 #define NETIO_BUFFER_MAX_SIZE (4 * 1024 * 1024)
-#define NETIO_ACCEPT_BACKLOG 5
+/*default watermarks of the send queue of a client and grace period in ms*/
+#define NETIO_HIGH_WATERMARK (1024 * 1024)
+#define NETIO_LOW_WATERMARK (256 * 1024)
+#define NETIO_GRACE 10000
+/*default limit of the bytes queued on all clients together*/
+#define NETIO_OUTBOUND_MAX (64 * 1024 * 1024)
+#define NETIO_ACCEPT_BACKLOG 128
+/*maximum number of clients accepted by one call of netio_tick*/
+#define NETIO_ACCEPT_BUDGET 64
+/*
+bytes read from a connection per wakeup and frames of a connection returned
+by netio_recv per tick, so that a flooding client can not hold up the others.
+The benchmarks build the library without them to compare.
+*/
+#ifndef NETIO_READ_BUDGET
+#define NETIO_READ_BUDGET (64 * 1024)
+#endif /*NETIO_READ_BUDGET*/
+#ifndef NETIO_FRAME_BUDGET
+#define NETIO_FRAME_BUDGET 64
+#endif /*NETIO_FRAME_BUDGET*/
+/*longest wait of netio_tick if no file descriptor is watched*/
 #define NETIO_TIMEOUT 10
+/*number of file descriptors which can be watched with netio_watch*/
+#define NETIO_WATCH_MAX 4
+/*
+default ms an accepted client has to complete its handshake and ms of
+silence after which a connection is closed as dead, it is probed after half
+of that
+*/
+#define NETIO_HANDSHAKE_TIMEOUT 10000
+#define NETIO_IDLE_TIMEOUT 60000
+/*
+ms a client refused because the server serves as many clients as it admits
+is told to wait, and the highest rate of admitted handshakes per second
+*/
+#define NETIO_RETRY_FULL 5000
+#define NETIO_RATE_MAX 1000000
+/*
+ms per slot of the timer wheel, 2 ** NETIO_WHEEL_BITS slots per level. Timers
+due later than the last slot of the last level are moved to it.
+*/
+#define NETIO_WHEEL_RESOLUTION 16
+#define NETIO_WHEEL_BITS 6
+#define NETIO_WHEEL_LEVELS 4
+/*
+ms between samples of the transport of the connections, and connections
+sampled by every thread per interval. With more connections each of them
+is sampled less often.
+*/
+#define NETIO_SAMPLE_INTERVAL 1000
+#define NETIO_SAMPLE_BUDGET 256
+/*
+longest time in ms netio_reset waits for the send queues to be flushed and
+for the peers to close their end after the last byte
+*/
+#define NETIO_DRAIN_TIMEOUT 2000
+/*
+version of what netio_handoff passes to a successor, which has to match for
+a takeover, and ms either side waits for the other while it is passed
+*/
+#define NETIO_HANDOFF_VERSION 1
+#define NETIO_HANDOFF_TIMEOUT 5000
+/*head start in ms of a connection attempt before the next one is started*/
+#define NETIO_CONNECT_DELAY 250
+/*seconds resolved hostnames are cached and number of cached hostnames*/
+#define NETIO_RESOLVE_TTL 60
+#define NETIO_RESOLVE_CACHE 8
+#define NETIO_EVENTS_MAX 64
+#define NETIO_THREADS_MAX 64
+/*number of messages which fit into a queue between two threads*/
+#define NETIO_CHANNEL_SIZE 4096
 
 typedef unsigned int connection_t;
 
+/*
+an immutable serialized frame including its length prefix. A frame can be
+queued on any number of connections and is freed once the last reference
+is released, so a broadcast is serialized only once.
+*/
+typedef struct netio_frame netio_frame_t;
+
+/*
+flags of a frame. Backfill frames carry history which is dropped first by
+NET_POLICY_BACKFILL and not sent again later.
+*/
+#define NETIO_FRAME_BACKFILL 1
+/*
+control frames are small and queued regardless of the policy, so that they
+also reach a paused client
+*/
+#define NETIO_FRAME_CONTROL 2
+/*tag of frames which do not need to be sent again if they are dropped*/
+#define NETIO_TAG_NONE LONG_MAX
+
+#define NETIO_NONE ((connection_t)-1)
+
 netResult netio_init();
 netResult netio_exit();
 
+/*
+hostnames and endpoints starting with NETIO_UNIX_PREFIX are the path of a unix
+domain socket for clients on the same host, the port is ignored for them
+*/
+#define NETIO_UNIX_PREFIX "unix:"
+/*
+like NETIO_UNIX_PREFIX, but frames are exchanged through rings in memory
+shared over the socket, which then only carries wakeups
+*/
+#define NETIO_SHM_PREFIX "shm:"
+/*bytes of each ring, every frame fits into one*/
+#define NETIO_RING_SIZE NETIO_BUFFER_MAX_SIZE
+
 netResult netio_connect(const char *hostname, const char *port);
-netResult netio_serve(const char *port);
+/*endpoint is a port or NETIO_UNIX_PREFIX or NETIO_SHM_PREFIX and a path*/
+netResult netio_serve(const char *endpoint);
+/*adds another endpoint a server accepts clients on*/
+netResult netio_listen(const char *endpoint);
+/*
+stops accepting clients and flushes what is queued on the connections
+before closing them, for at most NETIO_DRAIN_TIMEOUT
+*/
 netResult netio_reset();
+/*
+lets a successor take over the listeners and clients of this server through
+the unix domain socket at path, see netio_successor
+*/
+netResult netio_handoff_listen(const char *path);
+/*returns NET_SUCCESS once a successor waits to be passed netio_handoff*/
+netResult netio_successor();
+/*
+passes the listeners and the clients to the waiting successor along with
+state (the state of the caller), including what was received from the
+clients but not yet returned by netio_recv and what is still queued for
+them. Nothing is closed on the clients, netio is reset without draining
+afterwards. NET_TRY_AGAIN if the successor was not compatible or could not
+be passed everything, this server carries on then.
+*/
+netResult netio_handoff(const net_buffer_t *state);
+/*
+takes over the listeners and the clients of the server waiting for a
+successor at path. state is set to what the server passed to netio_handoff
+and owned by the caller. NET_TRY_AGAIN if no server waits at path.
+*/
+netResult netio_takeover(const char *path, net_buffer_t *state);
+netResult netio_backend_set(int backend);
+netResult netio_threads_set(int threads);
+netResult netio_backlog_set(int backlog);
+netResult netio_policy_set(int client_class, const struct net_policy *policy);
+netResult netio_outbound_max_set(size_t limit);
+netResult netio_zerocopy_set(size_t threshold);
+/*ms, 0 disables the timeout*/
+netResult netio_timeouts_set(unsigned long handshake, unsigned long idle);
+/*
+clients waiting to be admitted are not read from and time out only once
+admitted
+*/
+netResult netio_admission_set(const struct net_admission *admission);
 
 int netio_connection_active(connection_t who);
 netResult netio_connection_close(connection_t who);
+/*clients accepted by a server start as NET_CLASS_GUEST*/
+netResult netio_class_set(connection_t who, int client_class);
+/*who has completed its handshake, from now on only its silence counts*/
+netResult netio_established(connection_t who);
 
+/*
+waits until a socket or a watched file descriptor is ready or a timer of
+netio is due, then handles the ready sockets
+*/
 netResult netio_tick();
+/*
+makes netio_tick return once fd is readable, reading it is up to the caller.
+Watched file descriptors stay registered until netio_exit.
+*/
+netResult netio_watch(int fd);
 
+/*
+the received packet is not owned by the caller, it points into the receive
+buffer of the connection (or a copy made by an io thread) and stays valid
+until the next call to netio_tick or until the connection is closed.
+*/
 netResult netio_recv(connection_t *who, net_buffer_t *packet);
 netResult netio_send(connection_t who, const net_buffer_t *packet);
 
+/*
+the created frame holds one reference owned by the caller. If the frame is
+dropped by a paused client, the lowest tag among the dropped frames is
+reported by netio_resumed.
+*/
+netResult netio_frame_create(netio_frame_t **frame, const net_buffer_t *packet,
+                             int flags, long tag);
+void netio_frame_release(netio_frame_t *frame);
+/*
+queues frame on who, the connection takes its own reference. A server
+applies the policy of the class of who, so the frame may be dropped
+instead. NET_ERROR means who has to be closed.
+*/
+netResult netio_send_frame(connection_t who, netio_frame_t *frame);
+
+/*
+returns a paused client which has drained its send queue, the lowest tag of
+the frames it missed, or NETIO_TAG_NONE if all were untagged, and how many
+bytes may be sent to make up for them. The client drops every frame until
+it is passed to netio_resume.
+*/
+netResult netio_resumed(connection_t *who, long *tag, size_t *budget);
+/*
+queues frame on a resumed client regardless of its watermarks. Unless missed
+is NETIO_TAG_NONE the client stays paused and is returned by netio_resumed
+with missed again once it has drained frame.
+*/
+netResult netio_resume(connection_t who, netio_frame_t *frame, long missed);
+
+/*
+returns a connection which has been silent for half the idle timeout. It is
+closed unless a frame arrives from it before the timeout, so its peer should
+be sent something it answers.
+*/
+netResult netio_idle(connection_t *who);
+/*
+returns an accepted client netio has closed by itself, after a hangup, an
+error or a timeout, so that what is kept about it can be freed
+*/
+netResult netio_closed(connection_t *who);
+
+/*
+returns a client refused by the limits of netio_admission_set and the ms it
+should wait before trying again. Nothing it sends is returned by netio_recv,
+it is closed once what is queued on it has been sent.
+*/
+netResult netio_refused(connection_t *who, unsigned long *retry);
+
+netResult netio_stats_get(struct net_stats *stats);
+netResult netio_connection_stats_get(connection_t who,
+                                     struct net_connection_stats *stats);
+
 #endif /* NETIO_H_ */
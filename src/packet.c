@@ -2,10 +2,13 @@
 #include <limits.h>
 #include <string.h>
 
+static parseResult packet_peek_buf(net_buffer_t *pak, char **buf,
+                                   unsigned long *size);
 static parseResult packet_recv_buf(net_buffer_t *pak, char **buf,
                                    unsigned long *size);
 static parseResult packet_send_buf(net_buffer_t *pak, const char *buf,
                                    unsigned long size);
+static parseResult packet_reserve(net_buffer_t *pak, size_t size);
 
 parseResult packet_realloc(net_buffer_t *pak, size_t capacity)
 {
@@ -55,8 +58,7 @@ parseResult packet_send_i32(net_buffer_t *pak, long int n)
 parseResult packet_send_u32(net_buffer_t *pak, unsigned long n)
 {
     parseResult parsed;
-    if ((pak->size + 4 > pak->capacity) &&
-        (parsed = packet_realloc(pak, pak->size + 4)) != PACKET_SUCCESS)
+    if ((parsed = packet_reserve(pak, 4)) != PACKET_SUCCESS)
         return parsed;
     pak->buffer[pak->size + 0] = (unsigned char)((n >> 24) & 0xFF);
     pak->buffer[pak->size + 1] = (unsigned char)((n >> 16) & 0xFF);
@@ -89,12 +91,24 @@ parseResult packet_recv_packet(net_buffer_t *pak, net_buffer_t *buf)
     return result;
 }
 
+parseResult packet_peek_packet(net_buffer_t *pak, net_buffer_t *buf)
+{
+    parseResult result;
+    unsigned long capacity;
+    if ((result = packet_peek_buf(pak, &(buf->buffer), &capacity)) !=
+        PACKET_SUCCESS)
+        return result;
+    buf->size = 0;
+    buf->capacity = capacity;
+    return result;
+}
+
 parseResult packet_send_packet(net_buffer_t *pak, const net_buffer_t *buf)
 {
     return packet_send_buf(pak, buf->buffer, buf->size);
 }
 
-static parseResult packet_recv_buf(net_buffer_t *pak, char **buf,
+static parseResult packet_peek_buf(net_buffer_t *pak, char **buf,
                                    unsigned long *size)
 {
     long int length;
@@ -105,12 +119,25 @@ static parseResult packet_recv_buf(net_buffer_t *pak, char **buf,
         pak->size -= 4;
         return PACKET_NOT_READY;
     }
+    *buf = pak->buffer + pak->size;
+    *size = length;
+    pak->size += length;
+    return PACKET_SUCCESS;
+}
+
+static parseResult packet_recv_buf(net_buffer_t *pak, char **buf,
+                                   unsigned long *size)
+{
+    char *view;
+    unsigned long length;
+    parseResult parsed;
+    if ((parsed = packet_peek_buf(pak, &view, &length)) != PACKET_SUCCESS)
+        return parsed;
     *buf = malloc(length);
     if (!(*buf))
         return PACKET_ERROR;
-    memcpy(*buf, pak->buffer + pak->size, length);
+    memcpy(*buf, view, length);
     *size = length;
-    pak->size += length;
     return PACKET_SUCCESS;
 }
 
@@ -122,10 +149,24 @@ static parseResult packet_send_buf(net_buffer_t *pak, const char *buf,
         return PACKET_ERROR;
     if ((parsed = packet_send_i32(pak, size)) != PACKET_SUCCESS)
         return parsed;
-    if ((pak->size + size > pak->capacity) &&
-        (parsed = packet_realloc(pak, pak->size + size)) != PACKET_SUCCESS)
+    if ((parsed = packet_reserve(pak, size)) != PACKET_SUCCESS)
         return parsed;
     memcpy(pak->buffer + pak->size, buf, size);
     pak->size += size;
     return PACKET_SUCCESS;
 }
+
+/*
+grows pak geometrically, so that serializing many packets into one buffer
+does not copy it for every field
+*/
+static parseResult packet_reserve(net_buffer_t *pak, size_t size)
+{
+    size_t capacity = pak->capacity;
+    if (pak->size + size <= capacity)
+        return PACKET_SUCCESS;
+    capacity = capacity > 32 ? capacity * 2 : 64;
+    if (capacity < pak->size + size)
+        capacity = pak->size + size;
+    return packet_realloc(pak, capacity);
+}
@@ -30,5 +30,7 @@ parseResult packet_send_str(net_buffer_t *pak, const char *str);
 
 parseResult packet_send_packet(net_buffer_t *pak, const net_buffer_t *buf);
 parseResult packet_recv_packet(net_buffer_t *pak, net_buffer_t *buf);
+/*like packet_recv_packet, but buf points into pak instead of owning a copy*/
+parseResult packet_peek_packet(net_buffer_t *pak, net_buffer_t *buf);
 
 #endif /*PACKET_H_*/
@@ -10,11 +10,17 @@ static parseResult
 protocol_packet_recv_handshake_s(net_buffer_t *protocol_packet,
                                  struct protocol_packet_handshake_s *data);
 static parseResult
+protocol_packet_recv_busy(net_buffer_t *protocol_packet,
+                          struct protocol_packet_busy *data);
+static parseResult
 protocol_packet_recv_person(net_buffer_t *protocol_packet,
                             struct protocol_packet_person *data);
 static parseResult
 protocol_packet_recv_message(net_buffer_t *protocol_packet,
                              struct protocol_packet_message *data);
+static parseResult
+protocol_packet_recv_ping(net_buffer_t *protocol_packet,
+                          struct protocol_packet_ping *data);
 
 static parseResult protocol_packet_send_handshake_c(
     net_buffer_t *protocol_packet,
@@ -26,11 +32,17 @@ static parseResult protocol_packet_send_handshake_s(
     net_buffer_t *protocol_packet,
     const struct protocol_packet_handshake_s *data);
 static parseResult
+protocol_packet_send_busy(net_buffer_t *protocol_packet,
+                          const struct protocol_packet_busy *data);
+static parseResult
 protocol_packet_send_person(net_buffer_t *protocol_packet,
                             const struct protocol_packet_person *data);
 static parseResult
 protocol_packet_send_message(net_buffer_t *protocol_packet,
                              const struct protocol_packet_message *data);
+static parseResult
+protocol_packet_send_ping(net_buffer_t *protocol_packet,
+                          const struct protocol_packet_ping *data);
 
 parseResult packet_deserialize(net_buffer_t *protocol_packet,
                                struct protocol_packet *res)
@@ -47,6 +59,9 @@ parseResult packet_deserialize(net_buffer_t *protocol_packet,
         protocol_packet_recv_handshake_s(protocol_packet,
                                          &(res->as.handshake_s));
         break;
+    case NET_PROTO_BUSY:
+        protocol_packet_recv_busy(protocol_packet, &(res->as.busy));
+        break;
     case NET_PROTO_PERSON:
         protocol_packet_recv_person(protocol_packet, &(res->as.person));
         break;
@@ -56,6 +71,10 @@ parseResult packet_deserialize(net_buffer_t *protocol_packet,
     case NET_PROTO_INFO_C:
         protocol_packet_recv_info_c(protocol_packet, &(res->as.info_c));
         break;
+    case NET_PROTO_PING:
+    case NET_PROTO_PONG:
+        protocol_packet_recv_ping(protocol_packet, &(res->as.ping));
+        break;
     default:
         return PACKET_ERROR;
     }
@@ -75,6 +94,9 @@ parseResult packet_serialize(net_buffer_t *protocol_packet,
         protocol_packet_send_handshake_s(protocol_packet,
                                          &(data->as.handshake_s));
         break;
+    case NET_PROTO_BUSY:
+        protocol_packet_send_busy(protocol_packet, &(data->as.busy));
+        break;
     case NET_PROTO_PERSON:
         protocol_packet_send_person(protocol_packet, &(data->as.person));
         break;
@@ -84,6 +106,10 @@ parseResult packet_serialize(net_buffer_t *protocol_packet,
     case NET_PROTO_INFO_C:
         protocol_packet_send_info_c(protocol_packet, &(data->as.info_c));
         break;
+    case NET_PROTO_PING:
+    case NET_PROTO_PONG:
+        protocol_packet_send_ping(protocol_packet, &(data->as.ping));
+        break;
     default:
         return PACKET_ERROR;
     }
@@ -126,6 +152,16 @@ protocol_packet_recv_handshake_s(net_buffer_t *protocol_packet,
     return res;
 }
 
+static parseResult
+protocol_packet_recv_busy(net_buffer_t *protocol_packet,
+                          struct protocol_packet_busy *data)
+{
+    parseResult res = PACKET_SUCCESS;
+    if (res == PACKET_SUCCESS)
+        res = packet_recv_u32(protocol_packet, &(data->retry));
+    return res;
+}
+
 static parseResult
 protocol_packet_recv_person(net_buffer_t *protocol_packet,
                             struct protocol_packet_person *data)
@@ -154,6 +190,16 @@ protocol_packet_recv_message(net_buffer_t *protocol_packet,
     return res;
 }
 
+static parseResult
+protocol_packet_recv_ping(net_buffer_t *protocol_packet,
+                          struct protocol_packet_ping *data)
+{
+    parseResult res = PACKET_SUCCESS;
+    if (res == PACKET_SUCCESS)
+        res = packet_recv_u32(protocol_packet, &(data->token));
+    return res;
+}
+
 static parseResult
 protocol_packet_send_handshake_c(net_buffer_t *protocol_packet,
                                  const struct protocol_packet_handshake_c *data)
@@ -190,6 +236,16 @@ protocol_packet_send_handshake_s(net_buffer_t *protocol_packet,
     return res;
 }
 
+static parseResult
+protocol_packet_send_busy(net_buffer_t *protocol_packet,
+                          const struct protocol_packet_busy *data)
+{
+    parseResult res = PACKET_SUCCESS;
+    if (res == PACKET_SUCCESS)
+        res = packet_send_u32(protocol_packet, data->retry);
+    return res;
+}
+
 static parseResult
 protocol_packet_send_person(net_buffer_t *protocol_packet,
                             const struct protocol_packet_person *data)
@@ -217,3 +273,13 @@ protocol_packet_send_message(net_buffer_t *protocol_packet,
         res = packet_send_str(protocol_packet, data->message);
     return res;
 }
+
+static parseResult
+protocol_packet_send_ping(net_buffer_t *protocol_packet,
+                          const struct protocol_packet_ping *data)
+{
+    parseResult res = PACKET_SUCCESS;
+    if (res == PACKET_SUCCESS)
+        res = packet_send_u32(protocol_packet, data->token);
+    return res;
+}
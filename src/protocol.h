@@ -8,6 +8,11 @@
 #define NET_PROTO_PERSON 2
 #define NET_PROTO_MESSAGE 3
 #define NET_PROTO_INFO_C 4
+/*a ping is answered with a pong carrying the same token*/
+#define NET_PROTO_PING 5
+#define NET_PROTO_PONG 6
+/*a server too busy to admit a client tells it when to try again*/
+#define NET_PROTO_BUSY 7
 
 #define NET_PINFO_AUDIENCE 1
 #define NET_PINFO_HISTORY 2
@@ -34,6 +39,11 @@ struct protocol_packet_handshake_s {
     unsigned long self_id;
 };
 
+struct protocol_packet_busy {
+    /*ms*/
+    unsigned long retry;
+};
+
 /*any side packets*/
 struct protocol_packet_person {
     unsigned long person_id;
@@ -46,6 +56,11 @@ struct protocol_packet_message {
     long int index;
     char *message;
 };
+
+/*NET_PROTO_PING and NET_PROTO_PONG*/
+struct protocol_packet_ping {
+    unsigned long token;
+};
 /*end packets*/
 
 struct protocol_packet {
@@ -54,8 +69,10 @@ struct protocol_packet {
         struct protocol_packet_handshake_c handshake_c;
         struct protocol_packet_info_c info_c;
         struct protocol_packet_handshake_s handshake_s;
+        struct protocol_packet_busy busy;
         struct protocol_packet_person person;
         struct protocol_packet_message message;
+        struct protocol_packet_ping ping;
     } as;
 };
 
@@ -0,0 +1,51 @@
+#ifndef SHMXP_H_
+#define SHMXP_H_
+
+#include <stddef.h>
+
+/*
+shared memory exchanged with a process on the same host through a file
+descriptor (e.g. sent with sxp_send_fd). A region is a header of
+SHMXP_HEADER_SIZE bytes followed by SHMXP_RINGS rings of size bytes each.
+Every ring is mapped twice back to back, so data wrapping around the end of
+a ring can be read and written in one piece. Only available on unix.
+
+On linux the size of a region is sealed once it is created and shmxp_attach
+refuses regions which are not sealed. Elsewhere the other process can still
+truncate the file under the mapping. Either way it can write to the memory at
+any time, so what is read from it is copied out before it is checked.
+*/
+/*a multiple of the page sizes in use, parts are mapped at multiples of it*/
+#define SHMXP_HEADER_SIZE (64 * 1024)
+#define SHMXP_RINGS 2
+
+typedef struct shmxp_region {
+    int fd;
+    /*bytes of every ring, a multiple of SHMXP_HEADER_SIZE*/
+    size_t size;
+    void *header;
+    char *rings[SHMXP_RINGS];
+    /*the whole mapping, including the second view of every ring*/
+    void *base;
+    size_t length;
+} shmxp_region_t;
+
+typedef int shmxpResult;
+
+enum shmxpresults {
+    SHMXP_SUCCESS = 0,
+    /*returned when shared memory is not available on this platform*/
+    SHMXP_ERROR_PLATFORM = -1,
+    /*returned when size or the size or seals of the file are not valid*/
+    SHMXP_ERROR_INVAL = -2,
+    /*returned when the region could not be created or mapped*/
+    SHMXP_ERROR = -3
+};
+
+/*creates a zeroed region which is not visible in the file system*/
+shmxpResult shmxp_create(shmxp_region_t *region, size_t size);
+/*maps the region of fd created by another process, taking over fd*/
+shmxpResult shmxp_attach(shmxp_region_t *region, int fd);
+shmxpResult shmxp_destroy(shmxp_region_t *region);
+
+#endif /*SHMXP_H_*/
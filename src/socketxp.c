@@ -0,0 +1,199 @@
+#include "socketxp.h"
+
+static const sxp_vtable_t *sxp_current = &sxp_platform;
+
+sxpResult sxp_vtable_set(const sxp_vtable_t *vtable)
+{
+    sxp_current = vtable ? vtable : &sxp_platform;
+    return SXP_SUCCESS;
+}
+
+const sxp_vtable_t *sxp_vtable_get()
+{
+    return sxp_current;
+}
+
+sxpResult sxp_init()
+{
+    return sxp_current->init();
+}
+
+sxpResult sxp_cleanup()
+{
+    return sxp_current->cleanup();
+}
+
+sxpResult sxp_create(sxp_t *dst, int family, int type, int protocol)
+{
+    return sxp_current->create(dst, family, type, protocol);
+}
+
+sxpResult sxp_destroy(sxp_t *sock)
+{
+    return sxp_current->destroy(sock);
+}
+
+sxpResult sxp_nbio_set(sxp_t *sock, int nonblockingio)
+{
+    return sxp_current->nbio_set(sock, nonblockingio);
+}
+
+sxpResult sxp_addrinfo_get(addrinfo_t **results, const char *maybe_hostname,
+                           const char *serviceport, addrinfo_t *hints)
+{
+    return sxp_current->addrinfo_get(results, maybe_hostname, serviceport,
+                                     hints);
+}
+
+sxpResult sxp_addrinfo_free(addrinfo_t *info)
+{
+    return sxp_current->addrinfo_free(info);
+}
+
+/*server-side API*/
+sxpResult sxp_bind(sxp_t *sock, const sockaddr_t *address, size_t addrlen)
+{
+    return sxp_current->bind(sock, address, addrlen);
+}
+
+sxpResult sxp_listen(sxp_t *sock, size_t backlog)
+{
+    return sxp_current->listen(sock, backlog);
+}
+
+sxpResult sxp_accept(sxp_t *sock, sxp_t *newsock, int nonblockingio)
+{
+    return sxp_current->accept(sock, newsock, nonblockingio);
+}
+
+sxpResult sxp_unix_address(struct sockaddr_storage *address, size_t *addrlen,
+                           const char *path)
+{
+    return sxp_current->unix_address(address, addrlen, path);
+}
+
+sxpResult sxp_unix_unlink(const char *path)
+{
+    return sxp_current->unix_unlink(path);
+}
+
+sxpResult sxp_send_fd(sxp_t *sock, int fd)
+{
+    return sxp_current->send_fd(sock, fd);
+}
+
+sxpResult sxp_recv_fd(sxp_t *sock, int *fd)
+{
+    return sxp_current->recv_fd(sock, fd);
+}
+
+/*client-side API*/
+sxpResult sxp_connect(sxp_t *sock, sockaddr_t *address, size_t addrlen)
+{
+    return sxp_current->connect(sock, address, addrlen);
+}
+
+sxpResult sxp_connect_finish(sxp_t *sock)
+{
+    return sxp_current->connect_finish(sock);
+}
+
+/*any-side API*/
+sxpResult sxp_shutdown(sxp_t *sock)
+{
+    return sxp_current->shutdown(sock);
+}
+
+sxpResult sxp_send(sxp_t *sock, const char *data, size_t *num_sent,
+                   size_t size)
+{
+    return sxp_current->send(sock, data, num_sent, size);
+}
+
+sxpResult sxp_recv(sxp_t *sock, char *data, size_t *num_read, size_t size)
+{
+    return sxp_current->recv(sock, data, num_read, size);
+}
+
+sxpResult sxp_sendv(sxp_t *sock, const sxp_buffer_t buffers[], size_t count,
+                    size_t *num_sent)
+{
+    return sxp_current->sendv(sock, buffers, count, num_sent);
+}
+
+sxpResult sxp_zerocopy_set(sxp_t *sock, int enabled)
+{
+    return sxp_current->zerocopy_set(sock, enabled);
+}
+
+sxpResult sxp_send_zerocopy(sxp_t *sock, const char *data, size_t *num_sent,
+                            size_t size, int *pinned)
+{
+    return sxp_current->send_zerocopy(sock, data, num_sent, size, pinned);
+}
+
+sxpResult sxp_zerocopy_completed(sxp_t *sock, unsigned long *first,
+                                 unsigned long *last, int *copied)
+{
+    return sxp_current->zerocopy_completed(sock, first, last, copied);
+}
+
+sxpResult sxp_transport_get(sxp_t *sock, sxp_transport_t *transport)
+{
+    return sxp_current->transport_get(sock, transport);
+}
+
+sxpResult sxp_pair(sxp_t pair[2])
+{
+    return sxp_current->pair(pair);
+}
+
+unsigned long sxp_clock()
+{
+    return sxp_current->clock();
+}
+
+sxpResult sxp_poll(size_t /*maybe NULL*/ *results, pollsxp_t sxps[],
+                   size_t sxpcount, int timeout)
+{
+    return sxp_current->poll(results, sxps, sxpcount, timeout);
+}
+
+sxpResult sxp_poller_create(sxp_poller_t **poller, int kind)
+{
+    return sxp_current->poller_create(poller, kind);
+}
+
+sxpResult sxp_poller_destroy(sxp_poller_t *poller)
+{
+    return sxp_current->poller_destroy(poller);
+}
+
+sxpResult sxp_poller_add(sxp_poller_t *poller, sxp_t *sock, int events,
+                         size_t key)
+{
+    return sxp_current->poller_add(poller, sock, events, key);
+}
+
+sxpResult sxp_poller_modify(sxp_poller_t *poller, sxp_t *sock, int events,
+                            size_t key)
+{
+    return sxp_current->poller_modify(poller, sock, events, key);
+}
+
+sxpResult sxp_poller_remove(sxp_poller_t *poller, sxp_t *sock, size_t key)
+{
+    return sxp_current->poller_remove(poller, sock, key);
+}
+
+sxpResult sxp_poller_wait(sxp_poller_t *poller, sxp_event_t events[],
+                          size_t *count, size_t limit, int timeout)
+{
+    return sxp_current->poller_wait(poller, events, count, limit, timeout);
+}
+
+sxpResult sxp_poller_recv(sxp_poller_t *poller, sxp_t *sock, size_t key,
+                          char *data, size_t *num_read, size_t size)
+{
+    return sxp_current->poller_recv(poller, sock, key, data, num_read, size);
+}
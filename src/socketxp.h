@@ -16,6 +16,8 @@ typedef struct sockaddr sockaddr_t;
 
 #define SXP_POLLIN POLLRDNORM
 #define SXP_POLLOUT POLLWRNORM
+#define SXP_POLLHUP (POLLHUP | POLLNVAL)
+#define SXP_POLLERR POLLERR
 
 #else
 
@@ -38,9 +40,25 @@ typedef struct sockaddr sockaddr_t;
 
 #define SXP_POLLIN POLLIN
 #define SXP_POLLOUT POLLOUT
+#define SXP_POLLHUP (POLLHUP | POLLNVAL)
+#define SXP_POLLERR POLLERR
 
 #endif
 
+/*
+registers a socket with a poller which may receive ahead for it, see
+sxp_poller_recv. Never reported as an event.
+*/
+#define SXP_POLLRECV 0x10000
+
+/*maximum number of buffers accepted by sxp_sendv*/
+#define SXP_IOV_MAX 64
+
+typedef struct sxp_buffer {
+    const char *data;
+    size_t size;
+} sxp_buffer_t;
+
 typedef int sxpResult;
 
 enum sxpresults {
@@ -82,16 +100,215 @@ sxpResult sxp_addrinfo_free(addrinfo_t *info);
 /*server-side API*/
 sxpResult sxp_bind(sxp_t *sock, const sockaddr_t *address, size_t addrlen);
 sxpResult sxp_listen(sxp_t *sock, size_t backlog);
-sxpResult sxp_accept(sxp_t *sock, sxp_t *newsock);
+/*nonblockingio (SXP_BLOCKING or SXP_NONBLOCKING) is applied to newsock*/
+sxpResult sxp_accept(sxp_t *sock, sxp_t *newsock, int nonblockingio);
+
+/*
+unix domain sockets for clients on the same host, failing with
+SXP_ERROR_PLATFORM where they are not available. sxp_unix_address fills
+address with the address of the socket file at path, sxp_unix_unlink removes
+the socket file at path unless a server is still accepting on it.
+*/
+sxpResult sxp_unix_address(struct sockaddr_storage *address, size_t *addrlen,
+                           const char *path);
+sxpResult sxp_unix_unlink(const char *path);
+/*
+passes the file descriptor fd along with a single byte over a connected unix
+domain socket, the receiver owns the duplicate it gets. sxp_recv_fd sets fd
+to -1 if the byte arrived without one and fails with SXP_ERROR_CLOSED once
+the peer has closed the connection.
+*/
+sxpResult sxp_send_fd(sxp_t *sock, int fd);
+sxpResult sxp_recv_fd(sxp_t *sock, int *fd);
 
 /*client-side API*/
+/*returns SXP_ASYNC if a nonblocking socket is still connecting*/
 sxpResult sxp_connect(sxp_t *sock, sockaddr_t *address, size_t addrlen);
+/*result of an asynchronous connect, call once the socket became writable*/
+sxpResult sxp_connect_finish(sxp_t *sock);
 
 /*any-side API*/
-sxpResult sxp_send(sxp_t *sock, const char *data, size_t size);
+/*
+stops sending, the peer reads the end of the stream once it has read
+everything sent before. Receiving is not affected.
+*/
+sxpResult sxp_shutdown(sxp_t *sock);
+/*num_sent may be less than size if the socket buffer is full*/
+sxpResult sxp_send(sxp_t *sock, const char *data, size_t *num_sent,
+                   size_t size);
 sxpResult sxp_recv(sxp_t *sock, char *data, size_t *num_read, size_t size);
+/*gathers up to SXP_IOV_MAX buffers into one send, num_sent may be short*/
+sxpResult sxp_sendv(sxp_t *sock, const sxp_buffer_t buffers[], size_t count,
+                    size_t *num_sent);
+
+/*
+zero copy sending (MSG_ZEROCOPY), only available on linux and failing with
+SXP_ERROR_PLATFORM everywhere else. The kernel reads the data of a zero copy
+send after sxp_send_zerocopy has returned, so it must not be changed or freed
+until sxp_zerocopy_completed has reported the send. Sends are numbered per
+socket, starting at 0 and wrapping around after 0xffffffff. If the kernel
+was not able to pin the data it is copied instead, then pinned is 0 and the
+send has no number.
+*/
+sxpResult sxp_zerocopy_set(sxp_t *sock, int enabled);
+sxpResult sxp_send_zerocopy(sxp_t *sock, const char *data, size_t *num_sent,
+                            size_t size, int *pinned);
+/*
+returns the next range of completed sends from first to last, copied is
+nonzero if the kernel copied their data after all (e.g. over loopback).
+Completions make sockets report SXP_POLLERR, SXP_TRY_AGAIN means that none
+is left.
+*/
+sxpResult sxp_zerocopy_completed(sxp_t *sock, unsigned long *first,
+                                 unsigned long *last, int *copied);
+
+/*
+state of the transport below a connected socket, read from the kernel
+(TCP_INFO) on linux and failing with SXP_ERROR_PLATFORM everywhere else.
+Values the transport does not have, such as the round trip time of a unix
+domain socket, are 0.
+*/
+typedef struct sxp_transport {
+    /*bytes in the socket buffer which the peer has not acknowledged yet*/
+    unsigned long queued;
+    /*smoothed round trip time and its mean deviation in microseconds*/
+    unsigned long rtt;
+    unsigned long rtt_var;
+    /*segments sent again since the connection was established*/
+    unsigned long retransmits;
+    /*congestion window in segments*/
+    unsigned long cwnd;
+} sxp_transport_t;
+
+sxpResult sxp_transport_get(sxp_t *sock, sxp_transport_t *transport);
+
+/*
+creates two connected stream sockets, used to wake up a thread which is
+blocked in sxp_poller_wait by writing to the other end
+*/
+sxpResult sxp_pair(sxp_t pair[2]);
+
+/*milliseconds of a monotonic clock, only differences are meaningful*/
+unsigned long sxp_clock();
 
 sxpResult sxp_poll(size_t /*maybe NULL*/ *results, pollsxp_t sxps[],
                    size_t sxpcount, int timeout);
 
+/*
+readiness notification API. Unlike sxp_poll the set of watched sockets is
+kept by the poller, so that waiting only costs time proportional to the
+number of sockets which are actually ready (epoll where available).
+
+Every socket is registered under a caller chosen key which is reported back
+with its events. Keys must be unique and should be small and dense (e.g. an
+index into a table of connections), as pollers may use them as an index.
+*/
+typedef struct sxp_poller sxp_poller_t;
+
+typedef struct sxp_event {
+    size_t key;
+    /*
+    SXP_POLLIN, SXP_POLLOUT, SXP_POLLHUP and/or SXP_POLLERR, which is either a
+    socket error or a zero copy completion
+    */
+    int events;
+} sxp_event_t;
+
+/*
+kinds of pollers. SXP_POLLER_URING batches all registration changes into the
+system call which waits for events, it is only available on linux kernels
+with io_uring support and fails with SXP_ERROR_PLATFORM everywhere else.
+*/
+enum sxppollers { SXP_POLLER_DEFAULT = 0, SXP_POLLER_URING = 1 };
+
+sxpResult sxp_poller_create(sxp_poller_t **poller, int kind);
+sxpResult sxp_poller_destroy(sxp_poller_t *poller);
+
+sxpResult sxp_poller_add(sxp_poller_t *poller, sxp_t *sock, int events,
+                         size_t key);
+sxpResult sxp_poller_modify(sxp_poller_t *poller, sxp_t *sock, int events,
+                            size_t key);
+sxpResult sxp_poller_remove(sxp_poller_t *poller, sxp_t *sock, size_t key);
+
+sxpResult sxp_poller_wait(sxp_poller_t *poller, sxp_event_t events[],
+                          size_t *count, size_t limit, int timeout);
+/*
+sxp_recv for a socket registered under key. Pollers may receive ahead for
+sockets registered with SXP_POLLRECV (SXP_POLLER_URING does so with a
+multishot receive into buffers of the poller), which then report SXP_POLLIN
+until what they received has been read through this function. Such sockets
+must not be read in any other way until SXP_POLLRECV has been removed again
+with sxp_poller_modify, after which this function returns what was received
+ahead before it reads from the socket. Data still held when the socket is
+removed is dropped.
+*/
+sxpResult sxp_poller_recv(sxp_poller_t *poller, sxp_t *sock, size_t key,
+                          char *data, size_t *num_read, size_t size);
+
+/*
+the functions above call the transport set with sxp_vtable_set, which is
+sxp_platform (the sockets of the operating system) unless another one, such
+as sxp_loopback of loopback.h, has been set. The transport can only be changed
+while no socket or poller exists, sockets of one transport are unknown to
+every other one.
+*/
+typedef struct sxp_vtable {
+    /*
+    nonzero if the functions may be called from several threads at once,
+    netio neither starts io threads nor resolves in the background otherwise
+    */
+    int threads;
+    sxpResult (*init)();
+    sxpResult (*cleanup)();
+    sxpResult (*create)(sxp_t *dst, int family, int type, int protocol);
+    sxpResult (*destroy)(sxp_t *sock);
+    sxpResult (*nbio_set)(sxp_t *sock, int nonblockingio);
+    sxpResult (*addrinfo_get)(addrinfo_t **results, const char *maybe_hostname,
+                              const char *serviceport, addrinfo_t *hints);
+    sxpResult (*addrinfo_free)(addrinfo_t *info);
+    sxpResult (*bind)(sxp_t *sock, const sockaddr_t *address, size_t addrlen);
+    sxpResult (*listen)(sxp_t *sock, size_t backlog);
+    sxpResult (*accept)(sxp_t *sock, sxp_t *newsock, int nonblockingio);
+    sxpResult (*unix_address)(struct sockaddr_storage *address,
+                              size_t *addrlen, const char *path);
+    sxpResult (*unix_unlink)(const char *path);
+    sxpResult (*send_fd)(sxp_t *sock, int fd);
+    sxpResult (*recv_fd)(sxp_t *sock, int *fd);
+    sxpResult (*connect)(sxp_t *sock, sockaddr_t *address, size_t addrlen);
+    sxpResult (*connect_finish)(sxp_t *sock);
+    sxpResult (*shutdown)(sxp_t *sock);
+    sxpResult (*send)(sxp_t *sock, const char *data, size_t *num_sent,
+                      size_t size);
+    sxpResult (*recv)(sxp_t *sock, char *data, size_t *num_read, size_t size);
+    sxpResult (*sendv)(sxp_t *sock, const sxp_buffer_t buffers[], size_t count,
+                       size_t *num_sent);
+    sxpResult (*zerocopy_set)(sxp_t *sock, int enabled);
+    sxpResult (*send_zerocopy)(sxp_t *sock, const char *data, size_t *num_sent,
+                               size_t size, int *pinned);
+    sxpResult (*zerocopy_completed)(sxp_t *sock, unsigned long *first,
+                                    unsigned long *last, int *copied);
+    sxpResult (*transport_get)(sxp_t *sock, sxp_transport_t *transport);
+    sxpResult (*pair)(sxp_t pair[2]);
+    unsigned long (*clock)();
+    sxpResult (*poll)(size_t *results, pollsxp_t sxps[], size_t sxpcount,
+                      int timeout);
+    sxpResult (*poller_create)(sxp_poller_t **poller, int kind);
+    sxpResult (*poller_destroy)(sxp_poller_t *poller);
+    sxpResult (*poller_add)(sxp_poller_t *poller, sxp_t *sock, int events,
+                            size_t key);
+    sxpResult (*poller_modify)(sxp_poller_t *poller, sxp_t *sock, int events,
+                               size_t key);
+    sxpResult (*poller_remove)(sxp_poller_t *poller, sxp_t *sock, size_t key);
+    sxpResult (*poller_wait)(sxp_poller_t *poller, sxp_event_t events[],
+                             size_t *count, size_t limit, int timeout);
+    sxpResult (*poller_recv)(sxp_poller_t *poller, sxp_t *sock, size_t key,
+                             char *data, size_t *num_read, size_t size);
+} sxp_vtable_t;
+
+extern const sxp_vtable_t sxp_platform;
+
+/*NULL sets sxp_platform again*/
+sxpResult sxp_vtable_set(const sxp_vtable_t *vtable);
+const sxp_vtable_t *sxp_vtable_get();
+
 #endif /*SOCKETXP_H_*/
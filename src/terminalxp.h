@@ -42,4 +42,12 @@ txpResult txp_send(const char *str);
 txpResult txp_recv(char *buffer, size_t *nread, size_t blen);
 txpResult txp_flush();
 
+/*
+file descriptors which become readable whenever txp_recv has something to
+return, including changes of the window size, so that a caller can sleep
+until there is input. Fails where console input can only be polled.
+*/
+#define TXP_WAIT_MAX 2
+txpResult txp_wait_get(int fds[TXP_WAIT_MAX], size_t *count);
+
 #endif /*TERMINALXP_H_*/
@@ -0,0 +1,38 @@
+#ifndef THREADXP_H_
+#define THREADXP_H_
+
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+
+#include <windows.h>
+
+typedef HANDLE thxp_thread_t;
+
+#else
+
+#if !defined(_POSIX_C_SOURCE) || _POSIX_C_SOURCE < 200112L
+#define _POSIX_C_SOURCE 200112L
+#define _POSIX_SOURCE 1
+#endif /*_POSIX_C_SOURCE*/
+
+#include <pthread.h>
+
+typedef pthread_t thxp_thread_t;
+
+#endif /*WIN32*/
+
+typedef int thxpResult;
+
+enum thxpresults { THXP_SUCCESS = 0, THXP_ERROR = -1 };
+
+typedef void (*thxp_routine_t)(void *argument);
+
+thxpResult thxp_create(thxp_thread_t *thread, thxp_routine_t routine,
+                       void *argument);
+thxpResult thxp_join(thxp_thread_t *thread);
+/*the thread releases its resources on exit and can no longer be joined*/
+thxpResult thxp_detach(thxp_thread_t *thread);
+
+/*number of processors available to the process, at least 1*/
+unsigned int thxp_cpu_count();
+
+#endif /*THREADXP_H_*/
@@ -0,0 +1,152 @@
+/*memfd_create() is not part of POSIX*/
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#if !defined(_POSIX_C_SOURCE) || _POSIX_C_SOURCE < 200112L
+#define _POSIX_C_SOURCE 200112L
+#define _POSIX_SOURCE 1
+#endif /*_POSIX_C_SOURCE*/
+
+#include "shmxp.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+/*neither process can change the size of the region under the other one*/
+#define SHMXP_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+#endif
+
+static shmxpResult shmxp_map(shmxp_region_t *region, int fd, size_t size);
+static int shmxp_open();
+
+shmxpResult shmxp_create(shmxp_region_t *region, size_t size)
+{
+    shmxpResult result;
+    int fd;
+
+    if (!region || !size || size % SHMXP_HEADER_SIZE)
+        return SHMXP_ERROR_INVAL;
+    if ((fd = shmxp_open()) < 0)
+        return SHMXP_ERROR;
+    if (ftruncate(fd, SHMXP_HEADER_SIZE + SHMXP_RINGS * size) < 0) {
+        close(fd);
+        return SHMXP_ERROR;
+    }
+#ifdef SHMXP_SEALS
+    if (fcntl(fd, F_ADD_SEALS, SHMXP_SEALS) < 0) {
+        close(fd);
+        return SHMXP_ERROR;
+    }
+#endif
+    if ((result = shmxp_map(region, fd, size)) != SHMXP_SUCCESS)
+        close(fd);
+    return result;
+}
+
+shmxpResult shmxp_attach(shmxp_region_t *region, int fd)
+{
+    struct stat status;
+    size_t size;
+    shmxpResult result;
+#ifdef SHMXP_SEALS
+    int seals;
+#endif
+
+    if (!region || fd < 0)
+        return SHMXP_ERROR_INVAL;
+#ifdef SHMXP_SEALS
+    /*a region the other process could still shrink faults once it does*/
+    seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & SHMXP_SEALS) != SHMXP_SEALS) {
+        close(fd);
+        return SHMXP_ERROR_INVAL;
+    }
+#endif
+    if (fstat(fd, &status) < 0 || status.st_size <= SHMXP_HEADER_SIZE) {
+        close(fd);
+        return SHMXP_ERROR_INVAL;
+    }
+    size = ((size_t)status.st_size - SHMXP_HEADER_SIZE) / SHMXP_RINGS;
+    if (!size || size % SHMXP_HEADER_SIZE ||
+        SHMXP_HEADER_SIZE + SHMXP_RINGS * size != (size_t)status.st_size) {
+        close(fd);
+        return SHMXP_ERROR_INVAL;
+    }
+    if ((result = shmxp_map(region, fd, size)) != SHMXP_SUCCESS)
+        close(fd);
+    return result;
+}
+
+shmxpResult shmxp_destroy(shmxp_region_t *region)
+{
+    if (!region || !region->base)
+        return SHMXP_ERROR_INVAL;
+    munmap(region->base, region->length);
+    close(region->fd);
+    memset(region, 0, sizeof(*region));
+    return SHMXP_SUCCESS;
+}
+
+/*
+reserves the address space with an inaccessible mapping of fd (anonymous
+mappings are not part of POSIX), then maps the parts of fd over it
+*/
+static shmxpResult shmxp_map(shmxp_region_t *region, int fd, size_t size)
+{
+    char *base;
+    size_t length = SHMXP_HEADER_SIZE + 2 * SHMXP_RINGS * size;
+    size_t idx;
+
+    base = mmap(NULL, length, PROT_NONE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return SHMXP_ERROR;
+    if (mmap(base, SHMXP_HEADER_SIZE, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+        goto fail;
+    for (idx = 0; idx < 2 * SHMXP_RINGS; idx++) {
+        if (mmap(base + SHMXP_HEADER_SIZE + idx * size, size,
+                 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+                 SHMXP_HEADER_SIZE + idx / 2 * size) == MAP_FAILED)
+            goto fail;
+    }
+
+    region->fd = fd;
+    region->size = size;
+    region->header = base;
+    for (idx = 0; idx < SHMXP_RINGS; idx++)
+        region->rings[idx] = base + SHMXP_HEADER_SIZE + 2 * idx * size;
+    region->base = base;
+    region->length = length;
+    return SHMXP_SUCCESS;
+fail:
+    munmap(base, length);
+    return SHMXP_ERROR;
+}
+
+static int shmxp_open()
+{
+#ifdef __linux__
+    return memfd_create("sechat", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    char name[64];
+    unsigned int attempt;
+    int fd;
+
+    /*the name is only needed until the object is unlinked again*/
+    for (attempt = 0; attempt < 16; attempt++) {
+        sprintf(name, "/sechat-%ld-%lu-%u", (long)getpid(),
+                (unsigned long)time(NULL), attempt);
+        if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+            continue;
+        shm_unlink(name);
+        return fd;
+    }
+    return -1;
+#endif
+}
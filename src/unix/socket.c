@@ -1,20 +1,69 @@
+/*accept4() is not part of POSIX*/
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include "socketxp.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+
+#ifdef __linux__
+#include "uring.h"
+#include <linux/errqueue.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#endif
+
+/*
+the poll() based poller of the other unix systems replaces epoll on linux as
+well if SXP_POLL_FALLBACK is defined, which the benchmarks use to compare them
+*/
+#if defined(__linux__) && !defined(SXP_POLL_FALLBACK)
+#define SXP_EPOLL
+#endif
+
+struct sxp_poller {
+#ifdef SXP_EPOLL
+    /*used instead of epoll if the poller was created as SXP_POLLER_URING*/
+    sxp_uring_t *uring;
+    int epoll;
+    struct epoll_event *ready;
+    size_t ready_capacity;
+#else
+    pollsxp_t *list;
+    /*key of every entry in list*/
+    size_t *keys;
+    size_t count;
+    size_t capacity;
+    /*index into list for every key*/
+    size_t *slots;
+    size_t slot_count;
+    /*entry of list to look at first, so that no socket is left behind*/
+    size_t next;
+#endif
+};
 
 static sxpResult sxp_map_eai_error(int error, int system_errno);
 static sxpResult sxp_map_error(int error);
 
-sxpResult sxp_init()
+static sxpResult platform_init()
 {
     return SXP_SUCCESS;
 }
-sxpResult sxp_cleanup()
+static sxpResult platform_cleanup()
 {
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_create(sxp_t *dst, int family, int type, int protocol)
+static sxpResult platform_create(sxp_t *dst, int family, int type, int protocol)
 {
     int sock;
     if (!dst)
@@ -26,7 +75,7 @@ sxpResult sxp_create(sxp_t *dst, int family, int type, int protocol)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_destroy(sxp_t *sock)
+static sxpResult platform_destroy(sxp_t *sock)
 {
     if (!sock)
         return SXP_ERROR_INVAL;
@@ -35,7 +84,7 @@ sxpResult sxp_destroy(sxp_t *sock)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_nbio_set(sxp_t *sock, int nonblockingio)
+static sxpResult platform_nbio_set(sxp_t *sock, int nonblockingio)
 {
     long int enabler = nonblockingio == SXP_NONBLOCKING ? O_NONBLOCK : 0;
     long int disabler = nonblockingio == SXP_BLOCKING ? ~O_NONBLOCK : ~0;
@@ -47,8 +96,10 @@ sxpResult sxp_nbio_set(sxp_t *sock, int nonblockingio)
     }
     return SXP_SUCCESS;
 }
-sxpResult sxp_addrinfo_get(addrinfo_t **results, const char *maybe_hostname,
-                           const char *serviceport, addrinfo_t *hints)
+static sxpResult platform_addrinfo_get(addrinfo_t **results,
+                                       const char *maybe_hostname,
+                                       const char *serviceport,
+                                       addrinfo_t *hints)
 {
     int result = getaddrinfo(maybe_hostname, serviceport, hints, results);
     if (result != 0) {
@@ -57,14 +108,15 @@ sxpResult sxp_addrinfo_get(addrinfo_t **results, const char *maybe_hostname,
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_addrinfo_free(addrinfo_t *info)
+static sxpResult platform_addrinfo_free(addrinfo_t *info)
 {
     freeaddrinfo(info);
     return SXP_SUCCESS;
 }
 
 /*server-side API*/
-sxpResult sxp_bind(sxp_t *sock, const sockaddr_t *address, size_t addrlen)
+static sxpResult platform_bind(sxp_t *sock, const sockaddr_t *address,
+                               size_t addrlen)
 {
     int yes = 1;
     if (!sock)
@@ -76,7 +128,7 @@ sxpResult sxp_bind(sxp_t *sock, const sockaddr_t *address, size_t addrlen)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_listen(sxp_t *sock, size_t backlog)
+static sxpResult platform_listen(sxp_t *sock, size_t backlog)
 {
     if (!sock)
         return SXP_ERROR_INVAL;
@@ -85,20 +137,36 @@ sxpResult sxp_listen(sxp_t *sock, size_t backlog)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_accept(sxp_t *sock, sxp_t *newsock)
+static sxpResult platform_accept(sxp_t *sock, sxp_t *newsock, int nonblockingio)
 {
     int socket;
     if (!sock || !newsock)
         return SXP_ERROR_INVAL;
+#if defined(__linux__) && defined(SOCK_NONBLOCK)
+    /*saves the additional fcntl calls of sxp_nbio_set*/
+    socket = accept4(*sock, NULL, NULL,
+                     nonblockingio == SXP_NONBLOCKING ? SOCK_NONBLOCK : 0);
+    if (socket < 0)
+        return sxp_map_error(errno);
+#else
     socket = accept(*sock, NULL, NULL);
     if (socket < 0)
         return sxp_map_error(errno);
+    if (nonblockingio == SXP_NONBLOCKING) {
+        sxpResult result = platform_nbio_set(&socket, SXP_NONBLOCKING);
+        if (result != SXP_SUCCESS) {
+            close(socket);
+            return result;
+        }
+    }
+#endif
     *newsock = socket;
     return SXP_SUCCESS;
 }
 
 /*client-side API*/
-sxpResult sxp_connect(sxp_t *sock, sockaddr_t *address, size_t addrlen)
+static sxpResult platform_connect(sxp_t *sock, sockaddr_t *address,
+                                  size_t addrlen)
 {
     if (!sock)
         return SXP_ERROR_INVAL;
@@ -107,17 +175,148 @@ sxpResult sxp_connect(sxp_t *sock, sockaddr_t *address, size_t addrlen)
     return SXP_SUCCESS;
 }
 
-/*any-side API*/
-sxpResult sxp_send(sxp_t *sock, const char *data, size_t size)
+static sxpResult platform_connect_finish(sxp_t *sock)
+{
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (!sock)
+        return SXP_ERROR_INVAL;
+    if (getsockopt(*sock, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+        return sxp_map_error(errno);
+    if (error)
+        return sxp_map_error(error);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_shutdown(sxp_t *sock)
 {
     if (!sock)
         return SXP_ERROR_INVAL;
-    if (send(*sock, data, size, MSG_NOSIGNAL) < 0)
+    if (shutdown(*sock, SHUT_WR) < 0)
+        return sxp_map_error(errno);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_unix_address(struct sockaddr_storage *address,
+                                       size_t *addrlen, const char *path)
+{
+    struct sockaddr_un *local = (struct sockaddr_un *)address;
+    size_t length;
+    if (!address || !addrlen || !path)
+        return SXP_ERROR_INVAL;
+    length = strlen(path);
+    if (!length || length >= sizeof(local->sun_path))
+        return SXP_ERROR_INVAL;
+    memset(address, 0, sizeof(*address));
+    local->sun_family = AF_UNIX;
+    memcpy(local->sun_path, path, length + 1);
+    *addrlen = sizeof(*local);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_unix_unlink(const char *path)
+{
+    struct sockaddr_storage address;
+    size_t addrlen;
+    struct stat status;
+    sxpResult result;
+    int probe;
+
+    if ((result = platform_unix_address(&address, &addrlen, path)) !=
+        SXP_SUCCESS)
+        return result;
+    if (lstat(path, &status) < 0)
+        return errno == ENOENT ? SXP_SUCCESS : sxp_map_error(errno);
+    if (!S_ISSOCK(status.st_mode))
+        return SXP_ERROR_INVAL;
+
+    /*only a file nobody accepts on anymore is stale*/
+    if ((probe = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return sxp_map_error(errno);
+    if (fcntl(probe, F_SETFL, O_NONBLOCK) < 0 ||
+        connect(probe, (sockaddr_t *)&address, addrlen) == 0 ||
+        errno != ECONNREFUSED) {
+        close(probe);
+        return SXP_ERROR_INVAL;
+    }
+    close(probe);
+    if (unlink(path) < 0)
+        return sxp_map_error(errno);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_send_fd(sxp_t *sock, int fd)
+{
+    char control[CMSG_SPACE(sizeof(int))];
+    char byte = 0;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    if (!sock || fd < 0)
+        return SXP_ERROR_INVAL;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    if (sendmsg(*sock, &msg, MSG_NOSIGNAL) < 0)
+        return sxp_map_error(errno);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_recv_fd(sxp_t *sock, int *fd)
+{
+    char control[CMSG_SPACE(sizeof(int))];
+    char byte;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    ssize_t received;
+    if (!sock || !fd)
+        return SXP_ERROR_INVAL;
+    *fd = -1;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if ((received = recvmsg(*sock, &msg, 0)) < 0)
         return sxp_map_error(errno);
+    if (!received)
+        return SXP_ERROR_CLOSED;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    }
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_recv(sxp_t *sock, char *data, size_t *num_read, size_t size)
+/*any-side API*/
+static sxpResult platform_send(sxp_t *sock, const char *data, size_t *num_sent,
+                               size_t size)
+{
+    ssize_t sent;
+    if (!sock || !num_sent)
+        return SXP_ERROR_INVAL;
+    if ((sent = send(*sock, data, size, MSG_NOSIGNAL)) < 0)
+        return sxp_map_error(errno);
+    *num_sent = sent;
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_recv(sxp_t *sock, char *data, size_t *num_read,
+                               size_t size)
 {
     ssize_t read;
     if (!sock || !data || !num_read)
@@ -128,21 +327,490 @@ sxpResult sxp_recv(sxp_t *sock, char *data, size_t *num_read, size_t size)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_poll(size_t /*maybe NULL*/ *results, pollsxp_t sxps[],
-                   size_t sxpcount, int timeout)
+static sxpResult platform_sendv(sxp_t *sock, const sxp_buffer_t buffers[],
+                                size_t count, size_t *num_sent)
+{
+    struct iovec iov[SXP_IOV_MAX];
+    struct msghdr msg;
+    ssize_t sent;
+    size_t idx;
+    if (!sock || !buffers || !num_sent)
+        return SXP_ERROR_INVAL;
+    if (count > SXP_IOV_MAX)
+        return SXP_TOO_BIG;
+    for (idx = 0; idx < count; idx++) {
+        iov[idx].iov_base = (void *)buffers[idx].data;
+        iov[idx].iov_len = buffers[idx].size;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    if ((sent = sendmsg(*sock, &msg, MSG_NOSIGNAL)) < 0)
+        return sxp_map_error(errno);
+    *num_sent = sent;
+    return SXP_SUCCESS;
+}
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+
+static sxpResult platform_zerocopy_set(sxp_t *sock, int enabled)
+{
+    int value = enabled ? 1 : 0;
+    if (!sock)
+        return SXP_ERROR_INVAL;
+    if (setsockopt(*sock, SOL_SOCKET, SO_ZEROCOPY, &value, sizeof(value)) < 0)
+        return errno == ENOPROTOOPT ? SXP_ERROR_PLATFORM : sxp_map_error(errno);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_send_zerocopy(sxp_t *sock, const char *data,
+                                        size_t *num_sent, size_t size,
+                                        int *pinned)
+{
+    ssize_t sent;
+    if (!sock || !num_sent || !pinned)
+        return SXP_ERROR_INVAL;
+    *pinned = 1;
+    sent = send(*sock, data, size, MSG_NOSIGNAL | MSG_ZEROCOPY);
+    /*no memory left to track the pages, the send is not numbered*/
+    if (sent < 0 && errno == ENOBUFS) {
+        *pinned = 0;
+        sent = send(*sock, data, size, MSG_NOSIGNAL);
+    }
+    if (sent < 0)
+        return sxp_map_error(errno);
+    *num_sent = sent;
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_zerocopy_completed(sxp_t *sock, unsigned long *first,
+                                             unsigned long *last, int *copied)
+{
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err) +
+                            sizeof(struct sockaddr_in6))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct sock_extended_err error;
+    if (!sock || !first || !last || !copied)
+        return SXP_ERROR_INVAL;
+    /*other errors queued on the socket are skipped*/
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(*sock, &msg, MSG_ERRQUEUE) < 0)
+            return sxp_map_error(errno);
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!(cmsg->cmsg_level == SOL_IP &&
+                  cmsg->cmsg_type == IP_RECVERR) &&
+                !(cmsg->cmsg_level == SOL_IPV6 &&
+                  cmsg->cmsg_type == IPV6_RECVERR))
+                continue;
+            memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+            if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY || error.ee_errno)
+                continue;
+            *first = error.ee_info;
+            *last = error.ee_data;
+            *copied = error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+            return SXP_SUCCESS;
+        }
+    }
+}
+
+#else
+
+static sxpResult platform_zerocopy_set(sxp_t *sock, int enabled)
+{
+    (void)sock;
+    (void)enabled;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_send_zerocopy(sxp_t *sock, const char *data,
+                                        size_t *num_sent, size_t size,
+                                        int *pinned)
+{
+    (void)sock;
+    (void)data;
+    (void)num_sent;
+    (void)size;
+    (void)pinned;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_zerocopy_completed(sxp_t *sock, unsigned long *first,
+                                             unsigned long *last, int *copied)
+{
+    (void)sock;
+    (void)first;
+    (void)last;
+    (void)copied;
+    return SXP_ERROR_PLATFORM;
+}
+
+#endif /*__linux__ && SO_ZEROCOPY && MSG_ZEROCOPY*/
+
+#if defined(__linux__) && defined(TCP_INFO) && defined(SIOCOUTQ)
+
+static sxpResult platform_transport_get(sxp_t *sock, sxp_transport_t *transport)
+{
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+    int queued;
+    if (!sock || !transport)
+        return SXP_ERROR_INVAL;
+    memset(transport, 0, sizeof(*transport));
+    if (ioctl(*sock, SIOCOUTQ, &queued) < 0)
+        return sxp_map_error(errno);
+    transport->queued = queued;
+    /*not a tcp socket, it has nothing else to report*/
+    if (getsockopt(*sock, IPPROTO_TCP, TCP_INFO, &info, &length) < 0)
+        return errno == EOPNOTSUPP || errno == ENOPROTOOPT ?
+                   SXP_SUCCESS :
+                   sxp_map_error(errno);
+    transport->rtt = info.tcpi_rtt;
+    transport->rtt_var = info.tcpi_rttvar;
+    transport->retransmits = info.tcpi_total_retrans;
+    transport->cwnd = info.tcpi_snd_cwnd;
+    return SXP_SUCCESS;
+}
+
+#else
+
+static sxpResult platform_transport_get(sxp_t *sock, sxp_transport_t *transport)
+{
+    (void)sock;
+    (void)transport;
+    return SXP_ERROR_PLATFORM;
+}
+
+#endif /*__linux__ && TCP_INFO && SIOCOUTQ*/
+
+static sxpResult platform_pair(sxp_t pair[2])
+{
+    if (!pair)
+        return SXP_ERROR_INVAL;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+        return sxp_map_error(errno);
+    return SXP_SUCCESS;
+}
+
+static unsigned long platform_clock()
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+        return 0;
+    return (unsigned long)now.tv_sec * 1000UL +
+           (unsigned long)now.tv_nsec / 1000000UL;
+}
+
+static sxpResult platform_poll(size_t /*maybe NULL*/ *results, pollsxp_t sxps[],
+                               size_t sxpcount, int timeout)
 {
     ssize_t result;
     if (!sxpcount)
         return SXP_TRY_AGAIN;
     if (!sxps)
         return SXP_ERROR_INVAL;
-    if ((result = poll(sxps, sxpcount, timeout)) < 0)
+    if ((result = poll(sxps, sxpcount, timeout)) < 0) {
+        /*interrupted by a signal handler*/
+        if (errno == EINTR)
+            return SXP_TRY_AGAIN;
         return sxp_map_error(errno);
+    }
     if (results)
         *results = result;
     return result > 0 ? SXP_SUCCESS : SXP_TRY_AGAIN;
 }
 
+#ifdef SXP_EPOLL
+
+static unsigned int sxp_poller_events_to_epoll(int events)
+{
+    unsigned int result = 0;
+    if (events & SXP_POLLIN)
+        result |= EPOLLIN;
+    if (events & SXP_POLLOUT)
+        result |= EPOLLOUT;
+    return result;
+}
+
+static int sxp_poller_events_from_epoll(unsigned int events)
+{
+    int result = 0;
+    if (events & EPOLLIN)
+        result |= SXP_POLLIN;
+    if (events & EPOLLOUT)
+        result |= SXP_POLLOUT;
+    if (events & EPOLLHUP)
+        result |= SXP_POLLHUP;
+    if (events & EPOLLERR)
+        result |= SXP_POLLERR;
+    return result;
+}
+
+static sxpResult platform_poller_create(sxp_poller_t **poller, int kind)
+{
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    if (!(*poller = malloc(sizeof(**poller))))
+        return SXP_ERROR_MEMORY;
+    memset(*poller, 0, sizeof(**poller));
+    if (kind == SXP_POLLER_URING) {
+        sxpResult result = sxp_uring_create(&(*poller)->uring);
+        if (result != SXP_SUCCESS) {
+            free(*poller);
+            *poller = NULL;
+        }
+        return result;
+    }
+    if (((*poller)->epoll = epoll_create(1)) < 0) {
+        sxpResult result = sxp_map_error(errno);
+        free(*poller);
+        *poller = NULL;
+        return result;
+    }
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_destroy(sxp_poller_t *poller)
+{
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    if (poller->uring)
+        sxp_uring_destroy(poller->uring);
+    else
+        close(poller->epoll);
+    free(poller->ready);
+    free(poller);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_add(sxp_poller_t *poller, sxp_t *sock,
+                                     int events, size_t key)
+{
+    struct epoll_event event;
+    if (!poller || !sock)
+        return SXP_ERROR_INVAL;
+    if (poller->uring)
+        return sxp_uring_add(poller->uring, sock, events, key);
+    memset(&event, 0, sizeof(event));
+    event.events = sxp_poller_events_to_epoll(events);
+    event.data.u64 = key;
+    if (epoll_ctl(poller->epoll, EPOLL_CTL_ADD, *sock, &event) < 0)
+        return sxp_map_error(errno);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_modify(sxp_poller_t *poller, sxp_t *sock,
+                                        int events, size_t key)
+{
+    struct epoll_event event;
+    if (!poller || !sock)
+        return SXP_ERROR_INVAL;
+    if (poller->uring)
+        return sxp_uring_modify(poller->uring, sock, events, key);
+    memset(&event, 0, sizeof(event));
+    event.events = sxp_poller_events_to_epoll(events);
+    event.data.u64 = key;
+    if (epoll_ctl(poller->epoll, EPOLL_CTL_MOD, *sock, &event) < 0)
+        return sxp_map_error(errno);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_remove(sxp_poller_t *poller, sxp_t *sock,
+                                        size_t key)
+{
+    struct epoll_event event;
+    if (!poller || !sock)
+        return SXP_ERROR_INVAL;
+    if (poller->uring)
+        return sxp_uring_remove(poller->uring, sock, key);
+    /*kernels before 2.6.9 require a non-null event for EPOLL_CTL_DEL*/
+    memset(&event, 0, sizeof(event));
+    if (epoll_ctl(poller->epoll, EPOLL_CTL_DEL, *sock, &event) < 0)
+        return sxp_map_error(errno);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_wait(sxp_poller_t *poller,
+                                      sxp_event_t events[], size_t *count,
+                                      size_t limit, int timeout)
+{
+    int result;
+    int idx;
+    if (!poller || !events || !count || !limit)
+        return SXP_ERROR_INVAL;
+    if (poller->uring)
+        return sxp_uring_wait(poller->uring, events, count, limit, timeout);
+    if (poller->ready_capacity < limit) {
+        struct epoll_event *ready =
+            realloc(poller->ready, limit * sizeof(*ready));
+        if (!ready)
+            return SXP_ERROR_MEMORY;
+        poller->ready = ready;
+        poller->ready_capacity = limit;
+    }
+    *count = 0;
+    if ((result = epoll_wait(poller->epoll, poller->ready, limit, timeout)) <
+        0) {
+        if (errno == EINTR)
+            return SXP_TRY_AGAIN;
+        return sxp_map_error(errno);
+    }
+    for (idx = 0; idx < result; idx++) {
+        events[idx].key = poller->ready[idx].data.u64;
+        events[idx].events =
+            sxp_poller_events_from_epoll(poller->ready[idx].events);
+    }
+    *count = result;
+    return result > 0 ? SXP_SUCCESS : SXP_TRY_AGAIN;
+}
+
+#else
+
+static sxpResult platform_poller_create(sxp_poller_t **poller, int kind)
+{
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    if (kind != SXP_POLLER_DEFAULT)
+        return SXP_ERROR_PLATFORM;
+    if (!(*poller = malloc(sizeof(**poller))))
+        return SXP_ERROR_MEMORY;
+    memset(*poller, 0, sizeof(**poller));
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_destroy(sxp_poller_t *poller)
+{
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    free(poller->list);
+    free(poller->keys);
+    free(poller->slots);
+    free(poller);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_add(sxp_poller_t *poller, sxp_t *sock,
+                                     int events, size_t key)
+{
+    if (!poller || !sock)
+        return SXP_ERROR_INVAL;
+    if (poller->count == poller->capacity) {
+        size_t capacity = poller->capacity ? poller->capacity * 2 : 16;
+        pollsxp_t *list = realloc(poller->list, capacity * sizeof(*list));
+        size_t *keys;
+        if (!list)
+            return SXP_ERROR_MEMORY;
+        poller->list = list;
+        if (!(keys = realloc(poller->keys, capacity * sizeof(*keys))))
+            return SXP_ERROR_MEMORY;
+        poller->keys = keys;
+        poller->capacity = capacity;
+    }
+    if (key >= poller->slot_count) {
+        size_t slot_count = poller->slot_count ? poller->slot_count : 16;
+        size_t *slots;
+        while (slot_count <= key)
+            slot_count *= 2;
+        if (!(slots = realloc(poller->slots, slot_count * sizeof(*slots))))
+            return SXP_ERROR_MEMORY;
+        poller->slots = slots;
+        poller->slot_count = slot_count;
+    }
+    poller->list[poller->count].fd = *sock;
+    poller->list[poller->count].events =
+        events & (SXP_POLLIN | SXP_POLLOUT);
+    poller->list[poller->count].revents = 0;
+    poller->keys[poller->count] = key;
+    poller->slots[key] = poller->count;
+    poller->count++;
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_modify(sxp_poller_t *poller, sxp_t *sock,
+                                        int events, size_t key)
+{
+    size_t slot;
+    if (!poller || !sock || key >= poller->slot_count)
+        return SXP_ERROR_INVAL;
+    slot = poller->slots[key];
+    if (slot >= poller->count || poller->list[slot].fd != *sock)
+        return SXP_ERROR_INVAL;
+    poller->list[slot].events = events & (SXP_POLLIN | SXP_POLLOUT);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_remove(sxp_poller_t *poller, sxp_t *sock,
+                                        size_t key)
+{
+    size_t slot;
+    if (!poller || !sock || key >= poller->slot_count)
+        return SXP_ERROR_INVAL;
+    slot = poller->slots[key];
+    if (slot >= poller->count || poller->list[slot].fd != *sock)
+        return SXP_ERROR_INVAL;
+    poller->count--;
+    poller->list[slot] = poller->list[poller->count];
+    poller->keys[slot] = poller->keys[poller->count];
+    poller->slots[poller->keys[slot]] = slot;
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_wait(sxp_poller_t *poller,
+                                      sxp_event_t events[], size_t *count,
+                                      size_t limit, int timeout)
+{
+    size_t ready;
+    size_t seen;
+    sxpResult result;
+    if (!poller || !events || !count || !limit)
+        return SXP_ERROR_INVAL;
+    *count = 0;
+    if (!poller->count) {
+        if (timeout > 0)
+            poll(NULL, 0, timeout);
+        return SXP_TRY_AGAIN;
+    }
+    if ((result = platform_poll(&ready, poller->list, poller->count,
+                                timeout)) != SXP_SUCCESS)
+        return result;
+    for (seen = 0; seen < poller->count && *count < limit; seen++) {
+        size_t idx = (poller->next + seen) % poller->count;
+        int revents = poller->list[idx].revents;
+        if (!revents)
+            continue;
+        events[*count].key = poller->keys[idx];
+        events[*count].events = revents & (SXP_POLLIN | SXP_POLLOUT);
+        if (revents & SXP_POLLHUP)
+            events[*count].events |= SXP_POLLHUP;
+        if (revents & SXP_POLLERR)
+            events[*count].events |= SXP_POLLERR;
+        *count += 1;
+    }
+    poller->next = (poller->next + seen) % poller->count;
+    return *count > 0 ? SXP_SUCCESS : SXP_TRY_AGAIN;
+}
+
+#endif /*SXP_EPOLL*/
+
+static sxpResult platform_poller_recv(sxp_poller_t *poller, sxp_t *sock,
+                                      size_t key, char *data,
+                                      size_t *num_read, size_t size)
+{
+    if (!poller)
+        return SXP_ERROR_INVAL;
+#ifdef SXP_EPOLL
+    /*only io_uring receives ahead, and only for sockets which asked for it*/
+    if (poller->uring && sxp_uring_receiving(poller->uring, key))
+        return sxp_uring_recv(poller->uring, sock, key, data, num_read, size);
+#else
+    (void)key;
+#endif
+    return platform_recv(sock, data, num_read, size);
+}
+
 static sxpResult sxp_map_eai_error(int error, int system_errno)
 {
     switch (error) {
@@ -224,3 +892,16 @@ static sxpResult sxp_map_error(int error)
     }
     return SXP_ERROR_UNKNOWN;
 }
+
+const sxp_vtable_t sxp_platform = {
+    1, platform_init, platform_cleanup, platform_create, platform_destroy,
+    platform_nbio_set, platform_addrinfo_get, platform_addrinfo_free,
+    platform_bind, platform_listen, platform_accept, platform_unix_address,
+    platform_unix_unlink, platform_send_fd, platform_recv_fd, platform_connect,
+    platform_connect_finish, platform_shutdown, platform_send, platform_recv,
+    platform_sendv, platform_zerocopy_set, platform_send_zerocopy,
+    platform_zerocopy_completed, platform_transport_get, platform_pair,
+    platform_clock, platform_poll, platform_poller_create,
+    platform_poller_destroy, platform_poller_add, platform_poller_modify,
+    platform_poller_remove, platform_poller_wait, platform_poller_recv
+};
@@ -1,16 +1,39 @@
 #include "terminalxp.h"
+#include <errno.h>
+#include <signal.h>
+#include <sys/ioctl.h>
 
 static int terminal_fd = -1;
 static term_state_t terminal_reset_state = { 0 };
+/*self-pipe written by the SIGWINCH handler*/
+static int terminal_resize[2] = { -1, -1 };
+
+static void terminal_resized(int signal);
+static txpResult terminal_size_get(char *buffer, size_t *nread, size_t blen);
 
 txpResult txp_init()
 {
+    struct sigaction action;
     if ((terminal_fd = open("/dev/tty", O_RDWR | O_NONBLOCK)) < 0)
         return TXP_ERROR;
+    if (pipe(terminal_resize) < 0)
+        return TXP_ERROR;
+    if (fcntl(terminal_resize[0], F_SETFL, O_NONBLOCK) < 0 ||
+        fcntl(terminal_resize[1], F_SETFL, O_NONBLOCK) < 0)
+        return TXP_ERROR;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = terminal_resized;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGWINCH, &action, NULL) < 0)
+        return TXP_ERROR;
     return TXP_SUCCESS;
 }
 txpResult txp_exit()
 {
+    signal(SIGWINCH, SIG_DFL);
+    close(terminal_resize[0]);
+    close(terminal_resize[1]);
     if (close(terminal_fd) < 0)
         return TXP_ERROR;
     return TXP_SUCCESS;
@@ -72,6 +95,13 @@ txpResult txp_send(const char *str)
 txpResult txp_recv(char *buffer, size_t *nread, size_t blen)
 {
     ssize_t status;
+    char drain[16];
+    int resized = 0;
+    while (read(terminal_resize[0], drain, sizeof(drain)) > 0)
+        resized = 1;
+    /*reported like the answer to a cursor position request*/
+    if (resized && terminal_size_get(buffer, nread, blen) == TXP_SUCCESS)
+        return TXP_SUCCESS;
     if ((status = read(terminal_fd, buffer, blen)) < 0)
         return TXP_ERROR;
     *nread = status;
@@ -86,3 +116,37 @@ txpResult txp_flush()
         return TXP_ERROR;
     return TXP_SUCCESS;
 }
+
+txpResult txp_wait_get(int fds[TXP_WAIT_MAX], size_t *count)
+{
+    fds[0] = terminal_fd;
+    fds[1] = terminal_resize[0];
+    *count = 2;
+    return TXP_SUCCESS;
+}
+
+static void terminal_resized(int signal)
+{
+    int error = errno;
+    /*fails only if the pipe is full, which already reports the resize*/
+    ssize_t written = write(terminal_resize[1], "", 1);
+    (void)signal;
+    (void)written;
+    errno = error;
+}
+
+static txpResult terminal_size_get(char *buffer, size_t *nread, size_t blen)
+{
+    struct winsize size;
+    char report[32];
+    if (ioctl(terminal_fd, TIOCGWINSZ, &size) < 0 || !size.ws_row ||
+        !size.ws_col)
+        return TXP_ERROR;
+    sprintf(report, "\033[%u;%uR", (unsigned int)size.ws_row,
+            (unsigned int)size.ws_col);
+    if (strlen(report) > blen)
+        return TXP_ERROR;
+    memcpy(buffer, report, strlen(report));
+    *nread = strlen(report);
+    return TXP_SUCCESS;
+}
@@ -0,0 +1,55 @@
+#include "threadxp.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+struct thxp_start {
+    thxp_routine_t routine;
+    void *argument;
+};
+
+static void *thxp_start_routine(void *start);
+
+thxpResult thxp_create(thxp_thread_t *thread, thxp_routine_t routine,
+                       void *argument)
+{
+    struct thxp_start *start;
+    if (!thread || !routine)
+        return THXP_ERROR;
+    if (!(start = malloc(sizeof(*start))))
+        return THXP_ERROR;
+    start->routine = routine;
+    start->argument = argument;
+    if (pthread_create(thread, NULL, thxp_start_routine, start)) {
+        free(start);
+        return THXP_ERROR;
+    }
+    return THXP_SUCCESS;
+}
+
+thxpResult thxp_join(thxp_thread_t *thread)
+{
+    if (!thread || pthread_join(*thread, NULL))
+        return THXP_ERROR;
+    return THXP_SUCCESS;
+}
+
+thxpResult thxp_detach(thxp_thread_t *thread)
+{
+    if (!thread || pthread_detach(*thread))
+        return THXP_ERROR;
+    return THXP_SUCCESS;
+}
+
+unsigned int thxp_cpu_count()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1;
+}
+
+static void *thxp_start_routine(void *start)
+{
+    struct thxp_start copy = *(struct thxp_start *)start;
+    free(start);
+    copy.routine(copy.argument);
+    return NULL;
+}
@@ -0,0 +1,923 @@
+/*syscall() is not part of POSIX*/
+#define _GNU_SOURCE
+
+#include "uring.h"
+#include <endian.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define SXP_URING_SQ_ENTRIES 256
+#define SXP_URING_CQ_ENTRIES 4096
+/*buffers shared by the receives of all sockets, a power of two*/
+#define SXP_URING_BUFFERS 256
+#define SXP_URING_BUFFER_SIZE 4096
+/*
+buffers a socket may hold before its receive is stopped until they have been
+read, so that a single flooding client can not take all of them
+*/
+#define SXP_URING_HELD 16
+#define SXP_URING_GROUP 0
+
+/*user data of requests whose completions are not reported*/
+#define SXP_URING_IGNORE (~(__u64)0)
+#define SXP_URING_KEY_MASK 0xFFFFFFFFUL
+#define SXP_URING_TAG_MASK 0x7FFFFFFFUL
+#define SXP_URING_USER_DATA(tag, key) (((__u64)(tag) << 32) | (__u64)(key))
+/*set in the user data of receives, which carry the generation as their tag*/
+#define SXP_URING_RECV ((__u64)1 << 63)
+
+enum sxpuringflags {
+    SXP_URING_REGISTERED = 1,
+    /*a poll request for the current tag is owned by the kernel*/
+    SXP_URING_ARMED = 2,
+    /*the key is in the list of keys to arm on the next wait*/
+    SXP_URING_QUEUED = 4,
+    /*a multishot receive for the current generation is owned by the kernel*/
+    SXP_URING_RECEIVING = 8,
+    /*and its cancellation has been submitted*/
+    SXP_URING_CANCELLING = 16,
+    /*the receive ended for good, with end as its result*/
+    SXP_URING_ENDED = 32,
+    /*the key is in the list of keys to report on the next wait*/
+    SXP_URING_READY = 64
+};
+
+struct sxp_uring_entry {
+    int fd;
+    /*SXP_POLLIN, SXP_POLLOUT and SXP_POLLRECV*/
+    int events;
+    /*bumped on every change, completions carrying an older tag are dropped*/
+    unsigned long tag;
+    /*bumped on every add and remove, tags the receives*/
+    unsigned long generation;
+    int flags;
+    /*events of poll completions which have not been reported yet*/
+    int revents;
+    /*0 at the end of the stream or the errno the receive failed with*/
+    int end;
+    /*the buffers received into, oldest first, -1 if there are none*/
+    int first;
+    int last;
+    size_t held;
+    /*bytes of the first buffer which have been read already*/
+    size_t offset;
+};
+
+/*a buffer held by an entry*/
+struct sxp_uring_buffer {
+    size_t length;
+    int next;
+};
+
+struct sxp_uring {
+    int fd;
+    char *sq_ring;
+    size_t sq_ring_size;
+    char *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    /*sqes up to this tail are filled but not yet visible to the kernel*/
+    unsigned sq_local_tail;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /*registrations indexed by key*/
+    struct sxp_uring_entry *entries;
+    size_t entry_count;
+    /*keys which need a new poll request or receive*/
+    size_t *arming;
+    size_t arming_count;
+    size_t arming_capacity;
+    /*keys with events to report*/
+    size_t *ready;
+    size_t ready_count;
+    size_t ready_capacity;
+
+    /*the provided buffer ring, NULL if the kernel can not receive into it*/
+    struct io_uring_buf *buffer_ring;
+    char *buffer_data;
+    struct sxp_uring_buffer *buffers;
+    unsigned short buffer_tail;
+    /*buffers owned by the kernel*/
+    size_t buffers_free;
+    /*multishot receives owned by the kernel, of removed sockets as well*/
+    size_t receive_count;
+    /*set once the kernel refused a multishot receive*/
+    int receive_failed;
+};
+
+static int sxp_uring_enter(sxp_uring_t *ring, unsigned min_complete,
+                           unsigned flags, void *arg, size_t argsize);
+static struct io_uring_sqe *sxp_uring_sqe_get(sxp_uring_t *ring);
+static void sxp_uring_buffers_setup(sxp_uring_t *ring);
+static void sxp_uring_recycle(sxp_uring_t *ring, int bid);
+static int sxp_uring_receives(const sxp_uring_t *ring,
+                              const struct sxp_uring_entry *entry);
+static sxpResult sxp_uring_cancel(sxp_uring_t *ring, size_t key);
+static sxpResult sxp_uring_cancel_recv(sxp_uring_t *ring, size_t key);
+static sxpResult sxp_uring_stop(sxp_uring_t *ring, size_t key);
+static sxpResult sxp_uring_settle(sxp_uring_t *ring);
+static void sxp_uring_drop(sxp_uring_t *ring, struct sxp_uring_entry *entry);
+static sxpResult sxp_uring_queue(sxp_uring_t *ring, size_t key);
+static sxpResult sxp_uring_ready(sxp_uring_t *ring, size_t key);
+static sxpResult sxp_uring_arm(sxp_uring_t *ring);
+static sxpResult sxp_uring_arm_key(sxp_uring_t *ring, size_t key);
+static sxpResult sxp_uring_reap(sxp_uring_t *ring);
+static sxpResult sxp_uring_polled(sxp_uring_t *ring, __u64 user_data,
+                                  int res);
+static sxpResult sxp_uring_received(sxp_uring_t *ring, __u64 user_data,
+                                    int res, unsigned flags);
+static void sxp_uring_report(sxp_uring_t *ring, sxp_event_t events[],
+                             size_t *count, size_t limit);
+static sxpResult sxp_uring_map_error(int error);
+
+sxpResult sxp_uring_create(sxp_uring_t **ring)
+{
+    struct io_uring_params params;
+    sxp_uring_t *uring;
+
+    if (!ring)
+        return SXP_ERROR_INVAL;
+    if (!(uring = malloc(sizeof(*uring))))
+        return SXP_ERROR_MEMORY;
+    memset(uring, 0, sizeof(*uring));
+    uring->fd = -1;
+    uring->sq_ring = MAP_FAILED;
+    uring->cq_ring = MAP_FAILED;
+    uring->sqes = MAP_FAILED;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = SXP_URING_CQ_ENTRIES;
+    if ((uring->fd = syscall(__NR_io_uring_setup, SXP_URING_SQ_ENTRIES,
+                             &params)) < 0)
+        goto fail;
+    /*completions must never be dropped and waiting requires a timeout*/
+    if (!(params.features & IORING_FEAT_NODROP) ||
+        !(params.features & IORING_FEAT_EXT_ARG))
+        goto fail;
+
+    uring->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring->cq_ring_size > uring->sq_ring_size)
+            uring->sq_ring_size = uring->cq_ring_size;
+        uring->cq_ring_size = uring->sq_ring_size;
+    }
+    uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, uring->fd, IORING_OFF_SQ_RING);
+    if (uring->sq_ring == MAP_FAILED)
+        goto fail;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        uring->cq_ring = uring->sq_ring;
+    } else {
+        uring->cq_ring =
+            mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED, uring->fd, IORING_OFF_CQ_RING);
+        if (uring->cq_ring == MAP_FAILED)
+            goto fail;
+    }
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, uring->fd, IORING_OFF_SQES);
+    if (uring->sqes == MAP_FAILED)
+        goto fail;
+
+    uring->sq_head = (unsigned *)(uring->sq_ring + params.sq_off.head);
+    uring->sq_tail = (unsigned *)(uring->sq_ring + params.sq_off.tail);
+    uring->sq_array = (unsigned *)(uring->sq_ring + params.sq_off.array);
+    uring->sq_mask = *(unsigned *)(uring->sq_ring + params.sq_off.ring_mask);
+    uring->sq_entries = params.sq_entries;
+    uring->sq_local_tail = *uring->sq_tail;
+    uring->cq_head = (unsigned *)(uring->cq_ring + params.cq_off.head);
+    uring->cq_tail = (unsigned *)(uring->cq_ring + params.cq_off.tail);
+    uring->cq_mask = *(unsigned *)(uring->cq_ring + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)(uring->cq_ring + params.cq_off.cqes);
+    sxp_uring_buffers_setup(uring);
+
+    *ring = uring;
+    return SXP_SUCCESS;
+fail:
+    sxp_uring_destroy(uring);
+    return SXP_ERROR_PLATFORM;
+}
+
+sxpResult sxp_uring_destroy(sxp_uring_t *ring)
+{
+    struct io_uring_sqe *sqe;
+
+    if (!ring)
+        return SXP_ERROR_INVAL;
+    /*the kernel must be done with the buffers before they are freed*/
+    if (ring->receive_count && (sqe = sxp_uring_sqe_get(ring))) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        sqe->user_data = SXP_URING_IGNORE;
+        while (ring->receive_count && sxp_uring_settle(ring) == SXP_SUCCESS)
+            ;
+    }
+    if (ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != MAP_FAILED)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    /*closing the ring cancels all requests which are still in flight*/
+    if (ring->fd >= 0)
+        close(ring->fd);
+    if (ring->buffer_ring)
+        munmap(ring->buffer_ring,
+               SXP_URING_BUFFERS * sizeof(*ring->buffer_ring));
+    free(ring->buffer_data);
+    free(ring->buffers);
+    free(ring->entries);
+    free(ring->arming);
+    free(ring->ready);
+    free(ring);
+    return SXP_SUCCESS;
+}
+
+sxpResult sxp_uring_add(sxp_uring_t *ring, sxp_t *sock, int events,
+                        size_t key)
+{
+    struct sxp_uring_entry *entry;
+
+    if (!ring || !sock || (key & SXP_URING_KEY_MASK) != key)
+        return SXP_ERROR_INVAL;
+    if (key >= ring->entry_count) {
+        size_t entry_count = ring->entry_count ? ring->entry_count : 16;
+        struct sxp_uring_entry *entries;
+        while (entry_count <= key)
+            entry_count *= 2;
+        if (!(entries =
+                  realloc(ring->entries, entry_count * sizeof(*entries))))
+            return SXP_ERROR_MEMORY;
+        memset(entries + ring->entry_count, 0,
+               (entry_count - ring->entry_count) * sizeof(*entries));
+        ring->entries = entries;
+        ring->entry_count = entry_count;
+    }
+    entry = &ring->entries[key];
+    if (entry->flags & SXP_URING_REGISTERED)
+        return SXP_ERROR_INVAL;
+    entry->fd = *sock;
+    entry->events = events & (SXP_POLLIN | SXP_POLLOUT | SXP_POLLRECV);
+    entry->tag = (entry->tag + 1) & SXP_URING_TAG_MASK;
+    entry->generation = (entry->generation + 1) & SXP_URING_TAG_MASK;
+    /*the key may still be queued or ready from before*/
+    entry->flags = (entry->flags & (SXP_URING_QUEUED | SXP_URING_READY)) |
+                   SXP_URING_REGISTERED;
+    entry->revents = 0;
+    entry->end = 0;
+    entry->first = -1;
+    entry->last = -1;
+    entry->held = 0;
+    entry->offset = 0;
+    return sxp_uring_queue(ring, key);
+}
+
+sxpResult sxp_uring_modify(sxp_uring_t *ring, sxp_t *sock, int events,
+                           size_t key)
+{
+    struct sxp_uring_entry *entry;
+    sxpResult result;
+    int receives;
+
+    if (!ring || !sock || key >= ring->entry_count)
+        return SXP_ERROR_INVAL;
+    entry = &ring->entries[key];
+    if (!(entry->flags & SXP_URING_REGISTERED) || entry->fd != *sock)
+        return SXP_ERROR_INVAL;
+    events &= SXP_POLLIN | SXP_POLLOUT | SXP_POLLRECV;
+    if (events == entry->events)
+        return SXP_SUCCESS;
+    receives = sxp_uring_receives(ring, entry);
+    if ((result = sxp_uring_cancel(ring, key)) != SXP_SUCCESS)
+        return result;
+    entry->events = events;
+    entry->tag = (entry->tag + 1) & SXP_URING_TAG_MASK;
+    /*
+    the socket is read directly again once what has been received is read,
+    which must not race with the receive
+    */
+    if (receives && !sxp_uring_receives(ring, entry)) {
+        if ((result = sxp_uring_stop(ring, key)) != SXP_SUCCESS)
+            return result;
+        entry->flags &= ~SXP_URING_ENDED;
+    }
+    return sxp_uring_queue(ring, key);
+}
+
+sxpResult sxp_uring_remove(sxp_uring_t *ring, sxp_t *sock, size_t key)
+{
+    struct sxp_uring_entry *entry;
+    sxpResult result;
+
+    if (!ring || !sock || key >= ring->entry_count)
+        return SXP_ERROR_INVAL;
+    entry = &ring->entries[key];
+    if (!(entry->flags & SXP_URING_REGISTERED) || entry->fd != *sock)
+        return SXP_ERROR_INVAL;
+    result = sxp_uring_cancel(ring, key);
+    if (result == SXP_SUCCESS)
+        result = sxp_uring_cancel_recv(ring, key);
+    /*later completions of the receive only give their buffers back*/
+    sxp_uring_drop(ring, entry);
+    entry->flags &= ~(SXP_URING_REGISTERED | SXP_URING_RECEIVING |
+                      SXP_URING_CANCELLING | SXP_URING_ENDED);
+    entry->tag = (entry->tag + 1) & SXP_URING_TAG_MASK;
+    entry->generation = (entry->generation + 1) & SXP_URING_TAG_MASK;
+    return result;
+}
+
+sxpResult sxp_uring_wait(sxp_uring_t *ring, sxp_event_t events[],
+                         size_t *count, size_t limit, int timeout)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    sxpResult result;
+    int error;
+
+    if (!ring || !events || !count || !limit)
+        return SXP_ERROR_INVAL;
+    *count = 0;
+    if ((result = sxp_uring_arm(ring)) != SXP_SUCCESS)
+        return result;
+
+    /*the new requests are submitted by the same system call*/
+    if (!ring->ready_count &&
+        *ring->cq_head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        memset(&arg, 0, sizeof(arg));
+        if (timeout >= 0) {
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000L;
+            arg.ts = (__u64)(unsigned long)&ts;
+        }
+        error = sxp_uring_enter(ring, timeout ? 1 : 0,
+                                IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                                &arg, sizeof(arg));
+    } else {
+        error = sxp_uring_enter(ring, 0, 0, NULL, 0);
+    }
+    if (error == EINTR)
+        return SXP_TRY_AGAIN;
+    if (error && error != ETIME && error != EBUSY && error != EAGAIN)
+        return sxp_uring_map_error(error);
+
+    if ((result = sxp_uring_reap(ring)) != SXP_SUCCESS)
+        return result;
+    sxp_uring_report(ring, events, count, limit);
+    return *count > 0 ? SXP_SUCCESS : SXP_TRY_AGAIN;
+}
+
+int sxp_uring_receiving(sxp_uring_t *ring, size_t key)
+{
+    struct sxp_uring_entry *entry;
+
+    if (!ring || key >= ring->entry_count)
+        return 0;
+    entry = &ring->entries[key];
+    return (entry->flags & SXP_URING_REGISTERED) &&
+           (sxp_uring_receives(ring, entry) || entry->first >= 0 ||
+            (entry->flags & SXP_URING_RECEIVING));
+}
+
+sxpResult sxp_uring_recv(sxp_uring_t *ring, sxp_t *sock, size_t key,
+                         char *data, size_t *num_read, size_t size)
+{
+    struct sxp_uring_entry *entry;
+    sxpResult result;
+
+    if (!ring || !sock || !data || !num_read || key >= ring->entry_count)
+        return SXP_ERROR_INVAL;
+    entry = &ring->entries[key];
+    if (!(entry->flags & SXP_URING_REGISTERED) || entry->fd != *sock)
+        return SXP_ERROR_INVAL;
+    *num_read = 0;
+    while (entry->first >= 0 && *num_read < size) {
+        struct sxp_uring_buffer *buffer = &ring->buffers[entry->first];
+        size_t length = buffer->length - entry->offset;
+        if (length > size - *num_read)
+            length = size - *num_read;
+        memcpy(data + *num_read,
+               ring->buffer_data +
+                   (size_t)entry->first * SXP_URING_BUFFER_SIZE +
+                   entry->offset,
+               length);
+        *num_read += length;
+        entry->offset += length;
+        if (entry->offset == buffer->length) {
+            int next = buffer->next;
+            sxp_uring_recycle(ring, entry->first);
+            entry->first = next;
+            if (next < 0)
+                entry->last = -1;
+            entry->offset = 0;
+            entry->held--;
+        }
+    }
+    /*a receive stopped for holding too many buffers goes on*/
+    if (sxp_uring_receives(ring, entry) && entry->held < SXP_URING_HELD &&
+        !(entry->flags & (SXP_URING_RECEIVING | SXP_URING_ENDED)) &&
+        (result = sxp_uring_queue(ring, key)) != SXP_SUCCESS)
+        return result;
+    if (*num_read)
+        return SXP_SUCCESS;
+    if (entry->flags & SXP_URING_ENDED)
+        return entry->end ? SXP_ERROR_IO : SXP_SUCCESS;
+    return SXP_TRY_AGAIN;
+}
+
+static int sxp_uring_enter(sxp_uring_t *ring, unsigned min_complete,
+                           unsigned flags, void *arg, size_t argsize)
+{
+    unsigned submit;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    submit = ring->sq_local_tail -
+             __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (!submit && !(flags & IORING_ENTER_GETEVENTS))
+        return 0;
+    if (syscall(__NR_io_uring_enter, ring->fd, submit, min_complete, flags,
+                arg, argsize) < 0)
+        return errno;
+    return 0;
+}
+
+static struct io_uring_sqe *sxp_uring_sqe_get(sxp_uring_t *ring)
+{
+    struct io_uring_sqe *sqe;
+    unsigned index;
+
+    if (ring->sq_local_tail -
+            __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) ==
+        ring->sq_entries) {
+        /*the submission queue is full, hand it to the kernel early*/
+        if (sxp_uring_enter(ring, 0, 0, NULL, 0) ||
+            ring->sq_local_tail -
+                    __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) ==
+                ring->sq_entries)
+            return NULL;
+    }
+    index = ring->sq_local_tail & ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+static sxpResult sxp_uring_cancel(sxp_uring_t *ring, size_t key)
+{
+    struct sxp_uring_entry *entry = &ring->entries[key];
+    struct io_uring_sqe *sqe;
+
+    if (!(entry->flags & SXP_URING_ARMED))
+        return SXP_SUCCESS;
+    if (!(sqe = sxp_uring_sqe_get(ring)))
+        return SXP_ERROR_PLATFORM;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = SXP_URING_USER_DATA(entry->tag, key);
+    sqe->user_data = SXP_URING_IGNORE;
+    entry->flags &= ~SXP_URING_ARMED;
+    return SXP_SUCCESS;
+}
+
+static sxpResult sxp_uring_cancel_recv(sxp_uring_t *ring, size_t key)
+{
+    struct sxp_uring_entry *entry = &ring->entries[key];
+    struct io_uring_sqe *sqe;
+
+    if (!(entry->flags & SXP_URING_RECEIVING) ||
+        (entry->flags & SXP_URING_CANCELLING))
+        return SXP_SUCCESS;
+    if (!(sqe = sxp_uring_sqe_get(ring)))
+        return SXP_ERROR_PLATFORM;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = SXP_URING_RECV | SXP_URING_USER_DATA(entry->generation, key);
+    sqe->user_data = SXP_URING_IGNORE;
+    entry->flags |= SXP_URING_CANCELLING;
+    return SXP_SUCCESS;
+}
+
+/*cancels the receive of key and waits for its end, keeping what it got*/
+static sxpResult sxp_uring_stop(sxp_uring_t *ring, size_t key)
+{
+    struct sxp_uring_entry *entry = &ring->entries[key];
+    sxpResult result;
+
+    if ((result = sxp_uring_cancel_recv(ring, key)) != SXP_SUCCESS)
+        return result;
+    while (entry->flags & SXP_URING_RECEIVING) {
+        if ((result = sxp_uring_settle(ring)) != SXP_SUCCESS)
+            return result;
+    }
+    return SXP_SUCCESS;
+}
+
+/*submits what is queued and waits for at least one completion*/
+static sxpResult sxp_uring_settle(sxp_uring_t *ring)
+{
+    int error = sxp_uring_enter(ring, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (error && error != EINTR && error != EBUSY && error != EAGAIN)
+        return sxp_uring_map_error(error);
+    return sxp_uring_reap(ring);
+}
+
+/*gives the buffers held by entry back*/
+static void sxp_uring_drop(sxp_uring_t *ring, struct sxp_uring_entry *entry)
+{
+    while (entry->first >= 0) {
+        int next = ring->buffers[entry->first].next;
+        sxp_uring_recycle(ring, entry->first);
+        entry->first = next;
+    }
+    entry->last = -1;
+    entry->held = 0;
+    entry->offset = 0;
+}
+
+static sxpResult sxp_uring_queue(sxp_uring_t *ring, size_t key)
+{
+    struct sxp_uring_entry *entry = &ring->entries[key];
+
+    if (entry->flags & SXP_URING_QUEUED)
+        return SXP_SUCCESS;
+    if (ring->arming_count == ring->arming_capacity) {
+        size_t capacity =
+            ring->arming_capacity ? ring->arming_capacity * 2 : 16;
+        size_t *arming = realloc(ring->arming, capacity * sizeof(*arming));
+        if (!arming)
+            return SXP_ERROR_MEMORY;
+        ring->arming = arming;
+        ring->arming_capacity = capacity;
+    }
+    ring->arming[ring->arming_count++] = key;
+    entry->flags |= SXP_URING_QUEUED;
+    return SXP_SUCCESS;
+}
+
+static sxpResult sxp_uring_ready(sxp_uring_t *ring, size_t key)
+{
+    struct sxp_uring_entry *entry = &ring->entries[key];
+
+    if (entry->flags & SXP_URING_READY)
+        return SXP_SUCCESS;
+    if (ring->ready_count == ring->ready_capacity) {
+        size_t capacity = ring->ready_capacity ? ring->ready_capacity * 2 : 16;
+        size_t *ready = realloc(ring->ready, capacity * sizeof(*ready));
+        if (!ready)
+            return SXP_ERROR_MEMORY;
+        ring->ready = ready;
+        ring->ready_capacity = capacity;
+    }
+    ring->ready[ring->ready_count++] = key;
+    entry->flags |= SXP_URING_READY;
+    return SXP_SUCCESS;
+}
+
+static sxpResult sxp_uring_arm(sxp_uring_t *ring)
+{
+    size_t idx;
+    size_t kept = 0;
+    sxpResult result = SXP_SUCCESS;
+
+    for (idx = 0; idx < ring->arming_count; idx++) {
+        size_t key = ring->arming[idx];
+        sxpResult armed = SXP_TRY_AGAIN;
+        /*after a failure the remaining keys are kept for the next attempt*/
+        if (result == SXP_SUCCESS &&
+            (armed = sxp_uring_arm_key(ring, key)) < 0)
+            result = armed;
+        if (armed == SXP_SUCCESS)
+            ring->entries[key].flags &= ~SXP_URING_QUEUED;
+        else
+            ring->arming[kept++] = key;
+    }
+    ring->arming_count = kept;
+    return result;
+}
+
+/*SXP_TRY_AGAIN if the key has to wait for a free buffer*/
+static sxpResult sxp_uring_arm_key(sxp_uring_t *ring, size_t key)
+{
+    struct sxp_uring_entry *entry = &ring->entries[key];
+    int receives = sxp_uring_receives(ring, entry);
+    struct io_uring_sqe *sqe;
+    __u32 events;
+
+    if (!(entry->flags & SXP_URING_REGISTERED))
+        return SXP_SUCCESS;
+    if (!(entry->flags & SXP_URING_ARMED)) {
+        if (!(sqe = sxp_uring_sqe_get(ring)))
+            return SXP_ERROR_PLATFORM;
+        /*readability is reported by the receive, errors still by the poll*/
+        events = entry->events & (receives ? SXP_POLLOUT :
+                                             SXP_POLLIN | SXP_POLLOUT);
+#if __BYTE_ORDER == __BIG_ENDIAN
+        events = (events << 16) | (events >> 16);
+#endif
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = entry->fd;
+        sqe->poll32_events = events;
+        sqe->user_data = SXP_URING_USER_DATA(entry->tag, key);
+        entry->flags |= SXP_URING_ARMED;
+    }
+    if (!receives ||
+        (entry->flags & (SXP_URING_RECEIVING | SXP_URING_ENDED)) ||
+        entry->held >= SXP_URING_HELD)
+        return SXP_SUCCESS;
+    if (!ring->buffers_free)
+        return SXP_TRY_AGAIN;
+    if (!(sqe = sxp_uring_sqe_get(ring)))
+        return SXP_ERROR_PLATFORM;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = entry->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = SXP_URING_GROUP;
+    sqe->user_data =
+        SXP_URING_RECV | SXP_URING_USER_DATA(entry->generation, key);
+    entry->flags |= SXP_URING_RECEIVING;
+    ring->receive_count++;
+    return SXP_SUCCESS;
+}
+
+/*moves all completions into the entries*/
+static sxpResult sxp_uring_reap(sxp_uring_t *ring)
+{
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    sxpResult result = SXP_SUCCESS;
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        __u64 user_data = cqe->user_data;
+        sxpResult handled = SXP_SUCCESS;
+
+        /*every completion is handled, or buffers would get lost*/
+        if (user_data == SXP_URING_IGNORE)
+            ;
+        else if (user_data & SXP_URING_RECV)
+            handled = sxp_uring_received(ring, user_data, cqe->res,
+                                         cqe->flags);
+        else
+            handled = sxp_uring_polled(ring, user_data, cqe->res);
+        if (handled != SXP_SUCCESS)
+            result = handled;
+        head++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return result;
+}
+
+static sxpResult sxp_uring_polled(sxp_uring_t *ring, __u64 user_data,
+                                  int res)
+{
+    size_t key = (size_t)(user_data & SXP_URING_KEY_MASK);
+    struct sxp_uring_entry *entry;
+    int events;
+    sxpResult result;
+
+    if (key >= ring->entry_count)
+        return SXP_SUCCESS;
+    entry = &ring->entries[key];
+    /*completion of a request which has been removed or replaced*/
+    if (!(entry->flags & SXP_URING_REGISTERED) ||
+        entry->tag != (unsigned long)(user_data >> 32))
+        return SXP_SUCCESS;
+    entry->flags &= ~SXP_URING_ARMED;
+    if ((result = sxp_uring_queue(ring, key)) != SXP_SUCCESS)
+        return result;
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+    if (res > 0)
+        res = ((unsigned)res << 16) | ((unsigned)res >> 16);
+#endif
+    if (res < 0) {
+        events = SXP_POLLHUP;
+    } else {
+        events = res & (SXP_POLLIN | SXP_POLLOUT);
+        if (res & SXP_POLLHUP)
+            events |= SXP_POLLHUP;
+        if (res & SXP_POLLERR)
+            events |= SXP_POLLERR;
+    }
+    if (sxp_uring_receives(ring, entry))
+        events &= ~SXP_POLLIN;
+    if (!events)
+        return SXP_SUCCESS;
+    entry->revents |= events;
+    return sxp_uring_ready(ring, key);
+}
+
+static sxpResult sxp_uring_received(sxp_uring_t *ring, __u64 user_data,
+                                    int res, unsigned flags)
+{
+    size_t key = (size_t)(user_data & SXP_URING_KEY_MASK);
+    struct sxp_uring_entry *entry = NULL;
+    int bid = -1;
+    sxpResult result = SXP_SUCCESS;
+
+    if (flags & IORING_CQE_F_BUFFER) {
+        bid = (int)(flags >> IORING_CQE_BUFFER_SHIFT);
+        ring->buffers_free--;
+    }
+    if (!(flags & IORING_CQE_F_MORE))
+        ring->receive_count--;
+    if (key < ring->entry_count)
+        entry = &ring->entries[key];
+    /*a receive of a socket which has been removed since*/
+    if (!entry || !(entry->flags & SXP_URING_REGISTERED) ||
+        entry->generation !=
+            (unsigned long)((user_data >> 32) & SXP_URING_TAG_MASK)) {
+        if (bid >= 0)
+            sxp_uring_recycle(ring, bid);
+        return SXP_SUCCESS;
+    }
+
+    if (bid >= 0 && res > 0) {
+        ring->buffers[bid].length = res;
+        ring->buffers[bid].next = -1;
+        if (entry->last >= 0)
+            ring->buffers[entry->last].next = bid;
+        else
+            entry->first = bid;
+        entry->last = bid;
+        entry->held++;
+    } else if (bid >= 0) {
+        sxp_uring_recycle(ring, bid);
+    }
+
+    if (flags & IORING_CQE_F_MORE) {
+        if (entry->held >= SXP_URING_HELD)
+            result = sxp_uring_cancel_recv(ring, key);
+    } else {
+        entry->flags &= ~(SXP_URING_RECEIVING | SXP_URING_CANCELLING);
+        if (res == -EINVAL) {
+            size_t idx;
+            /*the kernel has no multishot receives, poll for reading instead*/
+            ring->receive_failed = 1;
+            for (idx = 0; idx < ring->entry_count && result == SXP_SUCCESS;
+                 idx++) {
+                struct sxp_uring_entry *other = &ring->entries[idx];
+                if (!(other->flags & SXP_URING_REGISTERED) ||
+                    !(other->events & SXP_POLLRECV))
+                    continue;
+                if ((result = sxp_uring_cancel(ring, idx)) == SXP_SUCCESS)
+                    result = sxp_uring_queue(ring, idx);
+                other->tag = (other->tag + 1) & SXP_URING_TAG_MASK;
+            }
+            return result;
+        }
+        /*out of buffers, stopped or cancelled receives are armed again*/
+        if (res == 0 ||
+            (res < 0 && res != -ENOBUFS && res != -ECANCELED)) {
+            entry->flags |= SXP_URING_ENDED;
+            entry->end = res < 0 ? -res : 0;
+        }
+        result = sxp_uring_queue(ring, key);
+    }
+    if (result == SXP_SUCCESS &&
+        (entry->first >= 0 || (entry->flags & SXP_URING_ENDED)))
+        result = sxp_uring_ready(ring, key);
+    return result;
+}
+
+/*
+fills events from the ready keys. Keys which did not fit are reported first
+on the next wait, received data is reported again until it has been read.
+*/
+static void sxp_uring_report(sxp_uring_t *ring, sxp_event_t events[],
+                             size_t *count, size_t limit)
+{
+    size_t idx;
+    size_t kept = 0;
+
+    for (idx = 0; idx < ring->ready_count; idx++) {
+        size_t key = ring->ready[idx];
+        struct sxp_uring_entry *entry = &ring->entries[key];
+        int ready = 0;
+
+        if (entry->flags & SXP_URING_REGISTERED) {
+            ready = entry->revents;
+            if (entry->first >= 0 || (sxp_uring_receives(ring, entry) &&
+                                      (entry->flags & SXP_URING_ENDED)))
+                ready |= SXP_POLLIN;
+        }
+        if (ready && *count == limit) {
+            ring->ready[kept++] = key;
+            continue;
+        }
+        entry->flags &= ~SXP_URING_READY;
+        if (!ready)
+            continue;
+        events[*count].key = key;
+        events[*count].events = ready;
+        *count += 1;
+        entry->revents = 0;
+    }
+    ring->ready_count = kept;
+    for (idx = 0; idx < *count; idx++) {
+        struct sxp_uring_entry *entry = &ring->entries[events[idx].key];
+        /*fits, all these keys have been in the list before*/
+        if (entry->first >= 0 || (entry->flags & SXP_URING_ENDED))
+            (void)sxp_uring_ready(ring, events[idx].key);
+    }
+}
+
+static sxpResult sxp_uring_map_error(int error)
+{
+    switch (error) {
+    case ENOMEM:
+        return SXP_ERROR_MEMORY;
+    case EINVAL:
+    case EBADF:
+    case EFAULT:
+        return SXP_ERROR_INVAL;
+    default:
+        return SXP_ERROR_PLATFORM;
+    }
+}
+
+/*
+registers the provided buffer ring, receiving is left to poll requests if
+the kernel does not support it
+*/
+static void sxp_uring_buffers_setup(sxp_uring_t *ring)
+{
+    struct io_uring_buf_reg reg;
+    size_t size = SXP_URING_BUFFERS * sizeof(*ring->buffer_ring);
+    int bid;
+
+    ring->buffer_ring = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buffer_ring == MAP_FAILED) {
+        ring->buffer_ring = NULL;
+        return;
+    }
+    ring->buffer_data = malloc(SXP_URING_BUFFERS * SXP_URING_BUFFER_SIZE);
+    ring->buffers = malloc(SXP_URING_BUFFERS * sizeof(*ring->buffers));
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (__u64)(unsigned long)ring->buffer_ring;
+    reg.ring_entries = SXP_URING_BUFFERS;
+    reg.bgid = SXP_URING_GROUP;
+    if (!ring->buffer_data || !ring->buffers ||
+        syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING,
+                &reg, 1) < 0) {
+        munmap(ring->buffer_ring, size);
+        ring->buffer_ring = NULL;
+        free(ring->buffer_data);
+        ring->buffer_data = NULL;
+        free(ring->buffers);
+        ring->buffers = NULL;
+        return;
+    }
+    for (bid = 0; bid < SXP_URING_BUFFERS; bid++)
+        sxp_uring_recycle(ring, bid);
+}
+
+/*hands the buffer bid to the kernel again*/
+static void sxp_uring_recycle(sxp_uring_t *ring, int bid)
+{
+    struct io_uring_buf *buffer;
+
+    if (!ring->buffer_ring)
+        return;
+    buffer = &ring->buffer_ring[ring->buffer_tail & (SXP_URING_BUFFERS - 1)];
+    buffer->addr = (__u64)(unsigned long)(ring->buffer_data +
+                                          (size_t)bid * SXP_URING_BUFFER_SIZE);
+    buffer->len = SXP_URING_BUFFER_SIZE;
+    buffer->bid = (__u16)bid;
+    ring->buffer_tail++;
+    ring->buffers_free++;
+    /*the tail takes the place of the reserved field of the first buffer*/
+    __atomic_store_n(&ring->buffer_ring[0].resv, ring->buffer_tail,
+                     __ATOMIC_RELEASE);
+}
+
+static int sxp_uring_receives(const sxp_uring_t *ring,
+                              const struct sxp_uring_entry *entry)
+{
+    return ring->buffer_ring && !ring->receive_failed &&
+           (entry->events & SXP_POLLRECV) && (entry->events & SXP_POLLIN);
+}
+
@@ -0,0 +1,40 @@
+#ifndef URING_H_
+#define URING_H_
+
+#include "socketxp.h"
+
+/*
+readiness notification through io_uring, used by sxp_poller on linux when
+SXP_POLLER_URING is requested. Sockets are watched with poll requests which
+are rearmed after every completion, so readiness is level triggered just like
+epoll. All requests queued between two calls of sxp_uring_wait are submitted
+together with the wait in a single io_uring_enter.
+
+Sockets registered with SXP_POLLRECV are read by a multishot receive into
+buffers provided to the kernel by the ring, so that a busy socket costs no
+system call per read. What was received is handed out by sxp_uring_recv and
+the buffers are given back to the kernel once read. The poll request of such
+a socket only waits for SXP_POLLOUT and errors. Kernels without multishot
+receives or provided buffer rings get plain poll requests instead.
+
+Accepts and sends are not queued on the ring, they are still made with
+their own system calls once the socket is reported ready.
+*/
+typedef struct sxp_uring sxp_uring_t;
+
+sxpResult sxp_uring_create(sxp_uring_t **ring);
+sxpResult sxp_uring_destroy(sxp_uring_t *ring);
+
+sxpResult sxp_uring_add(sxp_uring_t *ring, sxp_t *sock, int events,
+                        size_t key);
+sxpResult sxp_uring_modify(sxp_uring_t *ring, sxp_t *sock, int events,
+                           size_t key);
+sxpResult sxp_uring_remove(sxp_uring_t *ring, sxp_t *sock, size_t key);
+sxpResult sxp_uring_wait(sxp_uring_t *ring, sxp_event_t events[],
+                         size_t *count, size_t limit, int timeout);
+/*nonzero while reads of the socket of key have to go through sxp_uring_recv*/
+int sxp_uring_receiving(sxp_uring_t *ring, size_t key);
+sxpResult sxp_uring_recv(sxp_uring_t *ring, sxp_t *sock, size_t key,
+                         char *data, size_t *num_read, size_t size);
+
+#endif /*URING_H_*/
@@ -0,0 +1,21 @@
+#include "shmxp.h"
+
+shmxpResult shmxp_create(shmxp_region_t *region, size_t size)
+{
+    (void)region;
+    (void)size;
+    return SHMXP_ERROR_PLATFORM;
+}
+
+shmxpResult shmxp_attach(shmxp_region_t *region, int fd)
+{
+    (void)region;
+    (void)fd;
+    return SHMXP_ERROR_PLATFORM;
+}
+
+shmxpResult shmxp_destroy(shmxp_region_t *region)
+{
+    (void)region;
+    return SHMXP_ERROR_PLATFORM;
+}
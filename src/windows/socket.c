@@ -1,9 +1,24 @@
 #include "socketxp.h"
+#include <string.h>
+
+struct sxp_poller {
+    pollsxp_t *list;
+    /*key of every entry in list*/
+    size_t *keys;
+    size_t count;
+    size_t capacity;
+    /*index into list for every key*/
+    size_t *slots;
+    size_t slot_count;
+    /*entry of list to look at first, so that no socket is left behind*/
+    size_t next;
+};
 
 static sxpResult sxp_map_error(int error);
 static sxpResult sxp_map_eai_error(int error);
+static sxpResult platform_cleanup();
 
-sxpResult sxp_init()
+static sxpResult platform_init()
 {
     WORD versionReq;
     WSADATA wsaData;
@@ -13,20 +28,20 @@ sxpResult sxp_init()
     if (WSAStartup(versionReq, &wsaData))
         return SXP_ERROR_PLATFORM;
     if (LOBYTE(wsaData.wVersion) != 2 || HIBYTE(wsaData.wVersion) != 2) {
-        sxp_cleanup();
+        platform_cleanup();
         return SXP_ERROR_PLATFORM;
     }
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_cleanup()
+static sxpResult platform_cleanup()
 {
     if (WSACleanup())
         return sxp_map_error(WSAGetLastError());
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_create(sxp_t *dst, int family, int type, int protocol)
+static sxpResult platform_create(sxp_t *dst, int family, int type, int protocol)
 {
     if (!dst)
         return SXP_ERROR_INVAL;
@@ -36,7 +51,7 @@ sxpResult sxp_create(sxp_t *dst, int family, int type, int protocol)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_destroy(sxp_t *sock)
+static sxpResult platform_destroy(sxp_t *sock)
 {
     if (!sock)
         return SXP_ERROR_INVAL;
@@ -45,7 +60,7 @@ sxpResult sxp_destroy(sxp_t *sock)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_nbio_set(sxp_t *sock, int nonblockingio)
+static sxpResult platform_nbio_set(sxp_t *sock, int nonblockingio)
 {
     unsigned long int mode = (nonblockingio == SXP_NONBLOCKING) ? 1 : 0;
     if (!sock)
@@ -55,8 +70,10 @@ sxpResult sxp_nbio_set(sxp_t *sock, int nonblockingio)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_addrinfo_get(addrinfo_t **results, const char *maybe_hostname,
-                           const char *serviceport, addrinfo_t *hints)
+static sxpResult platform_addrinfo_get(addrinfo_t **results,
+                                       const char *maybe_hostname,
+                                       const char *serviceport,
+                                       addrinfo_t *hints)
 {
     int result = getaddrinfo(maybe_hostname, serviceport, hints, results);
     if (result != 0) {
@@ -65,14 +82,15 @@ sxpResult sxp_addrinfo_get(addrinfo_t **results, const char *maybe_hostname,
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_addrinfo_free(addrinfo_t *info)
+static sxpResult platform_addrinfo_free(addrinfo_t *info)
 {
     freeaddrinfo(info);
     return SXP_SUCCESS;
 }
 
 /*server-side API*/
-sxpResult sxp_bind(sxp_t *sock, const sockaddr_t *address, size_t addrlen)
+static sxpResult platform_bind(sxp_t *sock, const sockaddr_t *address,
+                               size_t addrlen)
 {
     const BOOL yes = 1;
     if (!sock)
@@ -85,7 +103,7 @@ sxpResult sxp_bind(sxp_t *sock, const sockaddr_t *address, size_t addrlen)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_listen(sxp_t *sock, size_t backlog)
+static sxpResult platform_listen(sxp_t *sock, size_t backlog)
 {
     if (!sock)
         return SXP_ERROR_INVAL;
@@ -94,41 +112,100 @@ sxpResult sxp_listen(sxp_t *sock, size_t backlog)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_accept(sxp_t *sock, sxp_t *newsock)
+static sxpResult platform_accept(sxp_t *sock, sxp_t *newsock, int nonblockingio)
 {
+    sxpResult result;
     if (!sock || !newsock)
         return SXP_ERROR_INVAL;
     if ((*newsock = accept(*sock, NULL, NULL)) == INVALID_SOCKET)
         return sxp_map_error(WSAGetLastError());
+    if ((result = platform_nbio_set(newsock, nonblockingio)) != SXP_SUCCESS) {
+        closesocket(*newsock);
+        return result;
+    }
     return SXP_SUCCESS;
 }
 
 /*client-side API*/
-sxpResult sxp_connect(sxp_t *sock, sockaddr_t *address, size_t addrlen)
+static sxpResult platform_connect(sxp_t *sock, sockaddr_t *address,
+                                  size_t addrlen)
 {
     if (!sock)
         return SXP_ERROR_INVAL;
-    if (connect(*sock, address, addrlen))
+    if (connect(*sock, address, addrlen)) {
+        int error = WSAGetLastError();
+        /*nonblocking connects report WSAEWOULDBLOCK instead of EINPROGRESS*/
+        return error == WSAEWOULDBLOCK ? SXP_ASYNC : sxp_map_error(error);
+    }
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_connect_finish(sxp_t *sock)
+{
+    int error = 0;
+    int length = sizeof(error);
+    if (!sock)
+        return SXP_ERROR_INVAL;
+    if (getsockopt(*sock, SOL_SOCKET, SO_ERROR, (char *)&error, &length))
         return sxp_map_error(WSAGetLastError());
+    if (error)
+        return sxp_map_error(error);
     return SXP_SUCCESS;
 }
 
-/*any-side API*/
-sxpResult sxp_send(sxp_t *sock, const char *data, size_t size)
+static sxpResult platform_shutdown(sxp_t *sock)
 {
     if (!sock)
         return SXP_ERROR_INVAL;
-    while (size) {
-        int sent;
-        if ((sent = send(*sock, data, size, 0)) == SOCKET_ERROR)
-            return sxp_map_error(WSAGetLastError());
-        data += sent;
-        size -= sent;
-    }
+    if (shutdown(*sock, SD_SEND) == SOCKET_ERROR)
+        return sxp_map_error(WSAGetLastError());
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_unix_address(struct sockaddr_storage *address,
+                                       size_t *addrlen, const char *path)
+{
+    (void)address;
+    (void)addrlen;
+    (void)path;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_unix_unlink(const char *path)
+{
+    (void)path;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_send_fd(sxp_t *sock, int fd)
+{
+    (void)sock;
+    (void)fd;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_recv_fd(sxp_t *sock, int *fd)
+{
+    (void)sock;
+    (void)fd;
+    return SXP_ERROR_PLATFORM;
+}
+
+/*any-side API*/
+static sxpResult platform_send(sxp_t *sock, const char *data, size_t *num_sent,
+                               size_t size)
+{
+    int sent;
+    if (!sock || !num_sent)
+        return SXP_ERROR_INVAL;
+    if ((sent = send(*sock, data, size, 0)) == SOCKET_ERROR)
+        return sxp_map_error(WSAGetLastError());
+    *num_sent = sent;
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_recv(sxp_t *sock, char *data, size_t *num_read, size_t size)
+static sxpResult platform_recv(sxp_t *sock, char *data, size_t *num_read,
+                               size_t size)
 {
     int read;
     if (!sock || !num_read)
@@ -139,8 +216,105 @@ sxpResult sxp_recv(sxp_t *sock, char *data, size_t *num_read, size_t size)
     return SXP_SUCCESS;
 }
 
-sxpResult sxp_poll(size_t /*maybe NULL*/ *results, pollsxp_t sxps[],
-                   size_t sxpcount, int timeout)
+static sxpResult platform_sendv(sxp_t *sock, const sxp_buffer_t buffers[],
+                                size_t count, size_t *num_sent)
+{
+    WSABUF wsabufs[SXP_IOV_MAX];
+    DWORD sent;
+    size_t idx;
+    if (!sock || !buffers || !num_sent)
+        return SXP_ERROR_INVAL;
+    if (count > SXP_IOV_MAX)
+        return SXP_TOO_BIG;
+    for (idx = 0; idx < count; idx++) {
+        wsabufs[idx].buf = (char *)buffers[idx].data;
+        wsabufs[idx].len = buffers[idx].size;
+    }
+    if (WSASend(*sock, wsabufs, count, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+        return sxp_map_error(WSAGetLastError());
+    *num_sent = sent;
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_zerocopy_set(sxp_t *sock, int enabled)
+{
+    (void)sock;
+    (void)enabled;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_send_zerocopy(sxp_t *sock, const char *data,
+                                        size_t *num_sent, size_t size,
+                                        int *pinned)
+{
+    (void)sock;
+    (void)data;
+    (void)num_sent;
+    (void)size;
+    (void)pinned;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_zerocopy_completed(sxp_t *sock, unsigned long *first,
+                                             unsigned long *last, int *copied)
+{
+    (void)sock;
+    (void)first;
+    (void)last;
+    (void)copied;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_transport_get(sxp_t *sock, sxp_transport_t *transport)
+{
+    (void)sock;
+    (void)transport;
+    return SXP_ERROR_PLATFORM;
+}
+
+static sxpResult platform_pair(sxp_t pair[2])
+{
+    struct sockaddr_in address;
+    int addrlen = sizeof(address);
+    SOCKET listener;
+
+    if (!pair)
+        return SXP_ERROR_INVAL;
+    /*there is no socketpair on windows, connect two sockets over loopback*/
+    if ((listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) ==
+        INVALID_SOCKET)
+        return sxp_map_error(WSAGetLastError());
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    pair[0] = INVALID_SOCKET;
+    pair[1] = INVALID_SOCKET;
+    if (bind(listener, (sockaddr_t *)&address, sizeof(address)) ||
+        getsockname(listener, (sockaddr_t *)&address, &addrlen) ||
+        listen(listener, 1))
+        goto fail;
+    if ((pair[1] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) ==
+            INVALID_SOCKET ||
+        connect(pair[1], (sockaddr_t *)&address, sizeof(address)) ||
+        (pair[0] = accept(listener, NULL, NULL)) == INVALID_SOCKET)
+        goto fail;
+    closesocket(listener);
+    return SXP_SUCCESS;
+fail:
+    if (pair[1] != INVALID_SOCKET)
+        closesocket(pair[1]);
+    closesocket(listener);
+    return sxp_map_error(WSAGetLastError());
+}
+
+static unsigned long platform_clock()
+{
+    return GetTickCount();
+}
+
+static sxpResult platform_poll(size_t /*maybe NULL*/ *results, pollsxp_t sxps[],
+                               size_t sxpcount, int timeout)
 {
     int res;
     if (!sxpcount)
@@ -156,6 +330,141 @@ sxpResult sxp_poll(size_t /*maybe NULL*/ *results, pollsxp_t sxps[],
     return res > 0 ? SXP_SUCCESS : SXP_TRY_AGAIN;
 }
 
+static sxpResult platform_poller_create(sxp_poller_t **poller, int kind)
+{
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    if (kind != SXP_POLLER_DEFAULT)
+        return SXP_ERROR_PLATFORM;
+    if (!(*poller = malloc(sizeof(**poller))))
+        return SXP_ERROR_MEMORY;
+    memset(*poller, 0, sizeof(**poller));
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_destroy(sxp_poller_t *poller)
+{
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    free(poller->list);
+    free(poller->keys);
+    free(poller->slots);
+    free(poller);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_add(sxp_poller_t *poller, sxp_t *sock,
+                                     int events, size_t key)
+{
+    if (!poller || !sock)
+        return SXP_ERROR_INVAL;
+    if (poller->count == poller->capacity) {
+        size_t capacity = poller->capacity ? poller->capacity * 2 : 16;
+        pollsxp_t *list = realloc(poller->list, capacity * sizeof(*list));
+        size_t *keys;
+        if (!list)
+            return SXP_ERROR_MEMORY;
+        poller->list = list;
+        if (!(keys = realloc(poller->keys, capacity * sizeof(*keys))))
+            return SXP_ERROR_MEMORY;
+        poller->keys = keys;
+        poller->capacity = capacity;
+    }
+    if (key >= poller->slot_count) {
+        size_t slot_count = poller->slot_count ? poller->slot_count : 16;
+        size_t *slots;
+        while (slot_count <= key)
+            slot_count *= 2;
+        if (!(slots = realloc(poller->slots, slot_count * sizeof(*slots))))
+            return SXP_ERROR_MEMORY;
+        poller->slots = slots;
+        poller->slot_count = slot_count;
+    }
+    poller->list[poller->count].fd = *sock;
+    poller->list[poller->count].events =
+        events & (SXP_POLLIN | SXP_POLLOUT);
+    poller->list[poller->count].revents = 0;
+    poller->keys[poller->count] = key;
+    poller->slots[key] = poller->count;
+    poller->count++;
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_modify(sxp_poller_t *poller, sxp_t *sock,
+                                        int events, size_t key)
+{
+    size_t slot;
+    if (!poller || !sock || key >= poller->slot_count)
+        return SXP_ERROR_INVAL;
+    slot = poller->slots[key];
+    if (slot >= poller->count || poller->list[slot].fd != *sock)
+        return SXP_ERROR_INVAL;
+    poller->list[slot].events = events & (SXP_POLLIN | SXP_POLLOUT);
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_remove(sxp_poller_t *poller, sxp_t *sock,
+                                        size_t key)
+{
+    size_t slot;
+    if (!poller || !sock || key >= poller->slot_count)
+        return SXP_ERROR_INVAL;
+    slot = poller->slots[key];
+    if (slot >= poller->count || poller->list[slot].fd != *sock)
+        return SXP_ERROR_INVAL;
+    poller->count--;
+    poller->list[slot] = poller->list[poller->count];
+    poller->keys[slot] = poller->keys[poller->count];
+    poller->slots[poller->keys[slot]] = slot;
+    return SXP_SUCCESS;
+}
+
+static sxpResult platform_poller_wait(sxp_poller_t *poller,
+                                      sxp_event_t events[], size_t *count,
+                                      size_t limit, int timeout)
+{
+    size_t ready;
+    size_t seen;
+    sxpResult result;
+    if (!poller || !events || !count || !limit)
+        return SXP_ERROR_INVAL;
+    *count = 0;
+    if (!poller->count) {
+        if (timeout > 0)
+            Sleep(timeout);
+        return SXP_TRY_AGAIN;
+    }
+    if ((result = platform_poll(&ready, poller->list, poller->count,
+                                timeout)) != SXP_SUCCESS)
+        return result;
+    for (seen = 0; seen < poller->count && *count < limit; seen++) {
+        size_t idx = (poller->next + seen) % poller->count;
+        int revents = poller->list[idx].revents;
+        if (!revents)
+            continue;
+        events[*count].key = poller->keys[idx];
+        events[*count].events = revents & (SXP_POLLIN | SXP_POLLOUT);
+        if (revents & SXP_POLLHUP)
+            events[*count].events |= SXP_POLLHUP;
+        if (revents & SXP_POLLERR)
+            events[*count].events |= SXP_POLLERR;
+        *count += 1;
+    }
+    poller->next = (poller->next + seen) % poller->count;
+    return *count > 0 ? SXP_SUCCESS : SXP_TRY_AGAIN;
+}
+
+/*WSAPoll pollers never receive ahead*/
+static sxpResult platform_poller_recv(sxp_poller_t *poller, sxp_t *sock,
+                                      size_t key, char *data,
+                                      size_t *num_read, size_t size)
+{
+    (void)key;
+    if (!poller)
+        return SXP_ERROR_INVAL;
+    return platform_recv(sock, data, num_read, size);
+}
+
 static sxpResult sxp_map_eai_error(int error)
 {
     switch (error) {
@@ -240,3 +549,16 @@ static sxpResult sxp_map_error(int error)
     }
     return SXP_ERROR_UNKNOWN;
 }
+
+const sxp_vtable_t sxp_platform = {
+    1, platform_init, platform_cleanup, platform_create, platform_destroy,
+    platform_nbio_set, platform_addrinfo_get, platform_addrinfo_free,
+    platform_bind, platform_listen, platform_accept, platform_unix_address,
+    platform_unix_unlink, platform_send_fd, platform_recv_fd, platform_connect,
+    platform_connect_finish, platform_shutdown, platform_send, platform_recv,
+    platform_sendv, platform_zerocopy_set, platform_send_zerocopy,
+    platform_zerocopy_completed, platform_transport_get, platform_pair,
+    platform_clock, platform_poll, platform_poller_create,
+    platform_poller_destroy, platform_poller_add, platform_poller_modify,
+    platform_poller_remove, platform_poller_wait, platform_poller_recv
+};
@@ -207,3 +207,11 @@ txpResult txp_recv(char *buffer, size_t *nread, size_t blen)
     }
     return TXP_SUCCESS;
 }
+
+txpResult txp_wait_get(int fds[TXP_WAIT_MAX], size_t *count)
+{
+    (void)fds;
+    *count = 0;
+    /*console handles can not be waited on together with sockets*/
+    return TXP_ERROR;
+}
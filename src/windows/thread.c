@@ -0,0 +1,57 @@
+#include "threadxp.h"
+#include <stdlib.h>
+
+struct thxp_start {
+    thxp_routine_t routine;
+    void *argument;
+};
+
+static DWORD WINAPI thxp_start_routine(LPVOID start);
+
+thxpResult thxp_create(thxp_thread_t *thread, thxp_routine_t routine,
+                       void *argument)
+{
+    struct thxp_start *start;
+    if (!thread || !routine)
+        return THXP_ERROR;
+    if (!(start = malloc(sizeof(*start))))
+        return THXP_ERROR;
+    start->routine = routine;
+    start->argument = argument;
+    if (!(*thread = CreateThread(NULL, 0, thxp_start_routine, start, 0,
+                                 NULL))) {
+        free(start);
+        return THXP_ERROR;
+    }
+    return THXP_SUCCESS;
+}
+
+thxpResult thxp_join(thxp_thread_t *thread)
+{
+    if (!thread || WaitForSingleObject(*thread, INFINITE) != WAIT_OBJECT_0)
+        return THXP_ERROR;
+    CloseHandle(*thread);
+    return THXP_SUCCESS;
+}
+
+thxpResult thxp_detach(thxp_thread_t *thread)
+{
+    if (!thread || !CloseHandle(*thread))
+        return THXP_ERROR;
+    return THXP_SUCCESS;
+}
+
+unsigned int thxp_cpu_count()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+static DWORD WINAPI thxp_start_routine(LPVOID start)
+{
+    struct thxp_start copy = *(struct thxp_start *)start;
+    free(start);
+    copy.routine(copy.argument);
+    return 0;
+}